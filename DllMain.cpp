@@ -17,9 +17,11 @@ int WINAPI DllMain(HINSTANCE hInstDll, DWORD fdwReason, LPVOID /* lpvReserved */
     {
         case DLL_PROCESS_ATTACH:
             InitInstance(hInstDll);
+            MsiSharedCacheInitialize();
             break;
 
         case DLL_PROCESS_DETACH:
+            MsiSharedCacheCleanup();
             g_hInst = NULL;
             break;
     }
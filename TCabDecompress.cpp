@@ -0,0 +1,910 @@
+/*****************************************************************************/
+/* TCabDecompress.cpp                     Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Built-in MSZIP and LZX decompressors for the cabinet files                */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 16.10.26  1.00  Lad  Created                                              */
+/*****************************************************************************/
+
+#include "wcx_msi.h"
+
+//-----------------------------------------------------------------------------
+// Local variables
+
+// Deflate: base lengths and extra bits for length codes 257-285
+static const WORD DeflateLengthBase[29] =
+{
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+static const BYTE DeflateLengthExtra[29] =
+{
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+// Deflate: base distances and extra bits for distance codes 0-29
+static const WORD DeflateDistBase[30] =
+{
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+
+static const BYTE DeflateDistExtra[30] =
+{
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+// Deflate: order of the code length code lengths
+static const BYTE DeflateLengthOrder[19] =
+{
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+// LZX: number of position slots for window sizes 2^15 - 2^21
+static const BYTE LzxPositionSlots[] = {30, 32, 34, 36, 38, 42, 50};
+
+// LZX: extra bits and position base for each position slot
+static const BYTE LzxExtraBits[LZX_MAX_POSITION_SLOTS] =
+{
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13, 14, 14,
+    15, 15, 16, 16, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17, 17,
+    17, 17
+};
+
+static const DWORD LzxPositionBase[LZX_MAX_POSITION_SLOTS] =
+{
+    0, 1, 2, 3, 4, 6, 8, 12, 16, 24, 32, 48, 64, 96, 128, 192,
+    256, 384, 512, 768, 1024, 1536, 2048, 3072, 4096, 6144, 8192, 12288, 16384, 24576, 32768, 49152,
+    65536, 98304, 131072, 196608, 262144, 393216, 524288, 655360, 786432, 917504, 1048576, 1179648, 1310720, 1441792, 1572864, 1703936,
+    1835008, 1966080
+};
+
+//-----------------------------------------------------------------------------
+// Local (non-class) functions
+
+static DWORD ReverseBits(DWORD dwCode, DWORD nBits)
+{
+    DWORD dwResult = 0;
+
+    for(DWORD i = 0; i < nBits; i++)
+    {
+        dwResult = (dwResult << 1) | (dwCode & 1);
+        dwCode >>= 1;
+    }
+    return dwResult;
+}
+
+//-----------------------------------------------------------------------------
+// CAB_HUFFMAN functions
+
+DWORD CAB_HUFFMAN::Build(const BYTE * Lengths, DWORD dwSymbols, bool bLsbFirst)
+{
+    DWORD NextCode[CAB_HUFFMAN_MAX_BITS + 1];
+    DWORD dwCode = 0;
+    DWORD dwIndex = 0;
+    LONG nLeft = 1;
+
+    // Count the codes of each length
+    memset(Count, 0, sizeof(Count));
+    for(DWORD i = 0; i < dwSymbols; i++)
+    {
+        if(Lengths[i] > CAB_HUFFMAN_MAX_BITS)
+            return ERROR_BAD_FORMAT;
+        Count[Lengths[i]]++;
+    }
+    Count[0] = 0;
+
+    // Check for over-subscribed set of lengths. Incomplete sets are allowed
+    for(DWORD nBits = 1; nBits <= CAB_HUFFMAN_MAX_BITS; nBits++)
+    {
+        nLeft = (nLeft << 1) - Count[nBits];
+        if(nLeft < 0)
+            return ERROR_BAD_FORMAT;
+    }
+
+    // Assign the first code and the first symbol index of each length
+    FirstCode[0] = FirstIndex[0] = 0;
+    for(DWORD nBits = 1; nBits <= CAB_HUFFMAN_MAX_BITS; nBits++)
+    {
+        dwCode = (dwCode + Count[nBits - 1]) << 1;
+        FirstCode[nBits] = NextCode[nBits] = dwCode;
+        FirstIndex[nBits] = dwIndex;
+        dwIndex += Count[nBits];
+    }
+
+    // Sort the symbols by their codes and fill the lookup table
+    Symbols.resize(dwIndex);
+    Fast.assign(1 << CAB_HUFFMAN_FAST_BITS, 0);
+    for(DWORD i = 0; i < dwSymbols; i++)
+    {
+        DWORD nBits = Lengths[i];
+
+        if(nBits != 0)
+        {
+            dwCode = NextCode[nBits]++;
+            Symbols[FirstIndex[nBits] + dwCode - FirstCode[nBits]] = (WORD)(i);
+
+            if(nBits <= CAB_HUFFMAN_FAST_BITS)
+            {
+                DWORD dwEntry = (i << 8) | nBits;
+                DWORD dwFill = 1 << (CAB_HUFFMAN_FAST_BITS - nBits);
+
+                if(bLsbFirst)
+                {
+                    dwCode = ReverseBits(dwCode, nBits);
+                    for(DWORD j = 0; j < dwFill; j++)
+                        Fast[dwCode | (j << nBits)] = dwEntry;
+                }
+                else
+                {
+                    dwCode = dwCode << (CAB_HUFFMAN_FAST_BITS - nBits);
+                    for(DWORD j = 0; j < dwFill; j++)
+                        Fast[dwCode | j] = dwEntry;
+                }
+            }
+        }
+    }
+    return ERROR_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// TMsZipDecoder functions
+
+TMsZipDecoder::TMsZipDecoder()
+{
+    BYTE Lengths[288];
+
+    // Build the tables for the fixed Huffman blocks
+    memset(Lengths + 0x00, 8, 144);
+    memset(Lengths + 144, 9, 256 - 144);
+    memset(Lengths + 256, 7, 280 - 256);
+    memset(Lengths + 280, 8, 288 - 280);
+    m_FixedLiterals.Build(Lengths, 288, true);
+    memset(Lengths, 5, 30);
+    m_FixedDistances.Build(Lengths, 30, true);
+
+    m_pbInput = m_pbInputEnd = NULL;
+    m_pbOutput = NULL;
+    m_cbOutput = m_dwOutputPos = 0;
+    m_dwBitBuffer = m_dwBitCount = 0;
+    m_dwOverrun = 0;
+    Reset();
+}
+
+void TMsZipDecoder::Reset()
+{
+    m_Window.assign(MSZIP_WINDOW_SIZE, 0);
+    m_dwWindowPos = 0;
+    m_TotalOut = 0;
+}
+
+DWORD TMsZipDecoder::Decompress(const BYTE * pbInput, DWORD cbInput, LPBYTE pbOutput, DWORD cbOutput)
+{
+    DWORD dwErrCode = ERROR_SUCCESS;
+    DWORD bFinal = 0;
+
+    // Each block begins with the "CK" signature
+    if(cbInput < 2 || pbInput[0] != 'C' || pbInput[1] != 'K')
+        return ERROR_FILE_CORRUPT;
+
+    // Setup the input and output
+    m_pbInput = pbInput + 2;
+    m_pbInputEnd = pbInput + cbInput;
+    m_pbOutput = pbOutput;
+    m_cbOutput = cbOutput;
+    m_dwOutputPos = 0;
+    m_dwBitBuffer = m_dwBitCount = 0;
+    m_dwOverrun = 0;
+
+    // Decompress the deflate blocks until the final one
+    while(dwErrCode == ERROR_SUCCESS && bFinal == 0)
+    {
+        bFinal = GetBits(1);
+
+        switch(GetBits(2))
+        {
+            case 0:
+                dwErrCode = InflateStored();
+                break;
+
+            case 1:
+                dwErrCode = InflateCodes(m_FixedLiterals, m_FixedDistances);
+                break;
+
+            case 2:
+                dwErrCode = InflateDynamic();
+                break;
+
+            default:
+                dwErrCode = ERROR_FILE_CORRUPT;
+                break;
+        }
+
+        // Reading more than a few bytes of padding means corrupt data
+        if(m_dwOverrun > 4)
+            dwErrCode = ERROR_FILE_CORRUPT;
+    }
+
+    // The block must decompress exactly to the expected size
+    if(dwErrCode == ERROR_SUCCESS && m_dwOutputPos != m_cbOutput)
+        dwErrCode = ERROR_FILE_CORRUPT;
+    return dwErrCode;
+}
+
+//-----------------------------------------------------------------------------
+// TMsZipDecoder protected functions
+
+DWORD TMsZipDecoder::InflateStored()
+{
+    DWORD dwLength;
+    DWORD dwNotLength;
+
+    // Skip the remaining bits of the current byte
+    GetBits(m_dwBitCount & 7);
+    dwLength = GetBits(16);
+    dwNotLength = GetBits(16);
+    if(dwLength != (~dwNotLength & 0xFFFF) || dwLength > (m_cbOutput - m_dwOutputPos))
+        return ERROR_FILE_CORRUPT;
+
+    // Copy the bytes. The bit buffer is byte-aligned now
+    while(dwLength-- > 0)
+    {
+        BYTE OneByte = (BYTE)GetBits(8);
+
+        m_pbOutput[m_dwOutputPos++] = OneByte;
+        m_Window[m_dwWindowPos] = OneByte;
+        m_dwWindowPos = (m_dwWindowPos + 1) & (MSZIP_WINDOW_SIZE - 1);
+        m_TotalOut++;
+    }
+    return ERROR_SUCCESS;
+}
+
+DWORD TMsZipDecoder::InflateDynamic()
+{
+    BYTE Lengths[286 + 30];
+    BYTE LengthLengths[19];
+    DWORD dwLiterals = GetBits(5) + 257;
+    DWORD dwDistances = GetBits(5) + 1;
+    DWORD dwCodes = GetBits(4) + 4;
+    DWORD dwSymbol;
+    DWORD dwErrCode;
+    DWORD i;
+
+    if(dwLiterals > 286 || dwDistances > 30)
+        return ERROR_FILE_CORRUPT;
+
+    // Read the code length code
+    memset(LengthLengths, 0, sizeof(LengthLengths));
+    for(i = 0; i < dwCodes; i++)
+        LengthLengths[DeflateLengthOrder[i]] = (BYTE)GetBits(3);
+    if((dwErrCode = m_Lengths.Build(LengthLengths, 19, true)) != ERROR_SUCCESS)
+        return dwErrCode;
+
+    // Read the literal/length and distance code lengths
+    for(i = 0; i < dwLiterals + dwDistances; )
+    {
+        BYTE Fill = 0;
+        DWORD dwRepeat;
+
+        if((dwErrCode = DecodeSymbol(m_Lengths, dwSymbol)) != ERROR_SUCCESS)
+            return dwErrCode;
+
+        if(dwSymbol < 16)
+        {
+            Lengths[i++] = (BYTE)(dwSymbol);
+            continue;
+        }
+
+        switch(dwSymbol)
+        {
+            case 16:
+                if(i == 0)
+                    return ERROR_FILE_CORRUPT;
+                Fill = Lengths[i - 1];
+                dwRepeat = GetBits(2) + 3;
+                break;
+
+            case 17:
+                dwRepeat = GetBits(3) + 3;
+                break;
+
+            default:
+                dwRepeat = GetBits(7) + 11;
+                break;
+        }
+
+        if(i + dwRepeat > dwLiterals + dwDistances)
+            return ERROR_FILE_CORRUPT;
+        while(dwRepeat-- > 0)
+            Lengths[i++] = Fill;
+    }
+
+    // Build the tables
+    if((dwErrCode = m_Literals.Build(Lengths, dwLiterals, true)) != ERROR_SUCCESS)
+        return dwErrCode;
+    if((dwErrCode = m_Distances.Build(Lengths + dwLiterals, dwDistances, true)) != ERROR_SUCCESS)
+        return dwErrCode;
+    return InflateCodes(m_Literals, m_Distances);
+}
+
+DWORD TMsZipDecoder::InflateCodes(const CAB_HUFFMAN & Literals, const CAB_HUFFMAN & Distances)
+{
+    DWORD dwSymbol;
+    DWORD dwLength;
+    DWORD dwDistance;
+    DWORD dwErrCode;
+
+    for(;;)
+    {
+        if((dwErrCode = DecodeSymbol(Literals, dwSymbol)) != ERROR_SUCCESS)
+            return dwErrCode;
+
+        // Literal
+        if(dwSymbol < 256)
+        {
+            if(m_dwOutputPos >= m_cbOutput)
+                return ERROR_FILE_CORRUPT;
+            m_pbOutput[m_dwOutputPos++] = (BYTE)(dwSymbol);
+            m_Window[m_dwWindowPos] = (BYTE)(dwSymbol);
+            m_dwWindowPos = (m_dwWindowPos + 1) & (MSZIP_WINDOW_SIZE - 1);
+            m_TotalOut++;
+            continue;
+        }
+
+        // End of block
+        if(dwSymbol == 256)
+            return ERROR_SUCCESS;
+
+        // Match: length and distance
+        dwSymbol -= 257;
+        if(dwSymbol >= 29)
+            return ERROR_FILE_CORRUPT;
+        dwLength = DeflateLengthBase[dwSymbol] + GetBits(DeflateLengthExtra[dwSymbol]);
+
+        if((dwErrCode = DecodeSymbol(Distances, dwSymbol)) != ERROR_SUCCESS)
+            return dwErrCode;
+        if(dwSymbol >= 30)
+            return ERROR_FILE_CORRUPT;
+        dwDistance = DeflateDistBase[dwSymbol] + GetBits(DeflateDistExtra[dwSymbol]);
+
+        if(dwDistance > m_TotalOut || dwLength > (m_cbOutput - m_dwOutputPos))
+            return ERROR_FILE_CORRUPT;
+
+        // Copy the match from the history
+        while(dwLength-- > 0)
+        {
+            BYTE OneByte = m_Window[(m_dwWindowPos - dwDistance) & (MSZIP_WINDOW_SIZE - 1)];
+
+            m_pbOutput[m_dwOutputPos++] = OneByte;
+            m_Window[m_dwWindowPos] = OneByte;
+            m_dwWindowPos = (m_dwWindowPos + 1) & (MSZIP_WINDOW_SIZE - 1);
+            m_TotalOut++;
+        }
+    }
+}
+
+DWORD TMsZipDecoder::DecodeSymbol(const CAB_HUFFMAN & Table, DWORD & dwSymbol)
+{
+    DWORD dwEntry;
+    DWORD dwCode = 0;
+
+    // Short codes are resolved by one lookup
+    NeedBits(CAB_HUFFMAN_MAX_BITS);
+    dwEntry = Table.Fast[m_dwBitBuffer & ((1 << CAB_HUFFMAN_FAST_BITS) - 1)];
+    if(dwEntry != 0)
+    {
+        dwSymbol = dwEntry >> 8;
+        GetBits(dwEntry & 0xFF);
+        return ERROR_SUCCESS;
+    }
+
+    // Long codes are resolved bit by bit
+    for(DWORD nBits = 1; nBits <= CAB_HUFFMAN_MAX_BITS; nBits++)
+    {
+        dwCode = (dwCode << 1) | ((m_dwBitBuffer >> (nBits - 1)) & 1);
+        if(nBits > CAB_HUFFMAN_FAST_BITS && (dwCode - Table.FirstCode[nBits]) < Table.Count[nBits])
+        {
+            dwSymbol = Table.Symbols[Table.FirstIndex[nBits] + dwCode - Table.FirstCode[nBits]];
+            GetBits(nBits);
+            return ERROR_SUCCESS;
+        }
+    }
+    return ERROR_FILE_CORRUPT;
+}
+
+DWORD TMsZipDecoder::GetBits(DWORD nBits)
+{
+    DWORD dwValue;
+
+    NeedBits(nBits);
+    dwValue = m_dwBitBuffer & ((1 << nBits) - 1);
+    m_dwBitBuffer >>= nBits;
+    m_dwBitCount -= nBits;
+    return dwValue;
+}
+
+void TMsZipDecoder::NeedBits(DWORD nBits)
+{
+    while(m_dwBitCount < nBits)
+    {
+        // Past the end of the input, supply zeros
+        if(m_pbInput < m_pbInputEnd)
+            m_dwBitBuffer |= (DWORD)(*m_pbInput++) << m_dwBitCount;
+        else
+            m_dwOverrun++;
+        m_dwBitCount += 8;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// TLzxDecoder functions
+
+TLzxDecoder::TLzxDecoder()
+{
+    m_dwWindowSize = 0;
+    m_dwWindowPos = 0;
+    m_dwMainSymbols = 0;
+    m_R0 = m_R1 = m_R2 = 1;
+    m_dwBlockType = 0;
+    m_dwBlockLength = 0;
+    m_BlockRemaining = 0;
+    m_dwFrame = 0;
+    m_dwIntelFileSize = 0;
+    m_dwIntelCurPos = 0;
+    m_bHeaderRead = false;
+    m_bIntelStarted = false;
+    m_pbInput = m_pbInputEnd = NULL;
+    m_BitBuffer = 0;
+    m_dwBitCount = 0;
+    m_dwOverrun = 0;
+}
+
+DWORD TLzxDecoder::Reset(DWORD dwWindowBits)
+{
+    // Check the window size
+    if(dwWindowBits < LZX_MIN_WINDOW_BITS || dwWindowBits > LZX_MAX_WINDOW_BITS)
+        return ERROR_NOT_SUPPORTED;
+
+    // Allocate the window. Keep it if the size did not change
+    m_dwWindowSize = 1 << dwWindowBits;
+    m_Window.resize(m_dwWindowSize);
+    m_dwMainSymbols = LZX_NUM_CHARS + LzxPositionSlots[dwWindowBits - LZX_MIN_WINDOW_BITS] * 8;
+
+    // Reset the state of the decoder
+    memset(m_MainLengths, 0, sizeof(m_MainLengths));
+    memset(m_LengthLengths, 0, sizeof(m_LengthLengths));
+    m_dwWindowPos = 0;
+    m_R0 = m_R1 = m_R2 = 1;
+    m_dwBlockType = 0;
+    m_dwBlockLength = 0;
+    m_BlockRemaining = 0;
+    m_dwFrame = 0;
+    m_dwIntelFileSize = 0;
+    m_dwIntelCurPos = 0;
+    m_bHeaderRead = false;
+    m_bIntelStarted = false;
+    return ERROR_SUCCESS;
+}
+
+DWORD TLzxDecoder::Decompress(const BYTE * pbInput, DWORD cbInput, LPBYTE pbOutput, DWORD cbOutput)
+{
+    DWORD dwFrameStart = m_dwWindowPos;
+    DWORD dwFrameEnd = m_dwWindowPos + cbOutput;
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    // Frames never wrap around the window
+    if(m_dwWindowSize == 0 || cbOutput > CAB_FRAME_SIZE || dwFrameEnd > m_dwWindowSize)
+        return ERROR_FILE_CORRUPT;
+
+    // Each frame begins on a fresh 16-bit boundary
+    m_pbInputEnd = pbInput + cbInput;
+    m_dwOverrun = 0;
+    InitBits(pbInput);
+
+    // The first frame begins with the E8 translation header
+    if(m_bHeaderRead == false)
+    {
+        if(GetBits(1))
+        {
+            DWORD dwHigh = GetBits(16);
+            DWORD dwLow = GetBits(16);
+
+            m_dwIntelFileSize = (dwHigh << 16) | dwLow;
+        }
+        m_bHeaderRead = true;
+    }
+
+    // Decode the blocks until the frame is full
+    while(m_dwWindowPos < dwFrameEnd)
+    {
+        if(m_BlockRemaining <= 0)
+        {
+            if((dwErrCode = ReadBlockHeader()) != ERROR_SUCCESS)
+                return dwErrCode;
+            continue;
+        }
+
+        if((dwErrCode = DecodeRun(dwFrameEnd)) != ERROR_SUCCESS)
+            return dwErrCode;
+        if(m_dwOverrun > 2)
+            return ERROR_FILE_CORRUPT;
+    }
+
+    // Matches must not go past the end of the frame
+    if(m_dwWindowPos != dwFrameEnd)
+        return ERROR_FILE_CORRUPT;
+
+    // Give the frame to the caller and undo the E8 translation
+    memcpy(pbOutput, &m_Window[dwFrameStart], cbOutput);
+    if(m_bIntelStarted && m_dwIntelFileSize != 0 && m_dwFrame < 32768 && cbOutput > 10)
+        TranslateE8(pbOutput, cbOutput);
+    m_dwIntelCurPos += cbOutput;
+    m_dwFrame++;
+
+    // Wrap the window
+    if(m_dwWindowPos == m_dwWindowSize)
+        m_dwWindowPos = 0;
+    return ERROR_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// TLzxDecoder protected functions
+
+DWORD TLzxDecoder::ReadBlockHeader()
+{
+    CAB_HUFFMAN PreTree;
+    DWORD dwErrCode;
+    DWORD dwHigh;
+    DWORD dwLow;
+
+    // Uncompressed block of odd length is followed by one padding byte.
+    // It may already be in the next frame.
+    if(m_dwBlockType == LZX_BLOCK_UNCOMPRESSED && (m_dwBlockLength & 1))
+    {
+        if(m_pbInput < m_pbInputEnd)
+            m_pbInput++;
+        InitBits(m_pbInput);
+    }
+
+    // Block type and 24-bit block length
+    m_dwBlockType = GetBits(3);
+    dwHigh = GetBits(16);
+    dwLow = GetBits(8);
+    m_dwBlockLength = (dwHigh << 8) | dwLow;
+
+    // A match that overran the previous block is taken from this one
+    m_BlockRemaining += (LONG)(m_dwBlockLength);
+    if(m_BlockRemaining < 0)
+        return ERROR_FILE_CORRUPT;
+
+    switch(m_dwBlockType)
+    {
+        case LZX_BLOCK_ALIGNED:
+            for(DWORD i = 0; i < LZX_ALIGNED_SYMBOLS; i++)
+                m_AlignedLengths[i] = (BYTE)GetBits(3);
+            if((dwErrCode = m_AlignedTree.Build(m_AlignedLengths, LZX_ALIGNED_SYMBOLS, false)) != ERROR_SUCCESS)
+                return dwErrCode;
+            // No break here, the rest is the same like verbatim block
+
+        case LZX_BLOCK_VERBATIM:
+            if((dwErrCode = ReadLengths(PreTree, m_MainLengths, 0, LZX_NUM_CHARS)) != ERROR_SUCCESS)
+                return dwErrCode;
+            if((dwErrCode = ReadLengths(PreTree, m_MainLengths, LZX_NUM_CHARS, m_dwMainSymbols)) != ERROR_SUCCESS)
+                return dwErrCode;
+            if((dwErrCode = m_MainTree.Build(m_MainLengths, m_dwMainSymbols, false)) != ERROR_SUCCESS)
+                return dwErrCode;
+            if(m_MainLengths[0xE8] != 0)
+                m_bIntelStarted = true;
+            if((dwErrCode = ReadLengths(PreTree, m_LengthLengths, 0, LZX_LENGTH_SYMBOLS)) != ERROR_SUCCESS)
+                return dwErrCode;
+            return m_LengthTree.Build(m_LengthLengths, LZX_LENGTH_SYMBOLS, false);
+
+        case LZX_BLOCK_UNCOMPRESSED:
+        {
+            DWORD R[3];
+
+            // Align to 16 bits, then read the repeated offsets
+            m_bIntelStarted = true;
+            AlignBits();
+            if((m_pbInputEnd - m_pbInput) < (ptrdiff_t)sizeof(R))
+                return ERROR_FILE_CORRUPT;
+            for(DWORD i = 0; i < 3; i++)
+            {
+                R[i] = m_pbInput[0] | (m_pbInput[1] << 8) | (m_pbInput[2] << 16) | ((DWORD)m_pbInput[3] << 24);
+                m_pbInput += 4;
+            }
+            m_R0 = R[0];
+            m_R1 = R[1];
+            m_R2 = R[2];
+            return ERROR_SUCCESS;
+        }
+    }
+    return ERROR_FILE_CORRUPT;
+}
+
+DWORD TLzxDecoder::ReadLengths(CAB_HUFFMAN & PreTree, BYTE * Lengths, DWORD dwFirst, DWORD dwLast)
+{
+    BYTE PreLengths[LZX_PRETREE_SYMBOLS];
+    DWORD dwSymbol;
+    DWORD dwErrCode;
+
+    // Read the pretree
+    for(DWORD i = 0; i < LZX_PRETREE_SYMBOLS; i++)
+        PreLengths[i] = (BYTE)GetBits(4);
+    if((dwErrCode = PreTree.Build(PreLengths, LZX_PRETREE_SYMBOLS, false)) != ERROR_SUCCESS)
+        return dwErrCode;
+
+    // Read the lengths, as deltas against the lengths of the previous block
+    for(DWORD i = dwFirst; i < dwLast; )
+    {
+        DWORD dwRepeat = 1;
+        BYTE Length = 0;
+
+        if((dwErrCode = DecodeSymbol(PreTree, dwSymbol)) != ERROR_SUCCESS)
+            return dwErrCode;
+
+        switch(dwSymbol)
+        {
+            case 17:        // Run of zeros, short
+                dwRepeat = GetBits(4) + 4;
+                break;
+
+            case 18:        // Run of zeros, long
+                dwRepeat = GetBits(5) + 20;
+                break;
+
+            case 19:        // Run of the same length
+                dwRepeat = GetBits(1) + 4;
+                if((dwErrCode = DecodeSymbol(PreTree, dwSymbol)) != ERROR_SUCCESS)
+                    return dwErrCode;
+                if(dwSymbol > 16)
+                    return ERROR_FILE_CORRUPT;
+                Length = (BYTE)((Lengths[i] + 17 - dwSymbol) % 17);
+                break;
+
+            default:        // Delta of one length
+                Length = (BYTE)((Lengths[i] + 17 - dwSymbol) % 17);
+                break;
+        }
+
+        if(i + dwRepeat > dwLast)
+            return ERROR_FILE_CORRUPT;
+        while(dwRepeat-- > 0)
+            Lengths[i++] = Length;
+    }
+    return ERROR_SUCCESS;
+}
+
+DWORD TLzxDecoder::DecodeRun(DWORD dwFrameEnd)
+{
+    LPBYTE pbWindow = &m_Window[0];
+    DWORD dwWindowMask = m_dwWindowSize - 1;
+    LONG nRun = (LONG)(dwFrameEnd - m_dwWindowPos);
+    DWORD dwErrCode;
+
+    // Decode up to the end of the block or the end of the frame, whichever comes first
+    if(nRun > m_BlockRemaining)
+        nRun = m_BlockRemaining;
+    m_BlockRemaining -= nRun;
+
+    // Uncompressed block: copy the bytes directly from the input
+    if(m_dwBlockType == LZX_BLOCK_UNCOMPRESSED)
+    {
+        if((m_pbInputEnd - m_pbInput) < nRun)
+            return ERROR_FILE_CORRUPT;
+        memcpy(pbWindow + m_dwWindowPos, m_pbInput, nRun);
+        m_dwWindowPos += nRun;
+        m_pbInput += nRun;
+
+        // At the end of the block, restart the bit stream
+        if(m_BlockRemaining == 0)
+            InitBits(m_pbInput);
+        return ERROR_SUCCESS;
+    }
+
+    // Verbatim or aligned block
+    while(nRun > 0)
+    {
+        DWORD dwMainSymbol;
+        DWORD dwLength;
+        DWORD dwOffset;
+        DWORD dwSlot;
+
+        if((dwErrCode = DecodeSymbol(m_MainTree, dwMainSymbol)) != ERROR_SUCCESS)
+            return dwErrCode;
+
+        // Literal
+        if(dwMainSymbol < LZX_NUM_CHARS)
+        {
+            pbWindow[m_dwWindowPos++] = (BYTE)(dwMainSymbol);
+            nRun--;
+            continue;
+        }
+
+        // Match length
+        dwMainSymbol -= LZX_NUM_CHARS;
+        dwLength = dwMainSymbol & 7;
+        if(dwLength == 7)
+        {
+            DWORD dwFooter;
+
+            if((dwErrCode = DecodeSymbol(m_LengthTree, dwFooter)) != ERROR_SUCCESS)
+                return dwErrCode;
+            dwLength += dwFooter;
+        }
+        dwLength += LZX_MIN_MATCH;
+
+        // Match offset
+        dwSlot = dwMainSymbol >> 3;
+        if(dwSlot > 2)
+        {
+            DWORD nExtraBits = LzxExtraBits[dwSlot];
+
+            dwOffset = LzxPositionBase[dwSlot] - 2;
+            if(m_dwBlockType == LZX_BLOCK_ALIGNED && nExtraBits >= 3)
+            {
+                DWORD dwAligned;
+
+                dwOffset += GetBits(nExtraBits - 3) << 3;
+                if((dwErrCode = DecodeSymbol(m_AlignedTree, dwAligned)) != ERROR_SUCCESS)
+                    return dwErrCode;
+                dwOffset += dwAligned;
+            }
+            else
+            {
+                dwOffset += GetBits(nExtraBits);
+            }
+
+            m_R2 = m_R1;
+            m_R1 = m_R0;
+            m_R0 = dwOffset;
+        }
+        else if(dwSlot == 0)
+        {
+            dwOffset = m_R0;
+        }
+        else if(dwSlot == 1)
+        {
+            dwOffset = m_R1;
+            m_R1 = m_R0;
+            m_R0 = dwOffset;
+        }
+        else
+        {
+            dwOffset = m_R2;
+            m_R2 = m_R0;
+            m_R0 = dwOffset;
+        }
+
+        // The match must stay within the window and the frame
+        if(dwOffset == 0 || dwOffset > m_dwWindowSize || (m_dwWindowPos + dwLength) > dwFrameEnd)
+            return ERROR_FILE_CORRUPT;
+
+        // Copy the match. The source may wrap around the window
+        for(DWORD i = 0; i < dwLength; i++)
+        {
+            pbWindow[m_dwWindowPos] = pbWindow[(m_dwWindowPos - dwOffset) & dwWindowMask];
+            m_dwWindowPos++;
+        }
+        nRun -= (LONG)(dwLength);
+    }
+
+    // A match went over the end of the block. The rest is taken from the next one
+    m_BlockRemaining += nRun;
+    return ERROR_SUCCESS;
+}
+
+DWORD TLzxDecoder::DecodeSymbol(const CAB_HUFFMAN & Table, DWORD & dwSymbol)
+{
+    DWORD dwPeek;
+    DWORD dwEntry;
+
+    // Short codes are resolved by one lookup
+    NeedBits(CAB_HUFFMAN_MAX_BITS);
+    dwPeek = (DWORD)(m_BitBuffer >> (m_dwBitCount - CAB_HUFFMAN_MAX_BITS)) & 0xFFFF;
+    dwEntry = Table.Fast[dwPeek >> (CAB_HUFFMAN_MAX_BITS - CAB_HUFFMAN_FAST_BITS)];
+    if(dwEntry != 0)
+    {
+        dwSymbol = dwEntry >> 8;
+        m_dwBitCount -= (dwEntry & 0xFF);
+        return ERROR_SUCCESS;
+    }
+
+    // Long codes
+    for(DWORD nBits = CAB_HUFFMAN_FAST_BITS + 1; nBits <= CAB_HUFFMAN_MAX_BITS; nBits++)
+    {
+        DWORD dwCode = dwPeek >> (CAB_HUFFMAN_MAX_BITS - nBits);
+
+        if((dwCode - Table.FirstCode[nBits]) < Table.Count[nBits])
+        {
+            dwSymbol = Table.Symbols[Table.FirstIndex[nBits] + dwCode - Table.FirstCode[nBits]];
+            m_dwBitCount -= nBits;
+            return ERROR_SUCCESS;
+        }
+    }
+    return ERROR_FILE_CORRUPT;
+}
+
+DWORD TLzxDecoder::GetBits(DWORD nBits)
+{
+    if(nBits == 0)
+        return 0;
+    NeedBits(nBits);
+    m_dwBitCount -= nBits;
+    return (DWORD)(m_BitBuffer >> m_dwBitCount) & ((1 << nBits) - 1);
+}
+
+void TLzxDecoder::NeedBits(DWORD nBits)
+{
+    while(m_dwBitCount < nBits)
+    {
+        DWORD dwWord = 0;
+
+        // The bit stream consists of little-endian 16-bit words. Supply zeros past the end
+        if((m_pbInput + 1) < m_pbInputEnd)
+        {
+            dwWord = m_pbInput[0] | (m_pbInput[1] << 8);
+            m_pbInput += 2;
+        }
+        else
+        {
+            m_dwOverrun++;
+        }
+
+        m_BitBuffer = (m_BitBuffer << 16) | dwWord;
+        m_dwBitCount += 16;
+    }
+}
+
+void TLzxDecoder::InitBits(const BYTE * pbInput)
+{
+    m_pbInput = pbInput;
+    m_BitBuffer = 0;
+    m_dwBitCount = 0;
+}
+
+void TLzxDecoder::AlignBits()
+{
+    // Drop the rest of the current 16-bit word. If the buffer
+    // is empty, the whole next word is padding.
+    NeedBits(16);
+    if(m_dwBitCount > 16 && m_dwOverrun == 0)
+        m_pbInput -= 2;
+    m_BitBuffer = 0;
+    m_dwBitCount = 0;
+}
+
+void TLzxDecoder::TranslateE8(LPBYTE pbData, DWORD cbData)
+{
+    LPBYTE pbDataEnd = pbData + cbData - 10;
+    LONG CurPos = (LONG)(m_dwIntelCurPos);
+    LONG FileSize = (LONG)(m_dwIntelFileSize);
+
+    while(pbData < pbDataEnd)
+    {
+        if(*pbData++ != 0xE8)
+        {
+            CurPos++;
+            continue;
+        }
+
+        LONG AbsOffset = (LONG)(pbData[0] | (pbData[1] << 8) | (pbData[2] << 16) | ((DWORD)pbData[3] << 24));
+        if(AbsOffset >= -CurPos && AbsOffset < FileSize)
+        {
+            LONG RelOffset = (AbsOffset >= 0) ? (AbsOffset - CurPos) : (AbsOffset + FileSize);
+
+            pbData[0] = (BYTE)(RelOffset);
+            pbData[1] = (BYTE)(RelOffset >> 8);
+            pbData[2] = (BYTE)(RelOffset >> 16);
+            pbData[3] = (BYTE)(RelOffset >> 24);
+        }
+        pbData += 4;
+        CurPos += 5;
+    }
+}
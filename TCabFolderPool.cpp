@@ -0,0 +1,318 @@
+/*****************************************************************************/
+/* TCabFolderPool.cpp                     Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Parallel decompression of the folders of an embedded cabinet              */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 16.10.26  1.00  Lad  Created                                              */
+/*****************************************************************************/
+
+#include "wcx_msi.h"
+
+//-----------------------------------------------------------------------------
+// TCabFolderPool functions
+
+TCabFolderPool::TCabFolderPool()
+{
+    m_pCabinet = NULL;
+    m_dwReaderFolder = CAB_NO_FOLDER;
+    m_dwNextFolder = 0;
+    m_dwActive = 0;
+    m_dwMaxWorkers = 0;
+    m_dwFiles = 0;
+    m_bStopping = false;
+}
+
+TCabFolderPool::~TCabFolderPool()
+{
+    Stop();
+}
+
+DWORD TCabFolderPool::Open(TCabinet * pCabinet, DWORD dwMaxWorkers)
+{
+    m_pCabinet = pCabinet;
+    m_Queues.resize(pCabinet->FolderCount());
+    m_dwMaxWorkers = (dwMaxWorkers < CAB_POOL_MAX_WORKERS) ? dwMaxWorkers : CAB_POOL_MAX_WORKERS;
+    return ERROR_SUCCESS;
+}
+
+void TCabFolderPool::FileStarted()
+{
+    std::lock_guard<std::mutex> ReadLock(m_ReadLock);
+
+    // Extracting a single file does not need the workers. Once the second
+    // file is extracted, we assume bulk extraction and start decompressing
+    // the following folders ahead.
+    if(++m_dwFiles == 2 && m_pCabinet->FolderCount() > 1)
+    {
+        StartWorkers(m_dwMaxWorkers);
+    }
+}
+
+void TCabFolderPool::StartWorkers(DWORD dwWorkers)
+{
+    // One worker would only duplicate the synchronous reader
+    if(dwWorkers > 1 && m_Threads.size() == 0)
+    {
+        // The folder being read synchronously stays with the consumer
+        if(m_dwReaderFolder != CAB_NO_FOLDER)
+        {
+            m_Queues[m_dwReaderFolder].State = CabQueueReleased;
+            m_dwNextFolder = m_dwReaderFolder + 1;
+        }
+
+        // The workers wait for the lock until all of them are created
+        std::lock_guard<std::mutex> Lock(m_Lock);
+
+        m_bStopping = false;
+        for(DWORD i = 0; i < dwWorkers; i++)
+        {
+            m_Threads.push_back(std::thread(WorkerThread, this));
+        }
+    }
+}
+
+void TCabFolderPool::Stop()
+{
+    // Tell the workers to exit and wait for them
+    {
+        std::lock_guard<std::mutex> Lock(m_Lock);
+
+        m_bStopping = true;
+        m_Changed.notify_all();
+    }
+
+    for(size_t i = 0; i < m_Threads.size(); i++)
+        m_Threads[i].join();
+    m_Threads.clear();
+
+    // Free the buffered data
+    for(size_t i = 0; i < m_Queues.size(); i++)
+        m_Queues[i] = CAB_FOLDER_QUEUE();
+    m_dwNextFolder = 0;
+    m_dwActive = 0;
+    m_dwFiles = 0;
+}
+
+DWORD TCabFolderPool::Read(DWORD dwFolder, ULONGLONG FolderOffset, LPVOID pvBuffer, DWORD cbToRead, LPDWORD PtrBytesRead)
+{
+    std::lock_guard<std::mutex> ReadLock(m_ReadLock);
+    LPBYTE pbBuffer = (LPBYTE)(pvBuffer);
+
+    // Check the folder index
+    if(dwFolder >= m_Queues.size())
+        return ERROR_INVALID_PARAMETER;
+
+    // Without workers, read the folder directly
+    if(m_Threads.size() != 0)
+    {
+        std::unique_lock<std::mutex> Lock(m_Lock);
+        CAB_FOLDER_QUEUE & Queue = m_Queues[dwFolder];
+
+        // The consumer moves forward. Folders before this one will not be needed
+        for(DWORD i = 0; i < dwFolder; i++)
+        {
+            if(m_Queues[i].State == CabQueueRunning || m_Queues[i].State == CabQueueDone)
+            {
+                ReleaseFolder(i);
+            }
+        }
+
+        // Is the folder being decompressed by a worker?
+        if(Queue.State == CabQueueRunning || Queue.State == CabQueueDone)
+        {
+            if(FolderOffset >= Queue.HeadOffset)
+                return ReadQueued(Lock, dwFolder, FolderOffset, pbBuffer, cbToRead, PtrBytesRead);
+            ReleaseFolder(dwFolder);
+        }
+
+        // No worker has it. Read it ourselves and let the workers go past it.
+        Queue.State = CabQueueReleased;
+        if(m_dwNextFolder <= dwFolder)
+            m_dwNextFolder = dwFolder + 1;
+        m_Changed.notify_all();
+    }
+
+    return ReadDirect(dwFolder, FolderOffset, pbBuffer, cbToRead, PtrBytesRead);
+}
+
+//-----------------------------------------------------------------------------
+// Protected functions
+
+void TCabFolderPool::WorkerThread(TCabFolderPool * pPool)
+{
+    pPool->WorkerMain();
+}
+
+void TCabFolderPool::WorkerMain()
+{
+    DWORD dwFolder = 0;
+
+    for(;;)
+    {
+        // Wait until there is a folder to decompress and enough space for it
+        {
+            std::unique_lock<std::mutex> Lock(m_Lock);
+
+            m_Changed.wait(Lock, [this, &dwFolder]()
+            {
+                if(m_bStopping)
+                    return true;
+                if(m_dwActive >= m_Threads.size() * CAB_POOL_FOLDERS_PER_WORKER)
+                    return false;
+                return FindIdleFolder(dwFolder);
+            });
+
+            if(m_bStopping)
+                break;
+
+            m_Queues[dwFolder].State = CabQueueRunning;
+            m_dwNextFolder = dwFolder + 1;
+            m_dwActive++;
+        }
+
+        // Decompress the folder into its queue
+        DecompressFolder(dwFolder);
+    }
+}
+
+DWORD TCabFolderPool::DecompressFolder(DWORD dwFolder)
+{
+    CAB_FOLDER_QUEUE & Queue = m_Queues[dwFolder];
+    TCabFolderReader Reader;
+    ULONGLONG FolderOffset = 0;
+    DWORD dwErrCode;
+
+    if((dwErrCode = Reader.Open(m_pCabinet, dwFolder)) == ERROR_SUCCESS)
+    {
+        for(;;)
+        {
+            std::vector<BYTE> Block(CAB_FRAME_SIZE);
+            DWORD dwBytesRead = 0;
+
+            // Decompress the next piece of the folder. This runs unlocked
+            if((dwErrCode = Reader.Read(FolderOffset, &Block[0], CAB_FRAME_SIZE, &dwBytesRead)) != ERROR_SUCCESS || dwBytesRead == 0)
+                break;
+            Block.resize(dwBytesRead);
+            FolderOffset += dwBytesRead;
+
+            // Wait for space in the queue, then append the block
+            std::unique_lock<std::mutex> Lock(m_Lock);
+            m_Changed.wait(Lock, [this, &Queue]()
+            {
+                return (m_bStopping || Queue.State != CabQueueRunning || Queue.Blocks.size() < CAB_POOL_QUEUE_BLOCKS);
+            });
+
+            // The consumer does not need the folder anymore
+            if(m_bStopping || Queue.State != CabQueueRunning)
+                return ERROR_CANCELLED;
+
+            Queue.Blocks.push_back(std::move(Block));
+            m_Changed.notify_all();
+        }
+    }
+
+    // The end of the folder is not an error
+    if(dwErrCode == ERROR_HANDLE_EOF)
+        dwErrCode = ERROR_SUCCESS;
+
+    // Tell the consumer that there will be no more data
+    std::lock_guard<std::mutex> Lock(m_Lock);
+    if(Queue.State == CabQueueRunning)
+    {
+        Queue.dwErrCode = dwErrCode;
+        Queue.State = CabQueueDone;
+        m_Changed.notify_all();
+    }
+    return dwErrCode;
+}
+
+DWORD TCabFolderPool::ReadQueued(std::unique_lock<std::mutex> & Lock, DWORD dwFolder, ULONGLONG FolderOffset, LPBYTE pbBuffer, DWORD cbToRead, LPDWORD PtrBytesRead)
+{
+    CAB_FOLDER_QUEUE & Queue = m_Queues[dwFolder];
+    DWORD dwBytesRead = 0;
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    while(dwBytesRead < cbToRead)
+    {
+        // Drop the blocks that are entirely before the requested offset
+        while(Queue.Blocks.size() && FolderOffset >= (Queue.HeadOffset + Queue.Blocks.front().size()))
+        {
+            Queue.HeadOffset += Queue.Blocks.front().size();
+            Queue.Blocks.pop_front();
+            m_Changed.notify_all();
+        }
+
+        // Copy the data from the first block
+        if(Queue.Blocks.size())
+        {
+            const std::vector<BYTE> & Block = Queue.Blocks.front();
+            DWORD dwBlockOffset = (DWORD)(FolderOffset - Queue.HeadOffset);
+            DWORD dwToCopy = (DWORD)(Block.size() - dwBlockOffset);
+
+            if(dwToCopy > (cbToRead - dwBytesRead))
+                dwToCopy = cbToRead - dwBytesRead;
+
+            memcpy(pbBuffer + dwBytesRead, &Block[dwBlockOffset], dwToCopy);
+            FolderOffset += dwToCopy;
+            dwBytesRead += dwToCopy;
+            continue;
+        }
+
+        // No more data will come
+        if(Queue.State == CabQueueDone)
+        {
+            dwErrCode = Queue.dwErrCode;
+            ReleaseFolder(dwFolder);
+            break;
+        }
+
+        // Wait for the worker
+        m_Changed.wait(Lock);
+    }
+
+    PtrBytesRead[0] = dwBytesRead;
+    return dwErrCode;
+}
+
+DWORD TCabFolderPool::ReadDirect(DWORD dwFolder, ULONGLONG FolderOffset, LPBYTE pbBuffer, DWORD cbToRead, LPDWORD PtrBytesRead)
+{
+    DWORD dwErrCode;
+
+    // Consecutive files of one folder continue with the same reader,
+    // so the folder is only decompressed once
+    if(m_dwReaderFolder != dwFolder)
+    {
+        m_dwReaderFolder = CAB_NO_FOLDER;
+        if((dwErrCode = m_Reader.Open(m_pCabinet, dwFolder)) != ERROR_SUCCESS)
+            return dwErrCode;
+        m_dwReaderFolder = dwFolder;
+    }
+
+    return m_Reader.Read(FolderOffset, pbBuffer, cbToRead, PtrBytesRead);
+}
+
+bool TCabFolderPool::FindIdleFolder(DWORD & dwFolder)
+{
+    for(DWORD i = m_dwNextFolder; i < m_Queues.size(); i++)
+    {
+        if(m_Queues[i].State == CabQueueIdle)
+        {
+            dwFolder = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+void TCabFolderPool::ReleaseFolder(DWORD dwFolder)
+{
+    CAB_FOLDER_QUEUE & Queue = m_Queues[dwFolder];
+
+    // Free the data. The worker (if any) notices the state change and stops
+    Queue.Blocks.clear();
+    Queue.State = CabQueueReleased;
+    m_dwActive--;
+    m_Changed.notify_all();
+}
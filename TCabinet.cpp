@@ -0,0 +1,312 @@
+/*****************************************************************************/
+/* TCabinet.cpp                           Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Parser of the cabinet files embedded in MSI streams                       */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 16.10.26  1.00  Lad  Created                                              */
+/*****************************************************************************/
+
+#include "wcx_msi.h"
+
+//-----------------------------------------------------------------------------
+// TCabinet functions
+
+TCabinet::TCabinet()
+{
+    m_pCompFile = NULL;
+    m_cbDataReserve = 0;
+}
+
+bool TCabinet::IsCabinet(TCompoundFile * pCompFile, DWORD dwEntry)
+{
+    CFB_STREAM Stream;
+    DWORD dwSignature = 0;
+    DWORD dwBytesRead = 0;
+
+    if(pCompFile->OpenStream(dwEntry, Stream) == ERROR_SUCCESS)
+        pCompFile->ReadStream(Stream, 0, &dwSignature, sizeof(DWORD), &dwBytesRead);
+    return (dwBytesRead == sizeof(DWORD) && dwSignature == CAB_SIGNATURE);
+}
+
+DWORD TCabinet::Open(TCompoundFile * pCompFile, DWORD dwEntry)
+{
+    CAB_HEADER Header;
+    ULONGLONG ByteOffset = sizeof(CAB_HEADER);
+    DWORD cbHeaderReserve = 0;
+    DWORD cbFolderReserve = 0;
+    DWORD dwErrCode;
+
+    // Open the stream and read the header
+    m_pCompFile = pCompFile;
+    if((dwErrCode = pCompFile->OpenStream(dwEntry, m_Stream)) != ERROR_SUCCESS)
+        return dwErrCode;
+    if((dwErrCode = ReadData(0, &Header, sizeof(CAB_HEADER))) != ERROR_SUCCESS)
+        return dwErrCode;
+    if(Header.Signature != CAB_SIGNATURE || Header.VersionMajor != 1)
+        return ERROR_BAD_FORMAT;
+
+    // Sizes of the reserved areas
+    if(Header.Flags & CAB_FLAG_RESERVE)
+    {
+        BYTE Reserve[4];
+
+        if((dwErrCode = ReadData(ByteOffset, Reserve, sizeof(Reserve))) != ERROR_SUCCESS)
+            return dwErrCode;
+        cbHeaderReserve = Reserve[0] | (Reserve[1] << 8);
+        cbFolderReserve = Reserve[2];
+        m_cbDataReserve = Reserve[3];
+        ByteOffset = ByteOffset + sizeof(Reserve) + cbHeaderReserve;
+    }
+
+    // Skip the names of the previous and next cabinets and disks
+    if(Header.Flags & CAB_FLAG_PREV_CABINET)
+    {
+        std::string strDummy;
+
+        if((dwErrCode = ReadString(ByteOffset, strDummy)) != ERROR_SUCCESS)
+            return dwErrCode;
+        if((dwErrCode = ReadString(ByteOffset, strDummy)) != ERROR_SUCCESS)
+            return dwErrCode;
+    }
+    if(Header.Flags & CAB_FLAG_NEXT_CABINET)
+    {
+        std::string strDummy;
+
+        if((dwErrCode = ReadString(ByteOffset, strDummy)) != ERROR_SUCCESS)
+            return dwErrCode;
+        if((dwErrCode = ReadString(ByteOffset, strDummy)) != ERROR_SUCCESS)
+            return dwErrCode;
+    }
+
+    // Load the folders
+    m_Folders.resize(Header.Folders);
+    for(size_t i = 0; i < m_Folders.size(); i++)
+    {
+        CAB_FOLDER_ENTRY FolderEntry;
+
+        if((dwErrCode = ReadData(ByteOffset, &FolderEntry, sizeof(CAB_FOLDER_ENTRY))) != ERROR_SUCCESS)
+            return dwErrCode;
+        ByteOffset = ByteOffset + sizeof(CAB_FOLDER_ENTRY) + cbFolderReserve;
+
+        m_Folders[i].DataOffset = FolderEntry.DataOffset;
+        m_Folders[i].DataBlocks = FolderEntry.DataBlocks;
+        m_Folders[i].CompressType = FolderEntry.CompressType;
+    }
+
+    // Load the files. Files that span multiple cabinets are skipped,
+    // because we only have one cabinet
+    ByteOffset = Header.FilesOffset;
+    m_Files.reserve(Header.Files);
+    for(DWORD i = 0; i < Header.Files; i++)
+    {
+        CAB_FILE_ENTRY FileEntry;
+        CAB_FILE File;
+
+        if((dwErrCode = ReadData(ByteOffset, &FileEntry, sizeof(CAB_FILE_ENTRY))) != ERROR_SUCCESS)
+            return dwErrCode;
+        ByteOffset += sizeof(CAB_FILE_ENTRY);
+        if((dwErrCode = ReadString(ByteOffset, File.Name)) != ERROR_SUCCESS)
+            return dwErrCode;
+
+        if(FileEntry.Folder < m_Folders.size())
+        {
+            File.FileSize = FileEntry.FileSize;
+            File.FolderOffset = FileEntry.FolderOffset;
+            File.Folder = FileEntry.Folder;
+            File.Date = FileEntry.Date;
+            File.Time = FileEntry.Time;
+            File.Attributes = FileEntry.Attributes;
+            m_Files.push_back(File);
+        }
+    }
+    return ERROR_SUCCESS;
+}
+
+DWORD TCabinet::ReadData(ULONGLONG ByteOffset, LPVOID pvBuffer, DWORD cbToRead)
+{
+    DWORD dwBytesRead = 0;
+    DWORD dwErrCode;
+
+    if((dwErrCode = m_pCompFile->ReadStream(m_Stream, ByteOffset, pvBuffer, cbToRead, &dwBytesRead)) == ERROR_SUCCESS)
+    {
+        if(dwBytesRead != cbToRead)
+        {
+            dwErrCode = ERROR_HANDLE_EOF;
+        }
+    }
+    return dwErrCode;
+}
+
+DWORD TCabinet::ReadString(ULONGLONG & ByteOffset, std::string & strValue)
+{
+    char szBuffer[0x100];
+    DWORD dwBytesRead = 0;
+    DWORD dwErrCode;
+
+    // Names in the cabinet are limited to 256 bytes, including the terminator
+    if((dwErrCode = m_pCompFile->ReadStream(m_Stream, ByteOffset, szBuffer, sizeof(szBuffer), &dwBytesRead)) != ERROR_SUCCESS)
+        return dwErrCode;
+
+    for(DWORD i = 0; i < dwBytesRead; i++)
+    {
+        if(szBuffer[i] == 0)
+        {
+            strValue.assign(szBuffer, i);
+            ByteOffset = ByteOffset + i + 1;
+            return ERROR_SUCCESS;
+        }
+    }
+    return ERROR_BAD_FORMAT;
+}
+
+//-----------------------------------------------------------------------------
+// TCabFolderReader functions
+
+TCabFolderReader::TCabFolderReader()
+{
+    m_pCabinet = NULL;
+    m_OutputOffset = 0;
+    m_NextDataOffset = 0;
+    m_cbOutput = 0;
+    m_dwFolder = 0;
+    m_dwBlock = 0;
+}
+
+DWORD TCabFolderReader::Open(TCabinet * pCabinet, DWORD dwFolder)
+{
+    DWORD dwCompressType;
+
+    // Check the compression type
+    if(dwFolder >= pCabinet->FolderCount())
+        return ERROR_INVALID_PARAMETER;
+    dwCompressType = pCabinet->Folder(dwFolder).CompressType & CAB_COMPRESS_MASK;
+    if(dwCompressType != CAB_COMPRESS_NONE && dwCompressType != CAB_COMPRESS_MSZIP && dwCompressType != CAB_COMPRESS_LZX)
+        return ERROR_NOT_SUPPORTED;
+
+    // Allocate the buffers
+    m_Input.resize(CAB_MAX_DATA_SIZE);
+    m_Output.resize(CAB_FRAME_SIZE);
+    m_pCabinet = pCabinet;
+    m_dwFolder = dwFolder;
+    return Restart();
+}
+
+DWORD TCabFolderReader::Read(ULONGLONG FolderOffset, LPVOID pvBuffer, DWORD cbToRead, LPDWORD PtrBytesRead)
+{
+    LPBYTE pbBuffer = (LPBYTE)(pvBuffer);
+    DWORD dwBytesRead = 0;
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    // Going back requires decompressing the folder from its beginning
+    if(FolderOffset < m_OutputOffset)
+    {
+        if((dwErrCode = Restart()) != ERROR_SUCCESS)
+            return dwErrCode;
+    }
+
+    while(dwBytesRead < cbToRead)
+    {
+        // Load blocks until we reach the one containing the offset
+        if(FolderOffset >= (m_OutputOffset + m_cbOutput))
+        {
+            if((dwErrCode = LoadNextBlock()) != ERROR_SUCCESS)
+                break;
+            continue;
+        }
+
+        // Copy the data from the current block
+        DWORD dwBlockOffset = (DWORD)(FolderOffset - m_OutputOffset);
+        DWORD dwToCopy = m_cbOutput - dwBlockOffset;
+
+        if(dwToCopy > (cbToRead - dwBytesRead))
+            dwToCopy = cbToRead - dwBytesRead;
+        memcpy(pbBuffer + dwBytesRead, &m_Output[dwBlockOffset], dwToCopy);
+        dwBytesRead += dwToCopy;
+        FolderOffset += dwToCopy;
+    }
+
+    // Reaching the end of the folder is not an error
+    if(dwErrCode == ERROR_HANDLE_EOF && dwBytesRead != 0)
+        dwErrCode = ERROR_SUCCESS;
+    if(PtrBytesRead != NULL)
+        PtrBytesRead[0] = dwBytesRead;
+    return dwErrCode;
+}
+
+//-----------------------------------------------------------------------------
+// Protected functions
+
+DWORD TCabFolderReader::Restart()
+{
+    const CAB_FOLDER & Folder = m_pCabinet->Folder(m_dwFolder);
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    // Reset the decompressor
+    switch(Folder.CompressType & CAB_COMPRESS_MASK)
+    {
+        case CAB_COMPRESS_MSZIP:
+            m_MsZip.Reset();
+            break;
+
+        case CAB_COMPRESS_LZX:
+            dwErrCode = m_Lzx.Reset((Folder.CompressType >> 8) & 0x1F);
+            break;
+    }
+
+    // Go to the first data block
+    m_NextDataOffset = Folder.DataOffset;
+    m_OutputOffset = 0;
+    m_cbOutput = 0;
+    m_dwBlock = 0;
+    return dwErrCode;
+}
+
+DWORD TCabFolderReader::LoadNextBlock()
+{
+    const CAB_FOLDER & Folder = m_pCabinet->Folder(m_dwFolder);
+    CAB_DATA_ENTRY DataEntry;
+    DWORD dwErrCode;
+
+    // Are there any blocks left?
+    if(m_dwBlock >= Folder.DataBlocks)
+        return ERROR_HANDLE_EOF;
+
+    // Read the block header and the compressed data
+    if((dwErrCode = m_pCabinet->ReadData(m_NextDataOffset, &DataEntry, sizeof(CAB_DATA_ENTRY))) != ERROR_SUCCESS)
+        return dwErrCode;
+    if(DataEntry.CompressedSize > m_Input.size() || DataEntry.UncompressedSize > m_Output.size())
+        return ERROR_FILE_CORRUPT;
+    m_NextDataOffset = m_NextDataOffset + sizeof(CAB_DATA_ENTRY) + m_pCabinet->DataReserve();
+    if((dwErrCode = m_pCabinet->ReadData(m_NextDataOffset, &m_Input[0], DataEntry.CompressedSize)) != ERROR_SUCCESS)
+        return dwErrCode;
+    m_NextDataOffset += DataEntry.CompressedSize;
+
+    // Decompress the block
+    switch(Folder.CompressType & CAB_COMPRESS_MASK)
+    {
+        case CAB_COMPRESS_NONE:
+            if(DataEntry.CompressedSize != DataEntry.UncompressedSize)
+                return ERROR_FILE_CORRUPT;
+            memcpy(&m_Output[0], &m_Input[0], DataEntry.UncompressedSize);
+            break;
+
+        case CAB_COMPRESS_MSZIP:
+            dwErrCode = m_MsZip.Decompress(&m_Input[0], DataEntry.CompressedSize, &m_Output[0], DataEntry.UncompressedSize);
+            break;
+
+        case CAB_COMPRESS_LZX:
+            dwErrCode = m_Lzx.Decompress(&m_Input[0], DataEntry.CompressedSize, &m_Output[0], DataEntry.UncompressedSize);
+            break;
+    }
+
+    // Move to the next block
+    if(dwErrCode == ERROR_SUCCESS)
+    {
+        m_OutputOffset += m_cbOutput;
+        m_cbOutput = DataEntry.UncompressedSize;
+        m_dwBlock++;
+    }
+    return dwErrCode;
+}
@@ -0,0 +1,367 @@
+/*****************************************************************************/
+/* TCabinet.h                             Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Reader of the cabinet files embedded in MSI streams, with the built-in    */
+/* MSZIP and LZX decompressors. Does not depend on Windows.                  */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 16.10.26  1.00  Lad  Created                                              */
+/*****************************************************************************/
+
+#ifndef __TCABINET_H__
+#define __TCABINET_H__
+
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+//-----------------------------------------------------------------------------
+// Cabinet file format. All values are little-endian.
+// https://learn.microsoft.com/en-us/previous-versions/bb417343(v=msdn.10)
+
+#define CAB_SIGNATURE           0x4643534D              // "MSCF"
+
+#define CAB_FLAG_PREV_CABINET   0x0001                  // Cabinet is not the first in a set
+#define CAB_FLAG_NEXT_CABINET   0x0002                  // Cabinet is not the last in a set
+#define CAB_FLAG_RESERVE        0x0004                  // Reserved fields are present
+
+#define CAB_FOLDER_FROM_PREV    0xFFFD                  // File continues from the previous cabinet
+#define CAB_FOLDER_TO_NEXT      0xFFFE                  // File continues in the next cabinet
+#define CAB_FOLDER_PREV_NEXT    0xFFFF                  // Both of the above
+
+#define CAB_ATTRIB_NAME_UTF8    0x0080                  // File name is in UTF-8
+
+#define CAB_COMPRESS_MASK       0x000F                  // Mask of the compression type
+#define CAB_COMPRESS_NONE       0x0000
+#define CAB_COMPRESS_MSZIP      0x0001
+#define CAB_COMPRESS_QUANTUM    0x0002
+#define CAB_COMPRESS_LZX        0x0003
+
+#define CAB_FRAME_SIZE          0x8000                  // Maximum uncompressed size of one data block
+#define CAB_MAX_DATA_SIZE       (CAB_FRAME_SIZE + 0x1800) // Maximum compressed size of one data block
+
+#pragma pack(push, 1)
+struct CAB_HEADER
+{
+    DWORD Signature;                                    // CAB_SIGNATURE
+    DWORD Reserved1;
+    DWORD CabinetSize;                                  // Size of the cabinet, in bytes
+    DWORD Reserved2;
+    DWORD FilesOffset;                                  // Offset of the first CFFILE entry
+    DWORD Reserved3;
+    BYTE  VersionMinor;
+    BYTE  VersionMajor;
+    WORD  Folders;                                      // Number of CFFOLDER entries
+    WORD  Files;                                        // Number of CFFILE entries
+    WORD  Flags;                                        // CAB_FLAG_XXX
+    WORD  SetID;
+    WORD  CabinetIndex;
+};
+
+struct CAB_FOLDER_ENTRY
+{
+    DWORD DataOffset;                                   // Offset of the first CFDATA block
+    WORD  DataBlocks;                                   // Number of CFDATA blocks
+    WORD  CompressType;                                 // CAB_COMPRESS_XXX
+};
+
+struct CAB_FILE_ENTRY
+{
+    DWORD FileSize;                                     // Uncompressed size of the file
+    DWORD FolderOffset;                                 // Offset of the file in the uncompressed folder
+    WORD  Folder;                                       // Index of the folder
+    WORD  Date;                                         // DOS date
+    WORD  Time;                                         // DOS time
+    WORD  Attributes;                                   // _A_XXX and CAB_ATTRIB_NAME_UTF8
+};
+
+struct CAB_DATA_ENTRY
+{
+    DWORD Checksum;
+    WORD  CompressedSize;                               // Size of the compressed data
+    WORD  UncompressedSize;                             // Size of the data after decompression
+};
+#pragma pack(pop)
+
+// Parsed folder
+struct CAB_FOLDER
+{
+    DWORD DataOffset;                                   // Offset of the first CFDATA block in the cabinet
+    DWORD DataBlocks;                                   // Number of CFDATA blocks
+    DWORD CompressType;                                 // CAB_COMPRESS_XXX, LZX window size in bits 8-12
+};
+
+// Parsed file
+struct CAB_FILE
+{
+    std::string Name;                                   // Name of the file, as stored in the cabinet
+    DWORD FileSize;                                     // Uncompressed size of the file
+    DWORD FolderOffset;                                 // Offset of the file in the uncompressed folder
+    DWORD Folder;                                       // Index of the folder
+    WORD  Date;                                         // DOS date
+    WORD  Time;                                         // DOS time
+    WORD  Attributes;                                   // _A_XXX and CAB_ATTRIB_NAME_UTF8
+};
+
+//-----------------------------------------------------------------------------
+// Canonical Huffman decoding table, shared by MSZIP and LZX. MSZIP reads
+// the codes LSB first, LZX reads them MSB first.
+
+#define CAB_HUFFMAN_MAX_BITS    16                      // Maximum length of a code
+#define CAB_HUFFMAN_FAST_BITS   10                      // Codes up to this length are decoded by one lookup
+
+struct CAB_HUFFMAN
+{
+    DWORD Build(const BYTE * Lengths, DWORD dwSymbols, bool bLsbFirst);
+
+    std::vector<DWORD> Fast;                            // (Symbol << 8) | Length for short codes, zero otherwise
+    std::vector<WORD> Symbols;                          // Symbols sorted by code
+    DWORD FirstCode[CAB_HUFFMAN_MAX_BITS + 1];          // First code of each length
+    DWORD FirstIndex[CAB_HUFFMAN_MAX_BITS + 1];         // Index of the first symbol of each length in Symbols
+    DWORD Count[CAB_HUFFMAN_MAX_BITS + 1];              // Number of codes of each length
+};
+
+//-----------------------------------------------------------------------------
+// MSZIP decompressor. Each data block is a complete deflate stream prefixed
+// with "CK". The 32 KB history carries over to the next block.
+
+#define MSZIP_WINDOW_SIZE       0x8000
+
+struct TMsZipDecoder
+{
+    TMsZipDecoder();
+
+    void  Reset();
+    DWORD Decompress(const BYTE * pbInput, DWORD cbInput, LPBYTE pbOutput, DWORD cbOutput);
+
+    protected:
+
+    DWORD InflateStored();
+    DWORD InflateDynamic();
+    DWORD InflateCodes(const CAB_HUFFMAN & Literals, const CAB_HUFFMAN & Distances);
+    DWORD DecodeSymbol(const CAB_HUFFMAN & Table, DWORD & dwSymbol);
+    DWORD GetBits(DWORD nBits);
+    void  NeedBits(DWORD nBits);
+
+    CAB_HUFFMAN m_FixedLiterals;                        // Tables for the fixed Huffman blocks
+    CAB_HUFFMAN m_FixedDistances;
+    CAB_HUFFMAN m_Literals;                             // Tables for the dynamic Huffman blocks
+    CAB_HUFFMAN m_Distances;
+    CAB_HUFFMAN m_Lengths;
+    std::vector<BYTE> m_Window;                         // History of the last 32 KB
+    ULONGLONG m_TotalOut;                               // Total bytes decompressed since reset
+    DWORD m_dwWindowPos;                                // Position in the window
+
+    const BYTE * m_pbInput;                             // Input data
+    const BYTE * m_pbInputEnd;
+    LPBYTE m_pbOutput;                                  // Output data
+    DWORD m_cbOutput;
+    DWORD m_dwOutputPos;
+    DWORD m_dwBitBuffer;                                // Bit buffer, LSB first
+    DWORD m_dwBitCount;
+    DWORD m_dwOverrun;                                  // Bytes read past the end of input
+};
+
+//-----------------------------------------------------------------------------
+// LZX decompressor. The state (window, trees, repeated offsets) persists
+// over the whole folder. Each data block decompresses to one 32 KB frame.
+
+#define LZX_MIN_WINDOW_BITS     15
+#define LZX_MAX_WINDOW_BITS     21
+#define LZX_MIN_MATCH           2
+#define LZX_NUM_CHARS           256
+#define LZX_PRETREE_SYMBOLS     20
+#define LZX_LENGTH_SYMBOLS      249
+#define LZX_ALIGNED_SYMBOLS     8
+#define LZX_MAX_POSITION_SLOTS  50
+#define LZX_MAINTREE_MAXSYMBOLS (LZX_NUM_CHARS + LZX_MAX_POSITION_SLOTS * 8)
+
+#define LZX_BLOCK_VERBATIM      1
+#define LZX_BLOCK_ALIGNED       2
+#define LZX_BLOCK_UNCOMPRESSED  3
+
+struct TLzxDecoder
+{
+    TLzxDecoder();
+
+    DWORD Reset(DWORD dwWindowBits);
+    DWORD Decompress(const BYTE * pbInput, DWORD cbInput, LPBYTE pbOutput, DWORD cbOutput);
+
+    protected:
+
+    DWORD ReadBlockHeader();
+    DWORD ReadLengths(CAB_HUFFMAN & PreTree, BYTE * Lengths, DWORD dwFirst, DWORD dwLast);
+    DWORD DecodeRun(DWORD dwFrameEnd);
+    DWORD DecodeSymbol(const CAB_HUFFMAN & Table, DWORD & dwSymbol);
+    DWORD GetBits(DWORD nBits);
+    void  NeedBits(DWORD nBits);
+    void  InitBits(const BYTE * pbInput);
+    void  AlignBits();
+    void  TranslateE8(LPBYTE pbData, DWORD cbData);
+
+    CAB_HUFFMAN m_MainTree;
+    CAB_HUFFMAN m_LengthTree;
+    CAB_HUFFMAN m_AlignedTree;
+    BYTE m_MainLengths[LZX_MAINTREE_MAXSYMBOLS];        // Code lengths, delta-coded against the previous block
+    BYTE m_LengthLengths[LZX_LENGTH_SYMBOLS];
+    BYTE m_AlignedLengths[LZX_ALIGNED_SYMBOLS];
+
+    std::vector<BYTE> m_Window;                         // Sliding window
+    DWORD m_dwWindowSize;                               // Size of the window
+    DWORD m_dwWindowPos;                                // Current position in the window
+    DWORD m_dwMainSymbols;                              // Number of symbols in the main tree
+    DWORD m_R0, m_R1, m_R2;                             // Repeated offsets
+
+    DWORD m_dwBlockType;                                // LZX_BLOCK_XXX of the current block
+    DWORD m_dwBlockLength;                              // Length of the current block
+    LONG  m_BlockRemaining;                             // Bytes remaining in the current block (negative if a match overran it)
+    DWORD m_dwFrame;                                    // Index of the current frame
+    DWORD m_dwIntelFileSize;                            // E8 translation size (zero = no translation)
+    DWORD m_dwIntelCurPos;                              // Position of the current frame for E8 translation
+    bool  m_bHeaderRead;                                // True if the stream header has been read
+    bool  m_bIntelStarted;                              // True if there was an E8 byte in the stream
+
+    const BYTE * m_pbInput;                             // Input data
+    const BYTE * m_pbInputEnd;
+    ULONGLONG m_BitBuffer;                              // Bit buffer, MSB first
+    DWORD m_dwBitCount;
+    DWORD m_dwOverrun;                                  // Words read past the end of input
+};
+
+//-----------------------------------------------------------------------------
+// Cabinet stored in a stream of the compound file
+
+struct TCabinet
+{
+    TCabinet();
+
+    DWORD Open(TCompoundFile * pCompFile, DWORD dwEntry);
+    DWORD ReadData(ULONGLONG ByteOffset, LPVOID pvBuffer, DWORD cbToRead);
+
+    const CAB_FILE & File(size_t nIndex) const          { return m_Files[nIndex]; }
+    const CAB_FOLDER & Folder(size_t nIndex) const      { return m_Folders[nIndex]; }
+    size_t FileCount() const                            { return m_Files.size(); }
+    size_t FolderCount() const                          { return m_Folders.size(); }
+    DWORD DataReserve() const                           { return m_cbDataReserve; }
+
+    static bool IsCabinet(TCompoundFile * pCompFile, DWORD dwEntry);
+
+    protected:
+
+    DWORD ReadString(ULONGLONG & ByteOffset, std::string & strValue);
+
+    std::vector<CAB_FOLDER> m_Folders;                  // Parsed CFFOLDER entries
+    std::vector<CAB_FILE> m_Files;                      // Parsed CFFILE entries
+    TCompoundFile * m_pCompFile;                        // Compound file containing the cabinet
+    CFB_STREAM m_Stream;                                // Stream of the cabinet
+    DWORD m_cbDataReserve;                              // Size of the reserved area in each CFDATA
+};
+
+//-----------------------------------------------------------------------------
+// Sequential reader of the uncompressed data of one folder. Only the data
+// blocks needed to reach the requested offset are decompressed.
+
+struct TCabFolderReader
+{
+    TCabFolderReader();
+
+    DWORD Open(TCabinet * pCabinet, DWORD dwFolder);
+    DWORD Read(ULONGLONG FolderOffset, LPVOID pvBuffer, DWORD cbToRead, LPDWORD PtrBytesRead);
+
+    const TCabinet * Cabinet() const                    { return m_pCabinet; }
+    DWORD Folder() const                                { return m_dwFolder; }
+
+    protected:
+
+    DWORD Restart();
+    DWORD LoadNextBlock();
+
+    TMsZipDecoder m_MsZip;
+    TLzxDecoder m_Lzx;
+    std::vector<BYTE> m_Input;                          // Compressed data of the current block
+    std::vector<BYTE> m_Output;                         // Uncompressed data of the current block
+    TCabinet * m_pCabinet;
+    ULONGLONG m_OutputOffset;                           // Folder offset of m_Output[0]
+    ULONGLONG m_NextDataOffset;                         // Cabinet offset of the next CFDATA
+    DWORD m_cbOutput;                                   // Valid bytes in m_Output
+    DWORD m_dwFolder;                                   // Index of the folder
+    DWORD m_dwBlock;                                    // Number of blocks loaded so far
+};
+
+//-----------------------------------------------------------------------------
+// Parallel decompression of cabinet folders. Folders are independent, so
+// while one file is being extracted, worker threads decompress the folders
+// that follow. The consumer reads the folders in order; the memory is
+// bounded by the number of blocks buffered per folder and the number of
+// folders buffered per worker.
+
+#define CAB_POOL_MAX_WORKERS    16                      // Maximum number of worker threads
+#define CAB_POOL_QUEUE_BLOCKS   32                      // Blocks buffered per folder (1 MB)
+#define CAB_POOL_FOLDERS_PER_WORKER 2                   // Folders buffered per worker
+#define CAB_NO_FOLDER           0xFFFFFFFF
+
+enum CAB_QUEUE_STATE
+{
+    CabQueueIdle = 0,                                   // Not started yet
+    CabQueueRunning,                                    // Being decompressed by a worker
+    CabQueueDone,                                       // Decompressed, waiting for the consumer
+    CabQueueReleased                                    // Consumed, skipped or read synchronously
+};
+
+struct CAB_FOLDER_QUEUE
+{
+    CAB_FOLDER_QUEUE()
+    {
+        HeadOffset = 0;
+        dwErrCode = ERROR_SUCCESS;
+        State = CabQueueIdle;
+    }
+
+    std::deque<std::vector<BYTE> > Blocks;              // Decompressed data not consumed yet
+    ULONGLONG HeadOffset;                               // Folder offset of the first block
+    DWORD dwErrCode;                                    // Result of the decompression
+    CAB_QUEUE_STATE State;
+};
+
+struct TCabFolderPool
+{
+    TCabFolderPool();
+    ~TCabFolderPool();
+
+    DWORD Open(TCabinet * pCabinet, DWORD dwMaxWorkers);
+    void  FileStarted();
+    void  StartWorkers(DWORD dwWorkers);
+    void  Stop();
+    DWORD Read(DWORD dwFolder, ULONGLONG FolderOffset, LPVOID pvBuffer, DWORD cbToRead, LPDWORD PtrBytesRead);
+
+    TCabinet * Cabinet()                                { return m_pCabinet; }
+    DWORD Workers()                                     { return (DWORD)(m_Threads.size()); }
+
+    protected:
+
+    static void WorkerThread(TCabFolderPool * pPool);
+    void  WorkerMain();
+    DWORD DecompressFolder(DWORD dwFolder);
+    DWORD ReadQueued(std::unique_lock<std::mutex> & Lock, DWORD dwFolder, ULONGLONG FolderOffset, LPBYTE pbBuffer, DWORD cbToRead, LPDWORD PtrBytesRead);
+    DWORD ReadDirect(DWORD dwFolder, ULONGLONG FolderOffset, LPBYTE pbBuffer, DWORD cbToRead, LPDWORD PtrBytesRead);
+    bool  FindIdleFolder(DWORD & dwFolder);
+    void  ReleaseFolder(DWORD dwFolder);
+
+    std::vector<CAB_FOLDER_QUEUE> m_Queues;             // One queue per folder
+    std::vector<std::thread> m_Threads;                 // Worker threads
+    std::mutex m_ReadLock;                              // Lets one consumer at a time read the folders
+    std::mutex m_Lock;                                  // Guards the queues and the counters
+    std::condition_variable m_Changed;                  // Signalled when a queue or a counter changes
+    TCabFolderReader m_Reader;                          // Reader for the synchronous reads
+    TCabinet * m_pCabinet;
+    DWORD m_dwReaderFolder;                             // Folder open in m_Reader
+    DWORD m_dwNextFolder;                               // First folder that workers may pick
+    DWORD m_dwActive;                                   // Number of folders in the Running or Done state
+    DWORD m_dwMaxWorkers;                               // Number of workers for bulk extraction
+    DWORD m_dwFiles;                                    // Number of files started so far
+    bool  m_bStopping;                                  // Set when the workers shall exit
+};
+
+#endif // __TCABINET_H__
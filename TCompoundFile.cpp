@@ -0,0 +1,967 @@
+/*****************************************************************************/
+/* TCompoundFile.cpp                      Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Read-only access to the Compound File Binary format (the MSI container)   */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 16.10.26  1.00  Lad  Created                                              */
+/*****************************************************************************/
+
+#include "wcx_msi.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include <algorithm>
+
+//-----------------------------------------------------------------------------
+// Local (non-class) functions
+
+static int Utf2Mime(WCHAR ch)
+{
+    if(ch >= '0' && ch <= '9')
+        return ch - '0';
+    if(ch >= 'A' && ch <= 'Z')
+        return ch - 'A' + 10;
+    if(ch >= 'a' && ch <= 'z')
+        return ch - 'a' + 10 + 26;
+    if(ch == '.')
+        return 10 + 26 + 26;
+    if(ch == '_')
+        return 10 + 26 + 26 + 1;
+    return -1;
+}
+
+static WCHAR Mime2Utf(int x)
+{
+    if(x < 10)
+        return (WCHAR)(x + '0');
+    if(x < 10 + 26)
+        return (WCHAR)(x - 10 + 'A');
+    if(x < 10 + 26 + 26)
+        return (WCHAR)(x - 10 - 26 + 'a');
+    if(x == 10 + 26 + 26)
+        return '.';
+    return '_';
+}
+
+//-----------------------------------------------------------------------------
+// MSI stream name encoding
+
+void MsiEncodeStreamName(const CFB_NAME & strName, bool bTable, CFB_NAME & strEncoded)
+{
+    int nMime1;
+    int nMime2;
+
+    // Table streams begin with a special character
+    strEncoded.clear();
+    if(bTable)
+        strEncoded.push_back(MSI_TABLE_STREAM_PREFIX);
+
+    // Pack pairs of characters into one
+    for(size_t i = 0; i < strName.size(); i++)
+    {
+        WCHAR ch = strName[i];
+
+        if(ch < 0x80 && (nMime1 = Utf2Mime(ch)) >= 0)
+        {
+            if((i + 1) < strName.size() && strName[i + 1] < 0x80 && (nMime2 = Utf2Mime(strName[i + 1])) >= 0)
+            {
+                ch = (WCHAR)(0x3800 + nMime1 + (nMime2 << 6));
+                i++;
+            }
+            else
+            {
+                ch = (WCHAR)(0x4800 + nMime1);
+            }
+        }
+        strEncoded.push_back(ch);
+    }
+}
+
+bool MsiDecodeStreamName(const CFB_NAME & strEncoded, CFB_NAME & strName)
+{
+    size_t nIndex = 0;
+    bool bIsTable = false;
+
+    // Check for the table stream
+    if(strEncoded.size() && strEncoded[0] == MSI_TABLE_STREAM_PREFIX)
+    {
+        bIsTable = true;
+        nIndex++;
+    }
+
+    // Unpack the characters
+    strName.clear();
+    for(; nIndex < strEncoded.size(); nIndex++)
+    {
+        WCHAR ch = strEncoded[nIndex];
+
+        if(0x3800 <= ch && ch < 0x4800)
+        {
+            strName.push_back(Mime2Utf((ch - 0x3800) & 0x3F));
+            strName.push_back(Mime2Utf(((ch - 0x3800) >> 6) & 0x3F));
+        }
+        else if(0x4800 <= ch && ch < 0x4840)
+        {
+            strName.push_back(Mime2Utf(ch - 0x4800));
+        }
+        else
+        {
+            strName.push_back(ch);
+        }
+    }
+    return bIsTable;
+}
+
+//-----------------------------------------------------------------------------
+// MSI file type detection
+
+// Class IDs of the root storage, as stored in the file
+static const BYTE ClsidDatabase[16]  = {0x84, 0x10, 0x0C, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x46};   // {000C1084-0000-0000-C000-000000000046}
+static const BYTE ClsidPatch[16]     = {0x86, 0x10, 0x0C, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x46};   // {000C1086-0000-0000-C000-000000000046}
+static const BYTE ClsidTransform[16] = {0x82, 0x10, 0x0C, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x46};   // {000C1082-0000-0000-C000-000000000046}
+
+static bool ReadFileAt(CFB_FILE_HANDLE hFile, ULONGLONG ByteOffset, LPVOID pvBuffer, DWORD cbToRead)
+{
+#ifdef _WIN32
+    OVERLAPPED Overlapped = {0};
+    DWORD dwBytesRead = 0;
+
+    Overlapped.Offset = (DWORD)(ByteOffset);
+    Overlapped.OffsetHigh = (DWORD)(ByteOffset >> 32);
+    return (ReadFile(hFile, pvBuffer, cbToRead, &dwBytesRead, &Overlapped) && dwBytesRead == cbToRead);
+#else
+    return (pread(hFile, pvBuffer, cbToRead, (off_t)(ByteOffset)) == (ssize_t)(cbToRead));
+#endif
+}
+
+// Only reads the header and the root directory entry. Files that are not
+// compound files are rejected after the first read of 512 bytes.
+MSI_STORAGE_TYPE MsiSniffStorage(LPCTSTR szFileName)
+{
+    MSI_STORAGE_TYPE StorageType = MsiStorageNone;
+    CFB_FILE_HANDLE hFile;
+    CFB_DIRENTRY RootEntry;
+    CFB_HEADER Header;
+    static const BYTE ClsidNull[16] = {0};
+
+#ifdef _WIN32
+    hFile = CreateFile(szFileName, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+#else
+    hFile = open(szFileName, O_RDONLY | O_CLOEXEC);
+#endif
+    if(hFile == CFB_INVALID_HANDLE)
+        return MsiStorageNone;
+
+    // Verify the header the same way TCompoundFile::Open does
+    if(ReadFileAt(hFile, 0, &Header, sizeof(CFB_HEADER)) &&
+       Header.Signature == CFB_HEADER_SIGNATURE && Header.ByteOrder == CFB_BYTE_ORDER_MARK &&
+       ((Header.MajorVersion == 3 && Header.SectorShift == 9) || (Header.MajorVersion == 4 && Header.SectorShift == 12)) &&
+       Header.MiniSectorShift == 6 && Header.FirstDirSector <= CFB_MAXREGSECT)
+    {
+        // The root entry is the first entry in the first directory sector
+        if(ReadFileAt(hFile, ((ULONGLONG)(Header.FirstDirSector) + 1) << Header.SectorShift, &RootEntry, sizeof(CFB_DIRENTRY)) && RootEntry.Type == CFB_TYPE_ROOT)
+        {
+            if(!memcmp(RootEntry.Clsid, ClsidDatabase, sizeof(ClsidDatabase)))
+                StorageType = MsiStorageDatabase;
+            else if(!memcmp(RootEntry.Clsid, ClsidPatch, sizeof(ClsidPatch)))
+                StorageType = MsiStoragePatch;
+            else if(!memcmp(RootEntry.Clsid, ClsidTransform, sizeof(ClsidTransform)))
+                StorageType = MsiStorageTransform;
+            else if(!memcmp(RootEntry.Clsid, ClsidNull, sizeof(ClsidNull)))
+                StorageType = MsiStorageUnknown;
+            else
+                StorageType = MsiStorageOther;
+        }
+    }
+
+#ifdef _WIN32
+    CloseHandle(hFile);
+#else
+    close(hFile);
+#endif
+    return StorageType;
+}
+
+//-----------------------------------------------------------------------------
+// Constructor and destructor
+
+TCompoundFile::TCompoundFile()
+{
+    memset(&m_Header, 0, sizeof(CFB_HEADER));
+    m_FileSize = 0;
+    m_dwSectorSize = 0;
+    m_dwMiniSectorSize = 0;
+    m_pbFileData = NULL;
+    m_hFile = CFB_INVALID_HANDLE;
+#ifdef _WIN32
+    m_hFileMap = NULL;
+#else
+    m_bCopyRange = true;
+#endif
+}
+
+TCompoundFile::~TCompoundFile()
+{
+    Close();
+}
+
+//-----------------------------------------------------------------------------
+// Public functions
+
+DWORD TCompoundFile::Open(LPCTSTR szFileName)
+{
+    DWORD dwErrCode;
+
+#ifdef _WIN32
+    LARGE_INTEGER FileSize;
+
+    // Open the file for read-only access
+    m_hFile = CreateFile(szFileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(m_hFile == INVALID_HANDLE_VALUE)
+        return GetLastError();
+
+    // Retrieve the file size
+    if(!GetFileSizeEx(m_hFile, &FileSize))
+        return GetLastError();
+    m_FileSize = FileSize.QuadPart;
+#else
+    struct stat fs;
+
+    // Open the file for read-only access
+    if((m_hFile = open(szFileName, O_RDONLY | O_CLOEXEC)) == -1)
+        return errno;
+
+    // Retrieve the file size
+    if(fstat(m_hFile, &fs) != 0)
+        return errno;
+    m_FileSize = fs.st_size;
+#endif
+
+    // Map the file to memory, if possible. If not, we will read it
+    MapFile();
+
+    // Load and verify the header
+    if((dwErrCode = ReadFileData(0, &m_Header, sizeof(CFB_HEADER))) != ERROR_SUCCESS)
+        return dwErrCode;
+    if(m_Header.Signature != CFB_HEADER_SIGNATURE || m_Header.ByteOrder != CFB_BYTE_ORDER_MARK)
+        return ERROR_BAD_FORMAT;
+    if(!(m_Header.MajorVersion == 3 && m_Header.SectorShift == 9) && !(m_Header.MajorVersion == 4 && m_Header.SectorShift == 12))
+        return ERROR_BAD_FORMAT;
+    if(m_Header.MiniSectorShift != 6)
+        return ERROR_BAD_FORMAT;
+
+    // Setup the sector sizes
+    m_dwSectorSize = 1 << m_Header.SectorShift;
+    m_dwMiniSectorSize = 1 << m_Header.MiniSectorShift;
+
+    // Load all the tables
+    if((dwErrCode = LoadFat()) != ERROR_SUCCESS)
+        return dwErrCode;
+    if((dwErrCode = LoadDirectory()) != ERROR_SUCCESS)
+        return dwErrCode;
+    if((dwErrCode = LoadDirectoryTree()) != ERROR_SUCCESS)
+        return dwErrCode;
+    if((dwErrCode = LoadMiniFat()) != ERROR_SUCCESS)
+        return dwErrCode;
+    return LoadMiniStream();
+}
+
+void TCompoundFile::Close()
+{
+    // Unmap the file
+    UnmapFile();
+
+    // Close the file handle
+    if(m_hFile != CFB_INVALID_HANDLE)
+    {
+#ifdef _WIN32
+        CloseHandle(m_hFile);
+#else
+        close(m_hFile);
+#endif
+        m_hFile = CFB_INVALID_HANDLE;
+    }
+
+    m_RootIndex.clear();
+    m_Entries.clear();
+    m_MiniStreamSectors.clear();
+    m_Fat.clear();
+    m_MiniFat.clear();
+}
+
+DWORD TCompoundFile::FindEntry(DWORD dwStorage, const CFB_NAME & strName)
+{
+    // Entries in the root storage are indexed
+    if(dwStorage == CFB_ROOT_ENTRY)
+    {
+        std::unordered_map<CFB_NAME, DWORD>::iterator iter = m_RootIndex.find(strName);
+        return (iter != m_RootIndex.end()) ? iter->second : CFB_NOSTREAM;
+    }
+
+    // Entries in the sub-storages are rare, so just go through them
+    if(dwStorage < m_Entries.size())
+    {
+        const std::vector<DWORD> & Children = m_Entries[dwStorage].Children;
+
+        for(size_t i = 0; i < Children.size(); i++)
+        {
+            if(m_Entries[Children[i]].Name == strName)
+            {
+                return Children[i];
+            }
+        }
+    }
+    return CFB_NOSTREAM;
+}
+
+DWORD TCompoundFile::OpenStream(DWORD dwEntry, CFB_STREAM & Stream)
+{
+    DWORD dwErrCode;
+
+    // Check the entry
+    if(dwEntry >= m_Entries.size() || m_Entries[dwEntry].Type != CFB_TYPE_STREAM)
+        return ERROR_FILE_NOT_FOUND;
+    const CFB_ENTRY & CfbEntry = m_Entries[dwEntry];
+
+    // Small streams are stored in the mini stream
+    Stream.Runs.clear();
+    if(CfbEntry.Size < m_Header.MiniStreamCutoff)
+        dwErrCode = BuildMiniRuns(CfbEntry.StartSector, CfbEntry.Size, Stream.Runs);
+    else
+        dwErrCode = BuildRuns(CfbEntry.StartSector, CfbEntry.Size, Stream.Runs);
+
+    // Fill the rest of the stream
+    Stream.Size = CfbEntry.Size;
+    Stream.dwEntry = dwEntry;
+    return dwErrCode;
+}
+
+DWORD TCompoundFile::ReadStream(const CFB_STREAM & Stream, ULONGLONG ByteOffset, LPVOID pvBuffer, DWORD cbToRead, LPDWORD PtrBytesRead)
+{
+    std::vector<CFB_RUN>::const_iterator iter;
+    LPBYTE pbBuffer = (LPBYTE)(pvBuffer);
+    DWORD dwBytesRead = 0;
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    // Cut the read to the end of the stream
+    if(ByteOffset > Stream.Size)
+        ByteOffset = Stream.Size;
+    if(cbToRead > (Stream.Size - ByteOffset))
+        cbToRead = (DWORD)(Stream.Size - ByteOffset);
+
+    // Find the run containing the starting offset
+    iter = std::upper_bound(Stream.Runs.begin(), Stream.Runs.end(), ByteOffset, [](ULONGLONG Offset, const CFB_RUN & Run)
+    {
+        return Offset < Run.StreamOffset;
+    });
+
+    // Read the data, run by run
+    if(cbToRead != 0 && iter != Stream.Runs.begin())
+    {
+        for(--iter; iter != Stream.Runs.end() && dwBytesRead < cbToRead; iter++)
+        {
+            ULONGLONG RunOffset = ByteOffset - iter->StreamOffset;
+            DWORD dwToCopy = cbToRead - dwBytesRead;
+
+            // Cut the read to the run boundary
+            if(dwToCopy > (iter->Length - RunOffset))
+                dwToCopy = (DWORD)(iter->Length - RunOffset);
+
+            // Read the piece of data
+            if((dwErrCode = ReadFileData(iter->FileOffset + RunOffset, pbBuffer + dwBytesRead, dwToCopy)) != ERROR_SUCCESS)
+                break;
+
+            // Move the offsets
+            dwBytesRead += dwToCopy;
+            ByteOffset += dwToCopy;
+        }
+    }
+
+    // Give the number of bytes read
+    if(PtrBytesRead != NULL)
+        PtrBytesRead[0] = dwBytesRead;
+    return dwErrCode;
+}
+
+DWORD TCompoundFile::WriteStream(const CFB_STREAM & Stream, ULONGLONG ByteOffset, DWORD cbToWrite, CFB_FILE_HANDLE hTargetFile, LPDWORD PtrBytesWritten)
+{
+    std::vector<CFB_RUN>::const_iterator iter;
+    DWORD dwBytesWritten = 0;
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    // Cut the write to the end of the stream
+    if(ByteOffset > Stream.Size)
+        ByteOffset = Stream.Size;
+    if(cbToWrite > (Stream.Size - ByteOffset))
+        cbToWrite = (DWORD)(Stream.Size - ByteOffset);
+
+    // Find the run containing the starting offset
+    iter = std::upper_bound(Stream.Runs.begin(), Stream.Runs.end(), ByteOffset, [](ULONGLONG Offset, const CFB_RUN & Run)
+    {
+        return Offset < Run.StreamOffset;
+    });
+
+    // Write the data. Each contiguous run is written by one call
+    if(cbToWrite != 0 && iter != Stream.Runs.begin())
+    {
+        for(--iter; iter != Stream.Runs.end() && dwBytesWritten < cbToWrite; iter++)
+        {
+            ULONGLONG RunOffset = ByteOffset - iter->StreamOffset;
+            DWORD dwToWrite = cbToWrite - dwBytesWritten;
+
+            // Cut the write to the run boundary
+            if(dwToWrite > (iter->Length - RunOffset))
+                dwToWrite = (DWORD)(iter->Length - RunOffset);
+
+            // Write the piece of data
+            if((dwErrCode = WriteFileData(iter->FileOffset + RunOffset, dwToWrite, hTargetFile)) != ERROR_SUCCESS)
+                break;
+
+            // Move the offsets
+            dwBytesWritten += dwToWrite;
+            ByteOffset += dwToWrite;
+        }
+    }
+
+    // Give the number of bytes written
+    if(PtrBytesWritten != NULL)
+        PtrBytesWritten[0] = dwBytesWritten;
+    return dwErrCode;
+}
+
+// Gives the data of the stream directly from the mapped file, without copying them.
+// The data end at the end of the run, so there may be less than requested.
+// The data stay valid until the compound file is closed.
+DWORD TCompoundFile::MapStream(const CFB_STREAM & Stream, ULONGLONG ByteOffset, DWORD cbMaxData, const BYTE ** PtrData, LPDWORD PtrBytesMapped)
+{
+    std::vector<CFB_RUN>::const_iterator iter;
+    ULONGLONG RunOffset;
+    DWORD cbMapped = 0;
+
+    // Only possible if the file is mapped
+    if(m_pbFileData == NULL)
+        return ERROR_NOT_SUPPORTED;
+    PtrData[0] = NULL;
+
+    // Cut the data to the end of the stream
+    if(ByteOffset > Stream.Size)
+        ByteOffset = Stream.Size;
+    if(cbMaxData > (Stream.Size - ByteOffset))
+        cbMaxData = (DWORD)(Stream.Size - ByteOffset);
+
+    // Find the run containing the starting offset
+    iter = std::upper_bound(Stream.Runs.begin(), Stream.Runs.end(), ByteOffset, [](ULONGLONG Offset, const CFB_RUN & Run)
+    {
+        return Offset < Run.StreamOffset;
+    });
+
+    // Give the data up to the end of the run
+    if(cbMaxData != 0 && iter != Stream.Runs.begin())
+    {
+        RunOffset = ByteOffset - (--iter)->StreamOffset;
+        cbMapped = (cbMaxData < (iter->Length - RunOffset)) ? cbMaxData : (DWORD)(iter->Length - RunOffset);
+
+        // Check whether the data are within the file
+        if((iter->FileOffset + RunOffset) > m_FileSize || cbMapped > (m_FileSize - iter->FileOffset - RunOffset))
+            return ERROR_HANDLE_EOF;
+        PtrData[0] = m_pbFileData + iter->FileOffset + RunOffset;
+    }
+
+    PtrBytesMapped[0] = cbMapped;
+    return ERROR_SUCCESS;
+}
+
+DWORD TCompoundFile::LoadStream(DWORD dwEntry, std::vector<BYTE> & Data)
+{
+    CFB_STREAM Stream;
+    DWORD dwBytesRead = 0;
+    DWORD dwErrCode;
+
+    if((dwErrCode = OpenStream(dwEntry, Stream)) == ERROR_SUCCESS)
+    {
+        // We only load streams that fit into 32-bit size
+        if(Stream.Size > 0xFFFFFFFF)
+            return ERROR_NOT_ENOUGH_MEMORY;
+
+        // Read the whole stream
+        Data.resize((size_t)(Stream.Size));
+        if(Data.size() != 0)
+        {
+            if((dwErrCode = ReadStream(Stream, 0, &Data[0], (DWORD)(Data.size()), &dwBytesRead)) == ERROR_SUCCESS)
+            {
+                if(dwBytesRead != Data.size())
+                {
+                    dwErrCode = ERROR_HANDLE_EOF;
+                }
+            }
+        }
+    }
+    return dwErrCode;
+}
+
+//-----------------------------------------------------------------------------
+// Protected functions
+
+void TCompoundFile::MapFile()
+{
+    // Don't map files that don't fit into the address space
+    if(m_FileSize == 0 || m_FileSize > (size_t)(-1))
+        return;
+
+#ifdef _WIN32
+    if((m_hFileMap = CreateFileMapping(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL)) != NULL)
+    {
+        if((m_pbFileData = (LPBYTE)MapViewOfFile(m_hFileMap, FILE_MAP_READ, 0, 0, 0)) == NULL)
+        {
+            CloseHandle(m_hFileMap);
+            m_hFileMap = NULL;
+        }
+    }
+#else
+    LPVOID pvFileData;
+
+    if((pvFileData = mmap(NULL, (size_t)(m_FileSize), PROT_READ, MAP_SHARED, m_hFile, 0)) != MAP_FAILED)
+    {
+        m_pbFileData = (LPBYTE)(pvFileData);
+    }
+#endif
+}
+
+void TCompoundFile::UnmapFile()
+{
+#ifdef _WIN32
+    if(m_pbFileData != NULL)
+        UnmapViewOfFile(m_pbFileData);
+    if(m_hFileMap != NULL)
+        CloseHandle(m_hFileMap);
+    m_hFileMap = NULL;
+#else
+    if(m_pbFileData != NULL)
+        munmap(m_pbFileData, (size_t)(m_FileSize));
+#endif
+    m_pbFileData = NULL;
+}
+
+DWORD TCompoundFile::ReadFileData(ULONGLONG ByteOffset, LPVOID pvBuffer, DWORD cbToRead)
+{
+    LPBYTE pbBuffer = (LPBYTE)(pvBuffer);
+
+    // Check whether the data are within the file
+    if(ByteOffset > m_FileSize || cbToRead > (m_FileSize - ByteOffset))
+        return ERROR_HANDLE_EOF;
+
+    // If the file is mapped, just copy the data
+    if(m_pbFileData != NULL)
+    {
+        memcpy(pbBuffer, m_pbFileData + ByteOffset, cbToRead);
+        return ERROR_SUCCESS;
+    }
+
+    while(cbToRead != 0)
+    {
+#ifdef _WIN32
+        OVERLAPPED Overlapped = {0};
+        DWORD dwBytesRead = 0;
+
+        Overlapped.Offset = (DWORD)(ByteOffset);
+        Overlapped.OffsetHigh = (DWORD)(ByteOffset >> 32);
+        if(!ReadFile(m_hFile, pbBuffer, cbToRead, &dwBytesRead, &Overlapped))
+            return GetLastError();
+#else
+        ssize_t dwBytesRead;
+
+        if((dwBytesRead = pread(m_hFile, pbBuffer, cbToRead, (off_t)(ByteOffset))) < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            return errno;
+        }
+#endif
+        // Prevent infinite loop if the file has been truncated meanwhile
+        if(dwBytesRead == 0)
+            return ERROR_HANDLE_EOF;
+
+        ByteOffset += dwBytesRead;
+        pbBuffer += dwBytesRead;
+        cbToRead -= (DWORD)(dwBytesRead);
+    }
+    return ERROR_SUCCESS;
+}
+
+DWORD TCompoundFile::WriteFileData(ULONGLONG ByteOffset, DWORD cbToWrite, CFB_FILE_HANDLE hTargetFile)
+{
+    std::vector<BYTE> Buffer;
+    DWORD dwErrCode;
+
+    // Check whether the data are within the file
+    if(ByteOffset > m_FileSize || cbToWrite > (m_FileSize - ByteOffset))
+        return ERROR_HANDLE_EOF;
+
+#ifdef __linux__
+    // Let the kernel copy the data between the files, if it can
+    while(m_bCopyRange && cbToWrite != 0)
+    {
+        loff_t InOffset = (loff_t)(ByteOffset);
+        ssize_t nCopied;
+
+        if((nCopied = copy_file_range(m_hFile, &InOffset, hTargetFile, NULL, cbToWrite, 0)) <= 0)
+        {
+            // Not supported by the file systems: fall back to the write
+            if(nCopied < 0 && errno != EXDEV && errno != ENOSYS && errno != EINVAL && errno != EOPNOTSUPP)
+                return errno;
+            m_bCopyRange = false;
+            break;
+        }
+
+        ByteOffset += nCopied;
+        cbToWrite -= (DWORD)(nCopied);
+    }
+#endif
+
+    while(cbToWrite != 0)
+    {
+        const BYTE * pbData;
+        DWORD dwToWrite = cbToWrite;
+
+        // Use the mapped data directly. If the file isn't mapped, read it to the bounce buffer
+        if(m_pbFileData == NULL)
+        {
+            dwToWrite = (cbToWrite < CFB_BOUNCE_BUFFER_SIZE) ? cbToWrite : CFB_BOUNCE_BUFFER_SIZE;
+            Buffer.resize(CFB_BOUNCE_BUFFER_SIZE);
+            if((dwErrCode = ReadFileData(ByteOffset, &Buffer[0], dwToWrite)) != ERROR_SUCCESS)
+                return dwErrCode;
+            pbData = &Buffer[0];
+        }
+        else
+        {
+            pbData = m_pbFileData + ByteOffset;
+        }
+
+#ifdef _WIN32
+        DWORD dwBytesWritten = 0;
+
+        if(!WriteFile(hTargetFile, pbData, dwToWrite, &dwBytesWritten, NULL))
+            return GetLastError();
+#else
+        ssize_t dwBytesWritten;
+
+        if((dwBytesWritten = write(hTargetFile, pbData, dwToWrite)) < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            return errno;
+        }
+#endif
+        // Prevent infinite loop if the disk is full
+        if(dwBytesWritten == 0)
+            return ERROR_CAN_NOT_COMPLETE;
+
+        ByteOffset += dwBytesWritten;
+        cbToWrite -= (DWORD)(dwBytesWritten);
+    }
+    return ERROR_SUCCESS;
+}
+
+DWORD TCompoundFile::LoadSectorChain(DWORD dwStartSector, std::vector<BYTE> & Data)
+{
+    std::vector<CFB_RUN> Runs;
+    DWORD dwErrCode;
+
+    // Build the runs of the chain. Size is unknown; it's given by the chain length
+    if((dwErrCode = BuildRuns(dwStartSector, (ULONGLONG)(-1), Runs)) == ERROR_SUCCESS)
+    {
+        // Calculate the total length
+        ULONGLONG TotalLength = Runs.size() ? (Runs.back().StreamOffset + Runs.back().Length) : 0;
+        if(TotalLength > 0x7FFFFFFF)
+            return ERROR_FILE_CORRUPT;
+
+        // Load all runs
+        Data.resize((size_t)(TotalLength));
+        for(size_t i = 0; i < Runs.size(); i++)
+        {
+            if((dwErrCode = ReadFileData(Runs[i].FileOffset, &Data[(size_t)(Runs[i].StreamOffset)], (DWORD)(Runs[i].Length))) != ERROR_SUCCESS)
+            {
+                break;
+            }
+        }
+    }
+    return dwErrCode;
+}
+
+DWORD TCompoundFile::LoadFat()
+{
+    std::vector<DWORD> FatSectors;
+    std::vector<DWORD> Difat(m_dwSectorSize / sizeof(DWORD));
+    DWORD dwEntriesPerSector = m_dwSectorSize / sizeof(DWORD);
+    DWORD dwMaxSectors = (DWORD)((m_FileSize + m_dwSectorSize - 1) / m_dwSectorSize);
+    DWORD dwDifatSector = m_Header.FirstDifatSector;
+    DWORD dwErrCode;
+
+    // The number of FAT sectors must make sense
+    if(m_Header.FatSectors == 0 || m_Header.FatSectors > dwMaxSectors)
+        return ERROR_FILE_CORRUPT;
+
+    // The first 109 FAT sectors are in the header
+    for(DWORD i = 0; i < CFB_HEADER_DIFAT_COUNT && FatSectors.size() < m_Header.FatSectors; i++)
+        FatSectors.push_back(m_Header.Difat[i]);
+
+    // The rest is in the DIFAT chain
+    for(DWORD i = 0; i < m_Header.DifatSectors && FatSectors.size() < m_Header.FatSectors; i++)
+    {
+        // Check the DIFAT sector
+        if(dwDifatSector > CFB_MAXREGSECT)
+            return ERROR_FILE_CORRUPT;
+
+        // Load the DIFAT sector
+        dwErrCode = ReadFileData((ULONGLONG)(dwDifatSector + 1) << m_Header.SectorShift, &Difat[0], m_dwSectorSize);
+        if(dwErrCode != ERROR_SUCCESS)
+            return dwErrCode;
+
+        // The last entry is the pointer to the next DIFAT sector
+        for(DWORD j = 0; j < dwEntriesPerSector - 1 && FatSectors.size() < m_Header.FatSectors; j++)
+            FatSectors.push_back(Difat[j]);
+        dwDifatSector = Difat[dwEntriesPerSector - 1];
+    }
+
+    // We must have all FAT sectors now
+    if(FatSectors.size() != m_Header.FatSectors)
+        return ERROR_FILE_CORRUPT;
+
+    // Load all FAT sectors
+    m_Fat.resize(FatSectors.size() * dwEntriesPerSector);
+    for(size_t i = 0; i < FatSectors.size(); i++)
+    {
+        if(FatSectors[i] > CFB_MAXREGSECT)
+            return ERROR_FILE_CORRUPT;
+
+        dwErrCode = ReadFileData((ULONGLONG)(FatSectors[i] + 1) << m_Header.SectorShift, &m_Fat[i * dwEntriesPerSector], m_dwSectorSize);
+        if(dwErrCode != ERROR_SUCCESS)
+            return dwErrCode;
+    }
+    return ERROR_SUCCESS;
+}
+
+DWORD TCompoundFile::LoadDirectory()
+{
+    std::vector<BYTE> DirData;
+    CFB_DIRENTRY * pDirEntry;
+    size_t nEntryCount;
+    DWORD dwErrCode;
+
+    // Load the whole directory
+    if((dwErrCode = LoadSectorChain(m_Header.FirstDirSector, DirData)) != ERROR_SUCCESS)
+        return dwErrCode;
+    if((nEntryCount = DirData.size() / sizeof(CFB_DIRENTRY)) == 0)
+        return ERROR_FILE_CORRUPT;
+    pDirEntry = (CFB_DIRENTRY *)(&DirData[0]);
+
+    // Parse all entries
+    m_Entries.resize(nEntryCount);
+    for(size_t i = 0; i < nEntryCount; i++, pDirEntry++)
+    {
+        CFB_ENTRY & CfbEntry = m_Entries[i];
+        size_t nNameLength = pDirEntry->NameLength / sizeof(WORD);
+
+        // The name length includes the terminating zero
+        if(nNameLength > 0)
+            nNameLength--;
+        if(nNameLength > CFB_MAX_NAME_LENGTH)
+            nNameLength = CFB_MAX_NAME_LENGTH;
+
+        // Copy the entry
+        CfbEntry.Name.assign((const WCHAR *)(pDirEntry->Name), nNameLength);
+        CfbEntry.Type = pDirEntry->Type;
+        CfbEntry.StartSector = pDirEntry->StartSector;
+        CfbEntry.Size = pDirEntry->StreamSize;
+        CfbEntry.Parent = CFB_NOSTREAM;
+
+        // Version 3 compound files may have garbage in the upper 32 bits
+        if(m_Header.MajorVersion == 3)
+            CfbEntry.Size &= 0xFFFFFFFF;
+
+        // We temporarily store the tree links in the children array
+        if(CfbEntry.Type != CFB_TYPE_EMPTY)
+        {
+            CfbEntry.Children.push_back(pDirEntry->LeftSibling);
+            CfbEntry.Children.push_back(pDirEntry->RightSibling);
+            CfbEntry.Children.push_back(pDirEntry->Child);
+        }
+    }
+
+    // The first entry must be the root storage
+    return (m_Entries[CFB_ROOT_ENTRY].Type == CFB_TYPE_ROOT) ? ERROR_SUCCESS : ERROR_FILE_CORRUPT;
+}
+
+DWORD TCompoundFile::LoadDirectoryTree()
+{
+    std::vector<DWORD> Links(m_Entries.size() * 3, CFB_NOSTREAM);
+    std::vector<DWORD> Storages;
+    std::vector<DWORD> Stack;
+
+    // Move the tree links out of the entries
+    for(size_t i = 0; i < m_Entries.size(); i++)
+    {
+        std::vector<DWORD> & Children = m_Entries[i].Children;
+
+        if(Children.size() == 3)
+        {
+            Links[i * 3 + 0] = Children[0];
+            Links[i * 3 + 1] = Children[1];
+            Links[i * 3 + 2] = Children[2];
+        }
+        Children.clear();
+    }
+
+    // Walk the trees of all storages, starting with the root
+    Storages.push_back(CFB_ROOT_ENTRY);
+    m_Entries[CFB_ROOT_ENTRY].Parent = CFB_ROOT_ENTRY;
+    while(Storages.size())
+    {
+        DWORD dwStorage = Storages.back();
+        DWORD dwEntry = Links[dwStorage * 3 + 2];
+
+        // In-order walk of the red-black tree, without recursion
+        Storages.pop_back();
+        while(dwEntry != CFB_NOSTREAM || Stack.size())
+        {
+            while(dwEntry != CFB_NOSTREAM)
+            {
+                // Each entry can only be visited once
+                if(dwEntry >= m_Entries.size() || m_Entries[dwEntry].Parent != CFB_NOSTREAM || m_Entries[dwEntry].Type == CFB_TYPE_EMPTY)
+                    return ERROR_FILE_CORRUPT;
+                m_Entries[dwEntry].Parent = dwStorage;
+
+                Stack.push_back(dwEntry);
+                dwEntry = Links[dwEntry * 3 + 0];
+            }
+
+            // Insert the entry to the parent storage
+            dwEntry = Stack.back();
+            Stack.pop_back();
+            m_Entries[dwStorage].Children.push_back(dwEntry);
+
+            // Index the names in the root storage
+            if(dwStorage == CFB_ROOT_ENTRY)
+                m_RootIndex[m_Entries[dwEntry].Name] = dwEntry;
+
+            // Sub-storages will be processed later
+            if(m_Entries[dwEntry].Type == CFB_TYPE_STORAGE)
+                Storages.push_back(dwEntry);
+            dwEntry = Links[dwEntry * 3 + 1];
+        }
+    }
+    return ERROR_SUCCESS;
+}
+
+DWORD TCompoundFile::LoadMiniFat()
+{
+    std::vector<BYTE> MiniFatData;
+    DWORD dwErrCode;
+
+    // Is there a mini FAT at all?
+    if(m_Header.MiniFatSectors == 0 || m_Header.FirstMiniFatSector == CFB_ENDOFCHAIN)
+        return ERROR_SUCCESS;
+
+    // Load the whole mini FAT
+    if((dwErrCode = LoadSectorChain(m_Header.FirstMiniFatSector, MiniFatData)) == ERROR_SUCCESS)
+    {
+        m_MiniFat.resize(MiniFatData.size() / sizeof(DWORD));
+        if(m_MiniFat.size())
+        {
+            memcpy(&m_MiniFat[0], &MiniFatData[0], m_MiniFat.size() * sizeof(DWORD));
+        }
+    }
+    return dwErrCode;
+}
+
+DWORD TCompoundFile::LoadMiniStream()
+{
+    const CFB_ENTRY & RootEntry = m_Entries[CFB_ROOT_ENTRY];
+    DWORD dwSector = RootEntry.StartSector;
+    DWORD dwSectorCount = (DWORD)((RootEntry.Size + m_dwSectorSize - 1) / m_dwSectorSize);
+
+    // The mini stream is the data of the root entry. Remember its sectors,
+    // so we can translate mini sectors to file offsets quickly
+    for(DWORD i = 0; i < dwSectorCount; i++)
+    {
+        if(dwSector >= m_Fat.size() || m_MiniStreamSectors.size() > m_Fat.size())
+            return ERROR_FILE_CORRUPT;
+        m_MiniStreamSectors.push_back(dwSector);
+        dwSector = m_Fat[dwSector];
+    }
+    return ERROR_SUCCESS;
+}
+
+void TCompoundFile::AppendRun(std::vector<CFB_RUN> & Runs, ULONGLONG FileOffset, ULONGLONG Length)
+{
+    // Merge with the previous run, if they are adjacent
+    if(Runs.size() && (Runs.back().FileOffset + Runs.back().Length) == FileOffset)
+    {
+        Runs.back().Length += Length;
+    }
+    else
+    {
+        CFB_RUN Run;
+
+        Run.StreamOffset = Runs.size() ? (Runs.back().StreamOffset + Runs.back().Length) : 0;
+        Run.FileOffset = FileOffset;
+        Run.Length = Length;
+        Runs.push_back(Run);
+    }
+}
+
+DWORD TCompoundFile::BuildRuns(DWORD dwStartSector, ULONGLONG Size, std::vector<CFB_RUN> & Runs)
+{
+    ULONGLONG BytesLeft = Size;
+    DWORD dwSector = dwStartSector;
+    size_t nSectorCount = 0;
+
+    // Walk the sector chain
+    while(BytesLeft != 0 && dwSector != CFB_ENDOFCHAIN)
+    {
+        ULONGLONG Length = (BytesLeft < m_dwSectorSize) ? BytesLeft : m_dwSectorSize;
+
+        // Check the sector index and loops in the chain
+        if(dwSector >= m_Fat.size() || ++nSectorCount > m_Fat.size())
+            return ERROR_FILE_CORRUPT;
+
+        AppendRun(Runs, (ULONGLONG)(dwSector + 1) << m_Header.SectorShift, Length);
+        dwSector = m_Fat[dwSector];
+        BytesLeft -= Length;
+    }
+
+    // If the size is known, the chain must have been long enough
+    return (Size == (ULONGLONG)(-1) || BytesLeft == 0) ? ERROR_SUCCESS : ERROR_FILE_CORRUPT;
+}
+
+DWORD TCompoundFile::BuildMiniRuns(DWORD dwStartSector, ULONGLONG Size, std::vector<CFB_RUN> & Runs)
+{
+    ULONGLONG BytesLeft = Size;
+    DWORD dwSectorsPerSector = m_dwSectorSize / m_dwMiniSectorSize;
+    DWORD dwMiniSector = dwStartSector;
+    size_t nSectorCount = 0;
+
+    // Walk the mini sector chain
+    while(BytesLeft != 0)
+    {
+        ULONGLONG Length = (BytesLeft < m_dwMiniSectorSize) ? BytesLeft : m_dwMiniSectorSize;
+        DWORD dwSectorIndex = dwMiniSector / dwSectorsPerSector;
+        DWORD dwSectorOffset = (dwMiniSector % dwSectorsPerSector) * m_dwMiniSectorSize;
+
+        // Check the sector index and loops in the chain
+        if(dwMiniSector >= m_MiniFat.size() || dwSectorIndex >= m_MiniStreamSectors.size() || ++nSectorCount > m_MiniFat.size())
+            return ERROR_FILE_CORRUPT;
+
+        AppendRun(Runs, ((ULONGLONG)(m_MiniStreamSectors[dwSectorIndex] + 1) << m_Header.SectorShift) + dwSectorOffset, Length);
+        dwMiniSector = m_MiniFat[dwMiniSector];
+        BytesLeft -= Length;
+    }
+    return ERROR_SUCCESS;
+}
@@ -0,0 +1,277 @@
+/*****************************************************************************/
+/* TCsvRenderPool.cpp                     Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Parallel rendering of the decoded tables to CSV                           */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 16.10.26  1.00  Lad  Created                                              */
+/*****************************************************************************/
+
+#include "wcx_msi.h"
+
+//-----------------------------------------------------------------------------
+// TCsvRenderPool functions
+
+TCsvRenderPool::TCsvRenderPool()
+{
+    m_pJobs = NULL;
+    m_pStringPool = NULL;
+    m_dwMaxWorkers = 0;
+    m_dwPhase = 0;
+    m_dwRunning = 0;
+    m_bRender = false;
+    m_bStopping = false;
+}
+
+TCsvRenderPool::~TCsvRenderPool()
+{
+    Stop();
+}
+
+// The worker threads are only started when there is enough work for them.
+// The thread that calls Measure or Render always takes part in the work.
+void TCsvRenderPool::Open(DWORD dwMaxWorkers)
+{
+    Stop();
+    m_dwMaxWorkers = (dwMaxWorkers < MSI_CSV_MAX_WORKERS) ? dwMaxWorkers : MSI_CSV_MAX_WORKERS;
+}
+
+// Calculates the length of the rendered rows of every job
+DWORD TCsvRenderPool::Measure(MSI_CSV_JOB * pJobs, size_t nJobs, const TMsiStringPool & StringPool)
+{
+    std::lock_guard<std::mutex> CallLock(m_CallLock);
+
+    // Split the jobs to ranges and measure them
+    m_pJobs = pJobs;
+    m_pStringPool = &StringPool;
+    SplitJobs(pJobs, nJobs);
+    RunPhase(false);
+
+    // Sum the ranges of each job
+    for(size_t i = 0; i < nJobs; i++)
+        pJobs[i].cbLength = 0;
+    for(size_t i = 0; i < m_Ranges.size(); i++)
+        pJobs[m_Ranges[i].nJob].cbLength += m_Ranges[i].ByteOffset;
+
+    m_pJobs = NULL;
+    m_pStringPool = NULL;
+    return ERROR_SUCCESS;
+}
+
+// Renders the rows of every job to its buffer. The ranges are rendered directly
+// to their final place, so the parts need not be copied together afterwards.
+DWORD TCsvRenderPool::Render(MSI_CSV_JOB * pJobs, size_t nJobs, const TMsiStringPool & StringPool)
+{
+    std::lock_guard<std::mutex> CallLock(m_CallLock);
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    // Split the jobs to ranges and measure them
+    m_pJobs = pJobs;
+    m_pStringPool = &StringPool;
+    SplitJobs(pJobs, nJobs);
+    RunPhase(false);
+
+    // Turn the lengths of the ranges to their offsets in the buffer of the job
+    for(size_t i = 0; i < nJobs; i++)
+        pJobs[i].cbLength = 0;
+    for(size_t i = 0; i < m_Ranges.size(); i++)
+    {
+        MSI_CSV_JOB & Job = pJobs[m_Ranges[i].nJob];
+        ULONGLONG cbRange = m_Ranges[i].ByteOffset;
+
+        m_Ranges[i].ByteOffset = Job.cbLength;
+        Job.cbLength += cbRange;
+    }
+
+    // All rows must fit into the buffers
+    for(size_t i = 0; i < nJobs; i++)
+    {
+        if(pJobs[i].pbBuffer == NULL || pJobs[i].cbLength > pJobs[i].cbBuffer)
+            dwErrCode = ERROR_INSUFFICIENT_BUFFER;
+    }
+
+    // Render the ranges
+    if(dwErrCode == ERROR_SUCCESS)
+        RunPhase(true);
+
+    m_pJobs = NULL;
+    m_pStringPool = NULL;
+    return dwErrCode;
+}
+
+void TCsvRenderPool::Stop()
+{
+    // Tell the workers to exit and wait for them
+    {
+        std::lock_guard<std::mutex> Lock(m_Lock);
+
+        m_bStopping = true;
+        m_Changed.notify_all();
+    }
+
+    for(size_t i = 0; i < m_Threads.size(); i++)
+        m_Threads[i].join();
+    m_Threads.clear();
+    m_Queues.clear();
+    m_Ranges.clear();
+    m_bStopping = false;
+}
+
+//-----------------------------------------------------------------------------
+// Protected functions
+
+void TCsvRenderPool::WorkerThread(TCsvRenderPool * pPool, size_t nWorker, DWORD dwPhase)
+{
+    pPool->WorkerMain(nWorker, dwPhase);
+}
+
+// The worker begins with the phase that was current when it was started.
+// If the next phase has already begun meanwhile, the worker joins it.
+void TCsvRenderPool::WorkerMain(size_t nWorker, DWORD dwPhase)
+{
+    std::unique_lock<std::mutex> Lock(m_Lock);
+
+    for(;;)
+    {
+        // Wait until a new phase starts
+        m_Changed.wait(Lock, [this, dwPhase]()
+        {
+            return (m_bStopping || m_dwPhase != dwPhase);
+        });
+
+        if(m_bStopping)
+            break;
+        dwPhase = m_dwPhase;
+
+        // Work on the ranges until there are none left
+        Lock.unlock();
+        ProcessRanges(nWorker);
+        Lock.lock();
+
+        // Tell the caller that we are done
+        if(--m_dwRunning == 0)
+            m_Changed.notify_all();
+    }
+}
+
+// Measures or renders all ranges. Small amounts of work are done by the calling thread alone
+void TCsvRenderPool::RunPhase(bool bRender)
+{
+    std::unique_lock<std::mutex> Lock(m_Lock);
+    size_t nWorkers;
+    size_t nRange = 0;
+
+    // Start the workers if there is enough work for them
+    Lock.unlock();
+    StartWorkers(m_Ranges.size());
+    Lock.lock();
+
+    // Give each worker (the caller is worker 0) a contiguous part of the ranges
+    nWorkers = m_Threads.size() + 1;
+    m_Queues.resize(nWorkers);
+    for(size_t i = 0; i < nWorkers; i++)
+    {
+        m_Queues[i].nNext = nRange;
+        m_Queues[i].nEnd = nRange = (m_Ranges.size() * (i + 1)) / nWorkers;
+    }
+
+    // Start the phase
+    m_bRender = bRender;
+    m_dwRunning = (DWORD)(m_Threads.size());
+    m_dwPhase++;
+    m_Changed.notify_all();
+
+    // Take part in the work
+    Lock.unlock();
+    ProcessRanges(0);
+    Lock.lock();
+
+    // Wait for the workers to finish their ranges
+    m_Changed.wait(Lock, [this]()
+    {
+        return (m_dwRunning == 0);
+    });
+}
+
+void TCsvRenderPool::ProcessRanges(size_t nWorker)
+{
+    size_t nRange;
+
+    while(TakeRange(nWorker, nRange))
+    {
+        MSI_CSV_RANGE & Range = m_Ranges[nRange];
+        MSI_CSV_JOB & Job = m_pJobs[Range.nJob];
+
+        // Each range only writes its own part of the buffer
+        if(m_bRender)
+            MsiCsvRenderRows(Job.pbBuffer + Range.ByteOffset, *Job.pTableData, *m_pStringPool, Range.dwFirstRow, Range.dwRows);
+        else
+            Range.ByteOffset = MsiCsvRowsLength(*Job.pTableData, *m_pStringPool, Range.dwFirstRow, Range.dwRows);
+    }
+}
+
+// Takes the next range of the worker. If the worker has none left,
+// it steals the last range of the worker that has the most of them
+bool TCsvRenderPool::TakeRange(size_t nWorker, size_t & nRange)
+{
+    std::lock_guard<std::mutex> Lock(m_Lock);
+    size_t nVictim = nWorker;
+
+    // Our own range, from the front
+    if(m_Queues[nWorker].nNext < m_Queues[nWorker].nEnd)
+    {
+        nRange = m_Queues[nWorker].nNext++;
+        return true;
+    }
+
+    // Find the worker with the most ranges left
+    for(size_t i = 0; i < m_Queues.size(); i++)
+    {
+        if((m_Queues[i].nEnd - m_Queues[i].nNext) > (m_Queues[nVictim].nEnd - m_Queues[nVictim].nNext))
+            nVictim = i;
+    }
+
+    // Steal from the back
+    if(m_Queues[nVictim].nNext < m_Queues[nVictim].nEnd)
+    {
+        nRange = --m_Queues[nVictim].nEnd;
+        return true;
+    }
+    return false;
+}
+
+// Splits the jobs to ranges of MSI_CSV_RANGE_ROWS rows
+void TCsvRenderPool::SplitJobs(MSI_CSV_JOB * pJobs, size_t nJobs)
+{
+    MSI_CSV_RANGE Range;
+
+    m_Ranges.clear();
+    for(size_t i = 0; i < nJobs; i++)
+    {
+        DWORD dwEndRow = pJobs[i].dwFirstRow + pJobs[i].dwRows;
+
+        for(DWORD dwRow = pJobs[i].dwFirstRow; dwRow < dwEndRow; dwRow += Range.dwRows)
+        {
+            Range.nJob = i;
+            Range.dwFirstRow = dwRow;
+            Range.dwRows = ((dwEndRow - dwRow) < MSI_CSV_RANGE_ROWS) ? (dwEndRow - dwRow) : MSI_CSV_RANGE_ROWS;
+            Range.ByteOffset = 0;
+            m_Ranges.push_back(Range);
+        }
+    }
+}
+
+// Starts one worker per range, up to the maximum. The caller is a worker too.
+// Called between the phases, so m_dwPhase doesn't change meanwhile.
+void TCsvRenderPool::StartWorkers(size_t nRanges)
+{
+    size_t nMaxThreads = (m_dwMaxWorkers > 1) ? (m_dwMaxWorkers - 1) : 0;
+    size_t nThreads = (nRanges > 1) ? (nRanges - 1) : 0;
+
+    if(nThreads > nMaxThreads)
+        nThreads = nMaxThreads;
+
+    while(m_Threads.size() < nThreads)
+        m_Threads.push_back(std::thread(WorkerThread, this, m_Threads.size() + 1, m_dwPhase));
+}
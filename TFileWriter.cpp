@@ -0,0 +1,270 @@
+/*****************************************************************************/
+/* TFileWriter.cpp                        Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Implementation of the TFileWriter class methods                           */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 16.10.26  1.00  Lad  Created                                              */
+/*****************************************************************************/
+
+#include "wcx_msi.h"
+
+//-----------------------------------------------------------------------------
+// Local functions
+
+// SetFileValidData needs the SE_MANAGE_VOLUME_NAME privilege. Usually,
+// only elevated administrators have it, and it must be enabled first.
+static bool EnableManageVolumePrivilege()
+{
+    TOKEN_PRIVILEGES Privileges;
+    HANDLE hToken = NULL;
+    bool bResult = false;
+
+    if(OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &hToken))
+    {
+        Privileges.PrivilegeCount = 1;
+        Privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+        if(LookupPrivilegeValue(NULL, SE_MANAGE_VOLUME_NAME, &Privileges.Privileges[0].Luid))
+        {
+            // This succeeds even if the token doesn't have the privilege
+            if(AdjustTokenPrivileges(hToken, FALSE, &Privileges, 0, NULL, NULL))
+                bResult = (GetLastError() == ERROR_SUCCESS);
+        }
+        CloseHandle(hToken);
+    }
+    return bResult;
+}
+
+//-----------------------------------------------------------------------------
+// TFileWriter functions
+
+TFileWriter::TFileWriter()
+{
+    for(size_t i = 0; i < WRITER_BUFFER_COUNT; i++)
+    {
+        ZeroMemory(&m_Slots[i].Overlapped, sizeof(OVERLAPPED));
+        m_Slots[i].Overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+        m_Slots[i].cbPending = 0;
+    }
+
+    m_hFile = INVALID_HANDLE_VALUE;
+    m_ByteOffset = 0;
+    m_FinalSize = 0;
+    m_nSlot = 0;
+    m_dwWriteSize = WRITER_MIN_WRITE_SIZE;
+    m_dwErrCode = ERROR_SUCCESS;
+}
+
+TFileWriter::~TFileWriter()
+{
+    // Cancel whatever has not been finished
+    if(m_hFile != INVALID_HANDLE_VALUE)
+        Abort();
+
+    for(size_t i = 0; i < WRITER_BUFFER_COUNT; i++)
+    {
+        if(m_Slots[i].Overlapped.hEvent != NULL)
+            CloseHandle(m_Slots[i].Overlapped.hEvent);
+        m_Slots[i].Overlapped.hEvent = NULL;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// TFileWriter methods
+
+DWORD TFileWriter::Create(LPCWSTR szFileName, ULONGLONG FinalSize)
+{
+    static bool bCanSetValidData = EnableManageVolumePrivilege();
+    LARGE_INTEGER FilePos;
+
+    // All events must have been created
+    for(size_t i = 0; i < WRITER_BUFFER_COUNT; i++)
+    {
+        if(m_Slots[i].Overlapped.hEvent == NULL)
+            return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    // Create the file for overlapped I/O
+    m_hFile = CreateFile(szFileName, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_FLAG_OVERLAPPED, NULL);
+    if(m_hFile == INVALID_HANDLE_VALUE)
+        return GetLastError();
+
+    // NTFS completes the writes beyond the valid data length synchronously.
+    // If we may move the valid data length, preallocate the file to its final
+    // size, so that the writes really run in the background. Moving only
+    // the end of the file would not help; the file then grows with the writes.
+    if(FinalSize != 0 && bCanSetValidData)
+    {
+        FilePos.QuadPart = (LONGLONG)(FinalSize);
+        if(SetFilePointerEx(m_hFile, FilePos, NULL, FILE_BEGIN) && SetEndOfFile(m_hFile))
+        {
+            if(SetFileValidData(m_hFile, FilePos.QuadPart))
+            {
+                m_FinalSize = FinalSize;
+            }
+            else
+            {
+                FilePos.QuadPart = 0;
+                if(SetFilePointerEx(m_hFile, FilePos, NULL, FILE_BEGIN))
+                    SetEndOfFile(m_hFile);
+            }
+        }
+    }
+    return ERROR_SUCCESS;
+}
+
+std::vector<BYTE> & TFileWriter::Buffer()
+{
+    WRITER_SLOT & Slot = FreeSlot();
+
+    // Make sure that the buffer has the current write size
+    if(Slot.Buffer.size() < m_dwWriteSize)
+        Slot.Buffer.resize(m_dwWriteSize);
+    return Slot.Buffer;
+}
+
+DWORD TFileWriter::Write(DWORD cbData)
+{
+    WRITER_SLOT & Slot = m_Slots[m_nSlot];
+
+    return StartWrite(Slot, &Slot.Buffer[0], cbData);
+}
+
+// Writes the caller's data directly. They must stay valid until the writer is closed
+DWORD TFileWriter::WriteData(const void * pvData, DWORD cbData)
+{
+    return StartWrite(FreeSlot(), pvData, cbData);
+}
+
+DWORD TFileWriter::Close()
+{
+    LARGE_INTEGER FilePos;
+
+    // Wait for all pending writes
+    for(size_t i = 0; i < WRITER_BUFFER_COUNT; i++)
+        WaitForSlot(m_Slots[i]);
+
+    // If the file was preallocated to a different size, fix it
+    if(m_dwErrCode == ERROR_SUCCESS && m_FinalSize != m_ByteOffset)
+    {
+        FilePos.QuadPart = (LONGLONG)(m_ByteOffset);
+        if(!SetFilePointerEx(m_hFile, FilePos, NULL, FILE_BEGIN) || !SetEndOfFile(m_hFile))
+        {
+            m_dwErrCode = GetLastError();
+        }
+    }
+
+    // Close the file
+    CloseHandle(m_hFile);
+    m_hFile = INVALID_HANDLE_VALUE;
+    return m_dwErrCode;
+}
+
+void TFileWriter::Abort()
+{
+    LARGE_INTEGER FilePos;
+    ULONGLONG EndOffset = m_ByteOffset;
+    DWORD dwTransferred;
+
+    // Cancel the pending writes and wait until they are really finished.
+    // A cancelled write leaves a hole, so the data ends where it begins
+    CancelIo(m_hFile);
+    for(size_t i = 0; i < WRITER_BUFFER_COUNT; i++)
+    {
+        WRITER_SLOT & Slot = m_Slots[i];
+
+        if(Slot.cbPending != 0)
+        {
+            ULONGLONG SlotOffset = ((ULONGLONG)(Slot.Overlapped.OffsetHigh) << 32) | Slot.Overlapped.Offset;
+
+            dwTransferred = 0;
+            GetOverlappedResult(m_hFile, &Slot.Overlapped, &dwTransferred, TRUE);
+            if(dwTransferred != Slot.cbPending && (SlotOffset + dwTransferred) < EndOffset)
+                EndOffset = SlotOffset + dwTransferred;
+            Slot.cbPending = 0;
+        }
+    }
+
+    // The file may have been preallocated to its full size. Cut it to the data
+    // that have really been written, so that it doesn't look complete and
+    // doesn't show the old content of the disk from its valid data
+    if(m_FinalSize != EndOffset)
+    {
+        FilePos.QuadPart = (LONGLONG)(EndOffset);
+        if(SetFilePointerEx(m_hFile, FilePos, NULL, FILE_BEGIN))
+            SetEndOfFile(m_hFile);
+    }
+
+    // Close the file
+    CloseHandle(m_hFile);
+    m_hFile = INVALID_HANDLE_VALUE;
+}
+
+//-----------------------------------------------------------------------------
+// Protected functions
+
+WRITER_SLOT & TFileWriter::FreeSlot()
+{
+    WRITER_SLOT & Slot = m_Slots[m_nSlot];
+
+    // If the slot is still being written, we have to wait for it.
+    // The writes are slower than the reads, so make them bigger.
+    if(Slot.cbPending != 0)
+    {
+        if(!HasOverlappedIoCompleted(&Slot.Overlapped) && m_dwWriteSize < WRITER_MAX_WRITE_SIZE)
+            m_dwWriteSize *= 2;
+        WaitForSlot(Slot);
+    }
+    return Slot;
+}
+
+DWORD TFileWriter::StartWrite(WRITER_SLOT & Slot, const void * pvData, DWORD cbData)
+{
+    // Don't start any writes after an error
+    if(m_dwErrCode != ERROR_SUCCESS)
+        return m_dwErrCode;
+    if(cbData == 0)
+        return ERROR_SUCCESS;
+
+    // Start the write at the current offset
+    Slot.Overlapped.Offset = (DWORD)(m_ByteOffset);
+    Slot.Overlapped.OffsetHigh = (DWORD)(m_ByteOffset >> 32);
+    ResetEvent(Slot.Overlapped.hEvent);
+    if(!WriteFile(m_hFile, pvData, cbData, NULL, &Slot.Overlapped))
+    {
+        if(GetLastError() != ERROR_IO_PENDING)
+        {
+            m_dwErrCode = GetLastError();
+            return m_dwErrCode;
+        }
+    }
+
+    // Move to the next slot
+    Slot.cbPending = cbData;
+    m_ByteOffset += cbData;
+    m_nSlot = (m_nSlot + 1) % WRITER_BUFFER_COUNT;
+    return ERROR_SUCCESS;
+}
+
+DWORD TFileWriter::WaitForSlot(WRITER_SLOT & Slot)
+{
+    DWORD dwTransferred = 0;
+
+    // Is there a pending write?
+    if(Slot.cbPending != 0)
+    {
+        if(GetOverlappedResult(m_hFile, &Slot.Overlapped, &dwTransferred, TRUE))
+        {
+            if(dwTransferred != Slot.cbPending && m_dwErrCode == ERROR_SUCCESS)
+                m_dwErrCode = ERROR_WRITE_FAULT;
+        }
+        else
+        {
+            if(m_dwErrCode == ERROR_SUCCESS)
+                m_dwErrCode = GetLastError();
+        }
+        Slot.cbPending = 0;
+    }
+    return m_dwErrCode;
+}
@@ -0,0 +1,67 @@
+/*****************************************************************************/
+/* TFileWriter.h                          Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Double-buffered writer of the extracted files                             */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 16.10.26  1.00  Lad  Created                                              */
+/*****************************************************************************/
+
+#ifndef __TFILEWRITER_H__
+#define __TFILEWRITER_H__
+
+//-----------------------------------------------------------------------------
+// Defines
+
+#define WRITER_BUFFER_COUNT     2                   // Number of buffers. One is filled while the other ones are written
+#define WRITER_MIN_WRITE_SIZE   0x40000             // Initial size of one write (256 KB)
+#define WRITER_MAX_WRITE_SIZE   0x1000000           // Max. size of one write (16 MB)
+
+//-----------------------------------------------------------------------------
+// The writer. The caller fills the buffer returned by Buffer() and passes it
+// to Write(). The write is overlapped; meanwhile, the caller fills the next
+// buffer. If the caller has to wait for a write, the write size is doubled.
+// Note that NTFS runs the writes that extend the file synchronously, so the
+// writes overlap the reading only if Create could preallocate the file.
+// Data that are already in memory (e.g. in the mapped MSI file) are passed
+// to WriteData() and written without copying them to the buffer.
+
+struct WRITER_SLOT
+{
+    OVERLAPPED Overlapped;                          // Overlapped structure of the pending write
+    std::vector<BYTE> Buffer;                       // Data of the write
+    DWORD cbPending;                                // Number of bytes being written. Zero if no write is pending
+};
+
+struct TFileWriter
+{
+    TFileWriter();
+    ~TFileWriter();
+
+    DWORD Create(LPCWSTR szFileName, ULONGLONG FinalSize);
+    std::vector<BYTE> & Buffer();
+    DWORD Write(DWORD cbData);
+    DWORD WriteData(const void * pvData, DWORD cbData);
+    DWORD Close();
+    void  Abort();
+
+    DWORD ErrorCode()                   { return m_dwErrCode; }
+    DWORD WriteSize()                   { return m_dwWriteSize; }
+
+    protected:
+
+    WRITER_SLOT & FreeSlot();
+    DWORD StartWrite(WRITER_SLOT & Slot, const void * pvData, DWORD cbData);
+    DWORD WaitForSlot(WRITER_SLOT & Slot);
+
+    WRITER_SLOT m_Slots[WRITER_BUFFER_COUNT];       // Buffers and their pending writes
+    ULONGLONG m_ByteOffset;                         // File offset of the next write
+    ULONGLONG m_FinalSize;                          // Size the file has been preallocated to (0 if not preallocated)
+    HANDLE m_hFile;                                 // Handle to the target file, opened for overlapped I/O
+    size_t m_nSlot;                                 // Index of the slot being filled by the caller
+    DWORD m_dwWriteSize;                            // Current size of one write
+    DWORD m_dwErrCode;                              // The first error that happened
+};
+
+#endif // __TFILEWRITER_H__
@@ -17,6 +17,9 @@
 // Defines
 
 #define MSI_MAGIC_SIGNATURE  0x434947414D49534D // "MSIMAGIC"
+#define MSI_MAX_BLOB_SIZE    0xFFFFFFFF         // Max. size of a file that can be loaded to memory
+#define MSI_RECORD_CACHE_SIZE 16               // Max. number of MSI records kept open for binary files
+#define MSI_MIN_CHUNK_SIZE   0x10000            // Min. size of one chunk read during extraction (64 KB)
 
 //-----------------------------------------------------------------------------
 // Information about MSI database
@@ -24,6 +27,10 @@
 typedef std::vector<std::tstring> MSI_STRING_LIST;
 
 struct TMsiDatabase;
+struct TMsiSnapshot;
+struct TMsiFile;
+
+typedef std::list<std::pair<DWORD, MSIHANDLE> > MSI_RECORD_CACHE;
 
 typedef enum MSI_TYPE
 {
@@ -42,6 +49,11 @@ struct MSI_BLOB
     }
 
     ~MSI_BLOB()
+    {
+        Free();
+    }
+
+    void Free()
     {
         if(pbData != NULL)
             HeapFree(g_hHeap, 0, pbData);
@@ -69,6 +81,44 @@ struct MSI_BLOB
     DWORD cbData;
 };
 
+typedef enum MSI_FILE_TYPE
+{
+    MsiFileNone = 0,                        // Unknown / not specified
+    MsiFileSummary,                         // A summary file
+    MsiFileBinary,                          // A binary file
+    MsiFileStream,                          // A stream read directly from the compound file
+    MsiFileTable,                           // A MSI table file
+    MsiFileCabinet,                         // A file in an embedded cabinet
+    MsiFileTypeCount                        // Number of the file types
+};
+
+typedef enum MSI_READ_SOURCE
+{
+    MsiReadNone = 0,                        // Not decided yet
+    MsiReadStream,                          // Read from the compound file
+    MsiReadTable,                           // Rendered from the decoded table
+    MsiReadRecord,                          // Read from the MSI record
+    MsiReadCabinet,                         // Decompressed from the embedded cabinet
+    MsiReadMemory,                          // Copied from the loaded file data
+    MsiReadPrefetched                       // Copied from the stream loaded ahead by the prefetcher
+};
+
+// Position of reading a file by chunks
+struct MSI_READ_CURSOR
+{
+    MSI_READ_CURSOR();
+    ~MSI_READ_CURSOR();
+
+    CFB_STREAM Stream;                      // The stream in the compound file (if MsiReadStream)
+    std::vector<BYTE> Data;                 // The stream loaded ahead (if MsiReadPrefetched)
+    ULONGLONG ByteOffset;                   // Number of bytes read so far
+    MSI_READ_SOURCE Source;                 // Where the data come from
+    MSIHANDLE hMsiRecord;                   // The record (if MsiReadRecord)
+    UINT nStreamField;                      // Field of the stream in the record (if MsiReadRecord)
+    DWORD dwRow;                            // The next row to be rendered (if MsiReadTable)
+    bool bHeaderDone;                       // true if the header has already been rendered (if MsiReadTable)
+};
+
 struct TMsiColumn
 {
     TMsiColumn(LPCTSTR szName, LPCTSTR szType);
@@ -88,135 +138,257 @@ struct TMsiTable
     DWORD Release();
 
     DWORD Load();
+    DWORD LoadFromCatalog(const MSI_CATALOG_TABLE & CatalogTable);
     DWORD LoadColumns();
+    DWORD LoadPrimaryKeys();
+    void  FindSpecialColumns();
+    size_t FindColumn(LPCTSTR szColumnName, MSI_TYPE ColumnType);
+    TMsiTableData * Data();
+    MSIHANDLE MsiView();
 
     const std::vector<TMsiColumn> & Columns()   { return m_Columns; }
-    MSIHANDLE MsiView()                         { return m_hMsiView; }
     LPCTSTR Name()                              { return m_strName.c_str(); }
 
     std::vector<TMsiColumn> m_Columns;      // List of columns
+    std::vector<size_t> m_KeyColumns;       // Indexes of the primary key columns
     std::tstring m_strName;                 // Table name
     TMsiDatabase * m_pMsiDb;                // Pointer to the parent database
-    LIST_ENTRY m_Entry;                     // Links to other tables
-    MSIHANDLE m_hMsiView;                   // MSI handle to the database view
+    TMsiTableData * m_pTableData;           // Natively decoded table data (loaded on demand)
+    MSIHANDLE m_hMsiView;                   // MSI handle to the database view (opened on demand)
     size_t m_nStreamColumn;                 // Index of the stream column. -1 if none
     size_t m_nNameColumn;                   // Index of the name column. -1 if none
     DWORD m_bIsStreamsTable;                // TRUE if this is the "_Streams" table
+    DWORD m_bDataLoaded;                    // TRUE if the native decoding has been tried
     DWORD m_dwRefs;
 };
 
+// Cold part of a file. Only needed when the file data are read
+struct MSI_FILE_DETAIL
+{
+    TMsiTable * pMsiTable;                  // Pointer to the database table. Owned by the snapshot
+    TCabFolderPool * pCabPool;              // Decompressor of the embedded cabinet (if cabinet file). Owned by the snapshot
+    MSIHANDLE hMsiHandle;                   // Handle to the MSI summary (if summary file) or the record (if binary file without primary key)
+    MSI_FILE_TYPE FileType;
+    DWORD dwStreamEntry;                    // Directory entry in the compound file (if stream file)
+    DWORD dwCabFile;                        // Index of the file in the cabinet (if cabinet file)
+    DWORD KeyOffset;                        // Values of the primary key of the row in the name arena (if binary file)
+    DWORD KeyCount;                         // Number of the values of the primary key
+};
+
+// All files of the database as structure of arrays. The names and the key values
+// are stored in one arena, so the whole list is allocated and freed in a few blocks
+struct TMsiFileList
+{
+    TMsiFileList();
+    ~TMsiFileList();
+
+    DWORD NewFile(TMsiTable * pMsiTable);
+    void  RemoveLastFile();
+    void  SetName(DWORD dwFile, LPCTSTR szFileName);
+    void  SetRefFile(DWORD dwFile, DWORD dwRefFile);
+    void  AddKeyValue(DWORD dwFile, LPCTSTR szValue);
+    LPCTSTR KeyValue(DWORD dwFile, size_t nIndex);
+    DWORD Find(LPCTSTR szFileName);
+    void  Clear();
+    void  CopyListing(const TMsiFileList & Source);
+    size_t MemorySize() const;
+
+    DWORD LoadFromCache(LPCTSTR szCacheFile, const MSI_CACHE_KEY & CacheKey, DWORD dwEntryCount);
+    DWORD SaveToCache(LPCTSTR szCacheFile, const MSI_CACHE_KEY & CacheKey);
+
+    MSI_FILE_ENTRY & Entry(DWORD dwFile)        { return m_Entries[dwFile]; }
+    MSI_FILE_DETAIL & Detail(DWORD dwFile)      { return m_Details[dwFile]; }
+    LPCTSTR Name(DWORD dwFile)                  { return &m_Arena[m_Entries[dwFile].NameOffset]; }
+    DWORD Count()                               { return (DWORD)(m_Entries.size()); }
+
+    protected:
+
+    DWORD AppendString(LPCTSTR szString, size_t ccString);
+    void  InsertToIndex(DWORD dwFile);
+    DWORD LoadCacheData(LPBYTE pbCache, size_t cbCache, const MSI_CACHE_KEY & CacheKey, DWORD dwEntryCount);
+
+    std::vector<MSI_FILE_ENTRY> m_Entries;  // Hot parts of the files
+    std::vector<MSI_FILE_DETAIL> m_Details; // Cold parts of the files
+    std::vector<TCHAR> m_Arena;             // Zero-terminated file names and key values
+    std::vector<DWORD> m_Index;             // Open-addressing hash table of the lowercased names
+};
+
+// A view of one file of the TMsiFileList, with the state needed to read it
 struct TMsiFile
 {
-    TMsiFile(TMsiTable * pMsiTable);
+    TMsiFile(TMsiDatabase * pMsiDb, TMsiSnapshot * pSnapshot, DWORD dwFile);
     ~TMsiFile();
 
     DWORD AddRef();
     DWORD Release();
+    void  Attach(DWORD dwFile);
 
-    DWORD SetSummaryFile(TMsiDatabase * pMsiDb, MSIHANDLE hMsiSummary);
+    DWORD SetSummaryFile(MSIHANDLE hMsiSummary);
     DWORD SetBinaryFile(TMsiDatabase * pMsiDb, MSIHANDLE hMsiRecord);
-    DWORD SetCsvFile(TMsiDatabase * pMsiDb);
+    DWORD SetBinaryFile(DWORD dwStreamEntry);
+    DWORD SetStreamFile(DWORD dwStreamEntry);
+    DWORD SetCsvFile();
+    DWORD SetCabinetFile(TCabFolderPool * pCabPool, DWORD dwCabFile);
 
     DWORD LoadSummaryFile(LPDWORD PtrFileSize);
     DWORD LoadBinaryFile(LPDWORD PtrFileSize);
+    DWORD LoadStreamFile(PULONGLONG PtrFileSize);
     DWORD LoadCsvFile(LPDWORD PtrFileSize);
+    DWORD LoadCabinetFile(LPDWORD PtrFileSize);
     
-    DWORD LoadFileInternal(LPDWORD PtrFileSize);
+    DWORD LoadFileInternal(PULONGLONG PtrFileSize);
+    DWORD LoadStreamFileInternal(PULONGLONG PtrFileSize);
     DWORD LoadFileData();
-
-    void MakeItemNameFileSafe(std::tstring & strItemName);
+    DWORD OpenRecordStream(MSIHANDLE * PtrMsiRecord, UINT * PtrStreamField);
+    DWORD OpenCursor(MSI_READ_CURSOR & Cursor);
+    DWORD MapChunk(MSI_READ_CURSOR & Cursor, DWORD cbMaxData, const BYTE ** PtrData, LPDWORD PtrBytesMapped);
+    DWORD ReadChunk(MSI_READ_CURSOR & Cursor, std::vector<BYTE> & Chunk, LPDWORD PtrBytesRead);
+    DWORD OpenStream(CFB_STREAM & Stream);
+    DWORD StartCabinetFile();
+    bool  IsNativeTableFile();
+    DWORD ReadCsvChunk(MSI_READ_CURSOR & Cursor, std::vector<BYTE> & Chunk, LPDWORD PtrBytesRead);
+    static size_t CsvHeaderSize(const std::vector<TMsiColumn> & Columns);
 
     const MSI_BLOB & FileData();
-    DWORD FileSize();
+    ULONGLONG FileSize();
     LPCTSTR Name();
 
-    enum MSI_FT
-    {
-        MsiFileNone = 0,            // Unknown / not specified
-        MsiFileSummary,             // A summary file
-        MsiFileBinary,              // A binary file
-        MsiFileTable                // A MSI table file
-    };
-
     protected:
 
-    DWORD SetUniqueFileName(TMsiDatabase * pMsiDb, LPCTSTR szFolderName, LPCTSTR szBaseName, LPCTSTR szExtension);
+    DWORD FindRecordStream(TMsiDatabase * pMsiDb, MSIHANDLE hMsiRecord);
+    void  StoreFileSize(PULONGLONG PtrFileSize, ULONGLONG FileSize);
+
+    MSI_FILE_ENTRY & Entry();
+    MSI_FILE_DETAIL & Detail();
+    TMsiTable * Table();
 
     friend struct TMsiDatabase;
 
-    LIST_ENTRY m_Entry;                     // Link to other files
-    TMsiTable * m_pMsiTable;                // Pointer to the database table
-    TMsiFile * m_pRefFile;                  // Reference to another file
-    std::tstring m_strName;                 // File name
-    MSIHANDLE m_hMsiHandle;                 // Handle to the MSI record (if binary file) or MSI summary (if summary file)
-    MSI_BLOB m_Data;
-    MSI_FT m_FileType;
-    DWORD m_dwFileSize;                     // Size of the file
+    CRITICAL_SECTION m_DataLock;            // Guards the loading of m_Data
+    TMsiDatabase * m_pMsiDb;                // The database of the file (not referenced)
+    TMsiSnapshot * m_pSnapshot;             // The snapshot with the file list (referenced)
+    DWORD m_dwFile;                         // Index of the file in the file list
+    DWORD m_dwDataFile;                     // Index of the file with the data (differs if the file refers to another one)
+    MSI_BLOB m_Data;                        // Data of the file, if loaded to memory
+    DWORD m_dwRefs;
+};
+
+// The listing of one open archive: its tables, files and embedded cabinets.
+// It is built once and all file sizes are known before it is published.
+// After that, it never changes and is read without any lock. Whoever works
+// with its files holds a reference, so the snapshot can be replaced or closed
+// while the files are still being extracted.
+struct TMsiSnapshot
+{
+    TMsiSnapshot();
+
+    DWORD AddRef();
+    DWORD Release();
+
+    std::vector<TMsiTable *> m_Tables;      // List of tables
+    TMsiFileList m_Files;                   // List of files
+    MSI_RECORD_CACHE m_Records;             // Recently used records of binary files, the most recent first. Guarded by the MSI lock of the database
+    std::vector<TCabinet *> m_Cabinets;     // Embedded cabinets referenced by the "Media" table
+    std::vector<TCabFolderPool *> m_CabPools; // Folder decompressors, one per embedded cabinet
+    DWORD m_bCachedFiles;                   // TRUE if the file list has been restored from a cache
     DWORD m_dwRefs;
+
+    protected:
+
+    ~TMsiSnapshot();
+};
+
+// Parsed data of one archive, shared by all opens of the same unchanged archive.
+// Each part is set only once and never changes after that. The data stay
+// in the process-wide cache after the archive is closed, until evicted.
+struct TMsiSharedData
+{
+    TMsiSharedData(const MSI_CACHE_KEY & CacheKey);
+    ~TMsiSharedData();
+
+    TMsiStringPool * StringPool();
+    TMsiStringPool * SetStringPool(TMsiStringPool * pStringPool);
+    TMsiCatalog * Catalog();
+    TMsiCatalog * SetCatalog(TMsiCatalog * pCatalog);
+    DWORD LoadFileList(TMsiFileList & Files);
+    void  SetFileList(const TMsiFileList & Files);
+
+    MSI_CACHE_KEY m_CacheKey;               // Identity of the archive
+    TMsiStringPool * m_pStringPool;         // Decoded string pool (NULL if not loaded yet)
+    TMsiCatalog * m_pCatalog;               // Decoded _Tables and _Columns (NULL if not loaded yet)
+    TMsiFileList m_Files;                   // Completed listing, without the database-specific parts
+    size_t m_cbMemory;                      // Memory taken by the parts above
+    DWORD m_bHasFiles;                      // TRUE if m_Files is valid
+    DWORD m_dwRefs;                         // Number of databases that use the data
 };
 
 // Our structure describing open archive
 struct TMsiDatabase
 {
-    TMsiDatabase(MSIHANDLE hMsiDb, FILETIME & ft);
+    TMsiDatabase(MSIHANDLE hMsiDb, TCompoundFile * pCompFile, FILETIME & ft);
 
     static TMsiDatabase * FromHandle(HANDLE hHandle);
 
     DWORD AddRef();
     DWORD Release();
     void  CloseAllFiles();
-    void  UnlockAndRelease();
 
+    void  SetListingCache(LPCTSTR szCacheFile, const MSI_CACHE_KEY & CacheKey);
+    void  SetSharedData(TMsiSharedData * pShared);
     TMsiFile * GetNextFile();
+    DWORD ReloadCachedFiles();
+    DWORD ReloadLastFile();
+    void  FileStarted();
+    void  FileSkipped();
+    void  PrefetchFiles();
+    DWORD BuildSnapshot(bool bUseCache, TMsiSnapshot ** PtrSnapshot);
+    DWORD MeasureCsvFiles();
+    void  LoadFileSizes(bool bCsvMeasured);
     TMsiFile * ReleaseLastFile(TMsiFile * pMsiFile = NULL);
-    TMsiFile * FindReferencedFile(TMsiTable * pMsiTable, LPCTSTR szStreamName, LPTSTR szFileName, size_t ccFileName);
 
+    DWORD LoadFileList(bool bUseCache);
     DWORD LoadTableNameIfExists(LPCTSTR szTableName);
     DWORD LoadTableNames();
     DWORD LoadTables();
+    DWORD LoadCatalogTables(TMsiCatalog * pCatalog);
     DWORD LoadFiles();
-    DWORD LoadMultipleStreamFiles(TMsiTable * pMsiTable);
-    DWORD LoadSimpleCsvFile(TMsiTable * pMsiTable);
-    DWORD LoadSummaryFile(MSIHANDLE hMsiSummary);
-
-    TMsiFile * IsFilePresent(LPCTSTR szFileName);
+    DWORD LoadRowNames(TMsiTable * pMsiTable, MSI_LISTING_TABLE & ListingTable, std::vector<MSIHANDLE> & Records);
+    MSIHANDLE FetchFileRecord(TMsiSnapshot * pSnapshot, DWORD dwFile);
+    MSIHANDLE GetFileRecord(TMsiSnapshot * pSnapshot, DWORD dwFile);
+    void LockMsiHandles()               { EnterCriticalSection(&m_MsiLock); }
+    void UnlockMsiHandles()             { LeaveCriticalSection(&m_MsiLock); }
     TMsiFile * LastFile();
+    TMsiStringPool * StringPool();
+    TMsiCatalog * Catalog();
+    TCompoundFile * CompoundFile()      { return m_pCompFile; }
+    TStreamPrefetcher & Prefetcher()    { return m_Prefetcher; }
+    TCsvRenderPool & CsvPool()          { return m_CsvPool; }
+    MSIHANDLE MsiHandle()               { return m_hMsiDb; }
     const FILETIME & FileTime()         { return m_FileTime; }
 
     protected:
 
     ~TMsiDatabase();
-    
-    template <typename LIST_ITEM>
-    void DeleteLinkedList(LIST_ENTRY & Links)
-    {
-        PLIST_ENTRY pHeadEntry = &Links;
-        PLIST_ENTRY pListEntry;
-        LIST_ITEM * pMsiItem;
-
-        for(pListEntry = pHeadEntry->Flink; pListEntry != pHeadEntry; )
-        {
-            // Get the TMsiTable out of it and move the pointer
-            pMsiItem = CONTAINING_RECORD(pListEntry, LIST_ITEM, m_Entry);
-            pListEntry = pListEntry->Flink;
-
-            // Unlin and free the class
-            RemoveEntryList(&pMsiItem->m_Entry);
-            pMsiItem->Release();
-        }
-    }
 
-    CRITICAL_SECTION m_Lock;
+    CRITICAL_SECTION m_CursorLock;          // Guards the iteration cursor, the building and the publishing of the snapshot
+    CRITICAL_SECTION m_MsiLock;             // Serializes the use of msi.dll views and records
     MSI_STRING_LIST m_TableNames;
-    PLIST_ENTRY m_pFileEntry;
     TMsiFile * m_pLastFile;                 // The last file found by ReadHeaders
-    LIST_ENTRY m_Tables;                    // List of tables
-    LIST_ENTRY m_Files;                     // List of files
+    TMsiSnapshot * m_pSnapshot;             // The published snapshot (NULL if not built yet)
+    TMsiSnapshot * m_pBuild;                // The snapshot being built
+    MSI_CACHE_KEY m_CacheKey;               // Identity of the archive in the listing cache
+    std::tstring m_strCacheFile;            // Listing cache file to be loaded or saved. Empty if not used
+    TMsiSharedData * m_pShared;             // Data shared with other opens of the same archive (can be NULL)
+    TStreamPrefetcher m_Prefetcher;         // Loads the streams of the next files during extraction
+    TCsvRenderPool m_CsvPool;               // Renders the natively decoded tables to CSV
     ULONGLONG m_MagicSignature;             // MSI_MAGIC_SIGNATURE
+    TCompoundFile * m_pCompFile;            // Native access to the MSI storage (can be NULL)
+    TMsiStringPool * m_pStringPool;         // Decoded string pool (loaded on demand)
+    TMsiCatalog * m_pCatalog;               // Decoded _Tables and _Columns (loaded on demand)
     MSIHANDLE m_hMsiDb;
     FILETIME m_FileTime;                    // File time of the MSI archive
-    DWORD m_dwTables;                       // Number of tables
-    DWORD m_dwFiles;                        // Number of files
+    DWORD m_dwNextFile;                     // The next file to be returned by GetNextFile
+    DWORD m_dwFilesStarted;                 // Number of files whose extraction has been started
     DWORD m_dwRefs;
 };
 
@@ -241,4 +413,15 @@ bool MsiRecordGetInteger(MSIHANDLE hMsiRecord, UINT nColumn, std::tstring & strV
 bool MsiRecordGetString(MSIHANDLE hMsiRecord, UINT nColumn, std::tstring & strValue);
 bool MsiRecordGetBinary(MSIHANDLE hMsiRecord, UINT nColumn, MSI_BLOB & binValue);
 
+//-----------------------------------------------------------------------------
+// Listing cache
+
+DWORD MsiCacheMakeKey(LPCTSTR szArchiveName, const WIN32_FIND_DATA & wf, TCompoundFile * pCompFile, MSI_CACHE_KEY & CacheKey);
+DWORD MsiCacheFileName(LPCTSTR szCacheDir, const MSI_CACHE_KEY & CacheKey, std::tstring & strCacheFile);
+
+void MsiSharedCacheInitialize();
+TMsiSharedData * MsiSharedCacheAcquire(const MSI_CACHE_KEY & CacheKey);
+void MsiSharedCacheRelease(TMsiSharedData * pShared);
+void MsiSharedCacheCleanup();
+
 #endif // __TMSI_H__
@@ -0,0 +1,483 @@
+/*****************************************************************************/
+/* TMsiArchive.cpp                        Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Native listing and reading of an MSI file, named the same way like        */
+/* the plugin names the files                                                */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 16.10.26  1.00  Lad  Created                                              */
+/*****************************************************************************/
+
+#include "wcx_msi.h"
+#include <algorithm>
+
+//-----------------------------------------------------------------------------
+// MSI_ITEM_CURSOR functions
+
+MSI_ITEM_CURSOR::MSI_ITEM_CURSOR()
+{
+    pCabReader = NULL;
+    ByteOffset = 0;
+    dwRow = 0;
+    bStarted = false;
+}
+
+//-----------------------------------------------------------------------------
+// TMsiArchive functions
+
+TMsiArchive::TMsiArchive()
+{
+    m_dwMaxWorkers = 1;
+}
+
+TMsiArchive::~TMsiArchive()
+{
+    Close();
+}
+
+DWORD TMsiArchive::Open(LPCTSTR szFileName, DWORD dwMaxWorkers)
+{
+    std::vector<MSI_LISTING_TABLE> ListingTables;
+    std::vector<TCabinet *> Cabinets;
+    TCabFolderPool * pCabPool;
+    TMsiSummary Summary;
+    bool bSummary;
+    DWORD dwErrCode;
+
+    // Load the strings and the list of the tables
+    m_dwMaxWorkers = (dwMaxWorkers != 0) ? dwMaxWorkers : 1;
+    if((dwErrCode = m_CompFile.Open(szFileName)) != ERROR_SUCCESS)
+        return dwErrCode;
+    if((dwErrCode = m_StringPool.Load(&m_CompFile)) != ERROR_SUCCESS)
+        return dwErrCode;
+    if((dwErrCode = m_Catalog.Load(&m_CompFile, m_StringPool)) != ERROR_SUCCESS)
+        return dwErrCode;
+    m_CsvPool.Open(m_dwMaxWorkers);
+
+    // The summary information is rendered only once, it is small
+    if((bSummary = (Summary.Load(&m_CompFile) == ERROR_SUCCESS)) == true)
+        Summary.RenderCsv(m_SummaryCsv);
+
+    // Decode all tables and list the files, the same way as the plugin does
+    if((dwErrCode = LoadTables(ListingTables)) != ERROR_SUCCESS)
+        return dwErrCode;
+    if((dwErrCode = m_Listing.Build(&m_CompFile, &m_StringPool, ListingTables, bSummary)) != ERROR_SUCCESS)
+        return dwErrCode;
+
+    // Folders of the cabinets are decompressed on all cores during bulk extraction
+    m_Listing.TakeCabinets(m_Cabinets);
+    for(size_t i = 0; i < m_Cabinets.size(); i++)
+    {
+        if((pCabPool = new TCabFolderPool()) == NULL)
+            return ERROR_NOT_ENOUGH_MEMORY;
+        pCabPool->Open(m_Cabinets[i], m_dwMaxWorkers);
+        m_CabPools.push_back(pCabPool);
+    }
+
+    // All sizes are known after this
+    return MeasureItems();
+}
+
+// Reads the next chunk of the item. More readers may read at once, each with its own cursor.
+// The number of bytes read is zero at the end of the item.
+DWORD TMsiArchive::ReadChunk(DWORD dwItem, MSI_ITEM_CURSOR & Cursor, std::vector<BYTE> & Chunk, LPDWORD PtrBytesRead)
+{
+    const MSI_LISTING_ITEM & Item = DataItem(dwItem);
+    DWORD dwBytesRead = 0;
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    // Make sure that the chunk has at least the minimal size
+    if(Chunk.size() < MSI_ITEM_CHUNK_SIZE)
+        Chunk.resize(MSI_ITEM_CHUNK_SIZE);
+
+    switch(Item.Type)
+    {
+        case MsiItemSummary:
+            if(Cursor.ByteOffset < m_SummaryCsv.size())
+            {
+                dwBytesRead = (DWORD)std::min<ULONGLONG>(Chunk.size(), m_SummaryCsv.size() - Cursor.ByteOffset);
+                memcpy(&Chunk[0], &m_SummaryCsv[(size_t)(Cursor.ByteOffset)], dwBytesRead);
+            }
+            break;
+
+        case MsiItemRow:
+        case MsiItemStream:
+            if(Item.dwStreamEntry != CFB_NOSTREAM)
+            {
+                if(Cursor.bStarted == false)
+                    dwErrCode = m_CompFile.OpenStream(Item.dwStreamEntry, Cursor.Stream);
+                if(dwErrCode == ERROR_SUCCESS)
+                    dwErrCode = m_CompFile.ReadStream(Cursor.Stream, Cursor.ByteOffset, &Chunk[0], (DWORD)(Chunk.size()), &dwBytesRead);
+            }
+            break;
+
+        case MsiItemCabinet:
+        {
+            TCabFolderPool * pCabPool = m_CabPools[Item.dwCabinet];
+            TCabFolderReader * pCabReader = Cursor.pCabReader;
+            const CAB_FILE & CabFile = pCabPool->Cabinet()->File(Item.dwCabFile);
+
+            // The caller's reader continues with the next file of the same folder.
+            // Otherwise, the pool starts decompressing the next folders ahead on bulk extraction.
+            if(Cursor.bStarted == false)
+            {
+                if(pCabReader == NULL)
+                    pCabPool->FileStarted();
+                else if(pCabReader->Cabinet() != pCabPool->Cabinet() || pCabReader->Folder() != CabFile.Folder)
+                    dwErrCode = pCabReader->Open(pCabPool->Cabinet(), CabFile.Folder);
+            }
+
+            if(dwErrCode == ERROR_SUCCESS && Cursor.ByteOffset < CabFile.FileSize)
+            {
+                dwBytesRead = (DWORD)std::min<ULONGLONG>(Chunk.size(), CabFile.FileSize - Cursor.ByteOffset);
+                if(pCabReader != NULL)
+                    dwErrCode = pCabReader->Read(CabFile.FolderOffset + Cursor.ByteOffset, &Chunk[0], dwBytesRead, &dwBytesRead);
+                else
+                    dwErrCode = pCabPool->Read(CabFile.Folder, CabFile.FolderOffset + Cursor.ByteOffset, &Chunk[0], dwBytesRead, &dwBytesRead);
+            }
+            break;
+        }
+
+        case MsiItemTable:
+            dwErrCode = ReadTableChunk(Item, Cursor, Chunk, &dwBytesRead);
+            break;
+
+        default:
+            dwErrCode = ERROR_NOT_SUPPORTED;
+            assert(false);
+            break;
+    }
+
+    // Give the number of bytes to the caller
+    if(dwErrCode == ERROR_SUCCESS)
+    {
+        Cursor.bStarted = true;
+        Cursor.ByteOffset += dwBytesRead;
+        PtrBytesRead[0] = dwBytesRead;
+    }
+    return dwErrCode;
+}
+
+// Writes the whole item directly from the compound file to the target file.
+// On Linux, the kernel copies the data between the files, if it can.
+// Returns ERROR_NOT_SUPPORTED if the item is not a stream; then use ReadChunk.
+DWORD TMsiArchive::WriteItem(DWORD dwItem, CFB_FILE_HANDLE hTargetFile, PULONGLONG PtrBytesWritten)
+{
+    const MSI_LISTING_ITEM & Item = DataItem(dwItem);
+    CFB_STREAM Stream;
+    ULONGLONG ByteOffset = 0;
+    DWORD dwBytesWritten = 0;
+    DWORD dwErrCode;
+
+    // Only the items stored as streams
+    if((Item.Type != MsiItemRow && Item.Type != MsiItemStream) || Item.dwStreamEntry == CFB_NOSTREAM)
+        return ERROR_NOT_SUPPORTED;
+    if((dwErrCode = m_CompFile.OpenStream(Item.dwStreamEntry, Stream)) != ERROR_SUCCESS)
+        return dwErrCode;
+
+    // Write the stream by large pieces
+    while(ByteOffset < Stream.Size)
+    {
+        DWORD dwToWrite = (DWORD)std::min<ULONGLONG>(MSI_ITEM_WRITE_SIZE, Stream.Size - ByteOffset);
+
+        if((dwErrCode = m_CompFile.WriteStream(Stream, ByteOffset, dwToWrite, hTargetFile, &dwBytesWritten)) != ERROR_SUCCESS)
+            break;
+        if(dwBytesWritten == 0)
+            break;
+        ByteOffset += dwBytesWritten;
+    }
+
+    // Give the number of bytes written
+    PtrBytesWritten[0] = ByteOffset;
+    return dwErrCode;
+}
+
+// Items that refer to another item show its data
+const MSI_LISTING_ITEM & TMsiArchive::DataItem(DWORD dwItem) const
+{
+    const MSI_LISTING_ITEM & Item = m_Listing.Item(dwItem);
+
+    return (Item.RefItem != MSI_NO_ITEM) ? m_Listing.Item(Item.RefItem) : Item;
+}
+
+// Splits the items to the units of parallel extraction. The files of one cabinet
+// folder are one unit, in the order of their data in the folder, so that each
+// folder is decompressed only once, by one thread with its own TCabFolderReader.
+// Items that show the same data follow each other. Other items are single units.
+void TMsiArchive::GroupItems(const std::vector<DWORD> & Items, std::vector<std::vector<DWORD> > & Units) const
+{
+    std::unordered_map<ULONGLONG, size_t> FolderUnits;
+
+    Units.clear();
+    for(size_t i = 0; i < Items.size(); i++)
+    {
+        const MSI_LISTING_ITEM & Item = DataItem(Items[i]);
+
+        if(Item.Type == MsiItemCabinet)
+        {
+            ULONGLONG FolderKey = ((ULONGLONG)(Item.dwCabinet) << 32) | m_Cabinets[Item.dwCabinet]->File(Item.dwCabFile).Folder;
+            std::pair<std::unordered_map<ULONGLONG, size_t>::iterator, bool> Inserted;
+
+            Inserted = FolderUnits.insert(std::make_pair(FolderKey, Units.size()));
+            if(Inserted.second)
+                Units.push_back(std::vector<DWORD>());
+            Units[Inserted.first->second].push_back(Items[i]);
+        }
+        else
+        {
+            Units.push_back(std::vector<DWORD>(1, Items[i]));
+        }
+    }
+
+    // Sort the files of each folder by their offset
+    for(size_t i = 0; i < Units.size(); i++)
+    {
+        std::stable_sort(Units[i].begin(), Units[i].end(), [this](DWORD dwItem1, DWORD dwItem2)
+        {
+            const MSI_LISTING_ITEM & Item1 = DataItem(dwItem1);
+            const MSI_LISTING_ITEM & Item2 = DataItem(dwItem2);
+
+            const TCabinet * pCabinet = m_Cabinets[Item1.dwCabinet];
+
+            // Units of more items only have the files of one cabinet folder
+            if(pCabinet->File(Item1.dwCabFile).FolderOffset != pCabinet->File(Item2.dwCabFile).FolderOffset)
+                return (pCabinet->File(Item1.dwCabFile).FolderOffset < pCabinet->File(Item2.dwCabFile).FolderOffset);
+            return (Item1.dwCabFile < Item2.dwCabFile);
+        });
+    }
+}
+
+void TMsiArchive::Close()
+{
+    // Stop the decompressors before their cabinets are freed
+    for(size_t i = 0; i < m_CabPools.size(); i++)
+        delete m_CabPools[i];
+    m_CabPools.clear();
+    for(size_t i = 0; i < m_Cabinets.size(); i++)
+        delete m_Cabinets[i];
+    m_Cabinets.clear();
+
+    // Free the tables
+    for(size_t i = 0; i < m_Tables.size(); i++)
+        delete m_Tables[i];
+    m_Tables.clear();
+
+    m_CsvPool.Stop();
+    m_Listing.Clear();
+    m_ItemSizes.clear();
+    m_SummaryCsv.clear();
+    m_CompFile.Close();
+}
+
+// Decodes all tables. Tables that cannot be decoded are still listed
+DWORD TMsiArchive::LoadTables(std::vector<MSI_LISTING_TABLE> & ListingTables)
+{
+    std::vector<MSI_COLUMN_LAYOUT> Layout;
+    MSI_LISTING_TABLE ListingTable;
+    MSI_ARCHIVE_TABLE * pTable;
+
+    for(size_t i = 0; i < m_Catalog.TableCount(); i++)
+    {
+        const MSI_CATALOG_TABLE & CatalogTable = m_Catalog.Table(i);
+
+        if((pTable = new MSI_ARCHIVE_TABLE) == NULL)
+            return ERROR_NOT_ENOUGH_MEMORY;
+        pTable->pCatalogTable = &CatalogTable;
+        ListingTable.Name = CatalogTable.Name;
+        ListingTable.ColumnNames.clear();
+        ListingTable.nStreamColumn = INVALID_SIZE_T;
+        ListingTable.nNameColumn = INVALID_SIZE_T;
+        ListingTable.bIsStreamsTable = false;
+
+        // The UTF-8 marker and the header of the CSV file
+        pTable->CsvHeader.push_back(0xEF);
+        pTable->CsvHeader.push_back(0xBB);
+        pTable->CsvHeader.push_back(0xBF);
+
+        // Setup the layout of the table stream from the column types
+        Layout.resize(CatalogTable.Columns.size());
+        for(size_t nColumn = 0; nColumn < CatalogTable.Columns.size(); nColumn++)
+        {
+            const MSI_CATALOG_COLUMN & Column = CatalogTable.Columns[nColumn];
+            size_t cbHeader = pTable->CsvHeader.size();
+
+            // The same types as the plugin gets from msi.dll
+            Layout[nColumn].IsKey = (Column.Type & MSI_COLUMN_KEY) ? true : false;
+            if(MSI_COLUMN_IS_BINARY(Column.Type))
+            {
+                Layout[nColumn].CellType = MsiCellStream;
+                Layout[nColumn].Width = 2;
+                if(ListingTable.nStreamColumn == INVALID_SIZE_T)
+                    ListingTable.nStreamColumn = nColumn;
+            }
+            else if(Column.Type & MSI_COLUMN_STRING)
+            {
+                Layout[nColumn].CellType = MsiCellString;
+                Layout[nColumn].Width = m_StringPool.StringRefSize();
+                if(ListingTable.nNameColumn == INVALID_SIZE_T)
+                    ListingTable.nNameColumn = nColumn;
+            }
+            else
+            {
+                Layout[nColumn].CellType = MsiCellInteger;
+                Layout[nColumn].Width = ((Column.Type & MSI_COLUMN_WIDTH_MASK) <= 2) ? 2 : 4;
+            }
+            ListingTable.ColumnNames.push_back(Column.Name);
+
+            // Append the name of the column to the header
+            pTable->CsvHeader.resize(cbHeader + 3 + MsiCsvCellLength(Column.Name.c_str(), Column.Name.size()));
+            if(nColumn > 0)
+                pTable->CsvHeader[cbHeader++] = ',';
+            pTable->CsvHeader[cbHeader++] = '\"';
+            cbHeader += MsiCsvCellEncode(&pTable->CsvHeader[cbHeader], pTable->CsvHeader.size() - cbHeader, Column.Name.c_str(), Column.Name.size());
+            pTable->CsvHeader[cbHeader++] = '\"';
+            pTable->CsvHeader.resize(cbHeader);
+        }
+        pTable->CsvHeader.push_back('\r');
+        pTable->CsvHeader.push_back('\n');
+
+        // The name column only matters in the tables with a binary column
+        if(ListingTable.nStreamColumn == INVALID_SIZE_T)
+            ListingTable.nNameColumn = INVALID_SIZE_T;
+
+        // Tables that cannot be decoded are listed, but their rows are not known
+        pTable->bDecoded = (pTable->Data.Load(&m_CompFile, CatalogTable.Name, Layout) == ERROR_SUCCESS);
+        ListingTable.pTableData = (pTable->bDecoded) ? &pTable->Data : NULL;
+        ListingTables.push_back(ListingTable);
+        m_Tables.push_back(pTable);
+    }
+
+    // Like in the plugin, the "_Streams" table is the last one
+    ListingTable.Name = MSI_WSTR("_Streams");
+    ListingTable.ColumnNames.clear();
+    ListingTable.pTableData = NULL;
+    ListingTable.nStreamColumn = INVALID_SIZE_T;
+    ListingTable.nNameColumn = INVALID_SIZE_T;
+    ListingTable.bIsStreamsTable = true;
+    ListingTables.push_back(ListingTable);
+    return ERROR_SUCCESS;
+}
+
+// Calculates the sizes of all items. All tables are measured at once,
+// so that the tables and the row ranges of big tables are measured in parallel
+DWORD TMsiArchive::MeasureItems()
+{
+    std::vector<MSI_CSV_JOB> Jobs;
+    std::vector<DWORD> JobItems;
+    MSI_CSV_JOB Job = {NULL, 0, 0, NULL, 0, 0};
+    DWORD dwErrCode;
+
+    m_ItemSizes.resize(m_Listing.ItemCount());
+    for(DWORD dwItem = 0; dwItem < m_Listing.ItemCount(); dwItem++)
+    {
+        const MSI_LISTING_ITEM & Item = m_Listing.Item(dwItem);
+
+        m_ItemSizes[dwItem] = 0;
+        if(Item.RefItem != MSI_NO_ITEM)
+            continue;
+
+        switch(Item.Type)
+        {
+            case MsiItemSummary:
+                m_ItemSizes[dwItem] = m_SummaryCsv.size();
+                break;
+
+            case MsiItemTable:
+                if(m_Tables[Item.dwTable]->bDecoded)
+                {
+                    Job.pTableData = &m_Tables[Item.dwTable]->Data;
+                    Job.dwRows = Job.pTableData->RowCount();
+                    Jobs.push_back(Job);
+                    JobItems.push_back(dwItem);
+                }
+                break;
+
+            case MsiItemRow:
+            case MsiItemStream:
+                if(Item.dwStreamEntry != CFB_NOSTREAM)
+                    m_ItemSizes[dwItem] = m_CompFile.Entry(Item.dwStreamEntry).Size;
+                break;
+
+            case MsiItemCabinet:
+                m_ItemSizes[dwItem] = m_Cabinets[Item.dwCabinet]->File(Item.dwCabFile).FileSize;
+                break;
+        }
+    }
+
+    // Measure the rows and add the headers
+    if(Jobs.size() != 0)
+    {
+        if((dwErrCode = m_CsvPool.Measure(&Jobs[0], Jobs.size(), m_StringPool)) != ERROR_SUCCESS)
+            return dwErrCode;
+        for(size_t i = 0; i < Jobs.size(); i++)
+        {
+            m_ItemSizes[JobItems[i]] = m_Tables[m_Listing.Item(JobItems[i]).dwTable]->CsvHeader.size() + Jobs[i].cbLength;
+        }
+    }
+
+    // Items that refer to another item show its size
+    for(size_t i = 0; i < m_ItemSizes.size(); i++)
+    {
+        if(m_Listing.Item(i).RefItem != MSI_NO_ITEM)
+            m_ItemSizes[i] = m_ItemSizes[m_Listing.Item(i).RefItem];
+    }
+    return ERROR_SUCCESS;
+}
+
+DWORD TMsiArchive::ReadTableChunk(const MSI_LISTING_ITEM & Item, MSI_ITEM_CURSOR & Cursor, std::vector<BYTE> & Chunk, LPDWORD PtrBytesRead)
+{
+    const MSI_ARCHIVE_TABLE & Table = *m_Tables[Item.dwTable];
+    LPBYTE pbBufferBegin = &Chunk[0];
+    LPBYTE pbBufferPtr = pbBufferBegin;
+    LPBYTE pbBufferEnd = pbBufferBegin + Chunk.size();
+    size_t cbRowSize;
+    size_t cbRows = 0;
+    DWORD dwEndRow;
+
+    // Only msi.dll could read the tables that could not be decoded
+    if(Table.bDecoded == false)
+        return ERROR_NOT_SUPPORTED;
+
+    // The first chunk begins with the UTF-8 marker and the header
+    if(Cursor.bStarted == false)
+    {
+        if(Table.CsvHeader.size() > Chunk.size())
+            return ERROR_INSUFFICIENT_BUFFER;
+        memcpy(pbBufferPtr, &Table.CsvHeader[0], Table.CsvHeader.size());
+        pbBufferPtr += Table.CsvHeader.size();
+    }
+
+    // Find out how many complete rows fit into the chunk
+    for(dwEndRow = Cursor.dwRow; dwEndRow < Table.Data.RowCount(); dwEndRow++)
+    {
+        // If the row doesn't fit, flush the chunk first.
+        // A row that is bigger than the whole chunk enlarges it.
+        cbRowSize = MsiCsvRowLength(Table.Data, m_StringPool, dwEndRow);
+        if((size_t)(pbBufferEnd - pbBufferPtr) < (cbRows + cbRowSize))
+        {
+            if(pbBufferPtr > pbBufferBegin || dwEndRow > Cursor.dwRow)
+                break;
+            Chunk.resize(cbRowSize);
+            pbBufferBegin = pbBufferPtr = &Chunk[0];
+            pbBufferEnd = pbBufferBegin + Chunk.size();
+        }
+        cbRows += cbRowSize;
+    }
+
+    // Render the rows. A big chunk is rendered by multiple threads
+    if(dwEndRow > Cursor.dwRow)
+    {
+        MSI_CSV_JOB Job = {&Table.Data, Cursor.dwRow, dwEndRow - Cursor.dwRow, pbBufferPtr, (size_t)(pbBufferEnd - pbBufferPtr), 0};
+        DWORD dwErrCode;
+
+        if((dwErrCode = m_CsvPool.Render(&Job, 1, m_StringPool)) != ERROR_SUCCESS)
+            return dwErrCode;
+        pbBufferPtr += (size_t)(Job.cbLength);
+        Cursor.dwRow = dwEndRow;
+    }
+
+    // Give the number of bytes to the caller
+    PtrBytesRead[0] = (DWORD)(pbBufferPtr - pbBufferBegin);
+    return ERROR_SUCCESS;
+}
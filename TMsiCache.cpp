@@ -0,0 +1,79 @@
+/*****************************************************************************/
+/* TMsiCache.cpp                          Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Checks of the listing cache file, before TMsiFileList uses the arrays     */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 16.10.26  1.00  Lad  Created                                              */
+/*****************************************************************************/
+
+#include "wcx_msi.h"
+
+//-----------------------------------------------------------------------------
+// Public functions
+
+// The cache may be damaged or written by a different version, so nothing in it
+// is trusted. The file types must be less than dwFileTypes and the stream entries
+// must exist in the compound file, which has dwEntryCount entries.
+DWORD MsiCacheCheckData(LPBYTE pbCache, size_t cbCache, const MSI_CACHE_KEY & CacheKey, DWORD dwFileTypes, DWORD dwEntryCount, MSI_CACHE_ARRAYS & Arrays)
+{
+    const MSI_CACHE_HEADER * pHeader = (const MSI_CACHE_HEADER *)(pbCache);
+    ULONGLONG cbExpected;
+    DWORD dwFileCount;
+
+    // Check the header. A cache of a different archive is not an error,
+    // but it can't be used either
+    if(cbCache < sizeof(MSI_CACHE_HEADER))
+        return ERROR_FILE_CORRUPT;
+    if(pHeader->Signature != MSI_CACHE_SIGNATURE || pHeader->Version != MSI_CACHE_VERSION || pHeader->CharSize != sizeof(TCHAR))
+        return ERROR_BAD_FORMAT;
+    if(memcmp(&pHeader->CacheKey, &CacheKey, sizeof(MSI_CACHE_KEY)))
+        return ERROR_INVALID_DATA;
+    dwFileCount = pHeader->FileCount;
+
+    // The arrays must exactly fill the rest of the file
+    cbExpected = sizeof(MSI_CACHE_HEADER) + (ULONGLONG)(dwFileCount) * (sizeof(MSI_FILE_ENTRY) + sizeof(MSI_CACHE_FILE)) +
+                 (ULONGLONG)(pHeader->IndexSize) * sizeof(DWORD) +
+                 (ULONGLONG)(pHeader->ArenaLength) * sizeof(TCHAR);
+    if(cbExpected != cbCache)
+        return ERROR_FILE_CORRUPT;
+
+    // The index must be a power of two and at most half full
+    if(pHeader->IndexSize < (dwFileCount * 2ULL) || (pHeader->IndexSize & (pHeader->IndexSize - 1)))
+        return ERROR_FILE_CORRUPT;
+
+    Arrays.pHeader = pHeader;
+    Arrays.pEntries = (const MSI_FILE_ENTRY *)(pHeader + 1);
+    Arrays.pCacheFiles = (const MSI_CACHE_FILE *)(Arrays.pEntries + dwFileCount);
+    Arrays.pIndex = (const DWORD *)(Arrays.pCacheFiles + dwFileCount);
+    Arrays.pArena = (const TCHAR *)(Arrays.pIndex + pHeader->IndexSize);
+
+    // Verify that nothing points outside the arrays
+    for(DWORD i = 0; i < dwFileCount; i++)
+    {
+        const MSI_FILE_ENTRY & Entry = Arrays.pEntries[i];
+        const MSI_CACHE_FILE & CacheFile = Arrays.pCacheFiles[i];
+        DWORD dwRefFile = Entry.RefFile;
+
+        // The name and its lowercased copy must be in the arena, both zero-terminated
+        if(Entry.NameLength == 0 || ((ULONGLONG)(Entry.NameOffset) + Entry.NameLength * 2ULL + 2) > pHeader->ArenaLength)
+            return ERROR_FILE_CORRUPT;
+        if(Arrays.pArena[Entry.NameOffset + Entry.NameLength] != 0 || Arrays.pArena[Entry.NameOffset + Entry.NameLength * 2 + 1] != 0)
+            return ERROR_FILE_CORRUPT;
+        if(dwRefFile != MSI_NO_FILE && (dwRefFile >= dwFileCount || Arrays.pEntries[dwRefFile].RefFile != MSI_NO_FILE))
+            return ERROR_FILE_CORRUPT;
+
+        // The file type must be known and the stream must exist
+        if(CacheFile.FileType >= dwFileTypes)
+            return ERROR_FILE_CORRUPT;
+        if(CacheFile.dwStreamEntry != CFB_NOSTREAM && CacheFile.dwStreamEntry >= dwEntryCount)
+            return ERROR_FILE_CORRUPT;
+    }
+    for(DWORD i = 0; i < pHeader->IndexSize; i++)
+    {
+        if(Arrays.pIndex[i] != MSI_NO_FILE && Arrays.pIndex[i] >= dwFileCount)
+            return ERROR_FILE_CORRUPT;
+    }
+    return ERROR_SUCCESS;
+}
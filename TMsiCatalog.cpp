@@ -0,0 +1,110 @@
+/*****************************************************************************/
+/* TMsiCatalog.cpp                        Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Native loader of the MSI catalog (_Tables and _Columns)                   */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 16.10.26  1.00  Lad  Created                                              */
+/*****************************************************************************/
+
+#include "wcx_msi.h"
+
+#include <algorithm>
+
+//-----------------------------------------------------------------------------
+// Local (non-class) functions
+
+static bool CompareColumnNumbers(const MSI_CATALOG_COLUMN & Column1, const MSI_CATALOG_COLUMN & Column2)
+{
+    return (Column1.Number < Column2.Number);
+}
+
+//-----------------------------------------------------------------------------
+// TMsiCatalog functions
+
+DWORD TMsiCatalog::Load(TCompoundFile * pCompFile, const TMsiStringPool & StringPool)
+{
+    std::unordered_map<CFB_NAME, size_t> TableIndex;
+    std::vector<MSI_COLUMN_LAYOUT> Layout;
+    MSI_COLUMN_LAYOUT StringKey = {MsiCellString, StringPool.StringRefSize(), true};
+    MSI_COLUMN_LAYOUT String = {MsiCellString, StringPool.StringRefSize(), false};
+    MSI_COLUMN_LAYOUT IntegerKey = {MsiCellInteger, 2, true};
+    MSI_COLUMN_LAYOUT Integer = {MsiCellInteger, 2, false};
+    TMsiTableData Tables;
+    TMsiTableData Columns;
+    LPCWSTR szString;
+    size_t ccString;
+    DWORD dwErrCode;
+
+    // Decode the "_Tables" table: (Name)
+    Layout.push_back(StringKey);
+    if((dwErrCode = Tables.Load(pCompFile, MSI_WSTR("_Tables"), Layout)) != ERROR_SUCCESS)
+        return dwErrCode;
+
+    // Decode the "_Columns" table: (Table, Number, Name, Type)
+    Layout.push_back(IntegerKey);
+    Layout.push_back(String);
+    Layout.push_back(Integer);
+    if((dwErrCode = Columns.Load(pCompFile, MSI_WSTR("_Columns"), Layout)) != ERROR_SUCCESS)
+        return dwErrCode;
+
+    // Create all tables
+    m_Tables.resize(Tables.RowCount());
+    for(DWORD dwRow = 0; dwRow < Tables.RowCount(); dwRow++)
+    {
+        szString = StringPool.String(Tables.Cell(0, dwRow), ccString);
+        m_Tables[dwRow].Name.assign(szString, ccString);
+        TableIndex[m_Tables[dwRow].Name] = dwRow;
+    }
+
+    // Assign the columns to their tables
+    for(DWORD dwRow = 0; dwRow < Columns.RowCount(); dwRow++)
+    {
+        std::unordered_map<CFB_NAME, size_t>::iterator iter;
+        MSI_CATALOG_COLUMN Column;
+        CFB_NAME strTableName;
+
+        // Find the table. Ignore columns of tables that are not in the "_Tables"
+        szString = StringPool.String(Columns.Cell(0, dwRow), ccString);
+        strTableName.assign(szString, ccString);
+        if((iter = TableIndex.find(strTableName)) == TableIndex.end())
+            continue;
+
+        // Both number and type are mandatory
+        if(Columns.Cell(1, dwRow) == MSI_NULL_INTEGER || Columns.Cell(3, dwRow) == MSI_NULL_INTEGER)
+            return ERROR_FILE_CORRUPT;
+
+        // Insert the column
+        szString = StringPool.String(Columns.Cell(2, dwRow), ccString);
+        Column.Name.assign(szString, ccString);
+        Column.Number = Columns.Cell(1, dwRow);
+        Column.Type = Columns.Cell(3, dwRow) & 0xFFFF;
+        m_Tables[iter->second].Columns.push_back(Column);
+    }
+
+    // The "_Columns" is sorted by table names. Make sure that the columns are in order
+    for(size_t i = 0; i < m_Tables.size(); i++)
+    {
+        std::vector<MSI_CATALOG_COLUMN> & TableColumns = m_Tables[i].Columns;
+        std::stable_sort(TableColumns.begin(), TableColumns.end(), CompareColumnNumbers);
+    }
+    return ERROR_SUCCESS;
+}
+
+size_t TMsiCatalog::MemorySize() const
+{
+    size_t cbMemory = m_Tables.capacity() * sizeof(MSI_CATALOG_TABLE);
+
+    // Approximation. The names are mostly short enough to fit the string object
+    for(size_t i = 0; i < m_Tables.size(); i++)
+    {
+        const MSI_CATALOG_TABLE & CatalogTable = m_Tables[i];
+
+        cbMemory += CatalogTable.Name.capacity() * sizeof(WCHAR);
+        cbMemory += CatalogTable.Columns.capacity() * sizeof(MSI_CATALOG_COLUMN);
+        for(size_t j = 0; j < CatalogTable.Columns.size(); j++)
+            cbMemory += CatalogTable.Columns[j].Name.capacity() * sizeof(WCHAR);
+    }
+    return cbMemory;
+}
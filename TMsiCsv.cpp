@@ -0,0 +1,390 @@
+/*****************************************************************************/
+/* TMsiCsv.cpp                            Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Conversion of UTF-16 strings and decoded tables to UTF-8 CSV              */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 16.10.26  1.00  Lad  Created                                              */
+/*****************************************************************************/
+
+#include "wcx_msi.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MSI_CSV_AVX2
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MSI_CSV_SSE2
+#endif
+
+//-----------------------------------------------------------------------------
+// Local functions
+
+// Characters that are copied to the cell as they are
+static bool IsPlainAscii(DWORD dwChar)
+{
+    return (dwChar < 0x80 && dwChar != '\"');
+}
+
+#ifdef MSI_CSV_SSE2
+// Returns a 16-bit mask with two bits set for every plain ASCII character in the block of 8
+static DWORD PlainAsciiMask(__m128i Chars)
+{
+    __m128i IsAscii = _mm_cmpeq_epi16(_mm_and_si128(Chars, _mm_set1_epi16((short)0xFF80)), _mm_setzero_si128());
+    __m128i IsQuote = _mm_cmpeq_epi16(Chars, _mm_set1_epi16('\"'));
+
+    return (DWORD)_mm_movemask_epi8(_mm_andnot_si128(IsQuote, IsAscii));
+}
+#endif
+
+#ifdef MSI_CSV_AVX2
+static DWORD CountTrailingZeros(DWORD dwValue)
+{
+#ifdef _MSC_VER
+    unsigned long nIndex;
+    _BitScanForward(&nIndex, dwValue);
+    return nIndex;
+#else
+    return __builtin_ctz(dwValue);
+#endif
+}
+
+// Returns a 32-bit mask with two bits set for every plain ASCII character in the block of 16
+static DWORD PlainAsciiMask(__m256i Chars)
+{
+    __m256i IsAscii = _mm256_cmpeq_epi16(_mm256_and_si256(Chars, _mm256_set1_epi16((short)0xFF80)), _mm256_setzero_si256());
+    __m256i IsQuote = _mm256_cmpeq_epi16(Chars, _mm256_set1_epi16('\"'));
+
+    return (DWORD)_mm256_movemask_epi8(_mm256_andnot_si256(IsQuote, IsAscii));
+}
+#endif
+
+// Converts the leading run of plain ASCII characters. Returns the number
+// of characters converted. If pbBuffer is NULL, the run is only measured.
+static size_t AsciiRun(LPCWSTR szValue, size_t ccValue, LPBYTE pbBuffer)
+{
+    size_t nIndex = 0;
+
+    // Don't bother with vectors if the run is empty
+    if(ccValue == 0 || !IsPlainAscii(szValue[0]))
+        return 0;
+
+#ifdef MSI_CSV_AVX2
+    // 32 characters per step
+    while((ccValue - nIndex) >= 32)
+    {
+        __m256i Chars0 = _mm256_loadu_si256((const __m256i *)(szValue + nIndex));
+        __m256i Chars1 = _mm256_loadu_si256((const __m256i *)(szValue + nIndex + 16));
+        DWORD dwMask0 = PlainAsciiMask(Chars0);
+        DWORD dwMask1 = PlainAsciiMask(Chars1);
+
+        // Stop at the first character that is not plain ASCII
+        if(dwMask0 != 0xFFFFFFFF)
+            return nIndex + AsciiRun(szValue + nIndex, CountTrailingZeros(~dwMask0) / 2, pbBuffer ? pbBuffer + nIndex : NULL);
+        if(dwMask1 != 0xFFFFFFFF)
+            break;
+
+        // The pack works within 128-bit lanes, so the quarters need to be reordered
+        if(pbBuffer != NULL)
+        {
+            __m256i Bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(Chars0, Chars1), 0xD8);
+            _mm256_storeu_si256((__m256i *)(pbBuffer + nIndex), Bytes);
+        }
+        nIndex += 32;
+    }
+#endif
+
+#ifdef MSI_CSV_SSE2
+    // 16 characters per step
+    while((ccValue - nIndex) >= 16)
+    {
+        __m128i Chars0 = _mm_loadu_si128((const __m128i *)(szValue + nIndex));
+        __m128i Chars1 = _mm_loadu_si128((const __m128i *)(szValue + nIndex + 8));
+
+        if(PlainAsciiMask(Chars0) != 0xFFFF || PlainAsciiMask(Chars1) != 0xFFFF)
+            break;
+
+        if(pbBuffer != NULL)
+            _mm_storeu_si128((__m128i *)(pbBuffer + nIndex), _mm_packus_epi16(Chars0, Chars1));
+        nIndex += 16;
+    }
+#endif
+
+    // The rest of the run, character by character
+    while(nIndex < ccValue && IsPlainAscii(szValue[nIndex]))
+    {
+        if(pbBuffer != NULL)
+            pbBuffer[nIndex] = (BYTE)(szValue[nIndex]);
+        nIndex++;
+    }
+    return nIndex;
+}
+
+// Encodes one character that is not plain ASCII. Unpaired surrogates become U+FFFD,
+// same like WideCharToMultiByte does. Returns the number of bytes; zero if it does not fit
+static size_t EncodeChar(LPCWSTR szValue, size_t ccValue, size_t & nIndex, LPBYTE pbBuffer, size_t cbBuffer)
+{
+    DWORD dwChar = szValue[nIndex];
+    size_t nNextIndex = nIndex + 1;
+    size_t nLength;
+
+    // Get the code point and the length of its UTF-8 sequence
+    if(dwChar < 0x80)
+    {
+        nLength = (dwChar == '\"') ? 2 : 1;
+    }
+    else if(dwChar < 0x800)
+    {
+        nLength = 2;
+    }
+    else if(0xD800 <= dwChar && dwChar < 0xDC00 && nNextIndex < ccValue && 0xDC00 <= szValue[nNextIndex] && szValue[nNextIndex] < 0xE000)
+    {
+        dwChar = 0x10000 + ((dwChar - 0xD800) << 10) + (szValue[nNextIndex++] - 0xDC00);
+        nLength = 4;
+    }
+    else
+    {
+        if(0xD800 <= dwChar && dwChar < 0xE000)
+            dwChar = 0xFFFD;
+        nLength = 3;
+    }
+
+    // Only measuring?
+    if(pbBuffer != NULL)
+    {
+        if(nLength > cbBuffer)
+            return 0;
+
+        switch(nLength)
+        {
+            case 1:
+                pbBuffer[0] = (BYTE)(dwChar);
+                break;
+
+            case 2:     // The quotation mark is doubled
+                pbBuffer[0] = (dwChar == '\"') ? '\"' : (BYTE)(0xC0 | (dwChar >> 6));
+                pbBuffer[1] = (dwChar == '\"') ? '\"' : (BYTE)(0x80 | (dwChar & 0x3F));
+                break;
+
+            case 3:
+                pbBuffer[0] = (BYTE)(0xE0 | (dwChar >> 12));
+                pbBuffer[1] = (BYTE)(0x80 | ((dwChar >> 6) & 0x3F));
+                pbBuffer[2] = (BYTE)(0x80 | (dwChar & 0x3F));
+                break;
+
+            case 4:
+                pbBuffer[0] = (BYTE)(0xF0 | (dwChar >> 18));
+                pbBuffer[1] = (BYTE)(0x80 | ((dwChar >> 12) & 0x3F));
+                pbBuffer[2] = (BYTE)(0x80 | ((dwChar >> 6) & 0x3F));
+                pbBuffer[3] = (BYTE)(0x80 | (dwChar & 0x3F));
+                break;
+        }
+    }
+
+    nIndex = nNextIndex;
+    return nLength;
+}
+
+// Length of the integer as rendered by RenderInteger
+static size_t IntegerLength(DWORD dwValue)
+{
+    size_t nLength = 1;
+
+    // NULL integers are rendered as "(null)"
+    if(dwValue == MSI_NULL_INTEGER)
+        return 6;
+
+    // Negative numbers have the minus sign
+    if((int)(dwValue) < 0)
+    {
+        dwValue = (DWORD)(-(LONGLONG)(int)(dwValue));
+        nLength++;
+    }
+
+    // Count the digits
+    while(dwValue >= 10)
+    {
+        dwValue /= 10;
+        nLength++;
+    }
+    return nLength;
+}
+
+// Renders the integer the same way as "%i" does
+static LPBYTE RenderInteger(LPBYTE pbBuffer, DWORD dwValue)
+{
+    LPBYTE pbBufferEnd = pbBuffer + IntegerLength(dwValue);
+    LPBYTE pbBufferPtr = pbBufferEnd;
+
+    if(dwValue == MSI_NULL_INTEGER)
+    {
+        memcpy(pbBuffer, "(null)", 6);
+        return pbBufferEnd;
+    }
+
+    // Convert the number, from the end
+    if((int)(dwValue) < 0)
+    {
+        dwValue = (DWORD)(-(LONGLONG)(int)(dwValue));
+        pbBuffer[0] = '-';
+    }
+
+    do
+    {
+        *(--pbBufferPtr) = (BYTE)('0' + (dwValue % 10));
+        dwValue /= 10;
+    }
+    while(dwValue != 0);
+    return pbBufferEnd;
+}
+
+//-----------------------------------------------------------------------------
+// Public functions
+
+size_t MsiCsvCellLength(LPCWSTR szValue, size_t ccValue)
+{
+    size_t cbLength = 0;
+    size_t nIndex = 0;
+
+    while(nIndex < ccValue)
+    {
+        size_t nRun = AsciiRun(szValue + nIndex, ccValue - nIndex, NULL);
+
+        nIndex += nRun;
+        cbLength += nRun;
+
+        while(nIndex < ccValue && !IsPlainAscii(szValue[nIndex]))
+            cbLength += EncodeChar(szValue, ccValue, nIndex, NULL, 0);
+    }
+    return cbLength;
+}
+
+size_t MsiCsvCellEncode(LPBYTE pbBuffer, size_t cbBuffer, LPCWSTR szValue, size_t ccValue)
+{
+    size_t cbWritten = 0;
+    size_t nIndex = 0;
+
+    while(nIndex < ccValue)
+    {
+        size_t ccRemaining = ccValue - nIndex;
+        size_t nRun;
+
+        // Plain ASCII characters are one byte each
+        if(ccRemaining > (cbBuffer - cbWritten))
+            ccRemaining = (cbBuffer - cbWritten);
+        nRun = AsciiRun(szValue + nIndex, ccRemaining, pbBuffer + cbWritten);
+        nIndex += nRun;
+        cbWritten += nRun;
+
+        // Encode the characters that are not plain ASCII
+        while(nIndex < ccValue && !IsPlainAscii(szValue[nIndex]))
+        {
+            size_t nLength = EncodeChar(szValue, ccValue, nIndex, pbBuffer + cbWritten, cbBuffer - cbWritten);
+
+            // The buffer is full
+            if(nLength == 0)
+                return cbWritten;
+            cbWritten += nLength;
+        }
+
+        // The buffer is full
+        if(cbWritten == cbBuffer)
+            break;
+    }
+    return cbWritten;
+}
+
+// Exact length of one rendered row
+size_t MsiCsvRowLength(const TMsiTableData & TableData, const TMsiStringPool & StringPool, DWORD dwRow)
+{
+    size_t cbRow = 2;                           // The end-of-line
+
+    // Each field has two quotation marks and all but the first one a comma
+    for(size_t i = 0; i < TableData.ColumnCount(); i++)
+    {
+        DWORD dwCell = TableData.Cell(i, dwRow);
+
+        if(TableData.CellType(i) == MsiCellString)
+            cbRow += StringPool.CsvLength(dwCell);
+        else
+            cbRow += IntegerLength(dwCell);
+        cbRow += (i > 0) ? 3 : 2;
+    }
+    return cbRow;
+}
+
+// Exact length of a range of rendered rows. Computed column by column from the precomputed
+// lengths of the strings, so that no cell needs to be converted to UTF-8
+ULONGLONG MsiCsvRowsLength(const TMsiTableData & TableData, const TMsiStringPool & StringPool, DWORD dwFirstRow, DWORD dwRows)
+{
+    ULONGLONG cbRows;
+
+    // The end-of-lines
+    cbRows = (ULONGLONG)(dwRows) * 2;
+
+    // Sum the columns
+    for(size_t i = 0; i < TableData.ColumnCount(); i++)
+    {
+        const DWORD * pCells = TableData.Column(i) + dwFirstRow;
+
+        // Each field has two quotation marks and all but the first one a comma
+        cbRows += (ULONGLONG)(dwRows) * ((i > 0) ? 3 : 2);
+
+        // Sum the lengths of the values
+        if(TableData.CellType(i) == MsiCellString)
+        {
+            for(DWORD dwRow = 0; dwRow < dwRows; dwRow++)
+                cbRows += StringPool.CsvLength(pCells[dwRow]);
+        }
+        else
+        {
+            for(DWORD dwRow = 0; dwRow < dwRows; dwRow++)
+                cbRows += IntegerLength(pCells[dwRow]);
+        }
+    }
+    return cbRows;
+}
+
+// Renders a range of rows. The buffer must have at least MsiCsvRowsLength bytes.
+// Returns the pointer after the last rendered row
+LPBYTE MsiCsvRenderRows(LPBYTE pbBuffer, const TMsiTableData & TableData, const TMsiStringPool & StringPool, DWORD dwFirstRow, DWORD dwRows)
+{
+    LPCWSTR szString;
+    size_t ccString;
+
+    for(DWORD dwRow = dwFirstRow; dwRow < dwFirstRow + dwRows; dwRow++)
+    {
+        for(size_t i = 0; i < TableData.ColumnCount(); i++)
+        {
+            DWORD dwCell = TableData.Cell(i, dwRow);
+
+            // Comma and the opening quotation mark
+            if(i > 0)
+                *pbBuffer++ = ',';
+            *pbBuffer++ = '\"';
+
+            // The value. The lengths of the strings are exact, so the buffer is never short
+            if(TableData.CellType(i) == MsiCellString)
+            {
+                szString = StringPool.String(dwCell, ccString);
+                pbBuffer += MsiCsvCellEncode(pbBuffer, StringPool.CsvLength(dwCell), szString, ccString);
+            }
+            else
+            {
+                pbBuffer = RenderInteger(pbBuffer, dwCell);
+            }
+
+            // The closing quotation mark
+            *pbBuffer++ = '\"';
+        }
+
+        // The end-of-line
+        pbBuffer[0] = '\r';
+        pbBuffer[1] = '\n';
+        pbBuffer += 2;
+    }
+    return pbBuffer;
+}
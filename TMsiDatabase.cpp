@@ -28,28 +28,44 @@ static bool FindStringInList(MSI_STRING_LIST & MsiTablesList, const std::tstring
 //-----------------------------------------------------------------------------
 // Constructor and destructor
 
-TMsiDatabase::TMsiDatabase(MSIHANDLE hMsiDb, FILETIME & ft)
+TMsiDatabase::TMsiDatabase(MSIHANDLE hMsiDb, TCompoundFile * pCompFile, FILETIME & ft)
 {
-    InitializeCriticalSection(&m_Lock);
+    InitializeCriticalSection(&m_CursorLock);
+    InitializeCriticalSection(&m_MsiLock);
     m_MagicSignature = MSI_MAGIC_SIGNATURE;
-    m_pFileEntry = NULL;
+    m_pCompFile = pCompFile;
+    m_pStringPool = NULL;
+    m_pCatalog = NULL;
+    m_pShared = NULL;
     m_pLastFile = NULL;
+    m_pSnapshot = NULL;
+    m_pBuild = NULL;
     m_FileTime = ft;
     m_hMsiDb = hMsiDb;
-    m_dwTables = 0;
-    m_dwFiles = 0;
+    m_dwNextFile = 0;
+    m_dwFilesStarted = 0;
     m_dwRefs = 1;
-
-    // The list head is empty
-    InitializeListHead(&m_Tables);
-    InitializeListHead(&m_Files);
+    m_CsvPool.Open(std::thread::hardware_concurrency());
+    memset(&m_CacheKey, 0, sizeof(MSI_CACHE_KEY));
 }
 
 TMsiDatabase::~TMsiDatabase()
 {
 #ifdef _DEBUG
     UINT nHandleCount;
+#endif
+
+    // A snapshot restored from a cache has no tables, so it doesn't keep the database.
+    // Free it before checking for leaks; it holds the handles of its files
+    if(m_pSnapshot != NULL)
+        m_pSnapshot->Release();
+    m_pSnapshot = NULL;
 
+    // Stop loading the streams ahead. The compound file is closed below
+    m_Prefetcher.Stop();
+    m_CsvPool.Stop();
+
+#ifdef _DEBUG
     // Only one handle should be open now
     if((nHandleCount = MSI_DUMP_HANDLES()) > 1)
     {
@@ -77,13 +93,37 @@ TMsiDatabase::~TMsiDatabase()
         MSI_CLOSE_HANDLE(m_hMsiDb);
     m_hMsiDb = NULL;
 
-    // Delete the lock
-    DeleteCriticalSection(&m_Lock);
+    // Free the catalog and the string pool, unless they belong to the shared data
+    if(m_pShared != NULL)
+    {
+        MsiSharedCacheRelease(m_pShared);
+        m_pShared = NULL;
+    }
+    else
+    {
+        if(m_pCatalog != NULL)
+            delete m_pCatalog;
+        if(m_pStringPool != NULL)
+            delete m_pStringPool;
+    }
+    m_pCatalog = NULL;
+    m_pStringPool = NULL;
+
+    // Close the compound file
+    if(m_pCompFile != NULL)
+        delete m_pCompFile;
+    m_pCompFile = NULL;
+
+    // Delete the locks
+    DeleteCriticalSection(&m_MsiLock);
+    DeleteCriticalSection(&m_CursorLock);
 }
 
 //-----------------------------------------------------------------------------
 // Public functions
 
+// The exported functions don't lock the whole database. The snapshot
+// is read without any lock and only the cursor has a lock of its own.
 TMsiDatabase * TMsiDatabase::FromHandle(HANDLE hHandle)
 {
     TMsiDatabase * pMsiDb;
@@ -93,7 +133,6 @@ TMsiDatabase * TMsiDatabase::FromHandle(HANDLE hHandle)
         pMsiDb = static_cast<TMsiDatabase *>(hHandle);
         if(pMsiDb->m_MagicSignature == MSI_MAGIC_SIGNATURE)
         {
-            EnterCriticalSection(&pMsiDb->m_Lock);
             pMsiDb->AddRef();
             return pMsiDb;
         }
@@ -119,16 +158,23 @@ DWORD TMsiDatabase::Release()
 
 void TMsiDatabase::CloseAllFiles()
 {
+    EnterCriticalSection(&m_CursorLock);
+
+    // Stop loading the streams ahead and free the loaded ones
+    m_Prefetcher.Stop();
+    m_dwFilesStarted = 0;
+
     // Free the last file, if any
     ReleaseLastFile();
 
-    // Free the list of files
-    DeleteLinkedList<TMsiFile>(m_Files);
-    m_dwFiles = 0;
+    // Release the snapshot. Files that are still being extracted keep it
+    // until they are done; the last one frees the tables, cabinets and records
+    if(m_pSnapshot != NULL)
+        m_pSnapshot->Release();
+    m_pSnapshot = NULL;
+    m_dwNextFile = 0;
 
-    // Free list of tables
-    DeleteLinkedList<TMsiTable>(m_Tables);
-    m_dwTables = 0;
+    LeaveCriticalSection(&m_CursorLock);
 }
 
 TMsiFile * TMsiDatabase::ReleaseLastFile(TMsiFile * pMsiFile)
@@ -147,78 +193,358 @@ TMsiFile * TMsiDatabase::ReleaseLastFile(TMsiFile * pMsiFile)
     return pMsiFile;
 }
 
-TMsiFile * TMsiDatabase::FindReferencedFile(TMsiTable * pMsiTable, LPCTSTR szStreamName, LPTSTR szFileName, size_t ccFileName)
+TMsiStringPool * TMsiDatabase::StringPool()
 {
-    TMsiFile * pRefFile = NULL;
-    LPCTSTR szDot;
-    TCHAR szRefFile[MAX_PATH];
+    TMsiStringPool * pStringPool;
 
-    // References to other files are only in the "_Streams" table
-    if(pMsiTable->m_bIsStreamsTable)
+    // Another open of the same archive may have loaded it already
+    if(m_pStringPool == NULL && m_pShared != NULL)
+        m_pStringPool = m_pShared->StringPool();
+
+    // The string pool is loaded once per database
+    if(m_pStringPool == NULL && m_pCompFile != NULL)
     {
-        // There must be dot in the name, like "Binary.bannrbmp"
-        if((szDot = _tcschr(szStreamName, _T('.'))) != NULL)
+        if((pStringPool = new TMsiStringPool()) != NULL)
         {
-            // Create the referenced file name
-            StringCchCopy(szRefFile, _countof(szRefFile), szStreamName);
-            szRefFile[szDot - szStreamName] = _T('\\');
+            if(pStringPool->Load(m_pCompFile) == ERROR_SUCCESS)
+            {
+                m_pStringPool = (m_pShared != NULL) ? m_pShared->SetStringPool(pStringPool) : pStringPool;
+            }
+            else
+            {
+                delete pStringPool;
+            }
+        }
+    }
+    return m_pStringPool;
+}
+
+TMsiCatalog * TMsiDatabase::Catalog()
+{
+    TMsiStringPool * pStringPool;
+    TMsiCatalog * pCatalog;
+
+    // Another open of the same archive may have loaded it already
+    if(m_pCatalog == NULL && m_pShared != NULL)
+        m_pCatalog = m_pShared->Catalog();
 
-            // Is it in the database?
-            if((pRefFile = IsFilePresent(szRefFile)) != NULL)
+    // The catalog is loaded once per database
+    if(m_pCatalog == NULL && (pStringPool = StringPool()) != NULL)
+    {
+        if((pCatalog = new TMsiCatalog()) != NULL)
+        {
+            if(pCatalog->Load(m_pCompFile, *pStringPool) == ERROR_SUCCESS)
+            {
+                m_pCatalog = (m_pShared != NULL) ? m_pShared->SetCatalog(pCatalog) : pCatalog;
+            }
+            else
             {
-                StringCchPrintf(szFileName, ccFileName, _T("%s\\%s"), pMsiTable->Name(), szDot + 1);
+                delete pCatalog;
             }
         }
     }
-    return pRefFile;
+    return m_pCatalog;
+}
+
+void TMsiDatabase::SetListingCache(LPCTSTR szCacheFile, const MSI_CACHE_KEY & CacheKey)
+{
+    m_strCacheFile = szCacheFile;
+    m_CacheKey = CacheKey;
 }
 
-void TMsiDatabase::UnlockAndRelease()
+void TMsiDatabase::SetSharedData(TMsiSharedData * pShared)
 {
-    LeaveCriticalSection(&m_Lock);
-    Release();
+    // The database takes over the reference
+    assert(m_pShared == NULL);
+    m_pShared = pShared;
 }
 
 TMsiFile * TMsiDatabase::GetNextFile()
 {
-    PLIST_ENTRY pHeadEntry = &m_Files;
-    TMsiFile * pMsiFile;
+    TMsiFile * pMsiFile = NULL;
+
+    EnterCriticalSection(&m_CursorLock);
+
+    // The first call builds the snapshot. All sizes are known after that
+    if(m_pSnapshot == NULL)
+    {
+        BuildSnapshot(true, &m_pSnapshot);
+        m_dwNextFile = 0;
+    }
+
+    // Do we have some files?
+    if(m_pSnapshot != NULL && m_dwNextFile < m_pSnapshot->m_Files.Count())
+    {
+        // Reuse the object of the last file, unless someone else still holds it
+        if(m_pLastFile != NULL && m_pLastFile->m_dwRefs == 1)
+        {
+            m_pLastFile->Attach(m_dwNextFile);
+        }
+        else
+        {
+            ReleaseLastFile();
+            m_pLastFile = new TMsiFile(this, m_pSnapshot, m_dwNextFile);
+        }
+
+        if(m_pLastFile != NULL)
+        {
+            m_dwNextFile++;
+
+            // During the extraction, start loading the next streams
+            if(m_Prefetcher.IsOpen())
+                PrefetchFiles();
+            pMsiFile = LastFile();
+        }
+    }
+
+    LeaveCriticalSection(&m_CursorLock);
+    return pMsiFile;
+}
+
+DWORD TMsiDatabase::ReloadCachedFiles()
+{
     DWORD dwErrCode = ERROR_SUCCESS;
 
-    // Files are not loaded yet
-    if(m_pFileEntry == NULL)
+    EnterCriticalSection(&m_CursorLock);
+
+    // Only the files restored from the listing cache need this
+    if(m_pSnapshot != NULL && m_pSnapshot->m_bCachedFiles && m_pLastFile != NULL)
+    {
+        // Streams can be read directly. Anything else needs the tables
+        const MSI_FILE_DETAIL & Detail = m_pSnapshot->m_Files.Detail(m_pLastFile->m_dwDataFile);
+        if(Detail.dwStreamEntry == CFB_NOSTREAM || Detail.dwStreamEntry >= m_pCompFile->EntryCount())
+        {
+            dwErrCode = ReloadLastFile();
+        }
+    }
+
+    LeaveCriticalSection(&m_CursorLock);
+    return dwErrCode;
+}
+
+// Replaces the snapshot restored from the cache with the real one and finds
+// the last file in it. Those who still read the old snapshot keep it.
+DWORD TMsiDatabase::ReloadLastFile()
+{
+    TMsiSnapshot * pSnapshot = NULL;
+    std::tstring strFileName(m_pLastFile->Name());
+    DWORD dwErrCode;
+    DWORD dwFile;
+
+    // Load the real file list instead of the cached one
+    dwErrCode = BuildSnapshot(false, &pSnapshot);
+    ReleaseLastFile();
+    m_pSnapshot->Release();
+    m_pSnapshot = pSnapshot;
+    if(dwErrCode != ERROR_SUCCESS)
+        return dwErrCode;
+
+    // The file names are unique, so we find the same file again
+    if((dwFile = m_pSnapshot->m_Files.Find(strFileName.c_str())) == MSI_NO_FILE)
+        return ERROR_FILE_NOT_FOUND;
+    if((m_pLastFile = new TMsiFile(this, m_pSnapshot, dwFile)) == NULL)
+        return ERROR_NOT_ENOUGH_MEMORY;
+    m_dwNextFile = dwFile + 1;
+    return ERROR_SUCCESS;
+}
+
+// Called when the extraction of a file begins. Extracting more than one
+// file means that the user extracts many of them, so we start loading
+// the next streams ahead
+void TMsiDatabase::FileStarted()
+{
+    if(InterlockedIncrement((LONG *)(&m_dwFilesStarted)) == 2 && m_pCompFile != NULL && g_dwPrefetchFiles != 0)
     {
-        // Shall we load the tables?
-        if(dwErrCode == ERROR_SUCCESS && m_TableNames.size() == 0)
-            dwErrCode = LoadTableNames();
+        EnterCriticalSection(&m_CursorLock);
+        m_Prefetcher.Open(m_pCompFile, g_dwPrefetchFiles, g_cbPrefetchMemory);
+        PrefetchFiles();
+        LeaveCriticalSection(&m_CursorLock);
+    }
+}
 
-        // Shall we load all tables?
-        if(dwErrCode == ERROR_SUCCESS && m_TableNames.size() && IsListEmpty(&m_Tables))
-            dwErrCode = LoadTables();
+void TMsiDatabase::FileSkipped()
+{
+    DWORD dwStreamEntry;
 
-        // Shall we load all files?
-        if(dwErrCode == ERROR_SUCCESS && !IsListEmpty(&m_Tables) && IsListEmpty(&m_Files))
-            dwErrCode = LoadFiles();
+    EnterCriticalSection(&m_CursorLock);
 
-        // Setup the file iteration
-        m_pFileEntry = m_Files.Flink;
+    // The stream of a skipped file will not be needed
+    if(m_Prefetcher.IsOpen() && m_pLastFile != NULL)
+    {
+        if((dwStreamEntry = m_pSnapshot->m_Files.Detail(m_pLastFile->m_dwDataFile).dwStreamEntry) != CFB_NOSTREAM)
+        {
+            m_Prefetcher.Drop(dwStreamEntry);
+        }
     }
 
-    // Do we have some files?
-    if(m_pFileEntry != pHeadEntry)
+    LeaveCriticalSection(&m_CursorLock);
+}
+
+// Asks the prefetcher for the streams of the current file and the files after it.
+// Only files stored as streams of the compound file are loaded ahead.
+// Called with the cursor locked
+void TMsiDatabase::PrefetchFiles()
+{
+    DWORD dwFileCount = (m_pSnapshot != NULL) ? m_pSnapshot->m_Files.Count() : 0;
+    DWORD dwFile = (m_dwNextFile != 0) ? (m_dwNextFile - 1) : 0;
+
+    for(DWORD i = 0; i < g_dwPrefetchFiles && dwFile < dwFileCount; i++, dwFile++)
     {
-        // Get the next file
-        pMsiFile = CONTAINING_RECORD(m_pFileEntry, TMsiFile, m_Entry);
-        m_pFileEntry = m_pFileEntry->Flink;
+        TMsiFileList & Files = m_pSnapshot->m_Files;
+        DWORD dwDataFile = dwFile;
+        DWORD dwStreamEntry;
 
-        // Make sure that we have the file size
-        pMsiFile->LoadFileInternal(NULL);
-        pMsiFile->AddRef();
+        // Files that refer to another file show its data
+        if(Files.Entry(dwFile).RefFile != MSI_NO_FILE)
+            dwDataFile = Files.Entry(dwFile).RefFile;
 
-        // Set the new last file
-        return ReleaseLastFile(pMsiFile);
+        // Only the streams in the compound file
+        if((dwStreamEntry = Files.Detail(dwDataFile).dwStreamEntry) != CFB_NOSTREAM)
+        {
+            m_Prefetcher.Request(dwStreamEntry);
+        }
     }
-    return NULL;
+}
+
+// Builds a new snapshot. Everything that the readers need is done here:
+// the tables are decoded and the sizes of all files are calculated.
+// Called with the cursor locked. The caller gets the snapshot
+// even if the listing is incomplete.
+DWORD TMsiDatabase::BuildSnapshot(bool bUseCache, TMsiSnapshot ** PtrSnapshot)
+{
+    DWORD dwErrCode;
+
+    if((m_pBuild = new TMsiSnapshot()) == NULL)
+        return ERROR_NOT_ENOUGH_MEMORY;
+
+    // Nobody else uses msi.dll while the snapshot is being built
+    LockMsiHandles();
+    dwErrCode = LoadFileList(bUseCache);
+
+    // The cached listings have all sizes already
+    if(m_pBuild->m_bCachedFiles == FALSE)
+    {
+        // Decode all tables now. The tables of a snapshot never change
+        for(size_t i = 0; i < m_pBuild->m_Tables.size(); i++)
+            m_pBuild->m_Tables[i]->Data();
+
+        // Measure all tables at once, then get the sizes of the rest
+        LoadFileSizes(MeasureCsvFiles() == ERROR_SUCCESS);
+
+        // All sizes are known now. Remember the listing for the next time the archive is opened.
+        if(bUseCache && dwErrCode == ERROR_SUCCESS)
+        {
+            if(m_strCacheFile.size() != 0)
+                m_pBuild->m_Files.SaveToCache(m_strCacheFile.c_str(), m_CacheKey);
+            if(m_pShared != NULL)
+                m_pShared->SetFileList(m_pBuild->m_Files);
+        }
+    }
+    UnlockMsiHandles();
+
+    // Give the snapshot to the caller
+    PtrSnapshot[0] = m_pBuild;
+    m_pBuild = NULL;
+    return dwErrCode;
+}
+
+// Calculates the sizes of the CSV files of all natively decoded tables in one go,
+// so that the tables and the row ranges of big tables are measured in parallel
+DWORD TMsiDatabase::MeasureCsvFiles()
+{
+    TMsiFileList & Files = m_pBuild->m_Files;
+    std::vector<MSI_CSV_JOB> Jobs;
+    std::vector<DWORD> JobFiles;
+    TMsiStringPool * pStringPool;
+    MSI_CSV_JOB Job = {NULL, 0, 0, NULL, 0, 0};
+
+    // Only if we have native access to the database
+    if(m_pCompFile == NULL || (pStringPool = StringPool()) == NULL)
+        return ERROR_NOT_SUPPORTED;
+
+    // Collect the tables
+    for(DWORD dwFile = 0; dwFile < Files.Count(); dwFile++)
+    {
+        MSI_FILE_DETAIL & Detail = Files.Detail(dwFile);
+
+        if(Detail.FileType == MsiFileTable && Files.Entry(dwFile).RefFile == MSI_NO_FILE)
+        {
+            if((Job.pTableData = Detail.pMsiTable->Data()) != NULL)
+            {
+                Job.dwRows = Job.pTableData->RowCount();
+                Jobs.push_back(Job);
+                JobFiles.push_back(dwFile);
+            }
+        }
+    }
+
+    // Measure the rows and add the headers
+    if(Jobs.size() != 0)
+    {
+        m_CsvPool.Measure(&Jobs[0], Jobs.size(), *pStringPool);
+        for(size_t i = 0; i < Jobs.size(); i++)
+        {
+            MSI_FILE_DETAIL & Detail = Files.Detail(JobFiles[i]);
+
+            Files.Entry(JobFiles[i]).FileSize = TMsiFile::CsvHeaderSize(Detail.pMsiTable->Columns()) + Jobs[i].cbLength;
+        }
+    }
+    return ERROR_SUCCESS;
+}
+
+// Gets the sizes of the files being built. Files that refer
+// to another file show its size, so they are skipped.
+void TMsiDatabase::LoadFileSizes(bool bCsvMeasured)
+{
+    TMsiFile MsiFile(this, m_pBuild, 0);
+
+    for(DWORD dwFile = 0; dwFile < m_pBuild->m_Files.Count(); dwFile++)
+    {
+        if(m_pBuild->m_Files.Entry(dwFile).RefFile == MSI_NO_FILE)
+        {
+            MsiFile.Attach(dwFile);
+            if(bCsvMeasured == false || MsiFile.IsNativeTableFile() == false)
+                MsiFile.LoadFileInternal(NULL);
+        }
+    }
+}
+
+DWORD TMsiDatabase::LoadFileList(bool bUseCache)
+{
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    // If the archive has not changed since the last time, the whole file list
+    // is restored from another open of the same archive or from the listing cache
+    if(bUseCache && m_pCompFile != NULL)
+    {
+        if(m_pShared != NULL && m_pShared->LoadFileList(m_pBuild->m_Files) == ERROR_SUCCESS)
+        {
+            m_pBuild->m_bCachedFiles = TRUE;
+            return ERROR_SUCCESS;
+        }
+
+        if(m_strCacheFile.size() != 0 && m_pBuild->m_Files.LoadFromCache(m_strCacheFile.c_str(), m_CacheKey, m_pCompFile->EntryCount()) == ERROR_SUCCESS)
+        {
+            if(m_pShared != NULL)
+                m_pShared->SetFileList(m_pBuild->m_Files);
+            m_pBuild->m_bCachedFiles = TRUE;
+            return ERROR_SUCCESS;
+        }
+    }
+
+    // Shall we load the tables?
+    if(dwErrCode == ERROR_SUCCESS && m_TableNames.size() == 0)
+        dwErrCode = LoadTableNames();
+
+    // Shall we load all tables?
+    if(dwErrCode == ERROR_SUCCESS && m_TableNames.size() && m_pBuild->m_Tables.size() == 0)
+        dwErrCode = LoadTables();
+
+    // Shall we load all files?
+    if(dwErrCode == ERROR_SUCCESS && m_pBuild->m_Tables.size() != 0 && m_pBuild->m_Files.Count() == 0)
+        dwErrCode = LoadFiles();
+
+    return dwErrCode;
 }
 
 DWORD TMsiDatabase::LoadTableNameIfExists(LPCTSTR szTableName)
@@ -245,11 +571,22 @@ DWORD TMsiDatabase::LoadTableNameIfExists(LPCTSTR szTableName)
 
 DWORD TMsiDatabase::LoadTableNames()
 {
+    TMsiCatalog * pCatalog;
     std::tstring strTableName;
     MSIHANDLE hMsiRecord = NULL;
     MSIHANDLE hMsiView = NULL;
     DWORD dwErrCode;
 
+    // If we have the native catalog, it contains all tables, including those
+    // without rows in "_Validation". The "_Streams" table is enumerated directly
+    if((pCatalog = Catalog()) != NULL)
+    {
+        for(size_t i = 0; i < pCatalog->TableCount(); i++)
+            m_TableNames.push_back(pCatalog->Table(i).Name);
+        m_TableNames.push_back(_T("_Streams"));
+        return ERROR_SUCCESS;
+    }
+
     // The "_Validation" table contain list of all tables in the MSI
     if((dwErrCode = MsiDatabaseOpenView(m_hMsiDb, _T("SELECT * from _Validation"), &hMsiView)) == ERROR_SUCCESS)
     {
@@ -292,9 +629,14 @@ DWORD TMsiDatabase::LoadTableNames()
 
 DWORD TMsiDatabase::LoadTables()
 {
+    TMsiCatalog * pCatalog;
     TMsiTable * pMsiTable;
     DWORD dwErrCode = ERROR_SUCCESS;
 
+    // Tables from the native catalog need no views
+    if((pCatalog = Catalog()) != NULL)
+        return LoadCatalogTables(pCatalog);
+
     // Enumerate table names
     for(size_t i = 0; i < m_TableNames.size(); i++)
     {
@@ -302,6 +644,16 @@ DWORD TMsiDatabase::LoadTables()
         MSIHANDLE hMsiView = NULL;
         TCHAR szQuery[256];
 
+        // If we have the compound file, the "_Streams" table is enumerated directly
+        if(m_pCompFile != NULL && strTableName == _T("_Streams"))
+        {
+            if((pMsiTable = new TMsiTable(this, strTableName, NULL)) == NULL)
+                return ERROR_NOT_ENOUGH_MEMORY;
+
+            m_pBuild->m_Tables.push_back(pMsiTable);
+            continue;
+        }
+
         // Load the list of columns of the table
         StringCchPrintf(szQuery, _countof(szQuery), _T("SELECT * FROM %s"), strTableName.c_str());
         if(MsiDatabaseOpenView(m_hMsiDb, szQuery, &hMsiView) == ERROR_SUCCESS)
@@ -314,8 +666,7 @@ DWORD TMsiDatabase::LoadTables()
             {
                 if(pMsiTable->Load() == ERROR_SUCCESS)
                 {
-                    InsertTailList(&m_Tables, &pMsiTable->m_Entry);
-                    InterlockedIncrement((LONG *)(&m_dwTables));
+                    m_pBuild->m_Tables.push_back(pMsiTable);
                     pMsiTable = NULL;
                 }
                 else
@@ -335,12 +686,46 @@ DWORD TMsiDatabase::LoadTables()
     return dwErrCode;
 }
 
+DWORD TMsiDatabase::LoadCatalogTables(TMsiCatalog * pCatalog)
+{
+    TMsiTable * pMsiTable;
+
+    // Create all tables from the catalog. Their views are opened on demand
+    for(size_t i = 0; i < pCatalog->TableCount(); i++)
+    {
+        const MSI_CATALOG_TABLE & CatalogTable = pCatalog->Table(i);
+
+        if((pMsiTable = new TMsiTable(this, CatalogTable.Name, NULL)) == NULL)
+            return ERROR_NOT_ENOUGH_MEMORY;
+
+        if(pMsiTable->LoadFromCatalog(CatalogTable) == ERROR_SUCCESS)
+        {
+            m_pBuild->m_Tables.push_back(pMsiTable);
+        }
+        else
+        {
+            pMsiTable->Release();
+        }
+    }
+
+    // The "_Streams" table is enumerated directly from the compound file
+    if((pMsiTable = new TMsiTable(this, _T("_Streams"), NULL)) == NULL)
+        return ERROR_NOT_ENOUGH_MEMORY;
+    m_pBuild->m_Tables.push_back(pMsiTable);
+    return ERROR_SUCCESS;
+}
+
+// The files are named by TMsiListing, the same way as the native archive
+// names them. Only the data of the files are accessed through msi.dll.
 DWORD TMsiDatabase::LoadFiles()
 {
-    PLIST_ENTRY pHeadEntry = &m_Tables;
-    PLIST_ENTRY pListEntry;
+    std::vector<std::vector<MSIHANDLE> > TableRecords(m_pBuild->m_Tables.size());
+    std::vector<MSI_LISTING_TABLE> ListingTables(m_pBuild->m_Tables.size());
+    TCabFolderPool * pCabPool;
+    TMsiListing Listing;
     MSIHANDLE hMsiSummary = NULL;
     UINT nPropertyCount = 0;
+    DWORD dwErrCode;
 
     // Load the summary information
     if(MsiGetSummaryInformation(m_hMsiDb, NULL, 0, &hMsiSummary) == ERROR_SUCCESS)
@@ -349,48 +734,128 @@ DWORD TMsiDatabase::LoadFiles()
         MSI_LOG_OPEN_HANDLE(hMsiSummary);
 
         // Get the number of items
-        if(MsiSummaryInfoGetPropertyCount(hMsiSummary, &nPropertyCount) == ERROR_SUCCESS)
+        if(MsiSummaryInfoGetPropertyCount(hMsiSummary, &nPropertyCount) != ERROR_SUCCESS)
         {
-            if(LoadSummaryFile(hMsiSummary) == ERROR_SUCCESS)
-            {
-                hMsiSummary = NULL;
-            }
+            MSI_CLOSE_HANDLE(hMsiSummary);
+            hMsiSummary = NULL;
         }
+    }
 
-        if(hMsiSummary != NULL)
+    // Describe the tables for the listing
+    for(size_t i = 0; i < m_pBuild->m_Tables.size(); i++)
+    {
+        MSI_LISTING_TABLE & ListingTable = ListingTables[i];
+        TMsiTable * pMsiTable = m_pBuild->m_Tables[i];
+
+        ListingTable.Name = pMsiTable->m_strName;
+        for(size_t nColumn = 0; nColumn < pMsiTable->m_Columns.size(); nColumn++)
+            ListingTable.ColumnNames.push_back(pMsiTable->m_Columns[nColumn].m_strName);
+        ListingTable.pTableData = pMsiTable->Data();
+        ListingTable.nStreamColumn = pMsiTable->m_nStreamColumn;
+        ListingTable.nNameColumn = pMsiTable->m_nNameColumn;
+        ListingTable.bIsStreamsTable = (pMsiTable->m_bIsStreamsTable != FALSE);
+
+        // The rows of the tables that are not decoded natively are read by msi.dll
+        if(ListingTable.pTableData == NULL && ListingTable.nStreamColumn != INVALID_SIZE_T && ListingTable.nNameColumn != INVALID_SIZE_T)
         {
-            MSI_CLOSE_HANDLE(hMsiSummary);
+            LoadRowNames(pMsiTable, ListingTable, TableRecords[i]);
+        }
+    }
+
+    // Name all files, then take over the embedded cabinets
+    dwErrCode = Listing.Build(m_pCompFile, StringPool(), ListingTables, (hMsiSummary != NULL));
+    Listing.TakeCabinets(m_pBuild->m_Cabinets);
+
+    // Folders of the cabinets are decompressed on all cores during bulk extraction
+    for(size_t i = 0; i < m_pBuild->m_Cabinets.size() && dwErrCode == ERROR_SUCCESS; i++)
+    {
+        if((pCabPool = new TCabFolderPool()) == NULL)
+        {
+            dwErrCode = ERROR_NOT_ENOUGH_MEMORY;
+            break;
         }
+
+        pCabPool->Open(m_pBuild->m_Cabinets[i], std::thread::hardware_concurrency());
+        m_pBuild->m_CabPools.push_back(pCabPool);
     }
 
-    // Load the tables
-    for(pListEntry = pHeadEntry->Flink; pListEntry != pHeadEntry; pListEntry = pListEntry->Flink)
+    // Create the files in the order of the items, so that the references between them stay the same
+    for(DWORD dwItem = 0; dwItem < Listing.ItemCount() && dwErrCode == ERROR_SUCCESS; dwItem++)
     {
-        TMsiTable * pMsiTable = CONTAINING_RECORD(pListEntry, TMsiTable, m_Entry);
+        const MSI_LISTING_ITEM & Item = Listing.Item(dwItem);
+        TMsiTable * pMsiTable = (Item.dwTable != MSI_NO_ITEM) ? m_pBuild->m_Tables[Item.dwTable] : NULL;
+        TMsiFile MsiFile(this, m_pBuild, m_pBuild->m_Files.NewFile(pMsiTable));
 
-        // Is it a database table with stream field?
-        if(pMsiTable->m_nStreamColumn != INVALID_SIZE_T && pMsiTable->m_nNameColumn != INVALID_SIZE_T)
+        // Is this just a reference to another file?
+        m_pBuild->m_Files.SetName(MsiFile.m_dwFile, Item.Name.c_str());
+        if(Item.RefItem != MSI_NO_ITEM)
         {
-            LoadMultipleStreamFiles(pMsiTable);
+            m_pBuild->m_Files.SetRefFile(MsiFile.m_dwFile, Item.RefItem);
+            continue;
         }
 
-        // Simple database table - we simulate it as simple CSV file
-        else
+        switch(Item.Type)
         {
-            LoadSimpleCsvFile(pMsiTable);
+            case MsiItemSummary:
+                MsiFile.SetSummaryFile(hMsiSummary);
+                hMsiSummary = NULL;
+                break;
+
+            case MsiItemTable:
+                MsiFile.SetCsvFile();
+                break;
+
+            case MsiItemRow:
+                if(ListingTables[Item.dwTable].pTableData == NULL)
+                {
+                    MsiFile.SetBinaryFile(this, TableRecords[Item.dwTable][Item.dwRow]);
+                    TableRecords[Item.dwTable][Item.dwRow] = NULL;
+                }
+                else
+                {
+                    MsiFile.SetBinaryFile(Item.dwStreamEntry);
+                }
+                break;
+
+            case MsiItemStream:
+                MsiFile.SetStreamFile(Item.dwStreamEntry);
+                break;
+
+            case MsiItemCabinet:
+                MsiFile.SetCabinetFile(m_pBuild->m_CabPools[Item.dwCabinet], Item.dwCabFile);
+                break;
         }
     }
-    return ERROR_SUCCESS;
+
+    // Close the records of the rows that refer to other files
+    for(size_t i = 0; i < TableRecords.size(); i++)
+    {
+        for(size_t j = 0; j < TableRecords[i].size(); j++)
+        {
+            if(TableRecords[i][j] != NULL)
+            {
+                MSI_CLOSE_HANDLE(TableRecords[i][j]);
+            }
+        }
+    }
+
+    // Close the summary if there is no file for it
+    if(hMsiSummary != NULL)
+        MSI_CLOSE_HANDLE(hMsiSummary);
+    return dwErrCode;
 }
 
-DWORD TMsiDatabase::LoadMultipleStreamFiles(TMsiTable * pMsiTable)
+// Loads the names of the rows of a table that is not decoded natively.
+// The records are kept, because the files of the rows need them.
+DWORD TMsiDatabase::LoadRowNames(TMsiTable * pMsiTable, MSI_LISTING_TABLE & ListingTable, std::vector<MSIHANDLE> & Records)
 {
-    TMsiFile * pMsiFile;
+    std::tstring strItemName;
     MSIHANDLE hMsiRecord;
-    MSIHANDLE hMsiView = pMsiTable->m_hMsiView;
+    MSIHANDLE hMsiView;
     DWORD dwErrCode;
 
     // Execute the query
+    hMsiView = pMsiTable->MsiView();
     if((dwErrCode = MsiViewExecute(hMsiView, NULL)) == ERROR_SUCCESS)
     {
         // Dump all records
@@ -399,19 +864,15 @@ DWORD TMsiDatabase::LoadMultipleStreamFiles(TMsiTable * pMsiTable)
             // Log the handle for diagnostics
             MSI_LOG_OPEN_HANDLE(hMsiRecord);
 
-            // Create the TMsiFile object
-            if((pMsiFile = new TMsiFile(pMsiTable)) != NULL)
+            // Rows without a name are not shown
+            if(MsiRecordGetString(hMsiRecord, (UINT)(pMsiTable->m_nNameColumn), strItemName))
             {
-                if((dwErrCode = pMsiFile->SetBinaryFile(this, hMsiRecord)) == ERROR_SUCCESS)
-                {
-                    InsertTailList(&m_Files, &pMsiFile->m_Entry);
-                    InterlockedIncrement((LONG *)(&m_dwFiles));
-                }
-                else
-                {
-                    MSI_CLOSE_HANDLE(hMsiRecord);
-                    pMsiFile->Release();
-                }
+                ListingTable.RowNames.push_back(strItemName);
+                Records.push_back(hMsiRecord);
+            }
+            else
+            {
+                MSI_CLOSE_HANDLE(hMsiRecord);
             }
         }
 
@@ -421,66 +882,104 @@ DWORD TMsiDatabase::LoadMultipleStreamFiles(TMsiTable * pMsiTable)
     return dwErrCode;
 }
 
-DWORD TMsiDatabase::LoadSimpleCsvFile(TMsiTable * pMsiTable)
+// Called with the MSI handles locked
+MSIHANDLE TMsiDatabase::FetchFileRecord(TMsiSnapshot * pSnapshot, DWORD dwFile)
 {
-    TMsiFile * pMsiFile;
-    DWORD dwErrCode = ERROR_NOT_ENOUGH_MEMORY;
+    const MSI_FILE_DETAIL & Detail = pSnapshot->m_Files.Detail(dwFile);
+    TMsiTable * pMsiTable = Detail.pMsiTable;
+    MSIHANDLE hMsiParams = NULL;
+    MSIHANDLE hMsiRecord = NULL;
+    MSIHANDLE hMsiView = NULL;
+    std::tstring strQuery;
 
-    if((pMsiFile = new TMsiFile(pMsiTable)) != NULL)
+    // Create the query that selects the row by its primary key
+    strQuery = _T("SELECT * FROM `");
+    strQuery += pMsiTable->m_strName;
+    strQuery += _T("` WHERE ");
+    for(size_t i = 0; i < pMsiTable->m_KeyColumns.size(); i++)
     {
-        if((dwErrCode = pMsiFile->SetCsvFile(this)) == ERROR_SUCCESS)
-        {
-            InsertTailList(&m_Files, &pMsiFile->m_Entry);
-            InterlockedIncrement((LONG *)(&m_dwFiles));
-        }
-        else
+        if(i > 0)
+            strQuery += _T(" AND ");
+        strQuery += _T("`");
+        strQuery += pMsiTable->m_Columns[pMsiTable->m_KeyColumns[i]].m_strName;
+        strQuery += _T("`=?");
+    }
+
+    // Fetch the record
+    if(MsiDatabaseOpenView(m_hMsiDb, strQuery.c_str(), &hMsiView) == ERROR_SUCCESS)
+    {
+        // Log the handle for diagnostics
+        MSI_LOG_OPEN_HANDLE(hMsiView);
+
+        // Fill the values of the primary key
+        if((hMsiParams = MsiCreateRecord(Detail.KeyCount)) != NULL)
         {
-            pMsiFile->Release();
+            // Log the handle for diagnostics
+            MSI_LOG_OPEN_HANDLE(hMsiParams);
+
+            for(DWORD i = 0; i < Detail.KeyCount; i++)
+            {
+                LPCTSTR szValue = pSnapshot->m_Files.KeyValue(dwFile, i);
+
+                if(pMsiTable->m_Columns[pMsiTable->m_KeyColumns[i]].m_Type == MsiTypeInteger)
+                    MsiRecordSetInteger(hMsiParams, (UINT)(i + 1), _ttoi(szValue));
+                else
+                    MsiRecordSetString(hMsiParams, (UINT)(i + 1), szValue);
+            }
+
+            // Execute the view and get the record
+            if(MsiViewExecute(hMsiView, hMsiParams) == ERROR_SUCCESS)
+            {
+                if(MsiViewFetch(hMsiView, &hMsiRecord) == ERROR_SUCCESS)
+                    MSI_LOG_OPEN_HANDLE(hMsiRecord);
+                else
+                    hMsiRecord = NULL;
+                MsiViewClose(hMsiView);
+            }
+            MSI_CLOSE_HANDLE(hMsiParams);
         }
+        MSI_CLOSE_HANDLE(hMsiView);
     }
-    return dwErrCode;
+    return hMsiRecord;
 }
 
-DWORD TMsiDatabase::LoadSummaryFile(MSIHANDLE hMsiSummary)
+// The records are cached in the snapshot, because the file indexes belong to it.
+// Called with the MSI handles locked; the record is only valid until they are unlocked
+MSIHANDLE TMsiDatabase::GetFileRecord(TMsiSnapshot * pSnapshot, DWORD dwFile)
 {
-    TMsiFile* pMsiFile;
-    DWORD dwErrCode = ERROR_NOT_ENOUGH_MEMORY;
+    MSI_RECORD_CACHE & Records = pSnapshot->m_Records;
+    MSIHANDLE hMsiRecord;
 
-    if((pMsiFile = new TMsiFile(NULL)) != NULL)
+    // Is the record in the cache? If yes, move it to the front
+    for(MSI_RECORD_CACHE::iterator iter = Records.begin(); iter != Records.end(); iter++)
     {
-        if((dwErrCode = pMsiFile->SetSummaryFile(this, hMsiSummary)) == ERROR_SUCCESS)
-        {
-            InsertTailList(&m_Files, &pMsiFile->m_Entry);
-            InterlockedIncrement((LONG*)(&m_dwFiles));
-        }
-        else
+        if(iter->first == dwFile)
         {
-            pMsiFile->Release();
+            Records.splice(Records.begin(), Records, iter);
+            return Records.front().second;
         }
     }
-    return dwErrCode;
-}
-
-TMsiFile * TMsiDatabase::IsFilePresent(LPCTSTR szFileName)
-{
-    PLIST_ENTRY pHeadEntry = &m_Files;
-    PLIST_ENTRY pListEntry;
 
-    for(pListEntry = pHeadEntry->Flink; pListEntry != pHeadEntry; pListEntry = pListEntry->Flink)
+    // Insert the record to the cache. Close the least recently used one
+    if((hMsiRecord = FetchFileRecord(pSnapshot, dwFile)) != NULL)
     {
-        TMsiFile * pMsiFile = CONTAINING_RECORD(pListEntry, TMsiFile, m_Entry);
-
-        if(!_tcsicmp(pMsiFile->Name(), szFileName))
+        Records.push_front(std::make_pair(dwFile, hMsiRecord));
+        if(Records.size() > MSI_RECORD_CACHE_SIZE)
         {
-            return pMsiFile;
+            MSI_CLOSE_HANDLE(Records.back().second);
+            Records.pop_back();
         }
     }
-    return NULL;
+    return hMsiRecord;
 }
 
 TMsiFile * TMsiDatabase::LastFile()
 {
-    if(m_pLastFile != NULL)
-        m_pLastFile->AddRef();
-    return m_pLastFile;
+    TMsiFile * pMsiFile;
+
+    EnterCriticalSection(&m_CursorLock);
+    if((pMsiFile = m_pLastFile) != NULL)
+        pMsiFile->AddRef();
+    LeaveCriticalSection(&m_CursorLock);
+    return pMsiFile;
 }
@@ -10,41 +10,6 @@
 
 #include "wcx_msi.h"
 
-//-----------------------------------------------------------------------------
-// MSI Summary info data types
-
-struct MSI_PROPERTY
-{
-    VARENUM vType;
-    LPCTSTR szName;
-};
-
-static const MSI_PROPERTY MsiPropertyList[] = 
-{
-    {VT_EMPTY},
-    {VT_I2,       _T("Codepage")},
-    {VT_LPSTR,    _T("Title")},
-    {VT_LPSTR,    _T("Subject")},
-    {VT_LPSTR,    _T("Author")},
-    {VT_LPSTR,    _T("Keywords")},
-    {VT_LPSTR,    _T("Comments")},
-    {VT_LPSTR,    _T("Template")},
-    {VT_LPSTR,    _T("Last Saved By")},
-    {VT_LPSTR,    _T("Revision Number")},
-    {VT_EMPTY},
-    {VT_FILETIME, _T("Last Printed")},
-    {VT_FILETIME, _T("Create Time / Date")},
-    {VT_FILETIME, _T("Last Save Time / Date")},
-    {VT_I4,       _T("Page Count")},
-    {VT_I4,       _T("Word Count")},
-    {VT_I4,       _T("Character Count")},
-    {VT_EMPTY},
-    {VT_LPSTR,    _T("Creating Application")},
-    {VT_I4,       _T("Security")}
-};
-
-static LPCTSTR szCsvExtension = _T(".csv");
-
 //-----------------------------------------------------------------------------
 // Non-class members
 
@@ -69,109 +34,110 @@ static LPBYTE AppendUtf8Marker(LPBYTE pbBufferPtr, LPBYTE pbBufferEnd)
     return pbBufferPtr + 3;
 }
 
-static LPBYTE AppendFieldString(LPBYTE pbBufferPtr, LPBYTE pbBufferEnd, const std::tstring & strValue, size_t nIndex)
+static LPBYTE AppendFieldString(LPBYTE pbBufferPtr, LPBYTE pbBufferEnd, LPCWSTR szValue, size_t ccValue, size_t nIndex)
 {
     size_t nLength;
 
-    // Append length of the UTF8 string plus 2x quotation marks
-    nLength = ((nIndex > 0) ? 1 : 0)            // Comma at the beginning
-            + 1                                 // Opening quotation mark
-            + WideCharToMultiByte(CP_UTF8, 0, strValue.c_str(), (int)(strValue.size()), NULL, 0, NULL, NULL)
-            + 1;                                // Closing quotation mark
-
     // Is this "dry run" (calculating the size)?
     if(pbBufferEnd == NULL)
+    {
+        nLength = ((nIndex > 0) ? 1 : 0)        // Comma at the beginning
+                + 1                             // Opening quotation mark
+                + MsiCsvCellLength(szValue, ccValue)
+                + 1;                            // Closing quotation mark
         return pbBufferPtr + nLength;
+    }
 
-    // Append comma
-    if(nIndex > 0)
+    // Append comma and the opening quotation mark
+    if(nIndex > 0 && pbBufferPtr < pbBufferEnd)
         *pbBufferPtr++ = ',';
+    if(pbBufferPtr < pbBufferEnd)
+        *pbBufferPtr++ = '\"';
 
-    // Append opening quotation mark
-    *pbBufferPtr++ = '\"';
+    // Append the UTF-8 string with the quotation marks doubled
+    pbBufferPtr += MsiCsvCellEncode(pbBufferPtr, (size_t)(pbBufferEnd - pbBufferPtr), szValue, ccValue);
 
-    // Append the UTF-8 string
-    pbBufferPtr += WideCharToMultiByte(CP_UTF8, 0, strValue.c_str(),
-                                             (int)(strValue.size()),
-                                           (LPSTR)(pbBufferPtr),
-                                             (int)(pbBufferEnd - pbBufferPtr), NULL, NULL);
     // Append closing quotation mark
-    *pbBufferPtr++ = '\"';
-
+    if(pbBufferPtr < pbBufferEnd)
+        *pbBufferPtr++ = '\"';
     return pbBufferPtr;
 }
 
+static LPBYTE AppendFieldString(LPBYTE pbBufferPtr, LPBYTE pbBufferEnd, const std::tstring & strValue, size_t nIndex)
+{
+    return AppendFieldString(pbBufferPtr, pbBufferEnd, strValue.c_str(), strValue.size(), nIndex);
+}
+
+static LPBYTE AppendCsvHeader(LPBYTE pbBufferPtr, LPBYTE pbBufferEnd, const std::vector<TMsiColumn> & Columns)
+{
+    // Append the header columns
+    for(size_t i = 0; i < Columns.size(); i++)
+    {
+        pbBufferPtr = AppendFieldString(pbBufferPtr, pbBufferEnd, Columns[i].m_strName, i);
+    }
+
+    // Append the end-of-line
+    return AppendNewLine(pbBufferPtr, pbBufferEnd);
+}
+
+// Formats the time the same way as TMsiSummary::RenderCsv: in UTC, as "YYYY-MM-DD HH:MM:SS"
 HRESULT StringCchPrintfFT(LPTSTR szBuffer, size_t ccBuffer, const FILETIME & ft)
 {
     SYSTEMTIME st;
-    LPTSTR szBufferEnd = szBuffer + ccBuffer;
-    LPTSTR szBufferPtr = szBuffer;
-    int nLength;
 
     // If the filetime is not present, do nothing
-    if(ft.dwHighDateTime && ft.dwHighDateTime)
+    if(ft.dwHighDateTime != 0 && FileTimeToSystemTime(&ft, &st))
     {
-        // Convert the file time to SYSTEMTIME
-        FileTimeToSystemTime(&ft, &st);
-
-        // Create date
-        nLength = GetDateFormat(LOCALE_USER_DEFAULT, DATE_SHORTDATE, &st, NULL, szBufferPtr, (int)(szBufferEnd - szBufferPtr));
-        if(nLength != 0)
-        {
-            szBufferPtr += (nLength - 1);
-            *szBufferPtr++ = _T(' ');
-        }
-
-        // Create time
-        GetTimeFormat(LOCALE_USER_DEFAULT, TIME_FORCE24HOURFORMAT, &st, NULL, szBufferPtr, (int)(szBufferEnd - szBufferPtr));
+        return StringCchPrintf(szBuffer, ccBuffer, _T("%04u-%02u-%02u %02u:%02u:%02u"), st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond);
     }
     else
     {
-        StringCchCopy(szBuffer, ccBuffer, _T("N/A"));
+        return StringCchCopy(szBuffer, ccBuffer, _T("N/A"));
     }
-    return S_OK;
 }
 
 //-----------------------------------------------------------------------------
-// TMsiFile functions
+// MSI_READ_CURSOR functions
 
-TMsiFile::TMsiFile(TMsiTable * pMsiTable)
+MSI_READ_CURSOR::MSI_READ_CURSOR()
 {
-    InitializeListHead(&m_Entry);
-    m_hMsiHandle = NULL;
-    m_dwFileSize = 0;
-    m_FileType = MsiFileNone;
-    m_dwRefs = 1;
+    ByteOffset = 0;
+    Source = MsiReadNone;
+    hMsiRecord = NULL;
+    nStreamField = 0;
+    dwRow = 0;
+    bHeaderDone = false;
+}
 
-    // Reset the referenced file
-    m_pRefFile = NULL;
+MSI_READ_CURSOR::~MSI_READ_CURSOR()
+{
+    if(hMsiRecord != NULL)
+        MSI_CLOSE_HANDLE(hMsiRecord);
+    hMsiRecord = NULL;
+}
 
-    // Reference the MSI table
-    if((m_pMsiTable = pMsiTable) != NULL)
-    {
-        m_pMsiTable->AddRef();
-    }
+//-----------------------------------------------------------------------------
+// TMsiFile functions
+
+TMsiFile::TMsiFile(TMsiDatabase * pMsiDb, TMsiSnapshot * pSnapshot, DWORD dwFile)
+{
+    InitializeCriticalSection(&m_DataLock);
+    m_pMsiDb = pMsiDb;
+    m_pSnapshot = pSnapshot;
+    m_pSnapshot->AddRef();
+    m_dwRefs = 1;
+    Attach(dwFile);
 }
 
 TMsiFile::~TMsiFile()
 {
-    // Sanity check
-    assert(m_dwRefs == 0);
-    
-    // Dereference the referenced file
-    if(m_pRefFile != NULL)
-        m_pRefFile->Release();
-    m_pRefFile = NULL;
-
-    // Dereference the database table
-    if(m_pMsiTable != NULL)
-        m_pMsiTable->Release();
-    m_pMsiTable = NULL;
+    // Sanity check. Views on the stack, used when the file list
+    // is being built, keep their initial reference
+    assert(m_dwRefs <= 1);
 
-    // Close the MSI handle, if any
-    if(m_hMsiHandle != NULL)
-        MSI_CLOSE_HANDLE(m_hMsiHandle);
-    m_hMsiHandle = NULL;
+    // Release the snapshot. It may be the last reference to it
+    m_pSnapshot->Release();
+    DeleteCriticalSection(&m_DataLock);
 }
 
 //-----------------------------------------------------------------------------
@@ -192,68 +158,86 @@ DWORD TMsiFile::Release()
     return m_dwRefs;
 }
 
-DWORD TMsiFile::SetSummaryFile(TMsiDatabase * pMsiDb, MSIHANDLE hMsiSummary)
+void TMsiFile::Attach(DWORD dwFile)
 {
-    // Remember the summary info
-    m_FileType = MsiFileSummary;
-    m_hMsiHandle = hMsiSummary;
+    // Free the data of the previous file
+    m_Data.Free();
 
-    // Ensure that we have an unique file name
-    return SetUniqueFileName(pMsiDb, NULL, _T("_SummaryInformation"), szCsvExtension);
+    // Files that refer to another file show its data
+    m_dwFile = m_dwDataFile = dwFile;
+    if(dwFile < m_pSnapshot->m_Files.Count() && m_pSnapshot->m_Files.Entry(dwFile).RefFile != MSI_NO_FILE)
+        m_dwDataFile = m_pSnapshot->m_Files.Entry(dwFile).RefFile;
+}
+
+DWORD TMsiFile::SetSummaryFile(MSIHANDLE hMsiSummary)
+{
+    // Remember the summary info
+    Detail().FileType = MsiFileSummary;
+    Detail().hMsiHandle = hMsiSummary;
+    return ERROR_SUCCESS;
 }
 
 DWORD TMsiFile::SetBinaryFile(TMsiDatabase * pMsiDb, MSIHANDLE hMsiRecord)
 {
-    TMsiFile * pRefFile;
-    std::tstring strItemName;
-    LPTSTR szExtension;
-    TCHAR szFileName[MAX_PATH];
-    TCHAR szBaseName[MAX_PATH];
-    TCHAR szFileExt[MAX_PATH] = {0};
+    TMsiTable * pMsiTable = Table();
+    std::tstring strValue;
 
-    // Retrieve the name of the item
-    if(MsiRecordGetString(hMsiRecord, (UINT)(m_pMsiTable->m_nNameColumn), strItemName))
-    {
-        // Is this just a reference to another file?
-        pRefFile = pMsiDb->FindReferencedFile(m_pMsiTable, strItemName.c_str(), szFileName, _countof(szFileName));
-        if((m_pRefFile = pRefFile) == NULL)
-        {
-            // Fix the item name to be file-safe
-            MakeItemNameFileSafe(strItemName);
+    // Locate the stream in the compound file, so we can read it directly
+    FindRecordStream(pMsiDb, hMsiRecord);
+    Detail().FileType = MsiFileBinary;
 
-            // Split the base name and extension
-            StringCchPrintf(szBaseName, _countof(szBaseName), strItemName.c_str());
-            if((szExtension = GetFileExtension(szBaseName)) > szBaseName)
-            {
-                StringCchCopy(szFileExt, _countof(szFileExt), szExtension);
-                szExtension[0] = 0;
-            }
+    // Remember the values of the primary key, so that the record can be
+    // fetched again when needed. Tables without primary key keep the record.
+    for(size_t i = 0; i < pMsiTable->m_KeyColumns.size(); i++)
+    {
+        size_t nColumn = pMsiTable->m_KeyColumns[i];
 
-            // Setup the unique file name
-            SetUniqueFileName(pMsiDb, m_pMsiTable->Name(), szBaseName, szFileExt);
-        }
+        if(pMsiTable->m_Columns[nColumn].m_Type == MsiTypeInteger)
+            MsiRecordGetInteger(hMsiRecord, (UINT)(nColumn), strValue);
         else
-        {
-            m_strName.assign(szFileName);
-            m_pRefFile->AddRef();
-        }
-
-        // Assign the file name and record handle
-        m_FileType = MsiFileBinary;
-        m_hMsiHandle = hMsiRecord;
-        return ERROR_SUCCESS;
+            MsiRecordGetString(hMsiRecord, (UINT)(nColumn), strValue);
+        m_pSnapshot->m_Files.AddKeyValue(m_dwFile, strValue.c_str());
     }
-    return ERROR_NOT_SUPPORTED;
+
+    // Keep the record only if we can't fetch it again
+    if(Detail().KeyCount != 0)
+        MSI_CLOSE_HANDLE(hMsiRecord);
+    else
+        Detail().hMsiHandle = hMsiRecord;
+    return ERROR_SUCCESS;
+}
+
+DWORD TMsiFile::SetBinaryFile(DWORD dwStreamEntry)
+{
+    // The row of a natively decoded table. If the cell is NULL, the file is empty
+    Detail().FileType = MsiFileBinary;
+    Detail().dwStreamEntry = dwStreamEntry;
+    return ERROR_SUCCESS;
+}
+
+DWORD TMsiFile::SetStreamFile(DWORD dwStreamEntry)
+{
+    // Remember the directory entry of the stream
+    Detail().FileType = MsiFileStream;
+    Detail().dwStreamEntry = dwStreamEntry;
+    return ERROR_SUCCESS;
 }
 
-DWORD TMsiFile::SetCsvFile(TMsiDatabase * pMsiDb)
+DWORD TMsiFile::SetCsvFile()
 {
     // Setup the handle
-    m_FileType = MsiFileTable;
-    m_hMsiHandle = NULL;
+    Detail().FileType = MsiFileTable;
+    Detail().hMsiHandle = NULL;
+    return ERROR_SUCCESS;
+}
 
-    // Generate unique file name
-    return SetUniqueFileName(pMsiDb, NULL, m_pMsiTable->Name(), szCsvExtension);
+DWORD TMsiFile::SetCabinetFile(TCabFolderPool * pCabPool, DWORD dwCabFile)
+{
+    // Remember the file in the cabinet
+    Detail().FileType = MsiFileCabinet;
+    Detail().pCabPool = pCabPool;
+    Detail().dwCabFile = dwCabFile;
+    return ERROR_SUCCESS;
 }
 
 DWORD TMsiFile::LoadSummaryFile(LPDWORD PtrFileSize)
@@ -265,6 +249,23 @@ DWORD TMsiFile::LoadSummaryFile(LPDWORD PtrFileSize)
     DWORD dwErrCode = ERROR_SUCCESS;
     UINT nPropertyCount = 0;
 
+    // Render the summary natively, so that it is the same as in msitool.
+    // Only if the compound file could not be opened, we ask msi.dll
+    if(m_pMsiDb->CompoundFile() != NULL)
+    {
+        std::vector<BYTE> Csv;
+        TMsiSummary Summary;
+
+        if(Summary.Load(m_pMsiDb->CompoundFile()) == ERROR_SUCCESS)
+        {
+            Summary.RenderCsv(Csv);
+            if(pbBufferBegin != NULL)
+                memcpy(pbBufferBegin, &Csv[0], min(Csv.size(), m_Data.cbData));
+            PtrFileSize[0] = (DWORD)(Csv.size());
+            return ERROR_SUCCESS;
+        }
+    }
+
     // Append the UTF-8 marker and table header
     pbBufferPtr = AppendUtf8Marker(pbBufferPtr, pbBufferEnd);
     pbBufferPtr = AppendFieldString(pbBufferPtr, pbBufferEnd, _T("Name"), 0);
@@ -272,22 +273,24 @@ DWORD TMsiFile::LoadSummaryFile(LPDWORD PtrFileSize)
     pbBufferPtr = AppendNewLine(pbBufferPtr, pbBufferEnd);
 
     // Read each field and store it tot he CSV file
-    if(MsiSummaryInfoGetPropertyCount(m_hMsiHandle, &nPropertyCount) == ERROR_SUCCESS)
+    if(MsiSummaryInfoGetPropertyCount(Detail().hMsiHandle, &nPropertyCount) == ERROR_SUCCESS)
     {
-        for(UINT i = 0; i < _countof(MsiPropertyList); i++)
+        for(UINT i = 0; i < MSI_SUMMARY_PROPERTY_COUNT; i++)
         {
+            LPCWSTR szName = MsiSummaryPropertyName(i);
             FILETIME ft = {0};
             UINT uDataType = 0;
             INT iValue = 0;
             TCHAR szValue[1024] = {0};
             DWORD ccValue = _countof(szValue);
 
-            if(MsiSummaryInfoGetProperty(m_hMsiHandle, i, &uDataType, &iValue, &ft, szValue, &ccValue) == ERROR_SUCCESS)
+            if(MsiSummaryInfoGetProperty(Detail().hMsiHandle, i, &uDataType, &iValue, &ft, szValue, &ccValue) == ERROR_SUCCESS)
             {
                 VARENUM vType = (VARENUM)(uDataType);
                 bool bUnknownFormat = false;
 
-                if(vType != VT_EMPTY)
+                // The properties have the same names as in the native archive
+                if(vType != VT_EMPTY && szName != NULL)
                 {
                     // Format the data type
                     switch(vType)
@@ -315,7 +318,7 @@ DWORD TMsiFile::LoadSummaryFile(LPDWORD PtrFileSize)
                     if(bUnknownFormat == false)
                     {
                         // Append name and value
-                        pbBufferPtr = AppendFieldString(pbBufferPtr, pbBufferEnd, MsiPropertyList[i].szName, 0);
+                        pbBufferPtr = AppendFieldString(pbBufferPtr, pbBufferEnd, szName, _tcslen(szName), 0);
                         pbBufferPtr = AppendFieldString(pbBufferPtr, pbBufferEnd, szValue, 1);
                         pbBufferPtr = AppendNewLine(pbBufferPtr, pbBufferEnd);
                     }
@@ -332,18 +335,31 @@ DWORD TMsiFile::LoadSummaryFile(LPDWORD PtrFileSize)
 
 DWORD TMsiFile::LoadBinaryFile(LPDWORD PtrFileSize)
 {
+    MSIHANDLE hMsiRecord = Detail().hMsiHandle;
+    UINT nStreamField = (UINT)(Table()->m_nStreamColumn + 1);
     DWORD dwFileSize = 0;
     DWORD dwErrCode;
 
+    // Re-acquire the record by its primary key. The handle is owned by the snapshot
+    if(hMsiRecord == NULL && Detail().KeyCount != 0)
+        hMsiRecord = m_pMsiDb->GetFileRecord(m_pSnapshot, m_dwDataFile);
+
+    // Files from natively decoded tables have no record. Their stream is missing
+    if(hMsiRecord == NULL)
+    {
+        PtrFileSize[0] = 0;
+        return ERROR_SUCCESS;
+    }
+
     // "Load file data" mode?
     if(m_Data.pbData != NULL)
     {
-        dwFileSize = m_dwFileSize;
-        dwErrCode = MsiRecordReadStream(m_hMsiHandle, (UINT)(m_pMsiTable->m_nStreamColumn + 1), (char *)(m_Data.pbData), &dwFileSize);
+        dwFileSize = m_Data.cbData;
+        dwErrCode = MsiRecordReadStream(hMsiRecord, nStreamField, (char *)(m_Data.pbData), &dwFileSize);
     }
     else
     {
-        dwFileSize = MsiRecordDataSize(m_hMsiHandle, (UINT)(m_pMsiTable->m_nStreamColumn + 1));
+        dwFileSize = MsiRecordDataSize(hMsiRecord, nStreamField);
         dwErrCode = ERROR_SUCCESS;
     }
 
@@ -353,70 +369,136 @@ DWORD TMsiFile::LoadBinaryFile(LPDWORD PtrFileSize)
     return dwErrCode;
 }
 
+DWORD TMsiFile::LoadStreamFile(PULONGLONG PtrFileSize)
+{
+    TCompoundFile * pCompFile = m_pMsiDb->CompoundFile();
+    DWORD dwStreamEntry = Detail().dwStreamEntry;
+    CFB_STREAM Stream;
+    ULONGLONG FileSize = 0;
+    DWORD dwBytesRead = 0;
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    // "Load file data" mode?
+    if(m_Data.pbData != NULL)
+    {
+        if((dwErrCode = pCompFile->OpenStream(dwStreamEntry, Stream)) == ERROR_SUCCESS)
+        {
+            dwErrCode = pCompFile->ReadStream(Stream, 0, m_Data.pbData, m_Data.cbData, &dwBytesRead);
+            FileSize = dwBytesRead;
+        }
+    }
+    else
+    {
+        FileSize = pCompFile->Entry(dwStreamEntry).Size;
+    }
+
+    // Give the file size to the caller
+    if(dwErrCode == ERROR_SUCCESS)
+        PtrFileSize[0] = FileSize;
+    return dwErrCode;
+}
+
+// Length of the UTF-8 marker and the header of a CSV file
+size_t TMsiFile::CsvHeaderSize(const std::vector<TMsiColumn> & Columns)
+{
+    BYTE Marker[3];
+
+    return (size_t)(AppendCsvHeader(Marker + 3, NULL, Columns) - Marker);
+}
+
 DWORD TMsiFile::LoadCsvFile(LPDWORD PtrFileSize)
 {
-    const std::vector<TMsiColumn> & Columns = m_pMsiTable->Columns();
+    TMsiTable * pMsiTable = Table();
+    const std::vector<TMsiColumn> & Columns = pMsiTable->Columns();
+    TMsiTableData * pTableData;
+    TMsiStringPool * pStringPool;
     std::tstring strValue;
-    MSIHANDLE hMsiView = m_pMsiTable->MsiView();
+    MSIHANDLE hMsiView;
     MSIHANDLE hMsiRecord;
     LPBYTE pbBufferBegin = m_Data.pbData;
     LPBYTE pbBufferPtr = m_Data.pbData;
     LPBYTE pbBufferEnd = m_Data.pbData + m_Data.cbData;
     DWORD dwErrCode = ERROR_SUCCESS;
 
-    // Append the UTF-8 marker
+    // Append the UTF-8 marker and the header
     pbBufferPtr = AppendUtf8Marker(pbBufferPtr, pbBufferEnd);
+    pbBufferPtr = AppendCsvHeader(pbBufferPtr, pbBufferEnd, Columns);
 
-    // Append the header columns
-    for(size_t i = 0; i < Columns.size(); i++)
+    // If we have the table decoded natively, dump it from the column arrays.
+    // Big tables are measured and rendered by multiple threads.
+    if((pTableData = pMsiTable->Data()) != NULL)
     {
-        pbBufferPtr = AppendFieldString(pbBufferPtr, pbBufferEnd, Columns[i].m_strName, i);
-    }
+        MSI_CSV_JOB Job = {pTableData, 0, pTableData->RowCount(), NULL, 0, 0};
 
-    // Append the end-of-line
-    pbBufferPtr = AppendNewLine(pbBufferPtr, pbBufferEnd);
+        pStringPool = m_pMsiDb->StringPool();
 
-    // Execute the query on top of the view
-    if(MsiViewExecute(hMsiView, NULL) == ERROR_SUCCESS)
-    {
-        // Fetch all records
-        while(MsiViewFetch(hMsiView, &hMsiRecord) == ERROR_SUCCESS)
+        // "Dry run" mode: Calculate the size without rendering anything
+        if(pbBufferEnd == NULL)
         {
-            // Log the handle for diagnostics
-            MSI_LOG_OPEN_HANDLE(hMsiRecord);
+            m_pMsiDb->CsvPool().Measure(&Job, 1, *pStringPool);
+            Job.cbLength += (ULONGLONG)(pbBufferPtr - pbBufferBegin);
 
-            // Dump all columns
-            for(size_t i = 0; i < Columns.size(); i++)
+            if(Job.cbLength > 0xFFFFFFFF)
+                return ERROR_FILE_TOO_LARGE;
+            PtrFileSize[0] = (DWORD)(Job.cbLength);
+            return ERROR_SUCCESS;
+        }
+
+        // Render the rows after the header
+        Job.pbBuffer = pbBufferPtr;
+        Job.cbBuffer = (pbBufferPtr < pbBufferEnd) ? (size_t)(pbBufferEnd - pbBufferPtr) : 0;
+        if((dwErrCode = m_pMsiDb->CsvPool().Render(&Job, 1, *pStringPool)) != ERROR_SUCCESS)
+            return dwErrCode;
+        pbBufferPtr += (size_t)(Job.cbLength);
+    }
+
+    // Execute the query on top of the view. The views are opened on demand
+    // and shared with the other users of the database
+    else
+    {
+        m_pMsiDb->LockMsiHandles();
+        if((hMsiView = pMsiTable->MsiView()) != NULL && MsiViewExecute(hMsiView, NULL) == ERROR_SUCCESS)
+        {
+            // Fetch all records
+            while(MsiViewFetch(hMsiView, &hMsiRecord) == ERROR_SUCCESS)
             {
-                // Retrieve the buffer data
-                switch(Columns[i].m_Type)
+                // Log the handle for diagnostics
+                MSI_LOG_OPEN_HANDLE(hMsiRecord);
+
+                // Dump all columns
+                for(size_t i = 0; i < Columns.size(); i++)
                 {
-                    case MsiTypeInteger:
-                        MsiRecordGetInteger(hMsiRecord, (UINT)(i), strValue);
-                        pbBufferPtr = AppendFieldString(pbBufferPtr, pbBufferEnd, strValue, i);
-                        break;
-
-                    case MsiTypeString:
-                        MsiRecordGetString(hMsiRecord, (UINT)(i), strValue);
-                        pbBufferPtr = AppendFieldString(pbBufferPtr, pbBufferEnd, strValue, i);
-                        break;
-
-                    default:
-                        dwErrCode = ERROR_NOT_SUPPORTED;
-                        assert(false);
-                        break;
+                    // Retrieve the buffer data
+                    switch(Columns[i].m_Type)
+                    {
+                        case MsiTypeInteger:
+                            MsiRecordGetInteger(hMsiRecord, (UINT)(i), strValue);
+                            pbBufferPtr = AppendFieldString(pbBufferPtr, pbBufferEnd, strValue, i);
+                            break;
+
+                        case MsiTypeString:
+                            MsiRecordGetString(hMsiRecord, (UINT)(i), strValue);
+                            pbBufferPtr = AppendFieldString(pbBufferPtr, pbBufferEnd, strValue, i);
+                            break;
+
+                        default:
+                            dwErrCode = ERROR_NOT_SUPPORTED;
+                            assert(false);
+                            break;
+                    }
                 }
-            }
 
-            // Append a newline
-            pbBufferPtr = AppendNewLine(pbBufferPtr, pbBufferEnd);
+                // Append a newline
+                pbBufferPtr = AppendNewLine(pbBufferPtr, pbBufferEnd);
 
-            // Close the MSI record
-            MSI_CLOSE_HANDLE(hMsiRecord);
-        }
+                // Close the MSI record
+                MSI_CLOSE_HANDLE(hMsiRecord);
+            }
 
-        // Finalize the executed view
-        MsiViewClose(hMsiView);
+            // Finalize the executed view
+            MsiViewClose(hMsiView);
+        }
+        m_pMsiDb->UnlockMsiHandles();
     }
 
     // Give the file size to the caller
@@ -425,30 +507,286 @@ DWORD TMsiFile::LoadCsvFile(LPDWORD PtrFileSize)
     return dwErrCode;
 }
 
-DWORD TMsiFile::LoadFileInternal(LPDWORD PtrFileSize)
+DWORD TMsiFile::LoadCabinetFile(LPDWORD PtrFileSize)
+{
+    TCabFolderPool * pCabPool = Detail().pCabPool;
+    const CAB_FILE & CabFile = pCabPool->Cabinet()->File(Detail().dwCabFile);
+    DWORD dwBytesRead = 0;
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    // "Load file data" mode?
+    if(m_Data.pbData != NULL)
+    {
+        dwErrCode = pCabPool->Read(CabFile.Folder, CabFile.FolderOffset, m_Data.pbData, min(m_Data.cbData, CabFile.FileSize), &dwBytesRead);
+    }
+    else
+    {
+        dwBytesRead = CabFile.FileSize;
+    }
+
+    // Give the file size to the caller
+    if(dwErrCode == ERROR_SUCCESS)
+        PtrFileSize[0] = dwBytesRead;
+    return dwErrCode;
+}
+
+bool TMsiFile::IsNativeTableFile()
+{
+    return (Detail().FileType == MsiFileTable && Table()->Data() != NULL);
+}
+
+DWORD TMsiFile::ReadCsvChunk(MSI_READ_CURSOR & Cursor, std::vector<BYTE> & Chunk, LPDWORD PtrBytesRead)
+{
+    const std::vector<TMsiColumn> & Columns = Table()->Columns();
+    TMsiTableData * pTableData;
+    TMsiStringPool * pStringPool;
+    LPBYTE pbBufferBegin;
+    LPBYTE pbBufferPtr;
+    LPBYTE pbBufferEnd;
+    size_t cbRowSize;
+    size_t cbRows = 0;
+    DWORD dwEndRow;
+
+    // Only natively decoded tables can be rendered by chunks
+    if(IsNativeTableFile() == false)
+        return ERROR_NOT_SUPPORTED;
+    pTableData = Table()->Data();
+    pStringPool = m_pMsiDb->StringPool();
+
+    // Make sure that the chunk has at least the minimal size
+    if(Chunk.size() < MSI_MIN_CHUNK_SIZE)
+        Chunk.resize(MSI_MIN_CHUNK_SIZE);
+    pbBufferBegin = pbBufferPtr = &Chunk[0];
+    pbBufferEnd = pbBufferBegin + Chunk.size();
+
+    // The first chunk begins with the UTF-8 marker and the header
+    if(Cursor.bHeaderDone == false)
+    {
+        if(AppendCsvHeader(pbBufferPtr + 3, NULL, Columns) > pbBufferEnd)
+            return ERROR_INSUFFICIENT_BUFFER;
+        pbBufferPtr = AppendUtf8Marker(pbBufferPtr, pbBufferEnd);
+        pbBufferPtr = AppendCsvHeader(pbBufferPtr, pbBufferEnd, Columns);
+        Cursor.bHeaderDone = true;
+    }
+
+    // Find out how many complete rows fit into the chunk
+    for(dwEndRow = Cursor.dwRow; dwEndRow < pTableData->RowCount(); dwEndRow++)
+    {
+        // If the row doesn't fit, flush the chunk first.
+        // A row that is bigger than the whole chunk enlarges it.
+        cbRowSize = MsiCsvRowLength(*pTableData, *pStringPool, dwEndRow);
+        if((size_t)(pbBufferEnd - pbBufferPtr) < (cbRows + cbRowSize))
+        {
+            if(pbBufferPtr > pbBufferBegin || dwEndRow > Cursor.dwRow)
+                break;
+            Chunk.resize(cbRowSize);
+            pbBufferBegin = pbBufferPtr = &Chunk[0];
+            pbBufferEnd = pbBufferBegin + Chunk.size();
+        }
+        cbRows += cbRowSize;
+    }
+
+    // Render the rows. A big chunk is rendered by multiple threads
+    if(dwEndRow > Cursor.dwRow)
+    {
+        MSI_CSV_JOB Job = {pTableData, Cursor.dwRow, dwEndRow - Cursor.dwRow, pbBufferPtr, (size_t)(pbBufferEnd - pbBufferPtr), 0};
+        DWORD dwErrCode;
+
+        if((dwErrCode = m_pMsiDb->CsvPool().Render(&Job, 1, *pStringPool)) != ERROR_SUCCESS)
+            return dwErrCode;
+        pbBufferPtr += (size_t)(Job.cbLength);
+        Cursor.dwRow = dwEndRow;
+    }
+
+    // Give the number of bytes to the caller
+    PtrBytesRead[0] = (DWORD)(pbBufferPtr - pbBufferBegin);
+    return ERROR_SUCCESS;
+}
+
+// Finds out where the data come from. Prefer the sources that can
+// be read by chunks; only the rest is loaded to memory as whole
+DWORD TMsiFile::OpenCursor(MSI_READ_CURSOR & Cursor)
+{
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    if(Cursor.Source == MsiReadNone)
+    {
+        // Let the database know that the extraction has begun
+        m_pMsiDb->FileStarted();
+
+        if(Detail().dwStreamEntry != CFB_NOSTREAM && m_pMsiDb->Prefetcher().Take(Detail().dwStreamEntry, Cursor.Data))
+            Cursor.Source = MsiReadPrefetched;
+        else if(OpenStream(Cursor.Stream) == ERROR_SUCCESS)
+            Cursor.Source = MsiReadStream;
+        else if(StartCabinetFile() == ERROR_SUCCESS)
+            Cursor.Source = MsiReadCabinet;
+        else if(IsNativeTableFile())
+            Cursor.Source = MsiReadTable;
+        else if(OpenRecordStream(&Cursor.hMsiRecord, &Cursor.nStreamField) == ERROR_SUCCESS)
+            Cursor.Source = MsiReadRecord;
+        else if((dwErrCode = LoadFileData()) == ERROR_SUCCESS)
+            Cursor.Source = MsiReadMemory;
+    }
+    return dwErrCode;
+}
+
+// Gives the next chunk of the file without copying it, if the data are already
+// in memory: in the mapped compound file, loaded ahead or loaded as whole.
+// The data stay valid while the file and the cursor exist. Returns
+// ERROR_NOT_SUPPORTED if the data must be read by ReadChunk.
+DWORD TMsiFile::MapChunk(MSI_READ_CURSOR & Cursor, DWORD cbMaxData, const BYTE ** PtrData, LPDWORD PtrBytesMapped)
+{
+    const BYTE * pbData = NULL;
+    DWORD cbMapped = 0;
+    DWORD dwErrCode;
+
+    // Find out where the data come from
+    if((dwErrCode = OpenCursor(Cursor)) != ERROR_SUCCESS)
+        return dwErrCode;
+
+    switch(Cursor.Source)
+    {
+        case MsiReadStream:
+            dwErrCode = m_pMsiDb->CompoundFile()->MapStream(Cursor.Stream, Cursor.ByteOffset, cbMaxData, &pbData, &cbMapped);
+            break;
+
+        case MsiReadMemory:
+            if(Cursor.ByteOffset < m_Data.cbData)
+            {
+                cbMapped = (DWORD)min(cbMaxData, m_Data.cbData - Cursor.ByteOffset);
+                pbData = m_Data.pbData + Cursor.ByteOffset;
+            }
+            break;
+
+        case MsiReadPrefetched:
+            if(Cursor.ByteOffset < Cursor.Data.size())
+            {
+                cbMapped = (DWORD)min(cbMaxData, Cursor.Data.size() - Cursor.ByteOffset);
+                pbData = &Cursor.Data[(size_t)(Cursor.ByteOffset)];
+            }
+            break;
+
+        default:
+            dwErrCode = ERROR_NOT_SUPPORTED;
+            break;
+    }
+
+    // Give the data to the caller
+    if(dwErrCode == ERROR_SUCCESS)
+    {
+        Cursor.ByteOffset += cbMapped;
+        PtrData[0] = pbData;
+        PtrBytesMapped[0] = cbMapped;
+    }
+    return dwErrCode;
+}
+
+DWORD TMsiFile::ReadChunk(MSI_READ_CURSOR & Cursor, std::vector<BYTE> & Chunk, LPDWORD PtrBytesRead)
+{
+    DWORD dwBytesRead = 0;
+    DWORD dwErrCode;
+
+    // On the first call, find out where the data come from
+    if((dwErrCode = OpenCursor(Cursor)) != ERROR_SUCCESS)
+        return dwErrCode;
+
+    // Make sure that the chunk has at least the minimal size
+    if(Chunk.size() < MSI_MIN_CHUNK_SIZE)
+        Chunk.resize(MSI_MIN_CHUNK_SIZE);
+
+    // Read the chunk
+    switch(Cursor.Source)
+    {
+        case MsiReadStream:
+            dwErrCode = m_pMsiDb->CompoundFile()->ReadStream(Cursor.Stream, Cursor.ByteOffset, &Chunk[0], (DWORD)(Chunk.size()), &dwBytesRead);
+            break;
+
+        case MsiReadTable:
+            dwErrCode = ReadCsvChunk(Cursor, Chunk, &dwBytesRead);
+            break;
+
+        case MsiReadRecord:
+            dwBytesRead = (DWORD)(Chunk.size());
+            m_pMsiDb->LockMsiHandles();
+            dwErrCode = MsiRecordReadStream(Cursor.hMsiRecord, Cursor.nStreamField, (char *)(&Chunk[0]), &dwBytesRead);
+            m_pMsiDb->UnlockMsiHandles();
+            break;
+
+        case MsiReadCabinet:
+            if(Cursor.ByteOffset < Detail().pCabPool->Cabinet()->File(Detail().dwCabFile).FileSize)
+            {
+                const CAB_FILE & CabFile = Detail().pCabPool->Cabinet()->File(Detail().dwCabFile);
+
+                dwBytesRead = (DWORD)min(Chunk.size(), CabFile.FileSize - Cursor.ByteOffset);
+                dwErrCode = Detail().pCabPool->Read(CabFile.Folder, CabFile.FolderOffset + Cursor.ByteOffset, &Chunk[0], dwBytesRead, &dwBytesRead);
+            }
+            break;
+
+        case MsiReadMemory:
+            if(Cursor.ByteOffset < m_Data.cbData)
+            {
+                dwBytesRead = (DWORD)min(Chunk.size(), m_Data.cbData - Cursor.ByteOffset);
+                memcpy(&Chunk[0], m_Data.pbData + Cursor.ByteOffset, dwBytesRead);
+            }
+            break;
+
+        case MsiReadPrefetched:
+            if(Cursor.ByteOffset < Cursor.Data.size())
+            {
+                dwBytesRead = (DWORD)min(Chunk.size(), Cursor.Data.size() - Cursor.ByteOffset);
+                memcpy(&Chunk[0], &Cursor.Data[(size_t)(Cursor.ByteOffset)], dwBytesRead);
+            }
+            break;
+
+        default:
+            dwErrCode = ERROR_NOT_SUPPORTED;
+            assert(false);
+            break;
+    }
+
+    // Give the number of bytes to the caller
+    if(dwErrCode == ERROR_SUCCESS)
+    {
+        Cursor.ByteOffset += dwBytesRead;
+        PtrBytesRead[0] = dwBytesRead;
+    }
+    return dwErrCode;
+}
+
+DWORD TMsiFile::LoadFileInternal(PULONGLONG PtrFileSize)
 {
+    ULONGLONG FileSize = 0;
     DWORD dwFileSize = 0;
     DWORD dwErrCode = ERROR_NOT_SUPPORTED;
 
-    // Is there a referenced file?
-    if(m_pRefFile != NULL)
-        return m_pRefFile->LoadFileInternal(PtrFileSize);
-
     // File-type-specific
-    switch(m_FileType)
+    switch(Detail().FileType)
     {
         case MsiFileSummary:
+            m_pMsiDb->LockMsiHandles();
             dwErrCode = LoadSummaryFile(&dwFileSize);
+            m_pMsiDb->UnlockMsiHandles();
             break;
 
         case MsiFileBinary:
+            if(Detail().dwStreamEntry != CFB_NOSTREAM)
+                return LoadStreamFileInternal(PtrFileSize);
+            m_pMsiDb->LockMsiHandles();
             dwErrCode = LoadBinaryFile(&dwFileSize);
+            m_pMsiDb->UnlockMsiHandles();
             break;
 
+        case MsiFileStream:
+            return LoadStreamFileInternal(PtrFileSize);
+
         case MsiFileTable:
             dwErrCode = LoadCsvFile(&dwFileSize);
             break;
 
+        case MsiFileCabinet:
+            dwErrCode = LoadCabinetFile(&dwFileSize);
+            break;
+
         default:
             dwErrCode = ERROR_NOT_SUPPORTED;
             assert(false);
@@ -458,82 +796,163 @@ DWORD TMsiFile::LoadFileInternal(LPDWORD PtrFileSize)
     // Give the file size to the caller
     if(dwErrCode == ERROR_SUCCESS)
     {
-        if(PtrFileSize != NULL)
-            PtrFileSize[0] = dwFileSize;
-        else
-            m_dwFileSize = dwFileSize;
+        FileSize = dwFileSize;
+        StoreFileSize(PtrFileSize, FileSize);
     }
     return dwErrCode;
 }
 
+DWORD TMsiFile::LoadStreamFileInternal(PULONGLONG PtrFileSize)
+{
+    ULONGLONG FileSize = 0;
+    DWORD dwErrCode;
+
+    // Streams are the only files that can have more than 4 GB
+    if((dwErrCode = LoadStreamFile(&FileSize)) == ERROR_SUCCESS)
+        StoreFileSize(PtrFileSize, FileSize);
+    return dwErrCode;
+}
+
+void TMsiFile::StoreFileSize(PULONGLONG PtrFileSize, ULONGLONG FileSize)
+{
+    if(PtrFileSize != NULL)
+        PtrFileSize[0] = FileSize;
+    else
+        Entry().FileSize = FileSize;
+}
+
 DWORD TMsiFile::LoadFileData()
 {
+    ULONGLONG FileSize = 0;
     DWORD dwErrCode = ERROR_SUCCESS;
 
-    // Is there a referenced file?
-    if(m_pRefFile != NULL)
-        return m_pRefFile->LoadFileData();
+    // Files over 4 GB can only be extracted by chunks
+    if(Entry().FileSize > MSI_MAX_BLOB_SIZE)
+        return ERROR_FILE_TOO_LARGE;
+
+    // The same file may be read by more threads at once
+    EnterCriticalSection(&m_DataLock);
 
     // Are the data already there?
-    if(m_Data.cbData < m_dwFileSize)
+    if(m_Data.cbData < Entry().FileSize)
     {
-        if((dwErrCode = m_Data.Reserve(m_dwFileSize)) == ERROR_SUCCESS)
+        if((dwErrCode = m_Data.Reserve((DWORD)(Entry().FileSize))) == ERROR_SUCCESS)
         {
-            dwErrCode = LoadFileInternal(&m_Data.cbData);
+            if((dwErrCode = LoadFileInternal(&FileSize)) == ERROR_SUCCESS)
+            {
+                m_Data.cbData = (DWORD)(FileSize);
+            }
         }
     }
+
+    LeaveCriticalSection(&m_DataLock);
     return dwErrCode;
 }
 
-void TMsiFile::MakeItemNameFileSafe(std::tstring & strItemName)
+DWORD TMsiFile::OpenRecordStream(MSIHANDLE * PtrMsiRecord, UINT * PtrStreamField)
 {
-    for(size_t i = 0; i < strItemName.size(); i++)
-    {
-        if(0 <= strItemName[i] && strItemName[i] < 0x20)
-        {
-            strItemName[i] = _T('_');
-        }
-    }
+    MSIHANDLE hMsiRecord;
+
+    // Only binary files that can be fetched again by their primary key.
+    // The record must be a fresh one, because reading moves its stream position.
+    if(Detail().FileType != MsiFileBinary || Detail().KeyCount == 0)
+        return ERROR_NOT_SUPPORTED;
+    m_pMsiDb->LockMsiHandles();
+    hMsiRecord = m_pMsiDb->FetchFileRecord(m_pSnapshot, m_dwDataFile);
+    m_pMsiDb->UnlockMsiHandles();
+    if(hMsiRecord == NULL)
+        return ERROR_FILE_NOT_FOUND;
+
+    // Give the record to the caller
+    PtrMsiRecord[0] = hMsiRecord;
+    PtrStreamField[0] = (UINT)(Table()->m_nStreamColumn + 1);
+    return ERROR_SUCCESS;
+}
+
+DWORD TMsiFile::OpenStream(CFB_STREAM & Stream)
+{
+    TCompoundFile * pCompFile;
+
+    // Only files that are stored in the compound file
+    if(Detail().dwStreamEntry == CFB_NOSTREAM)
+        return ERROR_NOT_SUPPORTED;
+    if((pCompFile = m_pMsiDb->CompoundFile()) == NULL)
+        return ERROR_NOT_SUPPORTED;
+
+    return pCompFile->OpenStream(Detail().dwStreamEntry, Stream);
+}
+
+DWORD TMsiFile::StartCabinetFile()
+{
+    // Only files in embedded cabinets
+    if(Detail().FileType != MsiFileCabinet || Detail().pCabPool == NULL)
+        return ERROR_NOT_SUPPORTED;
+
+    // Let the pool know that another file is being extracted.
+    // On bulk extraction, it starts decompressing the next folders ahead.
+    Detail().pCabPool->FileStarted();
+    return ERROR_SUCCESS;
 }
 
 const MSI_BLOB & TMsiFile::FileData()
 {
-    return m_pRefFile ? m_pRefFile->FileData() : m_Data;
+    return m_Data;
 }
 
-DWORD TMsiFile::FileSize()
+ULONGLONG TMsiFile::FileSize()
 {
-    return m_pRefFile ? m_pRefFile->FileSize() : m_dwFileSize;
+    return Entry().FileSize;
 }
 
 LPCTSTR TMsiFile::Name()
 {
-    return m_strName.c_str();
+    return m_pSnapshot->m_Files.Name(m_dwFile);
+}
+
+MSI_FILE_ENTRY & TMsiFile::Entry()
+{
+    return m_pSnapshot->m_Files.Entry(m_dwDataFile);
+}
+
+MSI_FILE_DETAIL & TMsiFile::Detail()
+{
+    return m_pSnapshot->m_Files.Detail(m_dwDataFile);
 }
 
-DWORD TMsiFile::SetUniqueFileName(TMsiDatabase * pMsiDb, LPCTSTR szFolderName, LPCTSTR szBaseName, LPCTSTR szExtension)
+TMsiTable * TMsiFile::Table()
 {
-    LPTSTR szFileNameEnd;
-    LPTSTR szFileNamePtr;
-    TCHAR szFileName[MAX_PATH];
-    DWORD dwNameIndex = 1;
+    return Detail().pMsiTable;
+}
 
-    // Setup the range
-    szFileNameEnd = szFileName + _countof(szFileName);
-    szFileNamePtr = szFileName;
+DWORD TMsiFile::FindRecordStream(TMsiDatabase * pMsiDb, MSIHANDLE hMsiRecord)
+{
+    TMsiTable * pMsiTable = Table();
+    const std::vector<TMsiColumn> & Columns = pMsiTable->Columns();
+    TCompoundFile * pCompFile = pMsiDb->CompoundFile();
+    std::tstring strStreamName(pMsiTable->Name());
+    std::tstring strValue;
+    CFB_NAME strEncoded;
 
-    // If we have directory, append it first
-    if(szFolderName && szFolderName[0])
+    // We need the compound file and the primary key
+    if(pCompFile == NULL || pMsiTable->m_KeyColumns.size() == 0)
+        return ERROR_NOT_SUPPORTED;
+
+    // The stream name is "Table.Key1.Key2..."
+    for(size_t i = 0; i < pMsiTable->m_KeyColumns.size(); i++)
     {
-        StringCchPrintfEx(szFileNamePtr, (szFileNameEnd - szFileNamePtr), &szFileNamePtr, NULL, 0, _T("%s\\"), szFolderName);
-    }
+        size_t nColumn = pMsiTable->m_KeyColumns[i];
 
-    // Construct the file name without numeric prefix
-    StringCchPrintf(szFileNamePtr, (szFileNameEnd - szFileNamePtr), _T("%s%s"), szBaseName, szExtension);
-    while(pMsiDb->IsFilePresent(szFileName))
-        StringCchPrintf(szFileName, _countof(szFileName), _T("%s_%03u%s"), szBaseName, dwNameIndex++, szExtension);
+        if(Columns[nColumn].m_Type == MsiTypeInteger)
+            MsiRecordGetInteger(hMsiRecord, (UINT)(nColumn), strValue);
+        else
+            MsiRecordGetString(hMsiRecord, (UINT)(nColumn), strValue);
 
-    // Assign the file name to the string
-    m_strName.assign(szFileName);
-    return ERROR_SUCCESS;
+        strStreamName.append(1, _T('.'));
+        strStreamName.append(strValue.c_str());
+    }
+
+    // Find the stream in the root storage
+    MsiEncodeStreamName(strStreamName, false, strEncoded);
+    Detail().dwStreamEntry = pCompFile->FindEntry(CFB_ROOT_ENTRY, strEncoded);
+    return (Detail().dwStreamEntry != CFB_NOSTREAM) ? ERROR_SUCCESS : ERROR_FILE_NOT_FOUND;
 }
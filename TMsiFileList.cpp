@@ -0,0 +1,429 @@
+/*****************************************************************************/
+/* TMsiFileList.cpp                       Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Flat list of the files of the database                                    */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 16.10.26  1.00  Lad  Created                                              */
+/*****************************************************************************/
+
+#include "wcx_msi.h"
+
+//-----------------------------------------------------------------------------
+// Local functions
+
+// Lowercases the name for the case-insensitive index, the same way as TMsiListing
+// compares the names. Names of the files are never longer than MAX_PATH,
+// because that's how they are created.
+static size_t FoldFileName(LPCTSTR szFileName, TCHAR (&szFoldedName)[MAX_PATH])
+{
+    size_t ccFoldedName = 0;
+
+    StringCchCopy(szFoldedName, _countof(szFoldedName), szFileName);
+    StringCchLength(szFoldedName, _countof(szFoldedName), &ccFoldedName);
+    for(size_t i = 0; i < ccFoldedName; i++)
+        szFoldedName[i] = MsiLowerChar(szFoldedName[i]);
+    return ccFoldedName;
+}
+
+// FNV-1a hash of the lowercased name
+static DWORD HashFileName(LPCTSTR szFoldedName, size_t ccFoldedName)
+{
+    DWORD dwHash = 0x811C9DC5;
+
+    for(size_t i = 0; i < ccFoldedName; i++)
+        dwHash = (dwHash ^ (DWORD)(szFoldedName[i])) * 0x01000193;
+    return dwHash;
+}
+
+// 64-bit FNV-1a, used for the name of the cache file
+static ULONGLONG HashBytes64(const void * pvData, size_t cbData, ULONGLONG Hash = 0xCBF29CE484222325ULL)
+{
+    const BYTE * pbData = (const BYTE *)(pvData);
+
+    for(size_t i = 0; i < cbData; i++)
+        Hash = (Hash ^ pbData[i]) * 0x00000100000001B3ULL;
+    return Hash;
+}
+
+static DWORD WriteCacheData(HANDLE hFile, const void * pvData, size_t cbData)
+{
+    DWORD dwBytesWritten = 0;
+
+    // Empty arrays have nothing to write
+    if(cbData != 0)
+    {
+        if(!WriteFile(hFile, pvData, (DWORD)(cbData), &dwBytesWritten, NULL))
+            return GetLastError();
+        if(dwBytesWritten != cbData)
+            return ERROR_HANDLE_DISK_FULL;
+    }
+    return ERROR_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// Constructor and destructor
+
+TMsiFileList::TMsiFileList()
+{}
+
+TMsiFileList::~TMsiFileList()
+{
+    Clear();
+}
+
+//-----------------------------------------------------------------------------
+// Public functions
+
+DWORD TMsiFileList::NewFile(TMsiTable * pMsiTable)
+{
+    MSI_FILE_ENTRY Entry = {0};
+    MSI_FILE_DETAIL Detail = {0};
+
+    // The file has no name yet, so it is not in the index
+    Entry.RefFile = MSI_NO_FILE;
+    Detail.pMsiTable = pMsiTable;
+    Detail.FileType = MsiFileNone;
+    Detail.dwStreamEntry = CFB_NOSTREAM;
+
+    m_Entries.push_back(Entry);
+    m_Details.push_back(Detail);
+    return (DWORD)(m_Entries.size() - 1);
+}
+
+void TMsiFileList::RemoveLastFile()
+{
+    // Only a file that has not been named yet can be removed
+    assert(m_Entries.size() != 0 && m_Entries.back().NameLength == 0);
+    m_Entries.pop_back();
+    m_Details.pop_back();
+}
+
+void TMsiFileList::SetName(DWORD dwFile, LPCTSTR szFileName)
+{
+    MSI_FILE_ENTRY & Entry = m_Entries[dwFile];
+    TCHAR szFoldedName[MAX_PATH];
+    size_t ccFoldedName;
+
+    // Store the name and the lowercased name right after it
+    ccFoldedName = FoldFileName(szFileName, szFoldedName);
+    Entry.NameOffset = AppendString(szFileName, ccFoldedName);
+    Entry.NameLength = (DWORD)(ccFoldedName);
+    Entry.NameHash = HashFileName(szFoldedName, ccFoldedName);
+    AppendString(szFoldedName, ccFoldedName);
+
+    // Insert the file to the name index
+    InsertToIndex(dwFile);
+}
+
+void TMsiFileList::SetRefFile(DWORD dwFile, DWORD dwRefFile)
+{
+    // Always refer to the file that has the data
+    if(m_Entries[dwRefFile].RefFile != MSI_NO_FILE)
+        dwRefFile = m_Entries[dwRefFile].RefFile;
+    m_Entries[dwFile].RefFile = dwRefFile;
+}
+
+void TMsiFileList::AddKeyValue(DWORD dwFile, LPCTSTR szValue)
+{
+    MSI_FILE_DETAIL & Detail = m_Details[dwFile];
+    DWORD dwOffset = AppendString(szValue, _tcslen(szValue));
+
+    // The values of one file follow each other
+    if(Detail.KeyCount++ == 0)
+        Detail.KeyOffset = dwOffset;
+}
+
+LPCTSTR TMsiFileList::KeyValue(DWORD dwFile, size_t nIndex)
+{
+    LPCTSTR szValue = &m_Arena[m_Details[dwFile].KeyOffset];
+
+    // Skip the preceding values
+    assert(nIndex < m_Details[dwFile].KeyCount);
+    while(nIndex-- > 0)
+        szValue = szValue + _tcslen(szValue) + 1;
+    return szValue;
+}
+
+DWORD TMsiFileList::Find(LPCTSTR szFileName)
+{
+    TCHAR szFoldedName[MAX_PATH];
+    size_t ccFoldedName;
+    size_t nMask = m_Index.size() - 1;
+    size_t nSlot;
+
+    // Is the index empty?
+    if(m_Index.size() == 0)
+        return MSI_NO_FILE;
+    ccFoldedName = FoldFileName(szFileName, szFoldedName);
+
+    // Walk the slots until we find the name or an empty slot
+    for(nSlot = HashFileName(szFoldedName, ccFoldedName) & nMask; m_Index[nSlot] != MSI_NO_FILE; nSlot = (nSlot + 1) & nMask)
+    {
+        const MSI_FILE_ENTRY & Entry = m_Entries[m_Index[nSlot]];
+        LPCTSTR szEntryName = &m_Arena[Entry.NameOffset + Entry.NameLength + 1];
+
+        if(Entry.NameLength == ccFoldedName && !memcmp(szEntryName, szFoldedName, ccFoldedName * sizeof(TCHAR)))
+        {
+            return m_Index[nSlot];
+        }
+    }
+    return MSI_NO_FILE;
+}
+
+void TMsiFileList::Clear()
+{
+    // Close the handles that the files keep
+    for(size_t i = 0; i < m_Details.size(); i++)
+    {
+        if(m_Details[i].hMsiHandle != NULL)
+            MSI_CLOSE_HANDLE(m_Details[i].hMsiHandle);
+        m_Details[i].hMsiHandle = NULL;
+    }
+
+    // Free all memory at once
+    std::vector<MSI_FILE_ENTRY>().swap(m_Entries);
+    std::vector<MSI_FILE_DETAIL>().swap(m_Details);
+    std::vector<TCHAR>().swap(m_Arena);
+    std::vector<DWORD>().swap(m_Index);
+}
+
+void TMsiFileList::CopyListing(const TMsiFileList & Source)
+{
+    // Only an empty list can be restored
+    assert(m_Entries.size() == 0);
+
+    // The hot parts, the index and the names are copied as they are
+    m_Entries = Source.m_Entries;
+    m_Index = Source.m_Index;
+    m_Arena = Source.m_Arena;
+
+    // From the cold parts, only the stream locations are copied.
+    // Everything else belongs to the database that loaded the files.
+    m_Details.resize(Source.m_Details.size());
+    for(size_t i = 0; i < m_Details.size(); i++)
+    {
+        memset(&m_Details[i], 0, sizeof(MSI_FILE_DETAIL));
+        m_Details[i].FileType = Source.m_Details[i].FileType;
+        m_Details[i].dwStreamEntry = Source.m_Details[i].dwStreamEntry;
+    }
+}
+
+size_t TMsiFileList::MemorySize() const
+{
+    return m_Entries.capacity() * sizeof(MSI_FILE_ENTRY) +
+           m_Details.capacity() * sizeof(MSI_FILE_DETAIL) +
+           m_Arena.capacity() * sizeof(TCHAR) +
+           m_Index.capacity() * sizeof(DWORD);
+}
+
+// The cached stream entries must exist in the compound file, which has dwEntryCount entries
+DWORD TMsiFileList::LoadFromCache(LPCTSTR szCacheFile, const MSI_CACHE_KEY & CacheKey, DWORD dwEntryCount)
+{
+    LARGE_INTEGER FileSize = {0};
+    HANDLE hFileMap;
+    HANDLE hFile;
+    LPBYTE pbCache;
+    DWORD dwErrCode = ERROR_FILE_CORRUPT;
+
+    // Only an empty list can be restored
+    assert(m_Entries.size() == 0);
+
+    // Open the cache file
+    hFile = CreateFile(szCacheFile, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(hFile == INVALID_HANDLE_VALUE)
+        return GetLastError();
+
+    // Map the whole cache to memory. The arrays are copied out as whole blocks
+    if(GetFileSizeEx(hFile, &FileSize) && (ULONGLONG)(FileSize.QuadPart) >= sizeof(MSI_CACHE_HEADER) && (ULONGLONG)(FileSize.QuadPart) <= (size_t)(-1))
+    {
+        if((hFileMap = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL)) != NULL)
+        {
+            if((pbCache = (LPBYTE)MapViewOfFile(hFileMap, FILE_MAP_READ, 0, 0, 0)) != NULL)
+            {
+                dwErrCode = LoadCacheData(pbCache, (size_t)(FileSize.QuadPart), CacheKey, dwEntryCount);
+                UnmapViewOfFile(pbCache);
+            }
+            CloseHandle(hFileMap);
+        }
+    }
+    CloseHandle(hFile);
+
+    // Don't leave a half-loaded list behind
+    if(dwErrCode != ERROR_SUCCESS)
+        Clear();
+    return dwErrCode;
+}
+
+DWORD TMsiFileList::SaveToCache(LPCTSTR szCacheFile, const MSI_CACHE_KEY & CacheKey)
+{
+    std::vector<MSI_CACHE_FILE> CacheFiles(m_Details.size());
+    MSI_CACHE_HEADER Header = {0};
+    HANDLE hFile;
+    TCHAR szTempFile[MAX_PATH];
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    // Prepare the header
+    Header.Signature = MSI_CACHE_SIGNATURE;
+    Header.Version = MSI_CACHE_VERSION;
+    Header.CharSize = sizeof(TCHAR);
+    Header.FileCount = (DWORD)(m_Entries.size());
+    Header.CacheKey = CacheKey;
+    Header.IndexSize = (DWORD)(m_Index.size());
+    Header.ArenaLength = (DWORD)(m_Arena.size());
+
+    // From the cold parts, only the stream locations are stored.
+    // Everything else needs the tables and is loaded when needed.
+    for(size_t i = 0; i < m_Details.size(); i++)
+    {
+        CacheFiles[i].FileType = m_Details[i].FileType;
+        CacheFiles[i].dwStreamEntry = m_Details[i].dwStreamEntry;
+    }
+
+    // Write to a temporary file first, so that nobody sees a half-written cache
+    StringCchPrintf(szTempFile, _countof(szTempFile), _T("%s.tmp"), szCacheFile);
+    hFile = CreateFile(szTempFile, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(hFile == INVALID_HANDLE_VALUE)
+        return GetLastError();
+
+    if(dwErrCode == ERROR_SUCCESS)
+        dwErrCode = WriteCacheData(hFile, &Header, sizeof(MSI_CACHE_HEADER));
+    if(dwErrCode == ERROR_SUCCESS && m_Entries.size())
+        dwErrCode = WriteCacheData(hFile, &m_Entries[0], m_Entries.size() * sizeof(MSI_FILE_ENTRY));
+    if(dwErrCode == ERROR_SUCCESS && CacheFiles.size())
+        dwErrCode = WriteCacheData(hFile, &CacheFiles[0], CacheFiles.size() * sizeof(MSI_CACHE_FILE));
+    if(dwErrCode == ERROR_SUCCESS && m_Index.size())
+        dwErrCode = WriteCacheData(hFile, &m_Index[0], m_Index.size() * sizeof(DWORD));
+    if(dwErrCode == ERROR_SUCCESS && m_Arena.size())
+        dwErrCode = WriteCacheData(hFile, &m_Arena[0], m_Arena.size() * sizeof(TCHAR));
+    CloseHandle(hFile);
+
+    // Replace the previous cache file
+    if(dwErrCode == ERROR_SUCCESS && !MoveFileEx(szTempFile, szCacheFile, MOVEFILE_REPLACE_EXISTING))
+        dwErrCode = GetLastError();
+    if(dwErrCode != ERROR_SUCCESS)
+        DeleteFile(szTempFile);
+    return dwErrCode;
+}
+
+//-----------------------------------------------------------------------------
+// Protected functions
+
+DWORD TMsiFileList::AppendString(LPCTSTR szString, size_t ccString)
+{
+    DWORD dwOffset = (DWORD)(m_Arena.size());
+
+    // Append the string with its terminating zero
+    m_Arena.insert(m_Arena.end(), szString, szString + ccString);
+    m_Arena.push_back(0);
+    return dwOffset;
+}
+
+void TMsiFileList::InsertToIndex(DWORD dwFile)
+{
+    size_t nIndexSize = m_Index.size();
+    size_t nMask;
+    size_t nSlot;
+
+    // Keep the index at most half full. On growth, all named files are inserted again
+    if((m_Entries.size() * 2) > nIndexSize)
+    {
+        nIndexSize = (nIndexSize != 0) ? nIndexSize : 0x400;
+        while(nIndexSize < (m_Entries.size() * 2))
+            nIndexSize *= 2;
+        m_Index.assign(nIndexSize, MSI_NO_FILE);
+        nMask = nIndexSize - 1;
+
+        for(DWORD i = 0; i < (DWORD)(m_Entries.size()); i++)
+        {
+            if(i != dwFile && m_Entries[i].NameLength != 0)
+            {
+                for(nSlot = m_Entries[i].NameHash & nMask; m_Index[nSlot] != MSI_NO_FILE; nSlot = (nSlot + 1) & nMask);
+                m_Index[nSlot] = i;
+            }
+        }
+    }
+
+    // Insert the file to the first empty slot
+    nMask = m_Index.size() - 1;
+    for(nSlot = m_Entries[dwFile].NameHash & nMask; m_Index[nSlot] != MSI_NO_FILE; nSlot = (nSlot + 1) & nMask);
+    m_Index[nSlot] = dwFile;
+}
+
+DWORD TMsiFileList::LoadCacheData(LPBYTE pbCache, size_t cbCache, const MSI_CACHE_KEY & CacheKey, DWORD dwEntryCount)
+{
+    MSI_CACHE_ARRAYS Arrays;
+    DWORD dwFileCount;
+    DWORD dwErrCode;
+
+    // Verify that nothing points outside the arrays
+    if((dwErrCode = MsiCacheCheckData(pbCache, cbCache, CacheKey, MsiFileTypeCount, dwEntryCount, Arrays)) != ERROR_SUCCESS)
+        return dwErrCode;
+    dwFileCount = Arrays.pHeader->FileCount;
+
+    // Copy the arrays. The cold parts that are not in the cache stay empty
+    m_Entries.assign(Arrays.pEntries, Arrays.pEntries + dwFileCount);
+    m_Details.resize(dwFileCount);
+    for(DWORD i = 0; i < dwFileCount; i++)
+    {
+        memset(&m_Details[i], 0, sizeof(MSI_FILE_DETAIL));
+        m_Details[i].FileType = (MSI_FILE_TYPE)(Arrays.pCacheFiles[i].FileType);
+        m_Details[i].dwStreamEntry = Arrays.pCacheFiles[i].dwStreamEntry;
+    }
+    m_Index.assign(Arrays.pIndex, Arrays.pIndex + Arrays.pHeader->IndexSize);
+    m_Arena.assign(Arrays.pArena, Arrays.pArena + Arrays.pHeader->ArenaLength);
+    return ERROR_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// Listing cache
+
+// Creates the identity of the archive
+DWORD MsiCacheMakeKey(LPCTSTR szArchiveName, const WIN32_FIND_DATA & wf, TCompoundFile * pCompFile, MSI_CACHE_KEY & CacheKey)
+{
+    const CFB_HEADER & Header = pCompFile->Header();
+    ULONGLONG HeaderHash;
+    TCHAR szFullPath[MAX_PATH];
+    DWORD ccFullPath;
+
+    // The same archive may be opened by different relative names
+    ccFullPath = GetFullPathName(szArchiveName, _countof(szFullPath), szFullPath, NULL);
+    if(ccFullPath == 0 || ccFullPath >= _countof(szFullPath))
+        return ERROR_INVALID_PARAMETER;
+    CharLowerBuff(szFullPath, ccFullPath);
+
+    // The header hash covers the compound file header and the sizes of all streams.
+    // Both are already loaded, so it costs no extra reading
+    HeaderHash = HashBytes64(&Header, sizeof(CFB_HEADER));
+    for(DWORD dwEntry = 0; dwEntry < pCompFile->EntryCount(); dwEntry++)
+    {
+        const CFB_ENTRY & CfbEntry = pCompFile->Entry(dwEntry);
+
+        HeaderHash = HashBytes64(CfbEntry.Name.c_str(), CfbEntry.Name.size() * sizeof(WCHAR), HeaderHash);
+        HeaderHash = HashBytes64(&CfbEntry.Size, sizeof(ULONGLONG), HeaderHash);
+    }
+
+    // Fill the key
+    memset(&CacheKey, 0, sizeof(MSI_CACHE_KEY));
+    CacheKey.ArchiveSize = ((ULONGLONG)(wf.nFileSizeHigh) << 32) | wf.nFileSizeLow;
+    CacheKey.LastWriteTime = wf.ftLastWriteTime;
+    CacheKey.PathHash = HashBytes64(szFullPath, ccFullPath * sizeof(TCHAR));
+    CacheKey.HeaderHash = (DWORD)(HeaderHash ^ (HeaderHash >> 32));
+    return ERROR_SUCCESS;
+}
+
+// Creates the name of the cache file of the archive
+DWORD MsiCacheFileName(LPCTSTR szCacheDir, const MSI_CACHE_KEY & CacheKey, std::tstring & strCacheFile)
+{
+    TCHAR szCacheFile[MAX_PATH];
+
+    // Make sure that the cache directory exists
+    if(!CreateDirectory(szCacheDir, NULL) && GetLastError() != ERROR_ALREADY_EXISTS)
+        return GetLastError();
+
+    // One cache file per archive path
+    StringCchPrintf(szCacheFile, _countof(szCacheFile), _T("%s\\%08X%08X.lst"), szCacheDir, (DWORD)(CacheKey.PathHash >> 32), (DWORD)(CacheKey.PathHash));
+    strCacheFile = szCacheFile;
+    return ERROR_SUCCESS;
+}
@@ -0,0 +1,234 @@
+/*****************************************************************************/
+/* TMsiLayout.cpp                         Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Installed layout of the product, joined from File/Component/Directory     */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 16.10.26  1.00  Lad  Created                                              */
+/*****************************************************************************/
+
+#include "wcx_msi.h"
+
+//-----------------------------------------------------------------------------
+// Local variables
+
+// Directories that Windows Installer redirects to system locations. Directly
+// under the root, these are shown by their name rather than by their DefaultDir
+static const WCHAR * SystemFolders[] =
+{
+    MSI_WSTR("AdminToolsFolder"),
+    MSI_WSTR("AppDataFolder"),
+    MSI_WSTR("CommonAppDataFolder"),
+    MSI_WSTR("CommonFiles64Folder"),
+    MSI_WSTR("CommonFilesFolder"),
+    MSI_WSTR("DesktopFolder"),
+    MSI_WSTR("FavoritesFolder"),
+    MSI_WSTR("FontsFolder"),
+    MSI_WSTR("LocalAppDataFolder"),
+    MSI_WSTR("MyPicturesFolder"),
+    MSI_WSTR("NetHoodFolder"),
+    MSI_WSTR("PersonalFolder"),
+    MSI_WSTR("PrintHoodFolder"),
+    MSI_WSTR("ProgramFiles64Folder"),
+    MSI_WSTR("ProgramFilesFolder"),
+    MSI_WSTR("ProgramMenuFolder"),
+    MSI_WSTR("RecentFolder"),
+    MSI_WSTR("SendToFolder"),
+    MSI_WSTR("StartMenuFolder"),
+    MSI_WSTR("StartupFolder"),
+    MSI_WSTR("System16Folder"),
+    MSI_WSTR("System64Folder"),
+    MSI_WSTR("SystemFolder"),
+    MSI_WSTR("TempFolder"),
+    MSI_WSTR("TemplateFolder"),
+    MSI_WSTR("WindowsFolder"),
+    MSI_WSTR("WindowsVolume")
+};
+
+//-----------------------------------------------------------------------------
+// Local (non-class) functions
+
+static bool IsSystemFolder(LPCWSTR szName, size_t ccName)
+{
+    for(size_t i = 0; i < _countof(SystemFolders); i++)
+    {
+        if(std::char_traits<WCHAR>::length(SystemFolders[i]) == ccName && !memcmp(SystemFolders[i], szName, ccName * sizeof(WCHAR)))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Names in MSI are "short|long" or just "name". Returns the long one
+static void GetLongName(LPCWSTR & szName, size_t & ccName)
+{
+    for(size_t i = 0; i < ccName; i++)
+    {
+        if(szName[i] == '|')
+        {
+            szName = szName + i + 1;
+            ccName = ccName - i - 1;
+            break;
+        }
+    }
+}
+
+// DefaultDir is "target[:source]". Only the target part is used
+static void GetTargetName(LPCWSTR & szName, size_t & ccName)
+{
+    for(size_t i = 0; i < ccName; i++)
+    {
+        if(szName[i] == ':')
+        {
+            ccName = i;
+            break;
+        }
+    }
+    GetLongName(szName, ccName);
+}
+
+static void AppendPathPart(CFB_NAME & strPath, LPCWSTR szName, size_t ccName)
+{
+    if(strPath.size() != 0)
+        strPath.append(1, '\\');
+    strPath.append(szName, ccName);
+}
+
+//-----------------------------------------------------------------------------
+// TMsiLayout functions
+
+DWORD TMsiLayout::Build(
+    const TMsiStringPool & StringPool,
+    const TMsiTableData & Directory,
+    const TMsiTableData & Component,
+    const TMsiTableData & File,
+    const MSI_LAYOUT_COLUMNS & Columns)
+{
+    std::unordered_map<DWORD, DWORD> ComponentIndex;
+    LPCWSTR szName;
+    size_t ccName;
+
+    // Build the index of directories and resolve their paths
+    m_DirIndex.clear();
+    m_DirIndex.reserve(Directory.RowCount());
+    for(DWORD dwRow = 0; dwRow < Directory.RowCount(); dwRow++)
+        m_DirIndex[Directory.Cell(Columns.Directory, dwRow)] = dwRow;
+    ResolveDirectories(StringPool, Directory, Columns);
+
+    // Join the components with their directories
+    ComponentIndex.reserve(Component.RowCount());
+    for(DWORD dwRow = 0; dwRow < Component.RowCount(); dwRow++)
+    {
+        std::unordered_map<DWORD, DWORD>::iterator iter = m_DirIndex.find(Component.Cell(Columns.ComponentDirectory, dwRow));
+        DWORD dwDirRow = (iter != m_DirIndex.end()) ? iter->second : MSI_LAYOUT_NO_ROW;
+
+        ComponentIndex[Component.Cell(Columns.Component, dwRow)] = dwDirRow;
+    }
+
+    // Join the files with the directories of their components.
+    // Files with unknown component are placed into the root.
+    m_Files.resize(File.RowCount());
+    for(DWORD dwRow = 0; dwRow < File.RowCount(); dwRow++)
+    {
+        std::unordered_map<DWORD, DWORD>::iterator iter = ComponentIndex.find(File.Cell(Columns.FileComponent, dwRow));
+        MSI_LAYOUT_FILE & LayoutFile = m_Files[dwRow];
+
+        if(iter != ComponentIndex.end() && iter->second != MSI_LAYOUT_NO_ROW)
+            LayoutFile.Path = m_DirPaths[iter->second];
+
+        szName = StringPool.String(File.Cell(Columns.FileName, dwRow), ccName);
+        GetLongName(szName, ccName);
+        AppendPathPart(LayoutFile.Path, szName, ccName);
+
+        LayoutFile.FileKey = File.Cell(Columns.File, dwRow);
+        LayoutFile.FileSize = File.Cell(Columns.FileSize, dwRow);
+        if(LayoutFile.FileSize == MSI_NULL_INTEGER)
+            LayoutFile.FileSize = 0;
+    }
+    return ERROR_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// Protected functions
+
+void TMsiLayout::ResolveDirectories(const TMsiStringPool & StringPool, const TMsiTableData & Directory, const MSI_LAYOUT_COLUMNS & Columns)
+{
+    std::vector<DWORD> Chain;
+    std::vector<BYTE> Resolved(Directory.RowCount());
+    std::vector<BYTE> IsRoot(Directory.RowCount());
+    LPCWSTR szName;
+    size_t ccName;
+
+    m_DirPaths.assign(Directory.RowCount(), CFB_NAME());
+    for(DWORD dwRow = 0; dwRow < Directory.RowCount(); dwRow++)
+    {
+        DWORD dwParentRow = MSI_LAYOUT_NO_ROW;
+        DWORD dwDirRow = dwRow;
+
+        // Parents listed after their children are resolved with the children
+        if(Resolved[dwRow] == 2)
+            continue;
+
+        // Walk up to the first resolved parent (or to the root).
+        // Each directory is resolved only once, so this is linear.
+        Chain.clear();
+        while(dwDirRow != MSI_LAYOUT_NO_ROW && Resolved[dwDirRow] == 0)
+        {
+            DWORD dwParentKey = Directory.Cell(Columns.DirectoryParent, dwDirRow);
+            std::unordered_map<DWORD, DWORD>::iterator iter;
+
+            // Mark the directory as being resolved, so that cycles are detected
+            Resolved[dwDirRow] = 1;
+            Chain.push_back(dwDirRow);
+
+            // The root has no parent or is its own parent
+            if(dwParentKey == 0 || dwParentKey == Directory.Cell(Columns.Directory, dwDirRow))
+            {
+                IsRoot[dwDirRow] = 1;
+                break;
+            }
+
+            // Unknown parents are treated as the root
+            iter = m_DirIndex.find(dwParentKey);
+            dwDirRow = (iter != m_DirIndex.end()) ? iter->second : MSI_LAYOUT_NO_ROW;
+        }
+
+        // If the walk ended at an already resolved directory, that's the parent of the chain.
+        // A directory that is still being resolved means a cycle; it becomes the root then.
+        if(dwDirRow != MSI_LAYOUT_NO_ROW && Resolved[dwDirRow] == 2 && !IsRoot[Chain.back()])
+            dwParentRow = dwDirRow;
+
+        // Resolve the chain from the top
+        for(size_t i = Chain.size(); i > 0; i--)
+        {
+            DWORD dwChainRow = Chain[i - 1];
+
+            // The root itself has an empty path
+            if(IsRoot[dwChainRow] == 0)
+            {
+                // Start with the path of the parent
+                if(dwParentRow != MSI_LAYOUT_NO_ROW)
+                    m_DirPaths[dwChainRow] = m_DirPaths[dwParentRow];
+
+                // Redirected system folders are shown by their name
+                szName = StringPool.String(Directory.Cell(Columns.Directory, dwChainRow), ccName);
+                if(!(dwParentRow != MSI_LAYOUT_NO_ROW && IsRoot[dwParentRow] && IsSystemFolder(szName, ccName)))
+                {
+                    // A directory with DefaultDir "." is the same as its parent
+                    szName = StringPool.String(Directory.Cell(Columns.DefaultDir, dwChainRow), ccName);
+                    GetTargetName(szName, ccName);
+                    if(ccName == 1 && szName[0] == '.')
+                        ccName = 0;
+                }
+
+                if(ccName != 0)
+                    AppendPathPart(m_DirPaths[dwChainRow], szName, ccName);
+            }
+
+            Resolved[dwChainRow] = 2;
+            dwParentRow = dwChainRow;
+        }
+    }
+}
@@ -0,0 +1,842 @@
+/*****************************************************************************/
+/* TMsiListing.cpp                        Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Names of the files shown for an MSI file. Shared by the plugin and by     */
+/* the native archive, so that both show exactly the same tree               */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 16.10.26  1.00  Lad  Created                                              */
+/*****************************************************************************/
+
+#include "wcx_msi.h"
+#include <algorithm>
+
+//-----------------------------------------------------------------------------
+// Local structures
+
+// Characters First - Last (every Step-th one) are lowercased by adding Delta
+struct MSI_LOWER_RANGE
+{
+    WORD First;
+    WORD Last;
+    int  Delta;
+    int  Step;
+};
+
+//-----------------------------------------------------------------------------
+// Local variables
+
+// Simple lowercase mapping of the Basic Multilingual Plane, from the Unicode
+// character database. Only mappings to a single BMP character are included
+static const MSI_LOWER_RANGE LowerRanges[] =
+{
+    {0x0041, 0x005A,     32, 1},
+    {0x00C0, 0x00D6,     32, 1},
+    {0x00D8, 0x00DE,     32, 1},
+    {0x0100, 0x012E,      1, 2},
+    {0x0132, 0x0136,      1, 2},
+    {0x0139, 0x0147,      1, 2},
+    {0x014A, 0x0176,      1, 2},
+    {0x0178, 0x0178,   -121, 1},
+    {0x0179, 0x017D,      1, 2},
+    {0x0181, 0x0181,    210, 1},
+    {0x0182, 0x0184,      1, 2},
+    {0x0186, 0x0186,    206, 1},
+    {0x0187, 0x0187,      1, 1},
+    {0x0189, 0x018A,    205, 1},
+    {0x018B, 0x018B,      1, 1},
+    {0x018E, 0x018E,     79, 1},
+    {0x018F, 0x018F,    202, 1},
+    {0x0190, 0x0190,    203, 1},
+    {0x0191, 0x0191,      1, 1},
+    {0x0193, 0x0193,    205, 1},
+    {0x0194, 0x0194,    207, 1},
+    {0x0196, 0x0196,    211, 1},
+    {0x0197, 0x0197,    209, 1},
+    {0x0198, 0x0198,      1, 1},
+    {0x019C, 0x019C,    211, 1},
+    {0x019D, 0x019D,    213, 1},
+    {0x019F, 0x019F,    214, 1},
+    {0x01A0, 0x01A4,      1, 2},
+    {0x01A6, 0x01A6,    218, 1},
+    {0x01A7, 0x01A7,      1, 1},
+    {0x01A9, 0x01A9,    218, 1},
+    {0x01AC, 0x01AC,      1, 1},
+    {0x01AE, 0x01AE,    218, 1},
+    {0x01AF, 0x01AF,      1, 1},
+    {0x01B1, 0x01B2,    217, 1},
+    {0x01B3, 0x01B5,      1, 2},
+    {0x01B7, 0x01B7,    219, 1},
+    {0x01B8, 0x01B8,      1, 1},
+    {0x01BC, 0x01BC,      1, 1},
+    {0x01C4, 0x01C4,      2, 1},
+    {0x01C5, 0x01C5,      1, 1},
+    {0x01C7, 0x01C7,      2, 1},
+    {0x01C8, 0x01C8,      1, 1},
+    {0x01CA, 0x01CA,      2, 1},
+    {0x01CB, 0x01DB,      1, 2},
+    {0x01DE, 0x01EE,      1, 2},
+    {0x01F1, 0x01F1,      2, 1},
+    {0x01F2, 0x01F4,      1, 2},
+    {0x01F6, 0x01F6,    -97, 1},
+    {0x01F7, 0x01F7,    -56, 1},
+    {0x01F8, 0x021E,      1, 2},
+    {0x0220, 0x0220,   -130, 1},
+    {0x0222, 0x0232,      1, 2},
+    {0x023A, 0x023A,  10795, 1},
+    {0x023B, 0x023B,      1, 1},
+    {0x023D, 0x023D,   -163, 1},
+    {0x023E, 0x023E,  10792, 1},
+    {0x0241, 0x0241,      1, 1},
+    {0x0243, 0x0243,   -195, 1},
+    {0x0244, 0x0244,     69, 1},
+    {0x0245, 0x0245,     71, 1},
+    {0x0246, 0x024E,      1, 2},
+    {0x0370, 0x0372,      1, 2},
+    {0x0376, 0x0376,      1, 1},
+    {0x037F, 0x037F,    116, 1},
+    {0x0386, 0x0386,     38, 1},
+    {0x0388, 0x038A,     37, 1},
+    {0x038C, 0x038C,     64, 1},
+    {0x038E, 0x038F,     63, 1},
+    {0x0391, 0x03A1,     32, 1},
+    {0x03A3, 0x03AB,     32, 1},
+    {0x03CF, 0x03CF,      8, 1},
+    {0x03D8, 0x03EE,      1, 2},
+    {0x03F4, 0x03F4,    -60, 1},
+    {0x03F7, 0x03F7,      1, 1},
+    {0x03F9, 0x03F9,     -7, 1},
+    {0x03FA, 0x03FA,      1, 1},
+    {0x03FD, 0x03FF,   -130, 1},
+    {0x0400, 0x040F,     80, 1},
+    {0x0410, 0x042F,     32, 1},
+    {0x0460, 0x0480,      1, 2},
+    {0x048A, 0x04BE,      1, 2},
+    {0x04C0, 0x04C0,     15, 1},
+    {0x04C1, 0x04CD,      1, 2},
+    {0x04D0, 0x052E,      1, 2},
+    {0x0531, 0x0556,     48, 1},
+    {0x10A0, 0x10C5,   7264, 1},
+    {0x10C7, 0x10C7,   7264, 1},
+    {0x10CD, 0x10CD,   7264, 1},
+    {0x13A0, 0x13EF,  38864, 1},
+    {0x13F0, 0x13F5,      8, 1},
+    {0x1C90, 0x1CBA,  -3008, 1},
+    {0x1CBD, 0x1CBF,  -3008, 1},
+    {0x1E00, 0x1E94,      1, 2},
+    {0x1E9E, 0x1E9E,  -7615, 1},
+    {0x1EA0, 0x1EFE,      1, 2},
+    {0x1F08, 0x1F0F,     -8, 1},
+    {0x1F18, 0x1F1D,     -8, 1},
+    {0x1F28, 0x1F2F,     -8, 1},
+    {0x1F38, 0x1F3F,     -8, 1},
+    {0x1F48, 0x1F4D,     -8, 1},
+    {0x1F59, 0x1F5F,     -8, 2},
+    {0x1F68, 0x1F6F,     -8, 1},
+    {0x1F88, 0x1F8F,     -8, 1},
+    {0x1F98, 0x1F9F,     -8, 1},
+    {0x1FA8, 0x1FAF,     -8, 1},
+    {0x1FB8, 0x1FB9,     -8, 1},
+    {0x1FBA, 0x1FBB,    -74, 1},
+    {0x1FBC, 0x1FBC,     -9, 1},
+    {0x1FC8, 0x1FCB,    -86, 1},
+    {0x1FCC, 0x1FCC,     -9, 1},
+    {0x1FD8, 0x1FD9,     -8, 1},
+    {0x1FDA, 0x1FDB,   -100, 1},
+    {0x1FE8, 0x1FE9,     -8, 1},
+    {0x1FEA, 0x1FEB,   -112, 1},
+    {0x1FEC, 0x1FEC,     -7, 1},
+    {0x1FF8, 0x1FF9,   -128, 1},
+    {0x1FFA, 0x1FFB,   -126, 1},
+    {0x1FFC, 0x1FFC,     -9, 1},
+    {0x2126, 0x2126,  -7517, 1},
+    {0x212A, 0x212A,  -8383, 1},
+    {0x212B, 0x212B,  -8262, 1},
+    {0x2132, 0x2132,     28, 1},
+    {0x2160, 0x216F,     16, 1},
+    {0x2183, 0x2183,      1, 1},
+    {0x24B6, 0x24CF,     26, 1},
+    {0x2C00, 0x2C2F,     48, 1},
+    {0x2C60, 0x2C60,      1, 1},
+    {0x2C62, 0x2C62, -10743, 1},
+    {0x2C63, 0x2C63,  -3814, 1},
+    {0x2C64, 0x2C64, -10727, 1},
+    {0x2C67, 0x2C6B,      1, 2},
+    {0x2C6D, 0x2C6D, -10780, 1},
+    {0x2C6E, 0x2C6E, -10749, 1},
+    {0x2C6F, 0x2C6F, -10783, 1},
+    {0x2C70, 0x2C70, -10782, 1},
+    {0x2C72, 0x2C72,      1, 1},
+    {0x2C75, 0x2C75,      1, 1},
+    {0x2C7E, 0x2C7F, -10815, 1},
+    {0x2C80, 0x2CE2,      1, 2},
+    {0x2CEB, 0x2CED,      1, 2},
+    {0x2CF2, 0x2CF2,      1, 1},
+    {0xA640, 0xA66C,      1, 2},
+    {0xA680, 0xA69A,      1, 2},
+    {0xA722, 0xA72E,      1, 2},
+    {0xA732, 0xA76E,      1, 2},
+    {0xA779, 0xA77B,      1, 2},
+    {0xA77D, 0xA77D, -35332, 1},
+    {0xA77E, 0xA786,      1, 2},
+    {0xA78B, 0xA78B,      1, 1},
+    {0xA78D, 0xA78D, -42280, 1},
+    {0xA790, 0xA792,      1, 2},
+    {0xA796, 0xA7A8,      1, 2},
+    {0xA7AA, 0xA7AA, -42308, 1},
+    {0xA7AB, 0xA7AB, -42319, 1},
+    {0xA7AC, 0xA7AC, -42315, 1},
+    {0xA7AD, 0xA7AD, -42305, 1},
+    {0xA7AE, 0xA7AE, -42308, 1},
+    {0xA7B0, 0xA7B0, -42258, 1},
+    {0xA7B1, 0xA7B1, -42282, 1},
+    {0xA7B2, 0xA7B2, -42261, 1},
+    {0xA7B3, 0xA7B3,    928, 1},
+    {0xA7B4, 0xA7C2,      1, 2},
+    {0xA7C4, 0xA7C4,    -48, 1},
+    {0xA7C5, 0xA7C5, -42307, 1},
+    {0xA7C6, 0xA7C6, -35384, 1},
+    {0xA7C7, 0xA7C9,      1, 2},
+    {0xA7D0, 0xA7D0,      1, 1},
+    {0xA7D6, 0xA7D8,      1, 2},
+    {0xA7F5, 0xA7F5,      1, 1},
+    {0xFF21, 0xFF3A,     32, 1},
+};
+
+//-----------------------------------------------------------------------------
+// Local functions
+
+static bool IsSameName(const CFB_NAME & strName1, const CFB_NAME & strName2)
+{
+    if(strName1.size() != strName2.size())
+        return false;
+
+    for(size_t i = 0; i < strName1.size(); i++)
+    {
+        if(MsiLowerChar(strName1[i]) != MsiLowerChar(strName2[i]))
+            return false;
+    }
+    return true;
+}
+
+static void MakeItemNameFileSafe(CFB_NAME & strItemName)
+{
+    for(size_t i = 0; i < strItemName.size(); i++)
+    {
+        if(strItemName[i] < 0x20)
+        {
+            strItemName[i] = '_';
+        }
+    }
+}
+
+// Splits the name to the base name and the extension. The extension begins
+// with the last dot of the plain name, but never at the beginning of the name
+static void SplitItemName(const CFB_NAME & strName, CFB_NAME & strBaseName, CFB_NAME & strExtension)
+{
+    size_t nExtension = strName.size();
+
+    for(size_t i = 0; i < strName.size(); i++)
+    {
+        if(strName[i] == '\\' || strName[i] == '/')
+            nExtension = strName.size();
+        if(strName[i] == '.')
+            nExtension = i;
+    }
+
+    if(nExtension == 0)
+        nExtension = strName.size();
+    strBaseName.assign(strName, 0, nExtension);
+    strExtension.assign(strName, nExtension, CFB_NAME::npos);
+}
+
+static void AppendNameSuffix(CFB_NAME & strName, DWORD dwSuffix)
+{
+    char szSuffix[16];
+    int nLength;
+
+    nLength = snprintf(szSuffix, _countof(szSuffix), "_%03u", dwSuffix);
+    for(int i = 0; i < nLength; i++)
+        strName.append(1, (WCHAR)(szSuffix[i]));
+}
+
+// Builds "Folder\BaseName_NNN.ext". Too long names lose the end of the base name
+// (or of the folder), so that the suffix and the extension are always there
+static void BuildItemName(CFB_NAME & strName, const CFB_NAME & strFolderName, const CFB_NAME & strBaseName, const CFB_NAME & strExtension, DWORD dwSuffix)
+{
+    size_t nTailStart;
+    size_t ccExcess;
+
+    strName.assign(strFolderName);
+    if(strFolderName.size() != 0)
+        strName.append(1, '\\');
+    strName.append(strBaseName);
+    nTailStart = strName.size();
+
+    if(dwSuffix != 0)
+        AppendNameSuffix(strName, dwSuffix);
+    strName.append(strExtension);
+
+    if(strName.size() > MSI_MAX_ITEM_NAME)
+    {
+        ccExcess = std::min(strName.size() - MSI_MAX_ITEM_NAME, nTailStart);
+        strName.erase(nTailStart - ccExcess, ccExcess);
+    }
+}
+
+static bool CompareCabFileNames(const std::pair<std::string, DWORD> & CabFile1, const std::pair<std::string, DWORD> & CabFile2)
+{
+    return (CabFile1.first < CabFile2.first);
+}
+
+//-----------------------------------------------------------------------------
+// Public functions
+
+WCHAR MsiLowerChar(WCHAR chValue)
+{
+    size_t nLeft = 0;
+    size_t nRight = _countof(LowerRanges);
+
+    // ASCII is the most common case
+    if(chValue < 0x80)
+        return (chValue >= 'A' && chValue <= 'Z') ? (WCHAR)(chValue + 0x20) : chValue;
+
+    // Binary search of the range
+    while(nLeft < nRight)
+    {
+        size_t nMiddle = (nLeft + nRight) / 2;
+        const MSI_LOWER_RANGE & Range = LowerRanges[nMiddle];
+
+        if(chValue < Range.First)
+            nRight = nMiddle;
+        else if(chValue > Range.Last)
+            nLeft = nMiddle + 1;
+        else
+            return ((chValue - Range.First) % Range.Step) ? chValue : (WCHAR)(chValue + Range.Delta);
+    }
+    return chValue;
+}
+
+// Case-insensitive key of a name
+void MsiFoldName(LPCWSTR szName, size_t ccName, CFB_NAME & strFoldedName)
+{
+    strFoldedName.resize(ccName);
+    for(size_t i = 0; i < ccName; i++)
+        strFoldedName[i] = MsiLowerChar(szName[i]);
+}
+
+//-----------------------------------------------------------------------------
+// TMsiListing functions
+
+TMsiListing::TMsiListing()
+{
+    m_pTables = NULL;
+    m_pStringPool = NULL;
+    m_pCompFile = NULL;
+}
+
+TMsiListing::~TMsiListing()
+{
+    Clear();
+}
+
+// Lists the summary information (if any), then the tables in the given order
+// and then the installed files. The compound file and the string pool may be NULL,
+// then only the row names given by the caller are used
+DWORD TMsiListing::Build(TCompoundFile * pCompFile, const TMsiStringPool * pStringPool, const std::vector<MSI_LISTING_TABLE> & Tables, bool bSummary)
+{
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    m_pCompFile = pCompFile;
+    m_pStringPool = pStringPool;
+    m_pTables = &Tables;
+
+    // The summary information is the first file
+    if(bSummary && AddUniqueItem(MsiItemSummary, MSI_NO_ITEM, CFB_NAME(), MSI_WSTR("_SummaryInformation.csv")) == MSI_NO_ITEM)
+        dwErrCode = ERROR_NOT_ENOUGH_MEMORY;
+
+    for(DWORD dwTable = 0; dwTable < Tables.size() && dwErrCode == ERROR_SUCCESS; dwTable++)
+    {
+        const MSI_LISTING_TABLE & Table = Tables[dwTable];
+
+        // Is it the "_Streams" table and we have direct access to the streams?
+        if(Table.bIsStreamsTable && m_pCompFile != NULL)
+        {
+            dwErrCode = LoadStreamItems(dwTable);
+        }
+
+        // Is it a database table with stream field?
+        else if(Table.nStreamColumn != INVALID_SIZE_T && Table.nNameColumn != INVALID_SIZE_T)
+        {
+            dwErrCode = LoadRowItems(dwTable);
+        }
+
+        // Simple database table - it is shown as a CSV file
+        else
+        {
+            if(AddUniqueItem(MsiItemTable, dwTable, CFB_NAME(), Table.Name + MSI_WSTR(".csv")) == MSI_NO_ITEM)
+                dwErrCode = ERROR_NOT_ENOUGH_MEMORY;
+        }
+    }
+
+    // Show the files from the cabinets as they would be installed
+    if(dwErrCode == ERROR_SUCCESS)
+        dwErrCode = LoadLayoutItems();
+
+    // The rest is only needed while naming the items
+    m_NameSuffixes.clear();
+    m_CabFiles.clear();
+    m_pCompFile = NULL;
+    m_pStringPool = NULL;
+    m_pTables = NULL;
+    return dwErrCode;
+}
+
+// Names are case-insensitive
+DWORD TMsiListing::FindItem(const CFB_NAME & strName) const
+{
+    std::unordered_map<CFB_NAME, DWORD>::const_iterator iter;
+    CFB_NAME strFoldedName;
+
+    MsiFoldName(strName.c_str(), strName.size(), strFoldedName);
+    iter = m_NameIndex.find(strFoldedName);
+    return (iter != m_NameIndex.end()) ? iter->second : MSI_NO_ITEM;
+}
+
+// The caller takes over the cabinets, in the order of MSI_LISTING_ITEM::dwCabinet
+void TMsiListing::TakeCabinets(std::vector<TCabinet *> & Cabinets)
+{
+    Cabinets.insert(Cabinets.end(), m_Cabinets.begin(), m_Cabinets.end());
+    m_Cabinets.clear();
+}
+
+void TMsiListing::Clear()
+{
+    for(size_t i = 0; i < m_Cabinets.size(); i++)
+        delete m_Cabinets[i];
+    m_Cabinets.clear();
+
+    m_Items.clear();
+    m_NameIndex.clear();
+    m_NameSuffixes.clear();
+    m_CabFiles.clear();
+}
+
+// Each row is a file in the folder of the table, named by the first string column
+DWORD TMsiListing::LoadRowItems(DWORD dwTable)
+{
+    const MSI_LISTING_TABLE & Table = (*m_pTables)[dwTable];
+    const TMsiTableData * pTableData = Table.pTableData;
+    CFB_NAME strStreamName;
+    CFB_NAME strItemName;
+    CFB_NAME strEncoded;
+    DWORD dwRowCount;
+    DWORD dwItem;
+
+    // Rows of the tables that are not decoded natively are named by the caller
+    if(pTableData != NULL && m_pStringPool == NULL)
+        return ERROR_NOT_SUPPORTED;
+    dwRowCount = (pTableData != NULL) ? pTableData->RowCount() : (DWORD)(Table.RowNames.size());
+
+    for(DWORD dwRow = 0; dwRow < dwRowCount; dwRow++)
+    {
+        // Retrieve the name of the item
+        if(pTableData != NULL)
+        {
+            LPCWSTR szItemName;
+            size_t ccItemName = 0;
+
+            szItemName = m_pStringPool->String(pTableData->Cell(Table.nNameColumn, dwRow), ccItemName);
+            strStreamName.assign(szItemName, ccItemName);
+        }
+        else
+        {
+            strStreamName = Table.RowNames[dwRow];
+        }
+
+        // Rows of the "_Streams" table may only show the data of another file
+        if(Table.bIsStreamsTable && (dwItem = FindReferencedItem(strStreamName, strItemName)) != MSI_NO_ITEM)
+        {
+            DWORD dwRefItem = dwItem;
+
+            if((dwItem = AddItem(MsiItemRow, dwTable, strItemName)) == MSI_NO_ITEM)
+                return ERROR_NOT_ENOUGH_MEMORY;
+            m_Items[dwItem].RefItem = dwRefItem;
+        }
+        else
+        {
+            strItemName = strStreamName;
+            MakeItemNameFileSafe(strItemName);
+            if((dwItem = AddUniqueItem(MsiItemRow, dwTable, Table.Name, strItemName)) == MSI_NO_ITEM)
+                return ERROR_NOT_ENOUGH_MEMORY;
+        }
+        m_Items[dwItem].dwRow = dwRow;
+
+        // Locate the stream of the row. If the cell is NULL, the file is empty
+        if(pTableData != NULL && m_pCompFile != NULL && pTableData->Cell(Table.nStreamColumn, dwRow) != 0)
+        {
+            pTableData->BuildStreamName(*m_pStringPool, Table.Name, dwRow, strStreamName);
+            MsiEncodeStreamName(strStreamName, false, strEncoded);
+            m_Items[dwItem].dwStreamEntry = m_pCompFile->FindEntry(CFB_ROOT_ENTRY, strEncoded);
+        }
+    }
+    return ERROR_SUCCESS;
+}
+
+// Streams that are not shown as rows of any table are in the "_Streams" folder
+DWORD TMsiListing::LoadStreamItems(DWORD dwTable)
+{
+    const MSI_LISTING_TABLE & Table = (*m_pTables)[dwTable];
+    const CFB_ENTRY & RootEntry = m_pCompFile->Entry(CFB_ROOT_ENTRY);
+    std::vector<CFB_NAME> CabinetNames;
+    CFB_NAME strStreamName;
+    CFB_NAME strItemName;
+    DWORD dwErrCode;
+    DWORD dwItem;
+
+    // Find out which streams are embedded cabinets
+    LoadCabinetNames(CabinetNames);
+
+    // Enumerate all streams in the root storage
+    for(size_t i = 0; i < RootEntry.Children.size(); i++)
+    {
+        DWORD dwEntry = RootEntry.Children[i];
+        const CFB_ENTRY & CfbEntry = m_pCompFile->Entry(dwEntry);
+
+        // Skip storages and the property sets (like "\005SummaryInformation")
+        if(CfbEntry.Type != CFB_TYPE_STREAM || CfbEntry.Name.size() == 0 || CfbEntry.Name[0] < 0x20)
+            continue;
+
+        // Skip the streams that belong to database tables
+        if(MsiDecodeStreamName(CfbEntry.Name, strStreamName))
+            continue;
+
+        // A stream of a table row is shown again, with the data of the row's file
+        if((dwItem = FindReferencedItem(strStreamName, strItemName)) != MSI_NO_ITEM)
+        {
+            DWORD dwRefItem = dwItem;
+
+            if((dwItem = AddItem(MsiItemStream, dwTable, strItemName)) == MSI_NO_ITEM)
+                return ERROR_NOT_ENOUGH_MEMORY;
+            m_Items[dwItem].RefItem = dwRefItem;
+        }
+        else
+        {
+            strItemName = strStreamName;
+            MakeItemNameFileSafe(strItemName);
+            if((dwItem = AddUniqueItem(MsiItemStream, dwTable, Table.Name, strItemName)) == MSI_NO_ITEM)
+                return ERROR_NOT_ENOUGH_MEMORY;
+        }
+        m_Items[dwItem].dwStreamEntry = dwEntry;
+
+        // If the stream is an embedded cabinet, also show the files inside it
+        for(size_t j = 0; j < CabinetNames.size(); j++)
+        {
+            if(IsSameName(CabinetNames[j], strStreamName))
+            {
+                if(TCabinet::IsCabinet(m_pCompFile, dwEntry) && (dwErrCode = LoadCabinetItems(dwTable, dwEntry, strStreamName)) != ERROR_SUCCESS)
+                    return dwErrCode;
+                break;
+            }
+        }
+    }
+    return ERROR_SUCCESS;
+}
+
+DWORD TMsiListing::LoadCabinetItems(DWORD dwTable, DWORD dwEntry, const CFB_NAME & strCabinetName)
+{
+    CFB_NAME strFolderName(MSI_WSTR("_Cabinets\\"));
+    std::vector<WCHAR> NameBuffer;
+    TCabinet * pCabinet;
+    CFB_NAME strItemName;
+    DWORD dwErrCode;
+    DWORD dwItem;
+
+    // Parse the cabinet. Damaged cabinets are shown as plain streams,
+    // like damaged tables are left out. Other errors stop the listing.
+    if((pCabinet = new TCabinet()) == NULL)
+        return ERROR_NOT_ENOUGH_MEMORY;
+    if((dwErrCode = pCabinet->Open(m_pCompFile, dwEntry)) != ERROR_SUCCESS)
+    {
+        delete pCabinet;
+        if(dwErrCode == ERROR_BAD_FORMAT || dwErrCode == ERROR_FILE_CORRUPT || dwErrCode == ERROR_HANDLE_EOF || dwErrCode == ERROR_NOT_SUPPORTED)
+            dwErrCode = ERROR_SUCCESS;
+        return dwErrCode;
+    }
+    m_Cabinets.push_back(pCabinet);
+
+    // Each cabinet has its own folder
+    strFolderName.append(strCabinetName);
+    for(DWORD dwCabFile = 0; dwCabFile < pCabinet->FileCount(); dwCabFile++)
+    {
+        const CAB_FILE & CabFile = pCabinet->File(dwCabFile);
+        DWORD dwCodePage = (CabFile.Attributes & CAB_ATTRIB_NAME_UTF8) ? CP_UTF8 : CP_ACP;
+
+        // Names in the cabinet are either UTF-8 or ANSI
+        NameBuffer.resize(CabFile.Name.size() + 1);
+        strItemName.assign(&NameBuffer[0], MsiCodePageToUtf16(dwCodePage, (const BYTE *)(CabFile.Name.c_str()), CabFile.Name.size(), &NameBuffer[0]));
+        MakeItemNameFileSafe(strItemName);
+        if((dwItem = AddUniqueItem(MsiItemCabinet, dwTable, strFolderName, strItemName)) == MSI_NO_ITEM)
+            return ERROR_NOT_ENOUGH_MEMORY;
+        m_Items[dwItem].dwCabinet = (DWORD)(m_Cabinets.size() - 1);
+        m_Items[dwItem].dwCabFile = dwCabFile;
+
+        // Files in the cabinet are named by the key of the "File" table
+        m_CabFiles.push_back(std::make_pair(CabFile.Name, dwItem));
+    }
+    return ERROR_SUCCESS;
+}
+
+// Shows the files from the cabinets as they would be installed
+DWORD TMsiListing::LoadLayoutItems()
+{
+    std::vector<std::pair<std::string, DWORD> >::iterator iter;
+    std::vector<std::pair<size_t, DWORD> > LayoutItems;
+    std::pair<std::string, DWORD> CabFileKey;
+    MSI_LAYOUT_COLUMNS Columns;
+    TMsiLayout Layout;
+    CFB_NAME strFolderName;
+    CFB_NAME strItemName;
+    DWORD dwDirectory;
+    DWORD dwComponent;
+    DWORD dwFile;
+    DWORD dwErrCode;
+    DWORD dwItem;
+
+    // Only the files embedded in the MSI can be shown
+    if(m_CabFiles.size() == 0 || m_pStringPool == NULL)
+        return ERROR_SUCCESS;
+
+    // We need all three tables, decoded natively
+    dwDirectory = FindTable(MSI_WSTR("Directory"));
+    dwComponent = FindTable(MSI_WSTR("Component"));
+    dwFile = FindTable(MSI_WSTR("File"));
+    if(dwDirectory == MSI_NO_ITEM || dwComponent == MSI_NO_ITEM || dwFile == MSI_NO_ITEM)
+        return ERROR_SUCCESS;
+    const TMsiTableData * pDirectoryData = (*m_pTables)[dwDirectory].pTableData;
+    const TMsiTableData * pComponentData = (*m_pTables)[dwComponent].pTableData;
+    const TMsiTableData * pFileData = (*m_pTables)[dwFile].pTableData;
+    if(pDirectoryData == NULL || pComponentData == NULL || pFileData == NULL)
+        return ERROR_SUCCESS;
+
+    // Find the columns of the joins
+    Columns.Directory = FindColumn(dwDirectory, MSI_WSTR("Directory"), MsiCellString);
+    Columns.DirectoryParent = FindColumn(dwDirectory, MSI_WSTR("Directory_Parent"), MsiCellString);
+    Columns.DefaultDir = FindColumn(dwDirectory, MSI_WSTR("DefaultDir"), MsiCellString);
+    Columns.Component = FindColumn(dwComponent, MSI_WSTR("Component"), MsiCellString);
+    Columns.ComponentDirectory = FindColumn(dwComponent, MSI_WSTR("Directory_"), MsiCellString);
+    Columns.File = FindColumn(dwFile, MSI_WSTR("File"), MsiCellString);
+    Columns.FileComponent = FindColumn(dwFile, MSI_WSTR("Component_"), MsiCellString);
+    Columns.FileName = FindColumn(dwFile, MSI_WSTR("FileName"), MsiCellString);
+    Columns.FileSize = FindColumn(dwFile, MSI_WSTR("FileSize"), MsiCellInteger);
+    if(Columns.Directory == INVALID_SIZE_T || Columns.DirectoryParent == INVALID_SIZE_T || Columns.DefaultDir == INVALID_SIZE_T ||
+       Columns.Component == INVALID_SIZE_T || Columns.ComponentDirectory == INVALID_SIZE_T ||
+       Columns.File == INVALID_SIZE_T || Columns.FileComponent == INVALID_SIZE_T || Columns.FileName == INVALID_SIZE_T || Columns.FileSize == INVALID_SIZE_T)
+        return ERROR_SUCCESS;
+
+    // Join the tables
+    if((dwErrCode = Layout.Build(*m_pStringPool, *pDirectoryData, *pComponentData, *pFileData, Columns)) != ERROR_SUCCESS)
+        return ERROR_SUCCESS;
+
+    // Sort the files in the cabinets by name. If more cabinets have
+    // a file of the same name, the first one is found.
+    std::stable_sort(m_CabFiles.begin(), m_CabFiles.end(), CompareCabFileNames);
+
+    // Each file of the layout refers to its file in the cabinet
+    for(size_t i = 0; i < Layout.FileCount(); i++)
+    {
+        LPCWSTR szFileKey;
+        size_t ccFileKey = 0;
+
+        // Keys of the "File" table are identifiers, so they are the same in UTF-8 and ANSI
+        szFileKey = m_pStringPool->String(Layout.File(i).FileKey, ccFileKey);
+        MsiUtf16ToUtf8(szFileKey, ccFileKey, CabFileKey.first);
+        iter = std::lower_bound(m_CabFiles.begin(), m_CabFiles.end(), CabFileKey, CompareCabFileNames);
+        if(iter != m_CabFiles.end() && iter->first == CabFileKey.first)
+            LayoutItems.push_back(std::make_pair(i, iter->second));
+    }
+
+    // The "File" table is sorted by its key, but the data in the cabinets are stored
+    // in the order of File.Sequence. Files are usually extracted in the order
+    // of the listing, so list them in the order of the data in the cabinet folders.
+    // Otherwise, the solid folders would be decompressed again for almost every file.
+    std::stable_sort(LayoutItems.begin(), LayoutItems.end(), [this](const std::pair<size_t, DWORD> & Item1, const std::pair<size_t, DWORD> & Item2)
+    {
+        const MSI_LISTING_ITEM & CabItem1 = m_Items[Item1.second];
+        const MSI_LISTING_ITEM & CabItem2 = m_Items[Item2.second];
+        const CAB_FILE & CabFile1 = m_Cabinets[CabItem1.dwCabinet]->File(CabItem1.dwCabFile);
+        const CAB_FILE & CabFile2 = m_Cabinets[CabItem2.dwCabinet]->File(CabItem2.dwCabFile);
+
+        if(CabItem1.dwCabinet != CabItem2.dwCabinet)
+            return (CabItem1.dwCabinet < CabItem2.dwCabinet);
+        if(CabFile1.Folder != CabFile2.Folder)
+            return (CabFile1.Folder < CabFile2.Folder);
+        return (CabFile1.FolderOffset < CabFile2.FolderOffset);
+    });
+
+    // Create the items of the layout
+    for(size_t i = 0; i < LayoutItems.size(); i++)
+    {
+        const MSI_LISTING_ITEM & CabItem = m_Items[LayoutItems[i].second];
+        size_t nNameStart;
+
+        // Split the path to the folder and the name
+        strItemName = Layout.File(LayoutItems[i].first).Path;
+        strFolderName = MSI_WSTR("_Installed");
+        MakeItemNameFileSafe(strItemName);
+        if((nNameStart = strItemName.rfind('\\')) != CFB_NAME::npos)
+        {
+            strFolderName.append(1, '\\');
+            strFolderName.append(strItemName, 0, nNameStart);
+            strItemName.erase(0, nNameStart + 1);
+        }
+
+        // The data are read from the file in the cabinet
+        DWORD dwCabinet = CabItem.dwCabinet;
+        DWORD dwCabFile = CabItem.dwCabFile;
+        DWORD dwRefItem = LayoutItems[i].second;
+
+        if((dwItem = AddUniqueItem(MsiItemCabinet, dwFile, strFolderName, strItemName)) == MSI_NO_ITEM)
+            return ERROR_NOT_ENOUGH_MEMORY;
+        m_Items[dwItem].RefItem = dwRefItem;
+        m_Items[dwItem].dwCabinet = dwCabinet;
+        m_Items[dwItem].dwCabFile = dwCabFile;
+    }
+    return ERROR_SUCCESS;
+}
+
+// Cabinets embedded in the MSI are named "#StreamName" in the "Cabinet" column of the "Media" table
+void TMsiListing::LoadCabinetNames(std::vector<CFB_NAME> & CabinetNames)
+{
+    const TMsiTableData * pTableData;
+    size_t nColumn;
+    DWORD dwTable;
+
+    if(m_pStringPool == NULL || (dwTable = FindTable(MSI_WSTR("Media"))) == MSI_NO_ITEM)
+        return;
+    if((pTableData = (*m_pTables)[dwTable].pTableData) == NULL)
+        return;
+
+    if((nColumn = FindColumn(dwTable, MSI_WSTR("Cabinet"), MsiCellString)) != INVALID_SIZE_T)
+    {
+        for(DWORD dwRow = 0; dwRow < pTableData->RowCount(); dwRow++)
+        {
+            LPCWSTR szCabinet;
+            size_t ccCabinet = 0;
+
+            szCabinet = m_pStringPool->String(pTableData->Cell(nColumn, dwRow), ccCabinet);
+            if(ccCabinet > 1 && szCabinet[0] == '#')
+                CabinetNames.push_back(CFB_NAME(szCabinet + 1, ccCabinet - 1));
+        }
+    }
+}
+
+// Streams named like "Binary.bannrbmp" are shown as "_Streams\bannrbmp",
+// if the file "Binary\bannrbmp" exists
+DWORD TMsiListing::FindReferencedItem(const CFB_NAME & strStreamName, CFB_NAME & strItemName)
+{
+    CFB_NAME strRefName(strStreamName);
+    size_t nDot;
+    DWORD dwRefItem;
+
+    if((nDot = strRefName.find('.')) == CFB_NAME::npos)
+        return MSI_NO_ITEM;
+    strRefName[nDot] = '\\';
+
+    if((dwRefItem = FindItem(strRefName)) != MSI_NO_ITEM)
+    {
+        strItemName = MSI_WSTR("_Streams\\");
+        strItemName.append(strStreamName, nDot + 1, CFB_NAME::npos);
+    }
+    return dwRefItem;
+}
+
+DWORD TMsiListing::FindTable(LPCWSTR szTableName)
+{
+    CFB_NAME strTableName(szTableName);
+
+    for(size_t i = 0; i < m_pTables->size(); i++)
+    {
+        if(IsSameName((*m_pTables)[i].Name, strTableName))
+        {
+            return (DWORD)(i);
+        }
+    }
+    return MSI_NO_ITEM;
+}
+
+size_t TMsiListing::FindColumn(DWORD dwTable, LPCWSTR szColumnName, MSI_CELL_TYPE CellType)
+{
+    const MSI_LISTING_TABLE & Table = (*m_pTables)[dwTable];
+    CFB_NAME strColumnName(szColumnName);
+
+    // The types of the cells are only known for the decoded tables
+    if(Table.pTableData == NULL)
+        return INVALID_SIZE_T;
+
+    for(size_t i = 0; i < Table.ColumnNames.size(); i++)
+    {
+        if(Table.pTableData->CellType(i) == CellType && IsSameName(Table.ColumnNames[i], strColumnName))
+        {
+            return i;
+        }
+    }
+    return INVALID_SIZE_T;
+}
+
+DWORD TMsiListing::AddItem(MSI_ITEM_TYPE Type, DWORD dwTable, const CFB_NAME & strName)
+{
+    MSI_LISTING_ITEM Item;
+    CFB_NAME strFoldedName;
+    DWORD dwItem = (DWORD)(m_Items.size());
+
+    Item.Name = strName;
+    Item.Type = Type;
+    Item.RefItem = MSI_NO_ITEM;
+    Item.dwTable = dwTable;
+    Item.dwRow = MSI_NO_ITEM;
+    Item.dwStreamEntry = CFB_NOSTREAM;
+    Item.dwCabinet = MSI_NO_ITEM;
+    Item.dwCabFile = MSI_NO_ITEM;
+    m_Items.push_back(Item);
+
+    // Insert the name to the index. If the name is there already, the first item wins
+    MsiFoldName(strName.c_str(), strName.size(), strFoldedName);
+    m_NameIndex.insert(std::make_pair(strFoldedName, dwItem));
+    return dwItem;
+}
+
+// Adds an item with a name that is not used yet. If the name exists,
+// a numeric suffix is added to the base name, like "Name_001.ext"
+DWORD TMsiListing::AddUniqueItem(MSI_ITEM_TYPE Type, DWORD dwTable, const CFB_NAME & strFolderName, const CFB_NAME & strItemName)
+{
+    CFB_NAME strFoldedName;
+    CFB_NAME strBaseName;
+    CFB_NAME strExtension;
+    CFB_NAME strName;
+
+    // Very long extensions stay in the base name, so that the suffix always fits
+    SplitItemName(strItemName, strBaseName, strExtension);
+    if(strExtension.size() > MSI_MAX_ITEM_NAME / 2)
+    {
+        strBaseName.append(strExtension);
+        strExtension.clear();
+    }
+
+    // Construct the file name without numeric suffix
+    BuildItemName(strName, strFolderName, strBaseName, strExtension, 0);
+    if(FindItem(strName) != MSI_NO_ITEM)
+    {
+        // Continue with the first suffix that has not been tried for this name yet
+        MsiFoldName(strName.c_str(), strName.size(), strFoldedName);
+        DWORD & dwSuffix = m_NameSuffixes.insert(std::make_pair(strFoldedName, 1)).first->second;
+
+        do
+        {
+            BuildItemName(strName, strFolderName, strBaseName, strExtension, dwSuffix++);
+        }
+        while(FindItem(strName) != MSI_NO_ITEM);
+    }
+    return AddItem(Type, dwTable, strName);
+}
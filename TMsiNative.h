@@ -0,0 +1,852 @@
+/*****************************************************************************/
+/* TMsiNative.h                           Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Native (msi.dll-free) access to the MSI storage. This part of the plugin  */
+/* does not depend on Windows and also builds on Linux (see GNUmakefile)     */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 16.10.26  1.00  Lad  Created                                              */
+/*****************************************************************************/
+
+#ifndef __TMSI_NATIVE_H__
+#define __TMSI_NATIVE_H__
+
+#include <unordered_map>
+#include <list>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+//-----------------------------------------------------------------------------
+// UTF-16 string literal (WCHAR is char16_t outside of Windows)
+
+#ifdef _WIN32
+#define MSI_WSTR(x)             L##x
+#else
+#define MSI_WSTR(x)             u##x
+#endif
+
+//-----------------------------------------------------------------------------
+// Compound File Binary (CFB) format. All values are little-endian.
+// https://learn.microsoft.com/en-us/openspecs/windows_protocols/ms-cfb
+
+#define CFB_HEADER_SIGNATURE    0xE11AB1A1E011CFD0ULL   // D0 CF 11 E0 A1 B1 1A E1
+#define CFB_BYTE_ORDER_MARK     0xFFFE                  // Little endian
+#define CFB_HEADER_DIFAT_COUNT  109                     // Number of DIFAT entries in the header
+
+#define CFB_MAXREGSECT          0xFFFFFFFA              // Maximum regular sector number
+#define CFB_DIFSECT             0xFFFFFFFC              // Sector is used by DIFAT
+#define CFB_FATSECT             0xFFFFFFFD              // Sector is used by FAT
+#define CFB_ENDOFCHAIN          0xFFFFFFFE              // End of a sector chain
+#define CFB_FREESECT            0xFFFFFFFF              // Unallocated sector
+#define CFB_NOSTREAM            0xFFFFFFFF              // No sibling / child in the directory tree
+
+#define CFB_TYPE_EMPTY          0x00                    // Unused directory entry
+#define CFB_TYPE_STORAGE        0x01                    // Storage object
+#define CFB_TYPE_STREAM         0x02                    // Stream object
+#define CFB_TYPE_ROOT           0x05                    // Root storage
+
+#define CFB_ROOT_ENTRY          0                       // Index of the root directory entry
+#define CFB_MAX_NAME_LENGTH     31                      // Maximum name length, without EOS
+#define CFB_BOUNCE_BUFFER_SIZE  0x100000                // Buffer size for copying when the file is not mapped
+
+#ifdef _WIN32
+typedef HANDLE CFB_FILE_HANDLE;
+#define CFB_INVALID_HANDLE      INVALID_HANDLE_VALUE
+#else
+typedef int CFB_FILE_HANDLE;
+#define CFB_INVALID_HANDLE      -1
+#endif
+
+#pragma pack(push, 1)
+struct CFB_HEADER
+{
+    ULONGLONG Signature;                                // CFB_HEADER_SIGNATURE
+    BYTE  Clsid[16];                                    // Reserved, must be zero
+    WORD  MinorVersion;
+    WORD  MajorVersion;                                 // 3 (512-byte sectors) or 4 (4096-byte sectors)
+    WORD  ByteOrder;                                    // CFB_BYTE_ORDER_MARK
+    WORD  SectorShift;                                  // 9 or 12
+    WORD  MiniSectorShift;                              // 6
+    BYTE  Reserved[6];
+    DWORD DirSectors;                                   // Number of directory sectors (zero for version 3)
+    DWORD FatSectors;                                   // Number of FAT sectors
+    DWORD FirstDirSector;                               // First sector of the directory chain
+    DWORD TransactionSignature;
+    DWORD MiniStreamCutoff;                             // Streams smaller than this are in the mini stream
+    DWORD FirstMiniFatSector;                           // First sector of the mini FAT chain
+    DWORD MiniFatSectors;                               // Number of mini FAT sectors
+    DWORD FirstDifatSector;                             // First sector of the DIFAT chain
+    DWORD DifatSectors;                                 // Number of DIFAT sectors
+    DWORD Difat[CFB_HEADER_DIFAT_COUNT];                // The first 109 FAT sectors
+};
+
+struct CFB_DIRENTRY
+{
+    WORD  Name[32];                                     // UTF-16 name, zero terminated
+    WORD  NameLength;                                   // Length of the name in bytes, including EOS
+    BYTE  Type;                                         // CFB_TYPE_XXX
+    BYTE  Color;                                        // Red-black tree node color
+    DWORD LeftSibling;
+    DWORD RightSibling;
+    DWORD Child;
+    BYTE  Clsid[16];
+    DWORD StateBits;
+    ULONGLONG CreationTime;
+    ULONGLONG ModifiedTime;
+    DWORD StartSector;                                  // First sector of the stream
+    ULONGLONG StreamSize;                               // Upper 32 bits must be ignored in version 3
+};
+#pragma pack(pop)
+
+typedef std::basic_string<WCHAR> CFB_NAME;
+
+// Parsed directory entry
+struct CFB_ENTRY
+{
+    CFB_NAME Name;                                      // Name of the entry
+    std::vector<DWORD> Children;                        // Child entries (storages only)
+    ULONGLONG Size;                                     // Size of the stream
+    DWORD StartSector;                                  // Starting sector (or mini sector)
+    DWORD Parent;                                       // Index of the parent storage
+    BYTE Type;                                          // CFB_TYPE_XXX
+};
+
+// One contiguous piece of a stream within the compound file
+struct CFB_RUN
+{
+    ULONGLONG StreamOffset;                             // Byte offset of the run within the stream
+    ULONGLONG FileOffset;                               // Byte offset of the run in the compound file
+    ULONGLONG Length;                                   // Length of the run, in bytes
+};
+
+// Opened stream, translated to the list of file runs
+struct CFB_STREAM
+{
+    CFB_STREAM()
+    {
+        Size = 0;
+        dwEntry = CFB_NOSTREAM;
+    }
+
+    std::vector<CFB_RUN> Runs;                          // Runs, in stream order
+    ULONGLONG Size;                                     // Total size of the stream
+    DWORD dwEntry;                                      // Directory entry of the stream
+};
+
+//-----------------------------------------------------------------------------
+// Read-only compound file
+
+struct TCompoundFile
+{
+    TCompoundFile();
+    ~TCompoundFile();
+
+    DWORD Open(LPCTSTR szFileName);
+    void  Close();
+
+    DWORD FindEntry(DWORD dwStorage, const CFB_NAME & strName);
+    DWORD OpenStream(DWORD dwEntry, CFB_STREAM & Stream);
+    DWORD ReadStream(const CFB_STREAM & Stream, ULONGLONG ByteOffset, LPVOID pvBuffer, DWORD cbToRead, LPDWORD PtrBytesRead);
+    DWORD WriteStream(const CFB_STREAM & Stream, ULONGLONG ByteOffset, DWORD cbToWrite, CFB_FILE_HANDLE hTargetFile, LPDWORD PtrBytesWritten);
+    DWORD MapStream(const CFB_STREAM & Stream, ULONGLONG ByteOffset, DWORD cbMaxData, const BYTE ** PtrData, LPDWORD PtrBytesMapped);
+    DWORD LoadStream(DWORD dwEntry, std::vector<BYTE> & Data);
+
+    const CFB_ENTRY & Entry(DWORD dwEntry)          { return m_Entries[dwEntry]; }
+    const CFB_HEADER & Header()                     { return m_Header; }
+    DWORD EntryCount()                              { return (DWORD)(m_Entries.size()); }
+    ULONGLONG FileSize()                            { return m_FileSize; }
+    bool IsMapped()                                 { return (m_pbFileData != NULL); }
+
+    protected:
+
+    void  MapFile();
+    void  UnmapFile();
+    DWORD ReadFileData(ULONGLONG ByteOffset, LPVOID pvBuffer, DWORD cbToRead);
+    DWORD WriteFileData(ULONGLONG ByteOffset, DWORD cbToWrite, CFB_FILE_HANDLE hTargetFile);
+    DWORD LoadSectorChain(DWORD dwStartSector, std::vector<BYTE> & Data);
+    DWORD LoadFat();
+    DWORD LoadDirectory();
+    DWORD LoadDirectoryTree();
+    DWORD LoadMiniStream();
+    DWORD LoadMiniFat();
+    DWORD BuildRuns(DWORD dwStartSector, ULONGLONG Size, std::vector<CFB_RUN> & Runs);
+    DWORD BuildMiniRuns(DWORD dwStartSector, ULONGLONG Size, std::vector<CFB_RUN> & Runs);
+    void  AppendRun(std::vector<CFB_RUN> & Runs, ULONGLONG FileOffset, ULONGLONG Length);
+
+    std::unordered_map<CFB_NAME, DWORD> m_RootIndex;    // Name -> entry index for the root storage
+    std::vector<CFB_ENTRY> m_Entries;                   // Parsed directory entries
+    std::vector<DWORD> m_MiniStreamSectors;             // Sectors of the mini stream (root entry data)
+    std::vector<DWORD> m_Fat;                           // The whole FAT
+    std::vector<DWORD> m_MiniFat;                       // The whole mini FAT
+    CFB_HEADER m_Header;                                // Copy of the file header
+    ULONGLONG m_FileSize;                               // Size of the compound file
+    DWORD m_dwSectorSize;                               // Size of the sector, in bytes
+    DWORD m_dwMiniSectorSize;                           // Size of the mini sector, in bytes
+    LPBYTE m_pbFileData;                                // The whole file mapped to memory (NULL if not mapped)
+#ifdef _WIN32
+    HANDLE m_hFileMap;                                  // Handle to the file mapping object
+#else
+    std::atomic<bool> m_bCopyRange;                     // If true, copy_file_range() can be used
+#endif
+    CFB_FILE_HANDLE m_hFile;                            // Handle to the compound file
+};
+
+//-----------------------------------------------------------------------------
+// Loads the streams that will be read next on a worker thread, so that
+// reading from the disk overlaps with writing the previous stream
+
+#define CFB_PREFETCH_MAX_FILES  64                      // Maximum number of streams loaded ahead
+
+enum CFB_PREFETCH_STATE
+{
+    CfbPrefetchQueued,                                  // Waiting for the worker
+    CfbPrefetchLoading,                                 // Being loaded by the worker
+    CfbPrefetchDone,                                    // Loaded, waiting for the consumer
+    CfbPrefetchFailed                                   // Could not be loaded
+};
+
+struct CFB_PREFETCH_ITEM
+{
+    std::vector<BYTE> Data;                             // Data of the stream (if CfbPrefetchDone)
+    ULONGLONG Size;                                     // Size of the stream
+    DWORD dwEntry;                                      // Directory entry of the stream
+    DWORD dwSequence;                                   // Identifies the item for the worker
+    CFB_PREFETCH_STATE State;
+};
+
+struct TStreamPrefetcher
+{
+    TStreamPrefetcher();
+    ~TStreamPrefetcher();
+
+    void  Open(TCompoundFile * pCompFile, DWORD dwLookahead, size_t cbMaxMemory);
+    bool  Request(DWORD dwEntry);
+    bool  Take(DWORD dwEntry, std::vector<BYTE> & Data);
+    void  Drop(DWORD dwEntry);
+    void  Stop();
+
+    bool  IsOpen()                                      { return (m_pCompFile != NULL); }
+
+    protected:
+
+    static void WorkerThread(TStreamPrefetcher * pPrefetcher);
+    void  WorkerMain();
+    std::list<CFB_PREFETCH_ITEM>::iterator FindItem(DWORD dwEntry);
+
+    std::list<CFB_PREFETCH_ITEM> m_Items;               // Requested streams, in the order of the requests
+    std::thread m_Thread;                               // The worker thread
+    std::mutex m_Lock;                                  // Guards the items and the counters
+    std::condition_variable m_Changed;                  // Signalled when an item or a counter changes
+    TCompoundFile * m_pCompFile;                        // The compound file (not owned)
+    size_t m_cbMaxMemory;                               // Maximum memory taken by the loaded streams
+    size_t m_cbMemory;                                  // Memory taken by the streams being loaded or loaded
+    DWORD m_dwLookahead;                                // Maximum number of requested streams
+    DWORD m_dwSequence;                                 // Sequence number of the next item
+    bool  m_bStopping;                                  // Set when the worker shall exit
+};
+
+//-----------------------------------------------------------------------------
+// MSI stream names. Names of the streams in MSI are compressed so that two
+// characters from [0-9A-Za-z._] are packed into one UTF-16 character.
+// Streams that belong to database tables begin with MSI_TABLE_STREAM_PREFIX.
+
+#define MSI_TABLE_STREAM_PREFIX 0x4840
+
+void MsiEncodeStreamName(const CFB_NAME & strName, bool bTable, CFB_NAME & strEncoded);
+bool MsiDecodeStreamName(const CFB_NAME & strEncoded, CFB_NAME & strName);   // Returns true for table streams
+
+//-----------------------------------------------------------------------------
+// Kinds of Windows Installer files. They are all compound files,
+// told apart by the class ID of the root storage.
+
+enum MSI_STORAGE_TYPE
+{
+    MsiStorageNone,                                     // Not a compound file
+    MsiStorageUnknown,                                  // Compound file without a class ID
+    MsiStorageOther,                                    // Compound file of another application
+    MsiStorageDatabase,                                 // Installer database (MSI) or merge module (MSM)
+    MsiStoragePatch,                                    // Patch package (MSP)
+    MsiStorageTransform                                 // Transform (MST)
+};
+
+MSI_STORAGE_TYPE MsiSniffStorage(LPCTSTR szFileName);
+
+//-----------------------------------------------------------------------------
+// MSI string pool. All strings in MSI tables are stored as string IDs, which
+// are indexes to the "_StringPool" stream. Each entry of the pool contains
+// length and reference count of the string. The string data themselves are
+// stored in the "_StringData" stream, in the database code page.
+
+#define MSI_STRING_REF_SHORT    2                       // Size of string ID in a table, in bytes
+#define MSI_STRING_REF_LONG     3                       // Size of string ID if the pool has "long string refs"
+#define MSI_POOL_LONG_REFS      0x8000                  // Flag in the pool header: long string refs
+
+struct MSI_STRING_ENTRY
+{
+    DWORD Offset;                                       // Offset of the string in the UTF-16 buffer
+    DWORD Length;                                       // Length of the string, in WCHARs
+    DWORD CsvLength;                                    // Length of the string as a CSV cell (see MsiCsvCellLength), in bytes
+    DWORD Refs;                                         // Reference count from the string pool
+};
+
+// Conversions of the strings. MsiCodePageToUtf16 needs cbString characters in the buffer
+size_t MsiCodePageToUtf16(DWORD dwCodePage, const BYTE * pbString, size_t cbString, LPWSTR szBuffer);
+void   MsiUtf16ToUtf8(LPCWSTR szString, size_t ccString, std::string & strUtf8);
+
+struct TMsiStringPool
+{
+    TMsiStringPool();
+
+    DWORD Load(TCompoundFile * pCompFile);
+
+    // Resolves the string ID to the string. The string is not zero terminated
+    LPCWSTR String(DWORD dwStringId, size_t & ccString) const
+    {
+        if(dwStringId < m_Strings.size())
+        {
+            ccString = m_Strings[dwStringId].Length;
+            return &m_Text[0] + m_Strings[dwStringId].Offset;
+        }
+
+        ccString = 0;
+        return &m_Text[0];
+    }
+
+    // Length of the string as a CSV cell. Precomputed, so that CSV sizes need no conversion
+    DWORD CsvLength(DWORD dwStringId) const
+    {
+        return (dwStringId < m_Strings.size()) ? m_Strings[dwStringId].CsvLength : 0;
+    }
+
+    // All strings, one after another. The strings are in the order of their IDs
+    LPCWSTR Text() const                                    { return &m_Text[0]; }
+    size_t TextLength() const                               { return m_Strings.size() ? (m_Strings.back().Offset + m_Strings.back().Length) : 0; }
+
+    const MSI_STRING_ENTRY & Entry(DWORD dwStringId) const  { return m_Strings[dwStringId]; }
+    DWORD Count() const                                     { return (DWORD)(m_Strings.size()); }
+    DWORD CodePage() const                                  { return m_dwCodePage; }
+    DWORD StringRefSize() const                             { return m_dwStringRefSize; }
+    size_t MemorySize() const;
+
+    protected:
+
+    std::vector<MSI_STRING_ENTRY> m_Strings;            // Indexed by string ID. ID 0 is the null string
+    std::vector<WCHAR> m_Text;                          // All strings, converted to UTF-16
+    DWORD m_dwCodePage;                                 // Code page of the string data
+    DWORD m_dwStringRefSize;                            // MSI_STRING_REF_SHORT or MSI_STRING_REF_LONG
+};
+
+//-----------------------------------------------------------------------------
+// CSV cells. Strings are converted to UTF-8 and the quotation marks are doubled
+// (RFC 4180). Runs of plain ASCII characters are converted with SSE2 or AVX2.
+
+size_t MsiCsvCellLength(LPCWSTR szValue, size_t ccValue);
+size_t MsiCsvCellEncode(LPBYTE pbBuffer, size_t cbBuffer, LPCWSTR szValue, size_t ccValue);   // Returns the number of bytes written
+
+//-----------------------------------------------------------------------------
+// MSI table data. Each table is stored in one stream, column by column.
+// Integers are stored with a bias (0x8000 or 0x80000000), so that zero
+// means NULL. Strings are stored as string IDs, streams as a flag whether
+// the stream exists (the stream itself is named "Table.Key1.Key2...").
+
+#ifndef MSI_NULL_INTEGER
+#define MSI_NULL_INTEGER        0x80000000              // Integer value of a NULL cell
+#endif
+
+enum MSI_CELL_TYPE
+{
+    MsiCellNone = 0,
+    MsiCellInteger,                                     // Integer (2 or 4 bytes)
+    MsiCellString,                                      // String ID (2 or 3 bytes)
+    MsiCellStream                                       // Stream reference (2 bytes)
+};
+
+struct MSI_COLUMN_LAYOUT
+{
+    MSI_CELL_TYPE CellType;                             // Type of the cell
+    DWORD Width;                                        // Width of the cell in the table stream, in bytes
+    bool IsKey;                                         // If true, the column is part of the primary key
+};
+
+struct TMsiTableData
+{
+    TMsiTableData();
+
+    DWORD Load(TCompoundFile * pCompFile, const CFB_NAME & strTableName, const std::vector<MSI_COLUMN_LAYOUT> & Layout);
+    void  BuildStreamName(const TMsiStringPool & StringPool, const CFB_NAME & strTableName, DWORD dwRow, CFB_NAME & strStreamName) const;
+
+    // Decoded cells of one column: integer values (or MSI_NULL_INTEGER), string IDs or stream flags
+    const DWORD * Column(size_t nColumn) const      { return &m_Cells[nColumn * m_dwRows]; }
+    DWORD Cell(size_t nColumn, DWORD dwRow) const   { return m_Cells[nColumn * m_dwRows + dwRow]; }
+    MSI_CELL_TYPE CellType(size_t nColumn) const    { return m_Layout[nColumn].CellType; }
+    size_t ColumnCount() const                      { return m_Layout.size(); }
+    DWORD RowCount() const                          { return m_dwRows; }
+
+    protected:
+
+    std::vector<MSI_COLUMN_LAYOUT> m_Layout;            // Layout of the columns
+    std::vector<DWORD> m_Cells;                         // All cells, column by column
+    DWORD m_dwRows;                                     // Number of rows
+};
+
+//-----------------------------------------------------------------------------
+// CSV rendering of the natively decoded tables. Each row is one line, each
+// cell is quoted. The lengths of the rows are known in advance from the
+// precomputed lengths of the strings, so the rows can be rendered in parallel,
+// each range of rows directly to its place in the output buffer.
+
+#define MSI_CSV_RANGE_ROWS      0x1000                  // Number of rows in one range of work
+#define MSI_CSV_MAX_WORKERS     64                      // Maximum number of rendering threads
+
+size_t    MsiCsvRowLength(const TMsiTableData & TableData, const TMsiStringPool & StringPool, DWORD dwRow);
+ULONGLONG MsiCsvRowsLength(const TMsiTableData & TableData, const TMsiStringPool & StringPool, DWORD dwFirstRow, DWORD dwRows);
+LPBYTE    MsiCsvRenderRows(LPBYTE pbBuffer, const TMsiTableData & TableData, const TMsiStringPool & StringPool, DWORD dwFirstRow, DWORD dwRows);
+
+// One table (or a part of it) to be measured or rendered
+struct MSI_CSV_JOB
+{
+    const TMsiTableData * pTableData;                   // The decoded table
+    DWORD dwFirstRow;                                   // The first row to render
+    DWORD dwRows;                                       // Number of rows to render
+    LPBYTE pbBuffer;                                    // Where to render the rows (NULL = only measure)
+    size_t cbBuffer;                                    // Size of the buffer, in bytes
+    ULONGLONG cbLength;                                 // [out] Length of the rendered rows, in bytes
+};
+
+// One range of rows, the unit of work of the render pool
+struct MSI_CSV_RANGE
+{
+    size_t nJob;                                        // Index of the job
+    DWORD dwFirstRow;                                   // The first row of the range
+    DWORD dwRows;                                       // Number of rows in the range
+    ULONGLONG ByteOffset;                               // Length of the range, then its offset in the job's buffer
+};
+
+// Ranges assigned to one worker. The owner takes them from the front,
+// the other workers steal from the back when they run out of their own.
+struct MSI_CSV_QUEUE
+{
+    size_t nNext;                                       // The next range to be taken by the owner
+    size_t nEnd;                                        // End of the ranges of the worker
+};
+
+struct TCsvRenderPool
+{
+    TCsvRenderPool();
+    ~TCsvRenderPool();
+
+    void  Open(DWORD dwMaxWorkers);
+    DWORD Measure(MSI_CSV_JOB * pJobs, size_t nJobs, const TMsiStringPool & StringPool);
+    DWORD Render(MSI_CSV_JOB * pJobs, size_t nJobs, const TMsiStringPool & StringPool);
+    void  Stop();
+
+    DWORD Workers()                                     { return (DWORD)(m_Threads.size()); }
+
+    protected:
+
+    static void WorkerThread(TCsvRenderPool * pPool, size_t nWorker, DWORD dwPhase);
+    void  WorkerMain(size_t nWorker, DWORD dwPhase);
+    void  RunPhase(bool bRender);
+    void  ProcessRanges(size_t nWorker);
+    bool  TakeRange(size_t nWorker, size_t & nRange);
+    void  SplitJobs(MSI_CSV_JOB * pJobs, size_t nJobs);
+    void  StartWorkers(size_t nRanges);
+
+    std::vector<MSI_CSV_RANGE> m_Ranges;                // Ranges of the current phase
+    std::vector<MSI_CSV_QUEUE> m_Queues;                // Ranges of each worker. The caller is worker 0
+    std::vector<std::thread> m_Threads;                 // Worker threads
+    std::mutex m_CallLock;                              // Lets one caller at a time measure or render
+    std::mutex m_Lock;                                  // Guards the queues and the counters
+    std::condition_variable m_Changed;                  // Signalled when a phase starts or ends
+    MSI_CSV_JOB * m_pJobs;                              // Jobs of the current phase
+    const TMsiStringPool * m_pStringPool;               // String pool of the current phase
+    DWORD m_dwMaxWorkers;                               // Maximum number of worker threads
+    DWORD m_dwPhase;                                    // Incremented when a phase starts
+    DWORD m_dwRunning;                                  // Number of threads still working on the phase
+    bool  m_bRender;                                    // If true, the phase renders the ranges; otherwise it measures them
+    bool  m_bStopping;                                  // Set when the workers shall exit
+};
+
+//-----------------------------------------------------------------------------
+// Text search in the decoded tables. Every distinct string is stored only once
+// in the string pool, so the text of the pool is scanned once (with SSE2)
+// and the matching strings are mapped back to the cells that refer to them.
+// Only the string cells are searched.
+
+#define MSI_SEARCH_IGNORE_CASE  0x0001                  // ASCII letters match regardless of their case
+
+DWORD MsiSearchStringPool(const TMsiStringPool & StringPool, LPCWSTR szPattern, size_t ccPattern, DWORD dwFlags, std::vector<DWORD> & StringIds);
+
+// A cell that refers to a string
+struct MSI_STRING_REF
+{
+    DWORD nTable;                                       // Index of the table in the list the index was built from
+    DWORD dwRow;                                        // Row of the cell
+    DWORD nColumn;                                      // Column of the cell
+};
+
+// Reverse index from the string ID to the cells that refer to the string
+struct TMsiStringRefs
+{
+    DWORD Build(const TMsiStringPool & StringPool, const TMsiTableData * const * ppTables, size_t nTables);
+    DWORD Search(const TMsiStringPool & StringPool, LPCWSTR szPattern, size_t ccPattern, DWORD dwFlags, std::vector<MSI_STRING_REF> & Hits) const;
+    const MSI_STRING_REF * Refs(DWORD dwStringId, size_t & nRefs) const;
+    size_t MemorySize() const;
+
+    protected:
+
+    std::vector<DWORD> m_First;                         // Index of the first reference of every string ID, plus the total count
+    std::vector<MSI_STRING_REF> m_Refs;                 // References grouped by the string ID, each group in the order of the cells
+};
+
+//-----------------------------------------------------------------------------
+// MSI catalog. The "_Tables" table contains names of all tables, the "_Columns"
+// table contains (Table, Number, Name, Type) of every column. The type is
+// a combination of flags and the width of the column.
+
+#define MSI_COLUMN_WIDTH_MASK   0x00FF                  // Width of the column (bytes for integers, characters for strings)
+#define MSI_COLUMN_VALID        0x0100
+#define MSI_COLUMN_LOCALIZABLE  0x0200
+#define MSI_COLUMN_STRING       0x0800
+#define MSI_COLUMN_NULLABLE     0x1000
+#define MSI_COLUMN_KEY          0x2000
+#define MSI_COLUMN_TEMPORARY    0x4000
+
+// Binary columns are strings with no width and no other flags
+#define MSI_COLUMN_IS_BINARY(dwType) (((dwType) & ~MSI_COLUMN_NULLABLE) == (MSI_COLUMN_STRING | MSI_COLUMN_VALID))
+
+struct MSI_CATALOG_COLUMN
+{
+    CFB_NAME Name;                                      // Name of the column
+    DWORD Number;                                       // One-based index of the column
+    DWORD Type;                                         // MSI_COLUMN_XXX flags and the width
+};
+
+struct MSI_CATALOG_TABLE
+{
+    CFB_NAME Name;                                      // Name of the table
+    std::vector<MSI_CATALOG_COLUMN> Columns;            // Columns, sorted by their number
+};
+
+struct TMsiCatalog
+{
+    DWORD Load(TCompoundFile * pCompFile, const TMsiStringPool & StringPool);
+
+    const MSI_CATALOG_TABLE & Table(size_t nIndex) const    { return m_Tables[nIndex]; }
+    size_t TableCount() const                               { return m_Tables.size(); }
+    size_t MemorySize() const;
+
+    protected:
+
+    std::vector<MSI_CATALOG_TABLE> m_Tables;            // All tables from the "_Tables" table
+};
+
+//-----------------------------------------------------------------------------
+// Installed layout. The "File", "Component" and "Directory" tables are joined
+// by their primary keys, so that every file gets its target path. The keys
+// are string IDs, so the hash indexes never need to compare the strings.
+
+#define MSI_LAYOUT_NO_ROW       0xFFFFFFFF              // The key was not found
+
+struct MSI_LAYOUT_COLUMNS
+{
+    size_t Directory;                                   // "Directory" column of the "Directory" table
+    size_t DirectoryParent;                             // "Directory_Parent" column of the "Directory" table
+    size_t DefaultDir;                                  // "DefaultDir" column of the "Directory" table
+    size_t Component;                                   // "Component" column of the "Component" table
+    size_t ComponentDirectory;                          // "Directory_" column of the "Component" table
+    size_t File;                                        // "File" column of the "File" table
+    size_t FileComponent;                               // "Component_" column of the "File" table
+    size_t FileName;                                    // "FileName" column of the "File" table
+    size_t FileSize;                                    // "FileSize" column of the "File" table
+};
+
+struct MSI_LAYOUT_FILE
+{
+    CFB_NAME Path;                                      // Target path relative to the root directory, with the long name
+    DWORD FileKey;                                      // String ID of the primary key in the "File" table
+    DWORD FileSize;                                     // Size of the file from the "File" table
+};
+
+struct TMsiLayout
+{
+    DWORD Build(const TMsiStringPool & StringPool,
+                const TMsiTableData & Directory,
+                const TMsiTableData & Component,
+                const TMsiTableData & File,
+                const MSI_LAYOUT_COLUMNS & Columns);
+
+    const MSI_LAYOUT_FILE & File(size_t nIndex) const   { return m_Files[nIndex]; }
+    size_t FileCount() const                            { return m_Files.size(); }
+
+    protected:
+
+    void  ResolveDirectories(const TMsiStringPool & StringPool, const TMsiTableData & Directory, const MSI_LAYOUT_COLUMNS & Columns);
+
+    std::unordered_map<DWORD, DWORD> m_DirIndex;        // Directory key -> row in the "Directory" table
+    std::vector<CFB_NAME> m_DirPaths;                   // Resolved path of each directory row
+    std::vector<MSI_LAYOUT_FILE> m_Files;               // All files, in the order of the "File" table
+};
+
+//-----------------------------------------------------------------------------
+// Summary information. The "\005SummaryInformation" stream is an OLE property set
+// https://learn.microsoft.com/en-us/openspecs/windows_protocols/ms-oleps
+
+#define MSI_SUMMARY_PROPERTY_COUNT  20                  // Properties 0 - 19, like in msi.dll
+#define MSI_PID_CODEPAGE        1                       // Code page of the string properties
+
+#define MSI_VT_EMPTY            0                       // The property is not there
+#define MSI_VT_I2               2                       // 16-bit signed integer
+#define MSI_VT_I4               3                       // 32-bit signed integer
+#define MSI_VT_LPSTR            30                      // String in the code page of the property set
+#define MSI_VT_FILETIME         64                      // FILETIME, 100 ns intervals since 1.1.1601 UTC
+
+struct MSI_SUMMARY_PROPERTY
+{
+    CFB_NAME Value;                                     // Value of a string property
+    ULONGLONG FileTime;                                 // Value of a time property
+    int IntValue;                                       // Value of an integer property
+    DWORD Type;                                         // MSI_VT_XXX
+};
+
+struct TMsiSummary
+{
+    TMsiSummary();
+
+    DWORD Load(TCompoundFile * pCompFile);
+    void  RenderCsv(std::vector<BYTE> & Csv) const;
+
+    const MSI_SUMMARY_PROPERTY & Property(DWORD dwPropertyId) const { return m_Properties[dwPropertyId]; }
+
+    protected:
+
+    DWORD LoadProperty(const BYTE * pbSection, size_t cbSection, DWORD dwPropertyId, DWORD dwOffset, DWORD dwCodePage);
+
+    MSI_SUMMARY_PROPERTY m_Properties[MSI_SUMMARY_PROPERTY_COUNT];
+};
+
+LPCWSTR MsiSummaryPropertyName(DWORD dwPropertyId);
+
+//-----------------------------------------------------------------------------
+// Listing of an MSI file. Both the plugin and the native archive list the files
+// this way, so they always have the same names: the summary information and
+// the tables are CSV files, rows of the tables with a binary column are files
+// in the folders of their tables, the other streams are in "_Streams", files
+// from the embedded cabinets are in "_Cabinets" and again in "_Installed",
+// as they would be installed. The names are case-insensitive; colliding names
+// get a numeric suffix, like "Name_001.ext".
+
+#define MSI_NO_ITEM             0xFFFFFFFF              // The item was not found
+#define MSI_MAX_ITEM_NAME       (MAX_PATH - 1)          // Maximum length of an item name
+
+struct TCabinet;
+struct TCabFolderReader;
+struct TCabFolderPool;
+
+enum MSI_ITEM_TYPE
+{
+    MsiItemSummary,                                     // Summary information, rendered to CSV
+    MsiItemTable,                                       // Table, rendered to CSV
+    MsiItemRow,                                         // Row of a table with a binary column
+    MsiItemStream,                                      // Stream of the compound file that is not a row
+    MsiItemCabinet                                      // File in an embedded cabinet
+};
+
+// A table as the listing needs it. The caller loads the names of the rows
+// of the tables that are not decoded natively (the plugin uses msi.dll)
+struct MSI_LISTING_TABLE
+{
+    CFB_NAME Name;                                      // Name of the table
+    std::vector<CFB_NAME> ColumnNames;                  // Names of the columns
+    std::vector<CFB_NAME> RowNames;                     // Names of the rows, if the table is not decoded natively
+    const TMsiTableData * pTableData;                   // Decoded rows, or NULL
+    size_t nStreamColumn;                               // The first binary column, or INVALID_SIZE_T
+    size_t nNameColumn;                                 // The first string column, if there is a binary one
+    bool bIsStreamsTable;                               // The "_Streams" table
+};
+
+struct MSI_LISTING_ITEM
+{
+    CFB_NAME Name;                                      // Path of the item, with backslashes
+    MSI_ITEM_TYPE Type;                                 // Where the data come from
+    DWORD RefItem;                                      // The item whose data are shown instead, or MSI_NO_ITEM
+    DWORD dwTable;                                      // Index of the table that the item belongs to, or MSI_NO_ITEM
+    DWORD dwRow;                                        // Row of the table, or index to the row names (MsiItemRow)
+    DWORD dwStreamEntry;                                // Directory entry of the stream. CFB_NOSTREAM = not known (MsiItemRow, MsiItemStream)
+    DWORD dwCabinet;                                    // Index of the cabinet (MsiItemCabinet)
+    DWORD dwCabFile;                                    // Index of the file in the cabinet (MsiItemCabinet)
+};
+
+struct TMsiListing
+{
+    TMsiListing();
+    ~TMsiListing();
+
+    DWORD Build(TCompoundFile * pCompFile, const TMsiStringPool * pStringPool, const std::vector<MSI_LISTING_TABLE> & Tables, bool bSummary);
+    DWORD FindItem(const CFB_NAME & strName) const;
+    void  TakeCabinets(std::vector<TCabinet *> & Cabinets);
+    void  Clear();
+
+    const MSI_LISTING_ITEM & Item(size_t nIndex) const  { return m_Items[nIndex]; }
+    size_t ItemCount() const                            { return m_Items.size(); }
+
+    protected:
+
+    DWORD LoadRowItems(DWORD dwTable);
+    DWORD LoadStreamItems(DWORD dwTable);
+    DWORD LoadCabinetItems(DWORD dwTable, DWORD dwEntry, const CFB_NAME & strCabinetName);
+    DWORD LoadLayoutItems();
+    void  LoadCabinetNames(std::vector<CFB_NAME> & CabinetNames);
+    DWORD FindReferencedItem(const CFB_NAME & strStreamName, CFB_NAME & strItemName);
+    DWORD FindTable(LPCWSTR szTableName);
+    size_t FindColumn(DWORD dwTable, LPCWSTR szColumnName, MSI_CELL_TYPE CellType);
+    DWORD AddItem(MSI_ITEM_TYPE Type, DWORD dwTable, const CFB_NAME & strName);
+    DWORD AddUniqueItem(MSI_ITEM_TYPE Type, DWORD dwTable, const CFB_NAME & strFolderName, const CFB_NAME & strItemName);
+
+    std::vector<MSI_LISTING_ITEM> m_Items;              // All items, in the order of the listing
+    std::vector<TCabinet *> m_Cabinets;                 // Embedded cabinets, until the caller takes them
+    std::vector<std::pair<std::string, DWORD> > m_CabFiles; // Names of the files in the cabinets -> item (only during the build)
+    std::unordered_map<CFB_NAME, DWORD> m_NameIndex;    // Folded item name -> item
+    std::unordered_map<CFB_NAME, DWORD> m_NameSuffixes; // Folded item name -> the next numeric suffix to try (only during the build)
+    const std::vector<MSI_LISTING_TABLE> * m_pTables;   // Tables of the database (only during the build)
+    const TMsiStringPool * m_pStringPool;               // Strings of the tables (only during the build)
+    TCompoundFile * m_pCompFile;                        // The MSI file (only during the build)
+};
+
+WCHAR MsiLowerChar(WCHAR chValue);
+void  MsiFoldName(LPCWSTR szName, size_t ccName, CFB_NAME & strFoldedName);
+
+//-----------------------------------------------------------------------------
+// Listing cache of the plugin. The cache file is written and loaded by
+// TMsiFileList; its layout is checked here, without msi.dll
+
+#define MSI_CACHE_SIGNATURE     0x4843534D              // 'MSCH'
+#define MSI_CACHE_VERSION       2
+#define MSI_NO_FILE             0xFFFFFFFF              // No file (e.g. no referenced file)
+
+// Hot part of a file. This is what the listing and the name lookups walk
+struct MSI_FILE_ENTRY
+{
+    ULONGLONG FileSize;                                 // Size of the file
+    DWORD NameOffset;                                   // Offset of the name in the name arena. The lowercased name follows it
+    DWORD NameLength;                                   // Length of the name, in characters
+    DWORD NameHash;                                     // Hash of the lowercased name
+    DWORD RefFile;                                      // The file whose data this file shows (MSI_NO_FILE if none)
+};
+
+// Identity of the archive in the listing cache. The cached listing
+// is only used if all members match the archive being opened
+struct MSI_CACHE_KEY
+{
+    ULONGLONG ArchiveSize;                              // Size of the MSI file
+    FILETIME LastWriteTime;                             // Last write time of the MSI file
+    ULONGLONG PathHash;                                 // Hash of the lowercased full path of the MSI file
+    DWORD HeaderHash;                                   // Hash of the compound file header and directory
+    DWORD Reserved;                                     // Zero
+};
+
+// Header of the listing cache file. It is followed by the arrays
+// of MSI_FILE_ENTRY, MSI_CACHE_FILE, the name index and the name arena,
+// in the same layout they have in memory.
+struct MSI_CACHE_HEADER
+{
+    DWORD Signature;                                    // MSI_CACHE_SIGNATURE
+    DWORD Version;                                      // MSI_CACHE_VERSION
+    DWORD CharSize;                                     // sizeof(TCHAR)
+    DWORD FileCount;                                    // Number of files
+    MSI_CACHE_KEY CacheKey;                             // Identity of the archive
+    DWORD IndexSize;                                    // Number of slots in the name index
+    DWORD ArenaLength;                                  // Number of characters in the name arena
+};
+
+// The part of MSI_FILE_DETAIL that is stored in the cache
+struct MSI_CACHE_FILE
+{
+    DWORD FileType;                                     // MSI_FILE_TYPE
+    DWORD dwStreamEntry;                                // Directory entry in the compound file (CFB_NOSTREAM if none)
+};
+
+// The arrays of a checked cache file. They point into the cache data
+struct MSI_CACHE_ARRAYS
+{
+    const MSI_CACHE_HEADER * pHeader;
+    const MSI_FILE_ENTRY * pEntries;
+    const MSI_CACHE_FILE * pCacheFiles;
+    const DWORD * pIndex;
+    const TCHAR * pArena;
+};
+
+DWORD MsiCacheCheckData(LPBYTE pbCache, size_t cbCache, const MSI_CACHE_KEY & CacheKey, DWORD dwFileTypes, DWORD dwEntryCount, MSI_CACHE_ARRAYS & Arrays);
+
+//-----------------------------------------------------------------------------
+// Native archive. Lists an MSI file without msi.dll, with the same file names
+// as the plugin (see TMsiListing), and reads the data of the files. Tables that
+// cannot be decoded natively are listed, but only msi.dll could read them.
+
+#define MSI_ITEM_CHUNK_SIZE     0x100000                // Minimal size of a chunk read from an item
+#define MSI_ITEM_WRITE_SIZE     0x10000000              // Maximal size of one write of a stream item (256 MB)
+
+struct MSI_ARCHIVE_TABLE
+{
+    const MSI_CATALOG_TABLE * pCatalogTable;            // Name and columns of the table
+    TMsiTableData Data;                                 // Decoded rows
+    std::vector<BYTE> CsvHeader;                        // UTF-8 marker and the names of the columns
+    bool bDecoded;                                      // false if the table could not be decoded
+};
+
+// Position of the reader in one item. Each reader has its own
+struct MSI_ITEM_CURSOR
+{
+    MSI_ITEM_CURSOR();
+
+    TCabFolderReader * pCabReader;                      // Reader of the cabinet folder owned by the caller. NULL = the cabinet pool
+    CFB_STREAM Stream;                                  // The stream (MsiItemRow, MsiItemStream)
+    ULONGLONG ByteOffset;                               // Number of bytes read so far
+    DWORD dwRow;                                        // The next row to render (MsiItemTable)
+    bool bStarted;                                      // Set after the first chunk
+};
+
+struct TMsiArchive
+{
+    TMsiArchive();
+    ~TMsiArchive();
+
+    DWORD Open(LPCTSTR szFileName, DWORD dwMaxWorkers);
+    DWORD ReadChunk(DWORD dwItem, MSI_ITEM_CURSOR & Cursor, std::vector<BYTE> & Chunk, LPDWORD PtrBytesRead);
+    DWORD WriteItem(DWORD dwItem, CFB_FILE_HANDLE hTargetFile, PULONGLONG PtrBytesWritten);
+    DWORD FindItem(const CFB_NAME & strName) const              { return m_Listing.FindItem(strName); }
+    const MSI_LISTING_ITEM & DataItem(DWORD dwItem) const;
+    void  GroupItems(const std::vector<DWORD> & Items, std::vector<std::vector<DWORD> > & Units) const;
+    void  Close();
+
+    const MSI_LISTING_ITEM & Item(size_t nIndex) const          { return m_Listing.Item(nIndex); }
+    ULONGLONG ItemSize(size_t nIndex) const                     { return m_ItemSizes[nIndex]; }
+    const MSI_ARCHIVE_TABLE & Table(size_t nIndex) const        { return *m_Tables[nIndex]; }
+    const TCabinet * Cabinet(size_t nIndex) const               { return m_Cabinets[nIndex]; }
+    const TMsiStringPool & StringPool() const                   { return m_StringPool; }
+    size_t ItemCount() const                                    { return m_Listing.ItemCount(); }
+    size_t TableCount() const                                   { return m_Tables.size(); }
+
+    protected:
+
+    DWORD LoadTables(std::vector<MSI_LISTING_TABLE> & ListingTables);
+    DWORD MeasureItems();
+    DWORD ReadTableChunk(const MSI_LISTING_ITEM & Item, MSI_ITEM_CURSOR & Cursor, std::vector<BYTE> & Chunk, LPDWORD PtrBytesRead);
+
+    TMsiListing m_Listing;                              // Names of all items, in the order of the plugin
+    std::vector<ULONGLONG> m_ItemSizes;                 // Sizes of the items
+    std::vector<MSI_ARCHIVE_TABLE *> m_Tables;          // All tables, in the order of the catalog
+    std::vector<TCabinet *> m_Cabinets;                 // Embedded cabinets
+    std::vector<TCabFolderPool *> m_CabPools;           // Decompressors of the embedded cabinets
+    std::vector<BYTE> m_SummaryCsv;                     // The summary information, rendered to CSV
+    TCompoundFile m_CompFile;                           // The MSI file
+    TMsiStringPool m_StringPool;                        // All strings of the tables
+    TMsiCatalog m_Catalog;                              // Names and columns of the tables
+    TCsvRenderPool m_CsvPool;                           // Renders big tables on multiple threads
+    DWORD m_dwMaxWorkers;                               // Number of threads for the cabinets and the tables
+};
+
+#endif // __TMSI_NATIVE_H__
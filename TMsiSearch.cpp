@@ -0,0 +1,291 @@
+/*****************************************************************************/
+/* TMsiSearch.cpp                         Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Text search in the string pool and the reverse index of string references */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 16.10.26  1.00  Lad  Created                                              */
+/*****************************************************************************/
+
+#include "wcx_msi.h"
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MSI_SEARCH_SSE2
+#endif
+
+//-----------------------------------------------------------------------------
+// Local structures
+
+struct TPoolSearch
+{
+    TPoolSearch(const TMsiStringPool & StringPool, const CFB_NAME & strPattern, bool bIgnoreCase, std::vector<DWORD> & StringIds)
+        : m_StringPool(StringPool), m_strPattern(strPattern), m_StringIds(StringIds)
+    {
+        m_szText = StringPool.Text();
+        m_ccText = StringPool.TextLength();
+        m_bIgnoreCase = bIgnoreCase;
+    }
+
+    DWORD FindStringId(size_t nPosition) const
+    {
+        DWORD dwLower = 0;
+        DWORD dwUpper = m_StringPool.Count();
+
+        // Find the last string that begins at or before the position.
+        // Empty strings begin at the same offset as the string after them
+        while((dwUpper - dwLower) > 1)
+        {
+            DWORD dwMiddle = dwLower + (dwUpper - dwLower) / 2;
+
+            if(m_StringPool.Entry(dwMiddle).Offset <= nPosition)
+                dwLower = dwMiddle;
+            else
+                dwUpper = dwMiddle;
+        }
+        return dwLower;
+    }
+
+    bool MatchesAt(size_t nPosition) const
+    {
+        LPCWSTR szText = m_szText + nPosition;
+
+        if(m_bIgnoreCase)
+        {
+            for(size_t i = 0; i < m_strPattern.size(); i++)
+            {
+                if(FoldChar(szText[i]) != m_strPattern[i])
+                    return false;
+            }
+            return true;
+        }
+        return (memcmp(szText, m_strPattern.c_str(), m_strPattern.size() * sizeof(WCHAR)) == 0);
+    }
+
+    // Checks the candidate position. Returns the position where the search continues
+    size_t Check(size_t nPosition)
+    {
+        if(MatchesAt(nPosition))
+        {
+            DWORD dwStringId = FindStringId(nPosition);
+            const MSI_STRING_ENTRY & Entry = m_StringPool.Entry(dwStringId);
+
+            // The match must not continue to the next string
+            if((nPosition + m_strPattern.size()) <= (Entry.Offset + Entry.Length))
+            {
+                // One match per string is enough, so we skip the rest of it
+                m_StringIds.push_back(dwStringId);
+                return Entry.Offset + Entry.Length;
+            }
+        }
+        return nPosition + 1;
+    }
+
+    static WCHAR FoldChar(WCHAR chValue)
+    {
+        return (chValue >= 'A' && chValue <= 'Z') ? (WCHAR)(chValue + 0x20) : chValue;
+    }
+
+    static bool IsAsciiLetter(WCHAR chValue)
+    {
+        return (chValue >= 'a' && chValue <= 'z');
+    }
+
+    void Search()
+    {
+        size_t nLast = m_strPattern.size() - 1;
+        size_t nPosition = 0;
+        WCHAR chFirst = m_strPattern[0];
+
+#ifdef MSI_SEARCH_SSE2
+        // Filter the positions by the first and the last character of the pattern,
+        // eight positions at once. When ignoring the case, the filter ORs the letters
+        // with 0x20, which maps uppercase ASCII letters to lowercase ones
+        __m128i FirstChar = _mm_set1_epi16((short)chFirst);
+        __m128i LastChar = _mm_set1_epi16((short)m_strPattern[nLast]);
+        __m128i FirstFold = _mm_set1_epi16((m_bIgnoreCase && IsAsciiLetter(chFirst)) ? 0x20 : 0);
+        __m128i LastFold = _mm_set1_epi16((m_bIgnoreCase && IsAsciiLetter(m_strPattern[nLast])) ? 0x20 : 0);
+
+        while((nPosition + nLast + 8) <= m_ccText)
+        {
+            __m128i FirstBlock = _mm_or_si128(_mm_loadu_si128((const __m128i *)(m_szText + nPosition)), FirstFold);
+            __m128i LastBlock = _mm_or_si128(_mm_loadu_si128((const __m128i *)(m_szText + nPosition + nLast)), LastFold);
+            __m128i Candidates = _mm_and_si128(_mm_cmpeq_epi16(FirstBlock, FirstChar), _mm_cmpeq_epi16(LastBlock, LastChar));
+            DWORD dwMask = (DWORD)(_mm_movemask_epi8(Candidates)) & 0x5555;
+            size_t nNextPosition = nPosition + 8;
+            size_t nResume = nPosition;
+
+            // Verify the candidates. A match skips the rest of its string,
+            // so it may also skip candidates that follow in the block
+            for(size_t i = 0; dwMask != 0; i++, dwMask >>= 2)
+            {
+                if((dwMask & 1) && (nPosition + i) >= nResume)
+                {
+                    nResume = Check(nPosition + i);
+                }
+            }
+            nPosition = std::max(nNextPosition, nResume);
+        }
+#endif
+
+        // The rest of the text, one position at a time
+        chFirst = m_bIgnoreCase ? FoldChar(chFirst) : chFirst;
+        while((nPosition + nLast) < m_ccText)
+        {
+            WCHAR chValue = m_bIgnoreCase ? FoldChar(m_szText[nPosition]) : m_szText[nPosition];
+
+            nPosition = (chValue == chFirst) ? Check(nPosition) : (nPosition + 1);
+        }
+    }
+
+    const TMsiStringPool & m_StringPool;
+    const CFB_NAME & m_strPattern;
+    std::vector<DWORD> & m_StringIds;
+    LPCWSTR m_szText;
+    size_t m_ccText;
+    bool m_bIgnoreCase;
+};
+
+//-----------------------------------------------------------------------------
+// Local functions
+
+static bool CompareRefs(const MSI_STRING_REF & Ref1, const MSI_STRING_REF & Ref2)
+{
+    if(Ref1.nTable != Ref2.nTable)
+        return (Ref1.nTable < Ref2.nTable);
+    if(Ref1.dwRow != Ref2.dwRow)
+        return (Ref1.dwRow < Ref2.dwRow);
+    return (Ref1.nColumn < Ref2.nColumn);
+}
+
+//-----------------------------------------------------------------------------
+// Public functions
+
+// Finds all strings that contain the pattern. The text of the pool is scanned once
+// and the IDs of the matching strings are returned in ascending order
+DWORD MsiSearchStringPool(const TMsiStringPool & StringPool, LPCWSTR szPattern, size_t ccPattern, DWORD dwFlags, std::vector<DWORD> & StringIds)
+{
+    bool bIgnoreCase = (dwFlags & MSI_SEARCH_IGNORE_CASE) ? true : false;
+    CFB_NAME strPattern;
+
+    // An empty pattern would match every string
+    StringIds.clear();
+    if(szPattern == NULL || ccPattern == 0)
+        return ERROR_INVALID_PARAMETER;
+    strPattern.assign(szPattern, ccPattern);
+
+    // The pattern is folded once, the text is folded as it goes
+    if(bIgnoreCase)
+    {
+        for(size_t i = 0; i < strPattern.size(); i++)
+            strPattern[i] = TPoolSearch::FoldChar(strPattern[i]);
+    }
+
+    TPoolSearch(StringPool, strPattern, bIgnoreCase, StringIds).Search();
+    return ERROR_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// TMsiStringRefs functions
+
+DWORD TMsiStringRefs::Build(const TMsiStringPool & StringPool, const TMsiTableData * const * ppTables, size_t nTables)
+{
+    std::vector<DWORD> NextRef;
+    DWORD dwStringCount = StringPool.Count();
+
+    // Count the references of every string. The null string is never searched
+    m_First.assign(dwStringCount + 1, 0);
+    for(size_t nTable = 0; nTable < nTables; nTable++)
+    {
+        const TMsiTableData * pTableData = ppTables[nTable];
+
+        for(size_t nColumn = 0; nColumn < pTableData->ColumnCount(); nColumn++)
+        {
+            if(pTableData->CellType(nColumn) == MsiCellString)
+            {
+                const DWORD * Column = pTableData->Column(nColumn);
+
+                for(DWORD dwRow = 0; dwRow < pTableData->RowCount(); dwRow++)
+                {
+                    if(Column[dwRow] != 0 && Column[dwRow] < dwStringCount)
+                        m_First[Column[dwRow] + 1]++;
+                }
+            }
+        }
+    }
+
+    // Turn the counts to the indexes of the first reference
+    for(DWORD i = 0; i < dwStringCount; i++)
+        m_First[i + 1] += m_First[i];
+    NextRef.assign(m_First.begin(), m_First.end() - 1);
+
+    // Fill the references, going through the tables in the same order
+    m_Refs.resize(m_First[dwStringCount]);
+    for(size_t nTable = 0; nTable < nTables; nTable++)
+    {
+        const TMsiTableData * pTableData = ppTables[nTable];
+
+        for(size_t nColumn = 0; nColumn < pTableData->ColumnCount(); nColumn++)
+        {
+            if(pTableData->CellType(nColumn) == MsiCellString)
+            {
+                const DWORD * Column = pTableData->Column(nColumn);
+
+                for(DWORD dwRow = 0; dwRow < pTableData->RowCount(); dwRow++)
+                {
+                    if(Column[dwRow] != 0 && Column[dwRow] < dwStringCount)
+                    {
+                        MSI_STRING_REF & Ref = m_Refs[NextRef[Column[dwRow]]++];
+
+                        Ref.nTable = (DWORD)(nTable);
+                        Ref.dwRow = dwRow;
+                        Ref.nColumn = (DWORD)(nColumn);
+                    }
+                }
+            }
+        }
+    }
+    return ERROR_SUCCESS;
+}
+
+// Finds all string cells that contain the pattern. The hits are sorted by table, row and column
+DWORD TMsiStringRefs::Search(const TMsiStringPool & StringPool, LPCWSTR szPattern, size_t ccPattern, DWORD dwFlags, std::vector<MSI_STRING_REF> & Hits) const
+{
+    std::vector<DWORD> StringIds;
+    DWORD dwErrCode;
+
+    Hits.clear();
+    if((dwErrCode = MsiSearchStringPool(StringPool, szPattern, ccPattern, dwFlags, StringIds)) == ERROR_SUCCESS)
+    {
+        for(size_t i = 0; i < StringIds.size(); i++)
+        {
+            const MSI_STRING_REF * pRefs;
+            size_t nRefs = 0;
+
+            if((pRefs = Refs(StringIds[i], nRefs)) != NULL)
+                Hits.insert(Hits.end(), pRefs, pRefs + nRefs);
+        }
+        std::sort(Hits.begin(), Hits.end(), CompareRefs);
+    }
+    return dwErrCode;
+}
+
+const MSI_STRING_REF * TMsiStringRefs::Refs(DWORD dwStringId, size_t & nRefs) const
+{
+    // The string ID may come from another pool
+    if((size_t)(dwStringId) + 1 >= m_First.size())
+    {
+        nRefs = 0;
+        return NULL;
+    }
+
+    nRefs = m_First[dwStringId + 1] - m_First[dwStringId];
+    return nRefs ? &m_Refs[m_First[dwStringId]] : NULL;
+}
+
+size_t TMsiStringRefs::MemorySize() const
+{
+    return m_First.capacity() * sizeof(DWORD) + m_Refs.capacity() * sizeof(MSI_STRING_REF);
+}
@@ -0,0 +1,231 @@
+/*****************************************************************************/
+/* TMsiShared.cpp                         Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Process-wide cache of the parsed data of the opened archives              */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 16.10.26  1.00  Lad  Created                                              */
+/*****************************************************************************/
+
+#include "wcx_msi.h"
+
+//-----------------------------------------------------------------------------
+// Local variables
+
+static std::list<TMsiSharedData *> SharedList;  // All shared data, the most recently used first
+static CRITICAL_SECTION SharedLock;             // Protects the list and the parts of the shared data
+
+//-----------------------------------------------------------------------------
+// Local functions
+
+// Frees the least recently used data that nobody uses, until the cache fits
+// the memory budget. The caller must hold the lock.
+static void TrimSharedCache()
+{
+    std::list<TMsiSharedData *>::iterator iter;
+    size_t cbMemory = 0;
+
+    // Get the total memory taken by the cache
+    for(iter = SharedList.begin(); iter != SharedList.end(); iter++)
+        cbMemory += (*iter)->m_cbMemory;
+
+    // Evict from the least recently used ones
+    for(iter = SharedList.end(); iter != SharedList.begin() && cbMemory > g_cbSharedCache; )
+    {
+        TMsiSharedData * pShared = *(--iter);
+
+        if(pShared->m_dwRefs == 0)
+        {
+            cbMemory -= pShared->m_cbMemory;
+            iter = SharedList.erase(iter);
+            delete pShared;
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Constructor and destructor
+
+TMsiSharedData::TMsiSharedData(const MSI_CACHE_KEY & CacheKey)
+{
+    m_CacheKey = CacheKey;
+    m_pStringPool = NULL;
+    m_pCatalog = NULL;
+    m_cbMemory = 0;
+    m_bHasFiles = FALSE;
+    m_dwRefs = 0;
+}
+
+TMsiSharedData::~TMsiSharedData()
+{
+    // Nobody may use the data anymore
+    assert(m_dwRefs == 0);
+
+    if(m_pCatalog != NULL)
+        delete m_pCatalog;
+    m_pCatalog = NULL;
+
+    if(m_pStringPool != NULL)
+        delete m_pStringPool;
+    m_pStringPool = NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Public functions
+
+TMsiStringPool * TMsiSharedData::StringPool()
+{
+    TMsiStringPool * pStringPool;
+
+    EnterCriticalSection(&SharedLock);
+    pStringPool = m_pStringPool;
+    LeaveCriticalSection(&SharedLock);
+    return pStringPool;
+}
+
+// Gives the loaded string pool to the shared data. If another database
+// has been faster, its string pool is used and ours is freed.
+TMsiStringPool * TMsiSharedData::SetStringPool(TMsiStringPool * pStringPool)
+{
+    EnterCriticalSection(&SharedLock);
+    if(m_pStringPool == NULL)
+    {
+        m_pStringPool = pStringPool;
+        m_cbMemory += pStringPool->MemorySize();
+        pStringPool = NULL;
+        TrimSharedCache();
+    }
+    LeaveCriticalSection(&SharedLock);
+
+    // Free our string pool if it's not needed
+    if(pStringPool != NULL)
+        delete pStringPool;
+    return m_pStringPool;
+}
+
+TMsiCatalog * TMsiSharedData::Catalog()
+{
+    TMsiCatalog * pCatalog;
+
+    EnterCriticalSection(&SharedLock);
+    pCatalog = m_pCatalog;
+    LeaveCriticalSection(&SharedLock);
+    return pCatalog;
+}
+
+TMsiCatalog * TMsiSharedData::SetCatalog(TMsiCatalog * pCatalog)
+{
+    EnterCriticalSection(&SharedLock);
+    if(m_pCatalog == NULL)
+    {
+        m_pCatalog = pCatalog;
+        m_cbMemory += pCatalog->MemorySize();
+        pCatalog = NULL;
+        TrimSharedCache();
+    }
+    LeaveCriticalSection(&SharedLock);
+
+    // Free our catalog if it's not needed
+    if(pCatalog != NULL)
+        delete pCatalog;
+    return m_pCatalog;
+}
+
+DWORD TMsiSharedData::LoadFileList(TMsiFileList & Files)
+{
+    DWORD dwErrCode = ERROR_FILE_NOT_FOUND;
+
+    EnterCriticalSection(&SharedLock);
+    if(m_bHasFiles)
+    {
+        Files.CopyListing(m_Files);
+        dwErrCode = ERROR_SUCCESS;
+    }
+    LeaveCriticalSection(&SharedLock);
+    return dwErrCode;
+}
+
+void TMsiSharedData::SetFileList(const TMsiFileList & Files)
+{
+    EnterCriticalSection(&SharedLock);
+    if(m_bHasFiles == FALSE)
+    {
+        m_Files.CopyListing(Files);
+        m_cbMemory += m_Files.MemorySize();
+        m_bHasFiles = TRUE;
+        TrimSharedCache();
+    }
+    LeaveCriticalSection(&SharedLock);
+}
+
+//-----------------------------------------------------------------------------
+// Shared cache
+
+void MsiSharedCacheInitialize()
+{
+    InitializeCriticalSection(&SharedLock);
+}
+
+// Returns the shared data of the archive. If there are none yet, they are created empty
+TMsiSharedData * MsiSharedCacheAcquire(const MSI_CACHE_KEY & CacheKey)
+{
+    std::list<TMsiSharedData *>::iterator iter;
+    TMsiSharedData * pShared = NULL;
+
+    EnterCriticalSection(&SharedLock);
+    for(iter = SharedList.begin(); iter != SharedList.end(); )
+    {
+        TMsiSharedData * pItem = *iter;
+
+        // Found the same archive?
+        if(!memcmp(&pItem->m_CacheKey, &CacheKey, sizeof(MSI_CACHE_KEY)))
+        {
+            pShared = pItem;
+            iter = SharedList.erase(iter);
+            continue;
+        }
+
+        // Data of an older version of the same archive will never be used again
+        if(pItem->m_CacheKey.PathHash == CacheKey.PathHash && pItem->m_dwRefs == 0)
+        {
+            iter = SharedList.erase(iter);
+            delete pItem;
+            continue;
+        }
+        iter++;
+    }
+
+    // Create new shared data if not found
+    if(pShared == NULL)
+        pShared = new TMsiSharedData(CacheKey);
+
+    // Move the data to the front of the list
+    if(pShared != NULL)
+    {
+        SharedList.push_front(pShared);
+        pShared->m_dwRefs++;
+    }
+    LeaveCriticalSection(&SharedLock);
+    return pShared;
+}
+
+void MsiSharedCacheRelease(TMsiSharedData * pShared)
+{
+    EnterCriticalSection(&SharedLock);
+    assert(pShared->m_dwRefs > 0);
+    pShared->m_dwRefs--;
+    TrimSharedCache();
+    LeaveCriticalSection(&SharedLock);
+}
+
+void MsiSharedCacheCleanup()
+{
+    std::list<TMsiSharedData *>::iterator iter;
+
+    // Free all shared data. No archive is open at this point
+    for(iter = SharedList.begin(); iter != SharedList.end(); iter++)
+        delete *iter;
+    SharedList.clear();
+    DeleteCriticalSection(&SharedLock);
+}
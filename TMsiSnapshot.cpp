@@ -0,0 +1,59 @@
+/*****************************************************************************/
+/* TMsiSnapshot.cpp                       Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Immutable listing of an open archive, shared by its readers               */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 16.10.26  1.00  Lad  Created                                              */
+/*****************************************************************************/
+
+#include "wcx_msi.h"
+
+//-----------------------------------------------------------------------------
+// TMsiSnapshot functions
+
+TMsiSnapshot::TMsiSnapshot()
+{
+    m_bCachedFiles = FALSE;
+    m_dwRefs = 1;
+}
+
+TMsiSnapshot::~TMsiSnapshot()
+{
+    // Free the list of files. This also closes the handles that the files keep
+    m_Files.Clear();
+
+    // Close the cached records
+    for(MSI_RECORD_CACHE::iterator iter = m_Records.begin(); iter != m_Records.end(); iter++)
+        MSI_CLOSE_HANDLE(iter->second);
+    m_Records.clear();
+
+    // Stop the decompressors, then free the embedded cabinets
+    for(size_t i = 0; i < m_CabPools.size(); i++)
+        delete m_CabPools[i];
+    m_CabPools.clear();
+    for(size_t i = 0; i < m_Cabinets.size(); i++)
+        delete m_Cabinets[i];
+    m_Cabinets.clear();
+
+    // Free the tables. The last one may also free the database
+    for(size_t i = 0; i < m_Tables.size(); i++)
+        m_Tables[i]->Release();
+    m_Tables.clear();
+}
+
+DWORD TMsiSnapshot::AddRef()
+{
+    return InterlockedIncrement((LONG *)(&m_dwRefs));
+}
+
+DWORD TMsiSnapshot::Release()
+{
+    if(InterlockedDecrement((LONG *)(&m_dwRefs)) == 0)
+    {
+        delete this;
+        return 0;
+    }
+    return m_dwRefs;
+}
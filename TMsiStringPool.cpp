@@ -0,0 +1,236 @@
+/*****************************************************************************/
+/* TMsiStringPool.cpp                     Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Native decoder of the MSI string pool (_StringPool and _StringData)       */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 16.10.26  1.00  Lad  Created                                              */
+/*****************************************************************************/
+
+#include "wcx_msi.h"
+
+//-----------------------------------------------------------------------------
+// Local (non-class) functions
+
+#ifndef _WIN32
+// Characters 0x80-0x9F of the Windows-1252 code page
+static const WCHAR Cp1252Table[0x20] =
+{
+    0x20AC, 0x0081, 0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021, 0x02C6, 0x2030, 0x0160, 0x2039, 0x0152, 0x008D, 0x017D, 0x008F,
+    0x0090, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014, 0x02DC, 0x2122, 0x0161, 0x203A, 0x0153, 0x009D, 0x017E, 0x0178
+};
+
+static size_t Utf8ToUtf16(const BYTE * pbString, size_t cbString, LPWSTR szBuffer)
+{
+    const BYTE * pbStringEnd = pbString + cbString;
+    LPWSTR szBufferPtr = szBuffer;
+
+    while(pbString < pbStringEnd)
+    {
+        DWORD dwCodePoint = *pbString++;
+        size_t nFollowing = 0;
+
+        // Decode the lead byte
+        if(dwCodePoint >= 0xF0)
+            nFollowing = 3, dwCodePoint &= 0x07;
+        else if(dwCodePoint >= 0xE0)
+            nFollowing = 2, dwCodePoint &= 0x0F;
+        else if(dwCodePoint >= 0xC0)
+            nFollowing = 1, dwCodePoint &= 0x1F;
+        else if(dwCodePoint >= 0x80)
+            dwCodePoint = 0xFFFD;
+
+        // Decode the following bytes
+        for(; nFollowing > 0 && pbString < pbStringEnd && (pbString[0] & 0xC0) == 0x80; nFollowing--)
+            dwCodePoint = (dwCodePoint << 6) | (*pbString++ & 0x3F);
+        if(nFollowing != 0)
+            dwCodePoint = 0xFFFD;
+
+        // Store the code point
+        if(dwCodePoint >= 0x10000)
+        {
+            *szBufferPtr++ = (WCHAR)(0xD800 + ((dwCodePoint - 0x10000) >> 10));
+            *szBufferPtr++ = (WCHAR)(0xDC00 + ((dwCodePoint - 0x10000) & 0x3FF));
+        }
+        else
+        {
+            *szBufferPtr++ = (WCHAR)(dwCodePoint);
+        }
+    }
+    return (size_t)(szBufferPtr - szBuffer);
+}
+#endif
+
+static DWORD LoadTableStream(TCompoundFile * pCompFile, LPCWSTR szTableName, std::vector<BYTE> & Data)
+{
+    CFB_NAME strEncoded;
+    DWORD dwEntry;
+
+    MsiEncodeStreamName(szTableName, true, strEncoded);
+    if((dwEntry = pCompFile->FindEntry(CFB_ROOT_ENTRY, strEncoded)) == CFB_NOSTREAM)
+        return ERROR_FILE_NOT_FOUND;
+    return pCompFile->LoadStream(dwEntry, Data);
+}
+
+//-----------------------------------------------------------------------------
+// Public functions
+
+// Converts string in a code page to UTF-16. The buffer must have at least cbString characters
+size_t MsiCodePageToUtf16(DWORD dwCodePage, const BYTE * pbString, size_t cbString, LPWSTR szBuffer)
+{
+    if(cbString == 0)
+        return 0;
+
+#ifdef _WIN32
+    return MultiByteToWideChar(dwCodePage, 0, (LPCSTR)(pbString), (int)(cbString), szBuffer, (int)(cbString));
+#else
+    // UTF-8 needs to be decoded
+    if(dwCodePage == CP_UTF8)
+        return Utf8ToUtf16(pbString, cbString, szBuffer);
+
+    // Everything else is treated as Windows-1252 (superset of ISO-8859-1)
+    for(size_t i = 0; i < cbString; i++)
+        szBuffer[i] = (0x80 <= pbString[i] && pbString[i] < 0xA0) ? Cp1252Table[pbString[i] - 0x80] : pbString[i];
+    return cbString;
+#endif
+}
+
+// Converts UTF-16 string to UTF-8. Unpaired surrogates become U+FFFD
+void MsiUtf16ToUtf8(LPCWSTR szString, size_t ccString, std::string & strUtf8)
+{
+    strUtf8.resize(ccString * 3);
+    if(ccString == 0)
+        return;
+
+#ifdef _WIN32
+    strUtf8.resize(WideCharToMultiByte(CP_UTF8, 0, szString, (int)(ccString), &strUtf8[0], (int)(strUtf8.size()), NULL, NULL));
+#else
+    size_t nLength = 0;
+
+    for(size_t i = 0; i < ccString; i++)
+    {
+        DWORD dwCodePoint = szString[i];
+
+        // Join the surrogate pairs
+        if(0xD800 <= dwCodePoint && dwCodePoint < 0xE000)
+        {
+            if(dwCodePoint < 0xDC00 && (i + 1) < ccString && 0xDC00 <= szString[i + 1] && szString[i + 1] < 0xE000)
+                dwCodePoint = 0x10000 + ((dwCodePoint - 0xD800) << 10) + (szString[++i] - 0xDC00);
+            else
+                dwCodePoint = 0xFFFD;
+        }
+
+        // Encode the code point. A pair of UTF-16 characters takes 4 bytes
+        if(dwCodePoint < 0x80)
+        {
+            strUtf8[nLength++] = (char)(dwCodePoint);
+        }
+        else if(dwCodePoint < 0x800)
+        {
+            strUtf8[nLength++] = (char)(0xC0 | (dwCodePoint >> 6));
+            strUtf8[nLength++] = (char)(0x80 | (dwCodePoint & 0x3F));
+        }
+        else if(dwCodePoint < 0x10000)
+        {
+            strUtf8[nLength++] = (char)(0xE0 | (dwCodePoint >> 12));
+            strUtf8[nLength++] = (char)(0x80 | ((dwCodePoint >> 6) & 0x3F));
+            strUtf8[nLength++] = (char)(0x80 | (dwCodePoint & 0x3F));
+        }
+        else
+        {
+            strUtf8[nLength++] = (char)(0xF0 | (dwCodePoint >> 18));
+            strUtf8[nLength++] = (char)(0x80 | ((dwCodePoint >> 12) & 0x3F));
+            strUtf8[nLength++] = (char)(0x80 | ((dwCodePoint >> 6) & 0x3F));
+            strUtf8[nLength++] = (char)(0x80 | (dwCodePoint & 0x3F));
+        }
+    }
+    strUtf8.resize(nLength);
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// TMsiStringPool functions
+
+TMsiStringPool::TMsiStringPool()
+{
+    m_dwCodePage = CP_ACP;
+    m_dwStringRefSize = MSI_STRING_REF_SHORT;
+}
+
+DWORD TMsiStringPool::Load(TCompoundFile * pCompFile)
+{
+    std::vector<BYTE> PoolData;
+    std::vector<BYTE> StringData;
+    MSI_STRING_ENTRY StringEntry = {0};
+    LPWORD PoolWords;
+    size_t nPoolWords;
+    size_t nDataOffset = 0;
+    size_t nTextLength = 0;
+    DWORD dwErrCode;
+
+    // Load both streams
+    if((dwErrCode = LoadTableStream(pCompFile, MSI_WSTR("_StringPool"), PoolData)) != ERROR_SUCCESS)
+        return dwErrCode;
+    if((dwErrCode = LoadTableStream(pCompFile, MSI_WSTR("_StringData"), StringData)) != ERROR_SUCCESS)
+        return dwErrCode;
+
+    // The string text will never have more WCHARs than there is bytes in the data.
+    // We add one extra character so that even the empty pool has a valid pointer
+    m_Text.resize(StringData.size() + 1);
+    m_Strings.clear();
+
+    // String ID 0 is always the null string
+    m_Strings.push_back(StringEntry);
+
+    // The header of the pool contains the code page and flags
+    nPoolWords = PoolData.size() / sizeof(WORD);
+    PoolWords = (LPWORD)(PoolData.size() ? &PoolData[0] : NULL);
+    if(nPoolWords >= 2)
+    {
+        m_dwCodePage = PoolWords[0] | ((PoolWords[1] & ~MSI_POOL_LONG_REFS) << 16);
+        m_dwStringRefSize = (PoolWords[1] & MSI_POOL_LONG_REFS) ? MSI_STRING_REF_LONG : MSI_STRING_REF_SHORT;
+    }
+
+    // Parse all pool entries. Each entry is a pair of (length, refcount)
+    for(size_t i = 2; (i + 1) < nPoolWords; )
+    {
+        DWORD dwLength = PoolWords[i];
+        DWORD dwRefs = PoolWords[i + 1];
+
+        // Strings over 64 KB take two entries. The first has zero length,
+        // the second one contains low and high word of the length
+        if(dwLength == 0 && dwRefs != 0)
+        {
+            if((i + 3) >= nPoolWords)
+                break;
+            dwLength = PoolWords[i + 2] | (PoolWords[i + 3] << 16);
+            i += 4;
+        }
+        else
+        {
+            i += 2;
+        }
+
+        // Check the string data
+        if(dwLength > (StringData.size() - nDataOffset))
+            return ERROR_FILE_CORRUPT;
+
+        // Convert the string to UTF-16
+        StringEntry.Offset = (DWORD)(nTextLength);
+        StringEntry.Length = (DWORD)MsiCodePageToUtf16(m_dwCodePage, &StringData[0] + nDataOffset, dwLength, &m_Text[nTextLength]);
+        StringEntry.CsvLength = (DWORD)MsiCsvCellLength(&m_Text[nTextLength], StringEntry.Length);
+        StringEntry.Refs = dwRefs;
+        m_Strings.push_back(StringEntry);
+
+        // Move the offsets
+        nTextLength += StringEntry.Length;
+        nDataOffset += dwLength;
+    }
+    return ERROR_SUCCESS;
+}
+
+size_t TMsiStringPool::MemorySize() const
+{
+    return m_Strings.capacity() * sizeof(MSI_STRING_ENTRY) + m_Text.capacity() * sizeof(WCHAR);
+}
@@ -0,0 +1,292 @@
+/*****************************************************************************/
+/* TMsiSummary.cpp                        Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Native reading of the "\005SummaryInformation" property set               */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 16.10.26  1.00  Lad  Created                                              */
+/*****************************************************************************/
+
+#include "wcx_msi.h"
+#include <algorithm>
+
+//-----------------------------------------------------------------------------
+// Local defines
+
+#define PROPERTY_SET_HEADER_SIZE    0x30                // Header, CLSID, number of sets, the first FMTID and its offset
+#define PROPERTY_SET_BYTE_ORDER     0xFFFE              // Little endian
+#define FILETIME_TICKS_PER_SECOND   10000000ULL         // FILETIME is in 100 ns intervals
+#define FILETIME_DAYS_TO_1970       134774              // Days from 1.1.1601 to 1.1.1970
+
+//-----------------------------------------------------------------------------
+// Local variables
+
+// Names of the properties, the same as the plugin always showed. NULL = not used by MSI
+static const WCHAR * SummaryPropertyNames[MSI_SUMMARY_PROPERTY_COUNT] =
+{
+    NULL,
+    MSI_WSTR("Codepage"),
+    MSI_WSTR("Title"),
+    MSI_WSTR("Subject"),
+    MSI_WSTR("Author"),
+    MSI_WSTR("Keywords"),
+    MSI_WSTR("Comments"),
+    MSI_WSTR("Template"),
+    MSI_WSTR("Last Saved By"),
+    MSI_WSTR("Revision Number"),
+    NULL,
+    MSI_WSTR("Last Printed"),
+    MSI_WSTR("Create Time / Date"),
+    MSI_WSTR("Last Save Time / Date"),
+    MSI_WSTR("Page Count"),
+    MSI_WSTR("Word Count"),
+    MSI_WSTR("Character Count"),
+    NULL,
+    MSI_WSTR("Creating Application"),
+    MSI_WSTR("Security")
+};
+
+//-----------------------------------------------------------------------------
+// Local functions
+
+static WORD GetWord(const BYTE * pbData)
+{
+    return (WORD)(pbData[0] | (pbData[1] << 8));
+}
+
+static DWORD GetDword(const BYTE * pbData)
+{
+    return pbData[0] | (pbData[1] << 8) | (pbData[2] << 16) | ((DWORD)(pbData[3]) << 24);
+}
+
+// Formats the UTC time as "YYYY-MM-DD HH:MM:SS"
+static int FormatFileTime(char * szBuffer, size_t ccBuffer, ULONGLONG FileTime)
+{
+    ULONGLONG Seconds = FileTime / FILETIME_TICKS_PER_SECOND;
+    DWORD dwSecondOfDay = (DWORD)(Seconds % 86400);
+    int nDays = (int)(Seconds / 86400) - FILETIME_DAYS_TO_1970;
+    int nYear, nMonth, nDay, nEra, nDayOfEra, nYearOfEra, nDayOfYear, nMonthIndex;
+
+    // Days since 1.1.1970 to the civil date (proleptic Gregorian calendar)
+    nDays += 719468;
+    nEra = ((nDays >= 0) ? nDays : (nDays - 146096)) / 146097;
+    nDayOfEra = nDays - nEra * 146097;
+    nYearOfEra = (nDayOfEra - nDayOfEra / 1460 + nDayOfEra / 36524 - nDayOfEra / 146096) / 365;
+    nDayOfYear = nDayOfEra - (365 * nYearOfEra + nYearOfEra / 4 - nYearOfEra / 100);
+    nMonthIndex = (5 * nDayOfYear + 2) / 153;
+    nDay = nDayOfYear - (153 * nMonthIndex + 2) / 5 + 1;
+    nMonth = (nMonthIndex < 10) ? (nMonthIndex + 3) : (nMonthIndex - 9);
+    nYear = nYearOfEra + nEra * 400 + ((nMonth <= 2) ? 1 : 0);
+
+    return snprintf(szBuffer, ccBuffer, "%04i-%02i-%02i %02u:%02u:%02u", nYear, nMonth, nDay,
+                                        dwSecondOfDay / 3600, (dwSecondOfDay / 60) % 60, dwSecondOfDay % 60);
+}
+
+static void AppendCsvCell(std::vector<BYTE> & Csv, LPCWSTR szValue, size_t ccValue, bool bFirst)
+{
+    size_t cbCsv = Csv.size();
+
+    Csv.resize(cbCsv + 3 + MsiCsvCellLength(szValue, ccValue));
+    if(bFirst == false)
+        Csv[cbCsv++] = ',';
+    Csv[cbCsv++] = '\"';
+    cbCsv += MsiCsvCellEncode(&Csv[cbCsv], Csv.size() - cbCsv, szValue, ccValue);
+    Csv[cbCsv++] = '\"';
+    Csv.resize(cbCsv);
+}
+
+static void AppendCsvCell(std::vector<BYTE> & Csv, const char * szValue, int nLength)
+{
+    WCHAR szBuffer[0x40];
+
+    // The formatted numbers and times are plain ASCII
+    for(int i = 0; i < nLength; i++)
+        szBuffer[i] = szValue[i];
+    AppendCsvCell(Csv, szBuffer, nLength, false);
+}
+
+//-----------------------------------------------------------------------------
+// TMsiSummary functions
+
+TMsiSummary::TMsiSummary()
+{
+    for(DWORD i = 0; i < MSI_SUMMARY_PROPERTY_COUNT; i++)
+    {
+        m_Properties[i].FileTime = 0;
+        m_Properties[i].IntValue = 0;
+        m_Properties[i].Type = MSI_VT_EMPTY;
+    }
+}
+
+DWORD TMsiSummary::Load(TCompoundFile * pCompFile)
+{
+    std::vector<BYTE> Stream;
+    const BYTE * pbSection;
+    size_t cbSection;
+    DWORD dwCodePage = CP_ACP;
+    DWORD dwProperties;
+    DWORD dwOffset;
+    DWORD dwEntry;
+    DWORD dwErrCode;
+
+    // Load the whole stream. It only has a few hundred bytes
+    if((dwEntry = pCompFile->FindEntry(CFB_ROOT_ENTRY, MSI_WSTR("\005SummaryInformation"))) == CFB_NOSTREAM)
+        return ERROR_FILE_NOT_FOUND;
+    if((dwErrCode = pCompFile->LoadStream(dwEntry, Stream)) != ERROR_SUCCESS)
+        return dwErrCode;
+
+    // Check the header. MSI only uses the first property set
+    if(Stream.size() < PROPERTY_SET_HEADER_SIZE || GetWord(&Stream[0]) != PROPERTY_SET_BYTE_ORDER || GetDword(&Stream[0x18]) == 0)
+        return ERROR_BAD_FORMAT;
+    if((dwOffset = GetDword(&Stream[0x2C])) > Stream.size() - 8)
+        return ERROR_BAD_FORMAT;
+
+    // The section begins with its size and the number of the properties
+    pbSection = &Stream[dwOffset];
+    cbSection = std::min<size_t>(GetDword(pbSection), Stream.size() - dwOffset);
+    dwProperties = GetDword(pbSection + 4);
+    if(cbSection < 8 || dwProperties > (cbSection - 8) / 8)
+        return ERROR_BAD_FORMAT;
+
+    // The strings are in the code page of the property set
+    for(DWORD i = 0; i < dwProperties; i++)
+    {
+        if(GetDword(pbSection + 8 + i * 8) == MSI_PID_CODEPAGE)
+        {
+            if(LoadProperty(pbSection, cbSection, MSI_PID_CODEPAGE, GetDword(pbSection + 12 + i * 8), 0) == ERROR_SUCCESS)
+                dwCodePage = (WORD)(m_Properties[MSI_PID_CODEPAGE].IntValue);
+            break;
+        }
+    }
+
+    // Load the properties. Unknown and damaged ones are left out
+    for(DWORD i = 0; i < dwProperties; i++)
+    {
+        DWORD dwPropertyId = GetDword(pbSection + 8 + i * 8);
+
+        if(dwPropertyId < MSI_SUMMARY_PROPERTY_COUNT && dwPropertyId != MSI_PID_CODEPAGE)
+        {
+            LoadProperty(pbSection, cbSection, dwPropertyId, GetDword(pbSection + 12 + i * 8), dwCodePage);
+        }
+    }
+    return ERROR_SUCCESS;
+}
+
+// Renders the properties to CSV, the same way as the plugin does
+void TMsiSummary::RenderCsv(std::vector<BYTE> & Csv) const
+{
+    char szValue[0x40];
+    int nLength;
+
+    // The UTF-8 marker and the header
+    Csv.clear();
+    Csv.push_back(0xEF);
+    Csv.push_back(0xBB);
+    Csv.push_back(0xBF);
+    AppendCsvCell(Csv, MSI_WSTR("Name"), 4, true);
+    AppendCsvCell(Csv, MSI_WSTR("Value"), 5, false);
+    Csv.push_back('\r');
+    Csv.push_back('\n');
+
+    // One row per property, in the order of their IDs
+    for(DWORD i = 0; i < MSI_SUMMARY_PROPERTY_COUNT; i++)
+    {
+        const MSI_SUMMARY_PROPERTY & Property = m_Properties[i];
+        LPCWSTR szName = SummaryPropertyNames[i];
+
+        if(Property.Type == MSI_VT_EMPTY || szName == NULL)
+            continue;
+
+        AppendCsvCell(Csv, szName, std::char_traits<WCHAR>::length(szName), true);
+        switch(Property.Type)
+        {
+            case MSI_VT_I2:
+            case MSI_VT_I4:
+                nLength = snprintf(szValue, _countof(szValue), "%i", Property.IntValue);
+                AppendCsvCell(Csv, szValue, nLength);
+                break;
+
+            case MSI_VT_FILETIME:
+                if((Property.FileTime >> 32) != 0)
+                    nLength = FormatFileTime(szValue, _countof(szValue), Property.FileTime);
+                else
+                    nLength = snprintf(szValue, _countof(szValue), "N/A");
+                AppendCsvCell(Csv, szValue, nLength);
+                break;
+
+            case MSI_VT_LPSTR:
+                AppendCsvCell(Csv, Property.Value.c_str(), Property.Value.size(), false);
+                break;
+        }
+        Csv.push_back('\r');
+        Csv.push_back('\n');
+    }
+}
+
+DWORD TMsiSummary::LoadProperty(const BYTE * pbSection, size_t cbSection, DWORD dwPropertyId, DWORD dwOffset, DWORD dwCodePage)
+{
+    MSI_SUMMARY_PROPERTY & Property = m_Properties[dwPropertyId];
+    std::vector<WCHAR> Buffer;
+    const BYTE * pbValue;
+    size_t cbValue;
+    DWORD dwType;
+
+    // Each value begins with its type, padded to 4 bytes
+    if(dwOffset < 8 || dwOffset > cbSection - 4)
+        return ERROR_BAD_FORMAT;
+    dwType = GetWord(pbSection + dwOffset);
+    pbValue = pbSection + dwOffset + 4;
+    cbValue = cbSection - dwOffset - 4;
+
+    switch(dwType)
+    {
+        case MSI_VT_I2:
+            if(cbValue < 2)
+                return ERROR_BAD_FORMAT;
+            Property.IntValue = (short)(GetWord(pbValue));
+            break;
+
+        case MSI_VT_I4:
+            if(cbValue < 4)
+                return ERROR_BAD_FORMAT;
+            Property.IntValue = (int)(GetDword(pbValue));
+            break;
+
+        case MSI_VT_FILETIME:
+            if(cbValue < 8)
+                return ERROR_BAD_FORMAT;
+            Property.FileTime = ((ULONGLONG)(GetDword(pbValue + 4)) << 32) | GetDword(pbValue);
+            break;
+
+        case MSI_VT_LPSTR:
+        {
+            size_t cbString;
+
+            // The length includes the terminating zero
+            if(cbValue < 4 || (cbString = GetDword(pbValue)) > cbValue - 4)
+                return ERROR_BAD_FORMAT;
+            pbValue += 4;
+            while(cbString > 0 && pbValue[cbString - 1] == 0)
+                cbString--;
+
+            Buffer.resize(cbString + 1);
+            Property.Value.assign(&Buffer[0], MsiCodePageToUtf16(dwCodePage, pbValue, cbString, &Buffer[0]));
+            break;
+        }
+
+        default:
+            return ERROR_NOT_SUPPORTED;
+    }
+
+    Property.Type = dwType;
+    return ERROR_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// Public functions
+
+LPCWSTR MsiSummaryPropertyName(DWORD dwPropertyId)
+{
+    return (dwPropertyId < MSI_SUMMARY_PROPERTY_COUNT) ? SummaryPropertyNames[dwPropertyId] : NULL;
+}
@@ -10,6 +10,31 @@
 
 #include "wcx_msi.h"
 
+//-----------------------------------------------------------------------------
+// Local functions
+
+// Formats the column type the same way like MsiViewGetColumnInfo(MSICOLINFO_TYPES)
+static void FormatColumnType(DWORD dwType, LPTSTR szColumnType, size_t ccColumnType)
+{
+    TCHAR chType;
+
+    // Get the type letter
+    if(MSI_COLUMN_IS_BINARY(dwType))
+        chType = _T('v');
+    else if(dwType & MSI_COLUMN_LOCALIZABLE)
+        chType = _T('l');
+    else if(dwType & MSI_COLUMN_STRING)
+        chType = _T('s');
+    else
+        chType = _T('i');
+
+    // Nullable columns have the letter in upper case
+    if(dwType & MSI_COLUMN_NULLABLE)
+        chType = (TCHAR)(chType - _T('a') + _T('A'));
+
+    StringCchPrintf(szColumnType, ccColumnType, _T("%c%u"), chType, (dwType & MSI_COLUMN_WIDTH_MASK));
+}
+
 //-----------------------------------------------------------------------------
 // TMsiColumn constructor
 
@@ -63,12 +88,13 @@ TMsiColumn::TMsiColumn(LPCTSTR szName, LPCTSTR szType)
 
 TMsiTable::TMsiTable(TMsiDatabase * pMsiDb, const std::tstring & strName, MSIHANDLE hMsiView)
 {
-    InitializeListHead(&m_Entry);
     m_strName = strName;
     m_hMsiView = hMsiView;
+    m_pTableData = NULL;
     m_nStreamColumn = INVALID_SIZE_T;
     m_nNameColumn = INVALID_SIZE_T;
     m_bIsStreamsTable = FALSE;
+    m_bDataLoaded = FALSE;
     m_dwRefs = 1;
 
     // Check for the "_Streams" table
@@ -92,6 +118,11 @@ TMsiTable::~TMsiTable()
         m_pMsiDb->Release();
     m_pMsiDb = NULL;
 
+    // Free the decoded table data
+    if(m_pTableData != NULL)
+        delete m_pTableData;
+    m_pTableData = NULL;
+
     // Close the view handle
     if(m_hMsiView != NULL)
         MSI_CLOSE_HANDLE(m_hMsiView);
@@ -123,30 +154,92 @@ DWORD TMsiTable::Load()
     // Load the columns
     if((dwErrCode = LoadColumns()) == ERROR_SUCCESS)
     {
-        // Check if we have a stream column
+        // Load the primary keys. We need them for locating the streams
+        LoadPrimaryKeys();
+        FindSpecialColumns();
+    }
+    return dwErrCode;
+}
+
+DWORD TMsiTable::LoadFromCatalog(const MSI_CATALOG_TABLE & CatalogTable)
+{
+    TCHAR szColumnType[16];
+
+    // Insert all columns. The primary key columns have the key flag
+    for(size_t i = 0; i < CatalogTable.Columns.size(); i++)
+    {
+        const MSI_CATALOG_COLUMN & Column = CatalogTable.Columns[i];
+
+        FormatColumnType(Column.Type, szColumnType, _countof(szColumnType));
+        m_Columns.push_back(TMsiColumn(Column.Name.c_str(), szColumnType));
+
+        if(Column.Type & MSI_COLUMN_KEY)
+        {
+            m_KeyColumns.push_back(i);
+        }
+    }
+
+    FindSpecialColumns();
+    return ERROR_SUCCESS;
+}
+
+void TMsiTable::FindSpecialColumns()
+{
+    // Check if we have a stream column
+    for(size_t i = 0; i < m_Columns.size(); i++)
+    {
+        if(m_Columns[i].m_Type == MsiTypeStream)
+        {
+            m_nStreamColumn = i;
+            break;
+        }
+    }
+
+    // If we have a stream column, take the first string as name
+    if(m_nStreamColumn != INVALID_SIZE_T)
+    {
         for(size_t i = 0; i < m_Columns.size(); i++)
         {
-            if(m_Columns[i].m_Type == MsiTypeStream)
+            if(m_Columns[i].m_Type == MsiTypeString)
             {
-                m_nStreamColumn = i;
+                m_nNameColumn = i;
                 break;
             }
         }
+    }
+}
 
-        // If we have a stream column, take the first string as name
-        if(m_nStreamColumn != INVALID_SIZE_T)
+size_t TMsiTable::FindColumn(LPCTSTR szColumnName, MSI_TYPE ColumnType)
+{
+    for(size_t i = 0; i < m_Columns.size(); i++)
+    {
+        if(m_Columns[i].m_Type == ColumnType && !_tcsicmp(m_Columns[i].m_strName.c_str(), szColumnName))
         {
-            for(size_t i = 0; i < m_Columns.size(); i++)
-            {
-                if(m_Columns[i].m_Type == MsiTypeString)
-                {
-                    m_nNameColumn = i;
-                    break;
-                }
-            }
+            return i;
         }
     }
-    return dwErrCode;
+    return INVALID_SIZE_T;
+}
+
+MSIHANDLE TMsiTable::MsiView()
+{
+    TCHAR szQuery[256];
+
+    // Tables from the native catalog open their view only when it's needed
+    if(m_hMsiView == NULL && m_bIsStreamsTable == FALSE && m_pMsiDb->MsiHandle() != NULL)
+    {
+        StringCchPrintf(szQuery, _countof(szQuery), _T("SELECT * FROM %s"), m_strName.c_str());
+        if(MsiDatabaseOpenView(m_pMsiDb->MsiHandle(), szQuery, &m_hMsiView) == ERROR_SUCCESS)
+        {
+            // Log the handle for diagnostics
+            MSI_LOG_OPEN_HANDLE(m_hMsiView);
+        }
+        else
+        {
+            m_hMsiView = NULL;
+        }
+    }
+    return m_hMsiView;
 }
 
 DWORD TMsiTable::LoadColumns()
@@ -197,3 +290,101 @@ DWORD TMsiTable::LoadColumns()
     }
     return dwErrCode;
 }
+
+DWORD TMsiTable::LoadPrimaryKeys()
+{
+    MSIHANDLE hMsiKeys = NULL;
+    DWORD dwErrCode;
+    UINT uKeys;
+
+    // Retrieve the names of the primary key columns
+    if((dwErrCode = MsiDatabaseGetPrimaryKeys(m_pMsiDb->MsiHandle(), m_strName.c_str(), &hMsiKeys)) == ERROR_SUCCESS)
+    {
+        // Log the handle for diagnostics
+        MSI_LOG_OPEN_HANDLE(hMsiKeys);
+
+        // Convert the names to column indexes
+        uKeys = MsiRecordGetFieldCount(hMsiKeys);
+        for(UINT i = 0; i < uKeys; i++)
+        {
+            TCHAR szKeyName[128];
+            DWORD ccKeyName = _countof(szKeyName);
+
+            if(MsiRecordGetString(hMsiKeys, i + 1, szKeyName, &ccKeyName) == ERROR_SUCCESS)
+            {
+                for(size_t j = 0; j < m_Columns.size(); j++)
+                {
+                    if(m_Columns[j].m_strName == szKeyName)
+                    {
+                        m_KeyColumns.push_back(j);
+                        break;
+                    }
+                }
+            }
+        }
+        MSI_CLOSE_HANDLE(hMsiKeys);
+    }
+    return dwErrCode;
+}
+
+TMsiTableData * TMsiTable::Data()
+{
+    std::vector<MSI_COLUMN_LAYOUT> Layout(m_Columns.size());
+    TMsiStringPool * pStringPool;
+    TCompoundFile * pCompFile;
+    TMsiTableData * pTableData;
+
+    // Already loaded? The table is decoded only once, while the snapshot
+    // is being built. After that, the table data never change.
+    if(m_bDataLoaded)
+        return m_pTableData;
+    m_bDataLoaded = TRUE;
+
+    // We need native access to the database
+    if((pCompFile = m_pMsiDb->CompoundFile()) == NULL || m_bIsStreamsTable)
+        return NULL;
+    if((pStringPool = m_pMsiDb->StringPool()) == NULL)
+        return NULL;
+
+    // Setup the layout of the table stream from the column types
+    for(size_t i = 0; i < m_Columns.size(); i++)
+    {
+        Layout[i].IsKey = false;
+        switch(m_Columns[i].m_Type)
+        {
+            case MsiTypeInteger:
+                Layout[i].CellType = MsiCellInteger;
+                Layout[i].Width = (m_Columns[i].m_Size <= 2) ? 2 : 4;
+                break;
+
+            case MsiTypeString:
+                Layout[i].CellType = MsiCellString;
+                Layout[i].Width = pStringPool->StringRefSize();
+                break;
+
+            case MsiTypeStream:
+                Layout[i].CellType = MsiCellStream;
+                Layout[i].Width = 2;
+                break;
+
+            default:
+                return NULL;
+        }
+    }
+
+    // Mark the primary key columns
+    for(size_t i = 0; i < m_KeyColumns.size(); i++)
+        Layout[m_KeyColumns[i]].IsKey = true;
+
+    // Decode the table stream
+    if((pTableData = new TMsiTableData()) != NULL)
+    {
+        if(pTableData->Load(pCompFile, m_strName, Layout) == ERROR_SUCCESS)
+        {
+            m_pTableData = pTableData;
+            return m_pTableData;
+        }
+        delete pTableData;
+    }
+    return NULL;
+}
@@ -0,0 +1,163 @@
+/*****************************************************************************/
+/* TMsiTableData.cpp                      Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Native decoder of the MSI table streams                                   */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 16.10.26  1.00  Lad  Created                                              */
+/*****************************************************************************/
+
+#include "wcx_msi.h"
+
+//-----------------------------------------------------------------------------
+// Local (non-class) functions
+
+static void AppendInteger(CFB_NAME & strValue, int nValue)
+{
+    WCHAR szBuffer[16];
+    size_t nIndex = _countof(szBuffer);
+    DWORD dwValue = (nValue < 0) ? (DWORD)(-(LONGLONG)nValue) : (DWORD)(nValue);
+
+    // Convert the number, from the end
+    do
+    {
+        szBuffer[--nIndex] = (WCHAR)('0' + (dwValue % 10));
+        dwValue /= 10;
+    }
+    while(dwValue != 0);
+
+    // Append the sign
+    if(nValue < 0)
+        szBuffer[--nIndex] = '-';
+    strValue.append(szBuffer + nIndex, _countof(szBuffer) - nIndex);
+}
+
+//-----------------------------------------------------------------------------
+// TMsiTableData functions
+
+TMsiTableData::TMsiTableData()
+{
+    m_dwRows = 0;
+}
+
+DWORD TMsiTableData::Load(TCompoundFile * pCompFile, const CFB_NAME & strTableName, const std::vector<MSI_COLUMN_LAYOUT> & Layout)
+{
+    std::vector<BYTE> TableData;
+    CFB_NAME strEncoded;
+    LPBYTE pbColumn;
+    DWORD dwRowSize = 0;
+    DWORD dwEntry;
+    DWORD dwErrCode;
+
+    // Calculate the size of one row
+    for(size_t i = 0; i < Layout.size(); i++)
+    {
+        if(Layout[i].Width != 2 && Layout[i].Width != 3 && Layout[i].Width != 4)
+            return ERROR_BAD_FORMAT;
+        dwRowSize += Layout[i].Width;
+    }
+    m_Layout = Layout;
+
+    // Load the whole table stream in one read. Empty tables may have no stream at all
+    MsiEncodeStreamName(strTableName, true, strEncoded);
+    if((dwEntry = pCompFile->FindEntry(CFB_ROOT_ENTRY, strEncoded)) != CFB_NOSTREAM)
+    {
+        if((dwErrCode = pCompFile->LoadStream(dwEntry, TableData)) != ERROR_SUCCESS)
+            return dwErrCode;
+    }
+
+    // Allocate the cells
+    m_dwRows = (dwRowSize != 0) ? (DWORD)(TableData.size() / dwRowSize) : 0;
+    m_Cells.resize(Layout.size() * m_dwRows);
+    if(m_dwRows == 0)
+        return ERROR_SUCCESS;
+    pbColumn = &TableData[0];
+
+    // Decode the columns
+    for(size_t i = 0; i < Layout.size(); i++)
+    {
+        DWORD * pCells = &m_Cells[i * m_dwRows];
+        LPBYTE pbCell = pbColumn;
+
+        switch(Layout[i].Width)
+        {
+            case 2:
+                for(DWORD dwRow = 0; dwRow < m_dwRows; dwRow++, pbCell += 2)
+                    pCells[dwRow] = pbCell[0] | (pbCell[1] << 8);
+                break;
+
+            case 3:
+                for(DWORD dwRow = 0; dwRow < m_dwRows; dwRow++, pbCell += 3)
+                    pCells[dwRow] = pbCell[0] | (pbCell[1] << 8) | (pbCell[2] << 16);
+                break;
+
+            case 4:
+                for(DWORD dwRow = 0; dwRow < m_dwRows; dwRow++, pbCell += 4)
+                    pCells[dwRow] = pbCell[0] | (pbCell[1] << 8) | (pbCell[2] << 16) | ((DWORD)(pbCell[3]) << 24);
+                break;
+        }
+
+        // Remove the bias from integers. Zero means NULL
+        if(Layout[i].CellType == MsiCellInteger)
+        {
+            DWORD dwBias = (Layout[i].Width == 2) ? 0x8000 : 0x80000000;
+
+            for(DWORD dwRow = 0; dwRow < m_dwRows; dwRow++)
+            {
+                if(pCells[dwRow] != 0)
+                    pCells[dwRow] = (DWORD)((int)(pCells[dwRow] - dwBias));
+                else
+                    pCells[dwRow] = MSI_NULL_INTEGER;
+            }
+
+            // Sign-extend the 16-bit values
+            if(Layout[i].Width == 2)
+            {
+                for(DWORD dwRow = 0; dwRow < m_dwRows; dwRow++)
+                {
+                    if(pCells[dwRow] != MSI_NULL_INTEGER)
+                    {
+                        pCells[dwRow] = (DWORD)(int)(short)(pCells[dwRow]);
+                    }
+                }
+            }
+        }
+
+        // Move to the next column
+        pbColumn += m_dwRows * Layout[i].Width;
+    }
+    return ERROR_SUCCESS;
+}
+
+void TMsiTableData::BuildStreamName(const TMsiStringPool & StringPool, const CFB_NAME & strTableName, DWORD dwRow, CFB_NAME & strStreamName) const
+{
+    LPCWSTR szString;
+    size_t ccString;
+
+    // The stream name is "Table.Key1.Key2..."
+    strStreamName = strTableName;
+    for(size_t i = 0; i < m_Layout.size(); i++)
+    {
+        if(m_Layout[i].IsKey)
+        {
+            DWORD dwCell = Cell(i, dwRow);
+
+            strStreamName.append(1, '.');
+            switch(m_Layout[i].CellType)
+            {
+                case MsiCellInteger:
+                    AppendInteger(strStreamName, (int)(dwCell));
+                    break;
+
+                case MsiCellString:
+                    szString = StringPool.String(dwCell, ccString);
+                    strStreamName.append(szString, ccString);
+                    break;
+
+                default:
+                    break;
+            }
+        }
+    }
+}
@@ -0,0 +1,231 @@
+/*****************************************************************************/
+/* TStreamPrefetcher.cpp                  Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Background loading of the streams that will be extracted next             */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 16.10.26  1.00  Lad  Created                                              */
+/*****************************************************************************/
+
+#include "wcx_msi.h"
+
+//-----------------------------------------------------------------------------
+// TStreamPrefetcher functions
+
+TStreamPrefetcher::TStreamPrefetcher()
+{
+    m_pCompFile = NULL;
+    m_cbMaxMemory = 0;
+    m_cbMemory = 0;
+    m_dwLookahead = 0;
+    m_dwSequence = 0;
+    m_bStopping = false;
+}
+
+TStreamPrefetcher::~TStreamPrefetcher()
+{
+    Stop();
+}
+
+void TStreamPrefetcher::Open(TCompoundFile * pCompFile, DWORD dwLookahead, size_t cbMaxMemory)
+{
+    Stop();
+
+    // Readers may already ask for the streams meanwhile
+    std::lock_guard<std::mutex> Lock(m_Lock);
+    m_pCompFile = pCompFile;
+    m_dwLookahead = (dwLookahead < CFB_PREFETCH_MAX_FILES) ? dwLookahead : CFB_PREFETCH_MAX_FILES;
+    m_cbMaxMemory = cbMaxMemory;
+}
+
+// Asks for loading the stream in the background. Returns false
+// if the stream is not worth loading ahead or there is no room for it
+bool TStreamPrefetcher::Request(DWORD dwEntry)
+{
+    std::lock_guard<std::mutex> Lock(m_Lock);
+    CFB_PREFETCH_ITEM Item;
+
+    // Not open or being stopped?
+    if(m_pCompFile == NULL || m_bStopping || dwEntry >= m_pCompFile->EntryCount())
+        return false;
+
+    // Streams that don't fit the memory are read directly, by chunks
+    if(m_pCompFile->Entry(dwEntry).Size > m_cbMaxMemory)
+        return false;
+
+    // Already requested, or too many streams ahead?
+    if(m_Items.size() >= m_dwLookahead || FindItem(dwEntry) != m_Items.end())
+        return false;
+
+    // Queue the stream
+    Item.Size = m_pCompFile->Entry(dwEntry).Size;
+    Item.dwEntry = dwEntry;
+    Item.dwSequence = m_dwSequence++;
+    Item.State = CfbPrefetchQueued;
+    m_Items.push_back(Item);
+
+    // The worker is started by the first request. It waits for the lock until we are done
+    if(!m_Thread.joinable())
+        m_Thread = std::thread(WorkerThread, this);
+    m_Changed.notify_all();
+    return true;
+}
+
+// Gives the loaded stream to the caller. Returns false if the stream
+// has not been loaded ahead; then the caller reads it directly.
+bool TStreamPrefetcher::Take(DWORD dwEntry, std::vector<BYTE> & Data)
+{
+    std::unique_lock<std::mutex> Lock(m_Lock);
+    std::list<CFB_PREFETCH_ITEM>::iterator iter;
+    bool bResult = false;
+
+    // Was the stream requested at all?
+    if((iter = FindItem(dwEntry)) == m_Items.end())
+        return false;
+
+    // The streams requested before this one have been skipped. Drop them.
+    // A stream being loaded just now is released by the worker.
+    while(m_Items.begin() != iter)
+    {
+        if(m_Items.front().State == CfbPrefetchDone)
+            m_cbMemory -= (size_t)(m_Items.front().Size);
+        m_Items.pop_front();
+    }
+
+    // If the worker is loading the stream, wait for it
+    m_Changed.wait(Lock, [&iter]()
+    {
+        return (iter->State != CfbPrefetchLoading);
+    });
+
+    // Take the data. If the stream has not been started yet, we are faster than the worker
+    if(iter->State == CfbPrefetchDone)
+    {
+        m_cbMemory -= (size_t)(iter->Size);
+        Data.swap(iter->Data);
+        bResult = true;
+    }
+
+    // Make room for the next streams
+    m_Items.erase(iter);
+    m_Changed.notify_all();
+    return bResult;
+}
+
+// Forgets the stream that will not be read (e.g. the user skipped the file)
+void TStreamPrefetcher::Drop(DWORD dwEntry)
+{
+    std::lock_guard<std::mutex> Lock(m_Lock);
+    std::list<CFB_PREFETCH_ITEM>::iterator iter;
+
+    // A stream being loaded just now is released by the worker
+    if((iter = FindItem(dwEntry)) != m_Items.end())
+    {
+        if(iter->State == CfbPrefetchDone)
+            m_cbMemory -= (size_t)(iter->Size);
+        m_Items.erase(iter);
+        m_Changed.notify_all();
+    }
+}
+
+void TStreamPrefetcher::Stop()
+{
+    // Tell the worker to exit and wait for it. A stream
+    // being loaded just now is finished first.
+    {
+        std::lock_guard<std::mutex> Lock(m_Lock);
+
+        m_bStopping = true;
+        m_Changed.notify_all();
+    }
+
+    if(m_Thread.joinable())
+        m_Thread.join();
+
+    // Free the loaded streams
+    m_Items.clear();
+    m_pCompFile = NULL;
+    m_cbMemory = 0;
+    m_bStopping = false;
+}
+
+//-----------------------------------------------------------------------------
+// Protected functions
+
+void TStreamPrefetcher::WorkerThread(TStreamPrefetcher * pPrefetcher)
+{
+    pPrefetcher->WorkerMain();
+}
+
+void TStreamPrefetcher::WorkerMain()
+{
+    std::unique_lock<std::mutex> Lock(m_Lock);
+    std::list<CFB_PREFETCH_ITEM>::iterator iter;
+
+    while(m_bStopping == false)
+    {
+        std::vector<BYTE> Data;
+        ULONGLONG Size;
+        DWORD dwSequence;
+        DWORD dwEntry;
+        DWORD dwErrCode;
+
+        // Find the oldest stream that waits for loading
+        for(iter = m_Items.begin(); iter != m_Items.end(); iter++)
+        {
+            if(iter->State == CfbPrefetchQueued)
+                break;
+        }
+
+        // Wait if there is nothing to do or the memory is full
+        if(iter == m_Items.end() || (m_cbMemory + iter->Size) > m_cbMaxMemory)
+        {
+            m_Changed.wait(Lock);
+            continue;
+        }
+
+        // Reserve the memory and load the stream without holding the lock
+        iter->State = CfbPrefetchLoading;
+        m_cbMemory += (size_t)(iter->Size);
+        dwSequence = iter->dwSequence;
+        dwEntry = iter->dwEntry;
+        Size = iter->Size;
+
+        Lock.unlock();
+        dwErrCode = m_pCompFile->LoadStream(dwEntry, Data);
+        Lock.lock();
+
+        // The consumer may have dropped the item meanwhile
+        for(iter = m_Items.begin(); iter != m_Items.end(); iter++)
+        {
+            if(iter->dwSequence == dwSequence)
+                break;
+        }
+
+        if(iter != m_Items.end() && dwErrCode == ERROR_SUCCESS)
+        {
+            iter->Data.swap(Data);
+            iter->State = CfbPrefetchDone;
+        }
+        else
+        {
+            if(iter != m_Items.end())
+                iter->State = CfbPrefetchFailed;
+            m_cbMemory -= (size_t)(Size);
+        }
+        m_Changed.notify_all();
+    }
+}
+
+std::list<CFB_PREFETCH_ITEM>::iterator TStreamPrefetcher::FindItem(DWORD dwEntry)
+{
+    std::list<CFB_PREFETCH_ITEM>::iterator iter;
+
+    for(iter = m_Items.begin(); iter != m_Items.end(); iter++)
+    {
+        if(iter->dwEntry == dwEntry)
+            break;
+    }
+    return iter;
+}
@@ -0,0 +1,1074 @@
+/*****************************************************************************/
+/* bench_archive.cpp                      Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Generator of synthetic MSI files and the benchmark of opening, listing,   */
+/* sizing and extracting them. Results are printed as JSON                   */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 16.10.26  1.00  Lad  Created                                              */
+/*****************************************************************************/
+
+#include "../wcx_msi.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+//-----------------------------------------------------------------------------
+// Local defines
+
+#define GEN_SECTOR_SHIFT        12                      // Version 4 compound file, so that streams may be over 4 GB
+#define GEN_SECTOR_SIZE         (1 << GEN_SECTOR_SHIFT)
+#define GEN_MINI_SECTOR_SIZE    64
+#define GEN_MINI_STREAM_CUTOFF  0x1000
+#define GEN_ENTRIES_PER_SECTOR  (GEN_SECTOR_SIZE / sizeof(DWORD))
+#define GEN_DIRENTRY_SIZE       128
+#define GEN_WRITE_BUFFER        0x100000
+
+#define MSI_TYPE_STRING(w)      (MSI_COLUMN_VALID | MSI_COLUMN_STRING | (w))
+#define MSI_TYPE_INTEGER(w)     (MSI_COLUMN_VALID | (w))
+#define MSI_TYPE_BINARY         (MSI_COLUMN_VALID | MSI_COLUMN_STRING | MSI_COLUMN_NULLABLE)
+
+//-----------------------------------------------------------------------------
+// Local structures
+
+// Shape of the generated MSI
+struct BENCH_SHAPE
+{
+    DWORD dwFileRows;                                   // Rows of the "File" table
+    DWORD dwExtraStrings;                               // Unique values in the "Property" table
+    DWORD dwBinaries;                                   // Rows of the "Binary" table, each with a stream
+    DWORD dwStreams;                                    // Streams that are not in any table
+    ULONGLONG StreamSize;                               // Size of each binary and loose stream
+    DWORD dwSeed;                                       // Seed of the random generator
+    bool bLongRefs;                                     // Use 3-byte string IDs even if the pool is small
+};
+
+struct GEN_COLUMN
+{
+    const char * szName;
+    DWORD dwType;                                       // MSI_COLUMN_XXX and the width
+};
+
+struct GEN_STREAM
+{
+    CFB_NAME strName;                                   // Encoded name of the stream
+    std::vector<BYTE> Data;                             // Data of the table streams
+    ULONGLONG Size;                                     // Size of the stream
+    ULONGLONG Seed;                                     // Seed of the generated data (if Data is empty)
+    DWORD dwStart;                                      // First sector or mini sector
+};
+
+// Table as it is being generated. Cells are string IDs,
+// integer values (or MSI_NULL_INTEGER) and stream flags
+struct TGenTable
+{
+    TGenTable(const char * szTableName, const GEN_COLUMN * pColumns, size_t nColumns)
+    {
+        strName = szTableName;
+        Columns.assign(pColumns, pColumns + nColumns);
+        dwRows = 0;
+    }
+
+    void AddRow(const DWORD * pValues)
+    {
+        Cells.insert(Cells.end(), pValues, pValues + Columns.size());
+        dwRows++;
+    }
+
+    std::string strName;
+    std::vector<GEN_COLUMN> Columns;
+    std::vector<DWORD> Cells;                           // Row by row
+    DWORD dwRows;
+};
+
+struct TGenStringPool
+{
+    TGenStringPool()
+    {
+        m_Strings.push_back(std::string());
+        m_Refs.push_back(0);
+    }
+
+    DWORD Add(const std::string & strValue)
+    {
+        std::unordered_map<std::string, DWORD>::iterator iter;
+        DWORD dwStringId;
+
+        // String ID 0 is the null string
+        if(strValue.size() == 0)
+            return 0;
+
+        // Reuse the existing string
+        if((iter = m_Index.find(strValue)) == m_Index.end())
+        {
+            dwStringId = (DWORD)(m_Strings.size());
+            m_Index[strValue] = dwStringId;
+            m_Strings.push_back(strValue);
+            m_Refs.push_back(0);
+        }
+        else
+        {
+            dwStringId = iter->second;
+        }
+
+        m_Refs[dwStringId]++;
+        return dwStringId;
+    }
+
+    std::unordered_map<std::string, DWORD> m_Index;
+    std::vector<std::string> m_Strings;
+    std::vector<DWORD> m_Refs;
+};
+
+// Buffered sequential writer of the compound file
+struct TGenWriter
+{
+    TGenWriter(FILE * fp) : m_Buffer(GEN_WRITE_BUFFER)
+    {
+        m_fp = fp;
+        m_cbBuffer = 0;
+        m_bFailed = false;
+    }
+
+    void Write(const void * pvData, size_t cbData)
+    {
+        const BYTE * pbData = (const BYTE *)(pvData);
+
+        while(cbData > 0)
+        {
+            size_t cbCopy = std::min(cbData, m_Buffer.size() - m_cbBuffer);
+
+            memcpy(&m_Buffer[m_cbBuffer], pbData, cbCopy);
+            m_cbBuffer += cbCopy;
+            pbData += cbCopy;
+            cbData -= cbCopy;
+            if(m_cbBuffer == m_Buffer.size())
+                Flush();
+        }
+    }
+
+    void WriteFill(BYTE Value, size_t cbData)
+    {
+        std::vector<BYTE> Fill(std::min<size_t>(cbData, GEN_SECTOR_SIZE), Value);
+
+        for(size_t cbChunk; cbData > 0; cbData -= cbChunk)
+        {
+            cbChunk = std::min(cbData, Fill.size());
+            Write(&Fill[0], cbChunk);
+        }
+    }
+
+    // Pads the data written so far to the next sector boundary
+    void PadSector(ULONGLONG cbWritten, BYTE Value = 0)
+    {
+        if(cbWritten % GEN_SECTOR_SIZE)
+            WriteFill(Value, (size_t)(GEN_SECTOR_SIZE - (cbWritten % GEN_SECTOR_SIZE)));
+    }
+
+    void Flush()
+    {
+        if(m_cbBuffer && fwrite(&m_Buffer[0], 1, m_cbBuffer, m_fp) != m_cbBuffer)
+            m_bFailed = true;
+        m_cbBuffer = 0;
+    }
+
+    std::vector<BYTE> m_Buffer;
+    size_t m_cbBuffer;
+    FILE * m_fp;
+    bool m_bFailed;
+};
+
+struct BENCH_PHASE
+{
+    BENCH_PHASE()
+    {
+        Seconds = 0;
+        Bytes = 0;
+        dwItems = 0;
+        PeakRssKb = 0;
+    }
+
+    double Seconds;
+    ULONGLONG Bytes;
+    DWORD dwItems;
+    ULONGLONG PeakRssKb;                                // Peak RSS of the process after the phase
+};
+
+struct TBulkJob
+{
+    TMsiArchive * pArchive;
+    std::vector<std::vector<DWORD> > Units;             // All items, grouped by TMsiArchive::GroupItems
+    std::atomic<size_t> nNextUnit;
+    std::atomic<ULONGLONG> Bytes;
+    std::atomic<DWORD> dwFailed;
+};
+
+//-----------------------------------------------------------------------------
+// Generator of the MSI file
+
+static CFB_NAME AsciiToName(const std::string & strValue)
+{
+    return CFB_NAME(strValue.begin(), strValue.end());
+}
+
+static std::string RandomName(std::mt19937 & Random, const char * szPrefix, DWORD dwIndex)
+{
+    static const char szNameChars[] = "abcdefghijklmnopqrstuvwxyz0123456789";
+    char szIndex[16];
+    std::string strValue(szPrefix);
+
+    for(size_t nLength = 4 + Random() % 12; nLength > 0; nLength--)
+        strValue.append(1, szNameChars[Random() % (_countof(szNameChars) - 1)]);
+    snprintf(szIndex, _countof(szIndex), "_%u", dwIndex);
+    return strValue + szIndex;
+}
+
+static std::string RandomGuid(std::mt19937 & Random)
+{
+    static const char szHexChars[] = "0123456789ABCDEF";
+    static const char szTemplate[] = "{xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx}";
+    std::string strValue;
+
+    for(size_t i = 0; szTemplate[i] != 0; i++)
+        strValue.append(1, (szTemplate[i] == 'x') ? szHexChars[Random() % 16] : szTemplate[i]);
+    return strValue;
+}
+
+// Fills the buffer with pseudo-random bytes, continuing from the state
+static void FillStreamData(LPBYTE pbBuffer, size_t cbBuffer, ULONGLONG & State)
+{
+    for(size_t i = 0; i < cbBuffer; i += sizeof(ULONGLONG))
+    {
+        State ^= State << 13;
+        State ^= State >> 7;
+        State ^= State << 17;
+        memcpy(pbBuffer + i, &State, std::min(sizeof(ULONGLONG), cbBuffer - i));
+    }
+}
+
+// Encodes the table to the column-major stream, with the biased integers
+static void EncodeTable(const TGenTable & Table, DWORD dwStringRefSize, std::vector<BYTE> & Data)
+{
+    for(size_t nColumn = 0; nColumn < Table.Columns.size(); nColumn++)
+    {
+        DWORD dwType = Table.Columns[nColumn].dwType;
+        DWORD dwWidth = (dwType & MSI_COLUMN_WIDTH_MASK) <= 2 ? 2 : 4;
+        DWORD dwBias = (dwWidth == 2) ? 0x8000 : 0x80000000;
+
+        // Strings are string IDs, binary columns are 2-byte flags
+        if(MSI_COLUMN_IS_BINARY(dwType))
+            dwWidth = 2;
+        else if(dwType & MSI_COLUMN_STRING)
+            dwWidth = dwStringRefSize;
+
+        for(DWORD dwRow = 0; dwRow < Table.dwRows; dwRow++)
+        {
+            DWORD dwValue = Table.Cells[dwRow * Table.Columns.size() + nColumn];
+
+            if(!(dwType & MSI_COLUMN_STRING))
+                dwValue = (dwValue == MSI_NULL_INTEGER) ? 0 : (dwValue + dwBias);
+            for(DWORD i = 0; i < dwWidth; i++)
+                Data.push_back((BYTE)(dwValue >> (i * 8)));
+        }
+    }
+}
+
+static void EncodeStringPool(const TGenStringPool & StringPool, bool bLongRefs, std::vector<BYTE> & PoolData, std::vector<BYTE> & StringData)
+{
+    std::vector<WORD> PoolWords;
+
+    // Code page 1252 and the flag of long string refs
+    PoolWords.push_back(1252);
+    PoolWords.push_back(bLongRefs ? MSI_POOL_LONG_REFS : 0);
+
+    // Strings over 64 KB take two entries
+    for(size_t i = 1; i < StringPool.m_Strings.size(); i++)
+    {
+        const std::string & strValue = StringPool.m_Strings[i];
+        WORD wRefs = (WORD)std::min<DWORD>(StringPool.m_Refs[i], 0xFFFF);
+
+        if(strValue.size() > 0xFFFF)
+        {
+            PoolWords.push_back(0);
+            PoolWords.push_back(wRefs);
+            PoolWords.push_back((WORD)(strValue.size()));
+            PoolWords.push_back((WORD)(strValue.size() >> 16));
+        }
+        else
+        {
+            PoolWords.push_back((WORD)(strValue.size()));
+            PoolWords.push_back(wRefs);
+        }
+        StringData.insert(StringData.end(), strValue.begin(), strValue.end());
+    }
+
+    PoolData.resize(PoolWords.size() * sizeof(WORD));
+    memcpy(&PoolData[0], &PoolWords[0], PoolData.size());
+}
+
+// Order of the names in the directory tree: shorter names first, then by uppercase characters
+static bool CompareStreamNames(const GEN_STREAM & Stream1, const GEN_STREAM & Stream2)
+{
+    const CFB_NAME & strName1 = Stream1.strName;
+    const CFB_NAME & strName2 = Stream2.strName;
+
+    if(strName1.size() != strName2.size())
+        return (strName1.size() < strName2.size());
+    for(size_t i = 0; i < strName1.size(); i++)
+    {
+        WCHAR chChar1 = (strName1[i] >= 'a' && strName1[i] <= 'z') ? (WCHAR)(strName1[i] - 0x20) : strName1[i];
+        WCHAR chChar2 = (strName2[i] >= 'a' && strName2[i] <= 'z') ? (WCHAR)(strName2[i] - 0x20) : strName2[i];
+
+        if(chChar1 != chChar2)
+            return (chChar1 < chChar2);
+    }
+    return false;
+}
+
+// Links the sorted entries [nFirst, nLast) to a balanced binary tree. Returns the directory entry of the root
+static DWORD LinkDirectoryTree(std::vector<CFB_DIRENTRY> & Entries, size_t nFirst, size_t nLast)
+{
+    size_t nMiddle = nFirst + (nLast - nFirst) / 2;
+
+    if(nFirst >= nLast)
+        return CFB_NOSTREAM;
+
+    Entries[nMiddle + 1].LeftSibling = LinkDirectoryTree(Entries, nFirst, nMiddle);
+    Entries[nMiddle + 1].RightSibling = LinkDirectoryTree(Entries, nMiddle + 1, nLast);
+    return (DWORD)(nMiddle + 1);
+}
+
+static void SetDirEntry(CFB_DIRENTRY & DirEntry, const CFB_NAME & strName, BYTE Type, DWORD dwStart, ULONGLONG Size)
+{
+    memset(&DirEntry, 0, sizeof(CFB_DIRENTRY));
+    for(size_t i = 0; i < strName.size(); i++)
+        DirEntry.Name[i] = strName[i];
+    DirEntry.NameLength = (WORD)((strName.size() + 1) * sizeof(WORD));
+    DirEntry.Type = Type;
+    DirEntry.Color = 1;
+    DirEntry.LeftSibling = DirEntry.RightSibling = DirEntry.Child = CFB_NOSTREAM;
+    DirEntry.StartSector = dwStart;
+    DirEntry.StreamSize = Size;
+}
+
+static void SetChain(std::vector<DWORD> & Fat, DWORD dwStart, DWORD dwCount)
+{
+    for(DWORD i = 0; i < dwCount; i++)
+        Fat[dwStart + i] = (i + 1 < dwCount) ? (dwStart + i + 1) : CFB_ENDOFCHAIN;
+}
+
+// Writes the compound file. The layout is: header, big streams,
+// mini stream, mini FAT, directory, FAT and DIFAT. Each chain is contiguous
+static DWORD WriteCompoundFile(const char * szFileName, std::vector<GEN_STREAM> & Streams)
+{
+    std::vector<CFB_DIRENTRY> Entries(Streams.size() + 1);
+    std::vector<DWORD> MiniFat;
+    std::vector<DWORD> Fat;
+    std::vector<BYTE> Chunk;
+    CFB_HEADER Header;
+    ULONGLONG MiniStreamSize = 0;
+    DWORD dwMiniStream, dwMiniStreamSectors;
+    DWORD dwMiniFat, dwMiniFatSectors;
+    DWORD dwDirectory, dwDirectorySectors;
+    DWORD dwFatSectors = 1, dwDifatSectors = 0;
+    DWORD dwSectors = 0;
+    FILE * fp;
+
+    // Allocate the sectors of the big streams and mini sectors of the small ones
+    std::sort(Streams.begin(), Streams.end(), CompareStreamNames);
+    for(size_t i = 0; i < Streams.size(); i++)
+    {
+        GEN_STREAM & Stream = Streams[i];
+
+        if(Stream.strName.size() > CFB_MAX_NAME_LENGTH)
+            return ERROR_INVALID_PARAMETER;
+
+        if(Stream.Size < GEN_MINI_STREAM_CUTOFF)
+        {
+            DWORD dwMiniSectors = (DWORD)((Stream.Size + GEN_MINI_SECTOR_SIZE - 1) / GEN_MINI_SECTOR_SIZE);
+
+            Stream.dwStart = dwMiniSectors ? (DWORD)(MiniFat.size()) : CFB_ENDOFCHAIN;
+            for(DWORD j = 0; j < dwMiniSectors; j++)
+                MiniFat.push_back((j + 1 < dwMiniSectors) ? (DWORD)(MiniFat.size() + 1) : CFB_ENDOFCHAIN);
+            MiniStreamSize += dwMiniSectors * GEN_MINI_SECTOR_SIZE;
+        }
+        else
+        {
+            Stream.dwStart = dwSectors;
+            dwSectors += (DWORD)((Stream.Size + GEN_SECTOR_SIZE - 1) / GEN_SECTOR_SIZE);
+        }
+        SetDirEntry(Entries[i + 1], Stream.strName, CFB_TYPE_STREAM, Stream.dwStart, Stream.Size);
+    }
+
+    // Then the mini stream, mini FAT and the directory
+    dwMiniStreamSectors = (DWORD)((MiniStreamSize + GEN_SECTOR_SIZE - 1) / GEN_SECTOR_SIZE);
+    dwMiniStream = dwSectors;
+    dwSectors += dwMiniStreamSectors;
+    dwMiniFatSectors = (DWORD)((MiniFat.size() + GEN_ENTRIES_PER_SECTOR - 1) / GEN_ENTRIES_PER_SECTOR);
+    dwMiniFat = dwSectors;
+    dwSectors += dwMiniFatSectors;
+    dwDirectorySectors = (DWORD)((Entries.size() * GEN_DIRENTRY_SIZE + GEN_SECTOR_SIZE - 1) / GEN_SECTOR_SIZE);
+    dwDirectory = dwSectors;
+    dwSectors += dwDirectorySectors;
+
+    // The FAT must also cover the FAT and DIFAT sectors
+    for(;;)
+    {
+        dwDifatSectors = (dwFatSectors > CFB_HEADER_DIFAT_COUNT) ? (DWORD)((dwFatSectors - CFB_HEADER_DIFAT_COUNT + GEN_ENTRIES_PER_SECTOR - 2) / (GEN_ENTRIES_PER_SECTOR - 1)) : 0;
+        if((ULONGLONG)(dwSectors) + dwFatSectors + dwDifatSectors <= (ULONGLONG)(dwFatSectors) * GEN_ENTRIES_PER_SECTOR)
+            break;
+        dwFatSectors++;
+    }
+
+    // Build the FAT
+    Fat.assign(dwFatSectors * GEN_ENTRIES_PER_SECTOR, CFB_FREESECT);
+    for(size_t i = 0; i < Streams.size(); i++)
+    {
+        if(Streams[i].Size >= GEN_MINI_STREAM_CUTOFF)
+            SetChain(Fat, Streams[i].dwStart, (DWORD)((Streams[i].Size + GEN_SECTOR_SIZE - 1) / GEN_SECTOR_SIZE));
+    }
+    SetChain(Fat, dwMiniStream, dwMiniStreamSectors);
+    SetChain(Fat, dwMiniFat, dwMiniFatSectors);
+    SetChain(Fat, dwDirectory, dwDirectorySectors);
+    for(DWORD i = 0; i < dwFatSectors; i++)
+        Fat[dwSectors + i] = CFB_FATSECT;
+    for(DWORD i = 0; i < dwDifatSectors; i++)
+        Fat[dwSectors + dwFatSectors + i] = CFB_DIFSECT;
+
+    // The root entry owns the mini stream
+    SetDirEntry(Entries[0], MSI_WSTR("Root Entry"), CFB_TYPE_ROOT, dwMiniStreamSectors ? dwMiniStream : CFB_ENDOFCHAIN, MiniStreamSize);
+    Entries[0].Child = LinkDirectoryTree(Entries, 0, Streams.size());
+
+    // Prepare the header
+    memset(&Header, 0, sizeof(CFB_HEADER));
+    Header.Signature = CFB_HEADER_SIGNATURE;
+    Header.MinorVersion = 0x3E;
+    Header.MajorVersion = 4;
+    Header.ByteOrder = CFB_BYTE_ORDER_MARK;
+    Header.SectorShift = GEN_SECTOR_SHIFT;
+    Header.MiniSectorShift = 6;
+    Header.DirSectors = dwDirectorySectors;
+    Header.FatSectors = dwFatSectors;
+    Header.FirstDirSector = dwDirectory;
+    Header.MiniStreamCutoff = GEN_MINI_STREAM_CUTOFF;
+    Header.FirstMiniFatSector = dwMiniFatSectors ? dwMiniFat : CFB_ENDOFCHAIN;
+    Header.MiniFatSectors = dwMiniFatSectors;
+    Header.FirstDifatSector = dwDifatSectors ? (dwSectors + dwFatSectors) : CFB_ENDOFCHAIN;
+    Header.DifatSectors = dwDifatSectors;
+    for(DWORD i = 0; i < CFB_HEADER_DIFAT_COUNT; i++)
+        Header.Difat[i] = (i < dwFatSectors) ? (dwSectors + i) : CFB_FREESECT;
+
+    // Write the file
+    if((fp = fopen(szFileName, "wb")) == NULL)
+        return (DWORD)(errno);
+    TGenWriter Writer(fp);
+
+    Writer.Write(&Header, sizeof(CFB_HEADER));
+    Writer.PadSector(sizeof(CFB_HEADER));
+
+    // Big streams, generated on the fly
+    Chunk.resize(GEN_WRITE_BUFFER);
+    for(size_t i = 0; i < Streams.size(); i++)
+    {
+        GEN_STREAM & Stream = Streams[i];
+        ULONGLONG State = Stream.Seed;
+
+        if(Stream.Size < GEN_MINI_STREAM_CUTOFF)
+            continue;
+
+        if(Stream.Data.size())
+        {
+            Writer.Write(&Stream.Data[0], Stream.Data.size());
+        }
+        else
+        {
+            for(ULONGLONG ByteOffset = 0; ByteOffset < Stream.Size; ByteOffset += Chunk.size())
+            {
+                size_t cbChunk = (size_t)std::min<ULONGLONG>(Chunk.size(), Stream.Size - ByteOffset);
+
+                FillStreamData(&Chunk[0], cbChunk, State);
+                Writer.Write(&Chunk[0], cbChunk);
+            }
+        }
+        Writer.PadSector(Stream.Size);
+    }
+
+    // Small streams go to the mini stream
+    for(size_t i = 0; i < Streams.size(); i++)
+    {
+        GEN_STREAM & Stream = Streams[i];
+        ULONGLONG State = Stream.Seed;
+
+        if(Stream.Size == 0 || Stream.Size >= GEN_MINI_STREAM_CUTOFF)
+            continue;
+
+        if(Stream.Data.size() == 0)
+        {
+            Stream.Data.resize((size_t)(Stream.Size));
+            FillStreamData(&Stream.Data[0], Stream.Data.size(), State);
+        }
+        Writer.Write(&Stream.Data[0], Stream.Data.size());
+        Writer.WriteFill(0, (size_t)((GEN_MINI_SECTOR_SIZE - (Stream.Size % GEN_MINI_SECTOR_SIZE)) % GEN_MINI_SECTOR_SIZE));
+    }
+    Writer.PadSector(MiniStreamSize);
+
+    // Mini FAT, directory and FAT
+    if(MiniFat.size())
+        Writer.Write(&MiniFat[0], MiniFat.size() * sizeof(DWORD));
+    Writer.PadSector(MiniFat.size() * sizeof(DWORD), 0xFF);
+    Writer.Write(&Entries[0], Entries.size() * sizeof(CFB_DIRENTRY));
+    for(size_t i = Entries.size(); (i * GEN_DIRENTRY_SIZE) % GEN_SECTOR_SIZE; i++)
+    {
+        CFB_DIRENTRY EmptyEntry;
+
+        SetDirEntry(EmptyEntry, CFB_NAME(), CFB_TYPE_EMPTY, 0, 0);
+        EmptyEntry.NameLength = 0;
+        EmptyEntry.Color = 0;
+        Writer.Write(&EmptyEntry, sizeof(CFB_DIRENTRY));
+    }
+    Writer.Write(&Fat[0], Fat.size() * sizeof(DWORD));
+
+    // The FAT sectors that do not fit the header are in the DIFAT chain
+    for(DWORD i = 0; i < dwDifatSectors; i++)
+    {
+        std::vector<DWORD> Difat(GEN_ENTRIES_PER_SECTOR, CFB_FREESECT);
+
+        for(DWORD j = 0; j < GEN_ENTRIES_PER_SECTOR - 1; j++)
+        {
+            DWORD dwFatSector = CFB_HEADER_DIFAT_COUNT + i * (GEN_ENTRIES_PER_SECTOR - 1) + j;
+
+            if(dwFatSector < dwFatSectors)
+                Difat[j] = dwSectors + dwFatSector;
+        }
+        Difat[GEN_ENTRIES_PER_SECTOR - 1] = (i + 1 < dwDifatSectors) ? (dwSectors + dwFatSectors + i + 1) : CFB_ENDOFCHAIN;
+        Writer.Write(&Difat[0], Difat.size() * sizeof(DWORD));
+    }
+
+    Writer.Flush();
+    if(fclose(fp) != 0 || Writer.m_bFailed)
+        return ERROR_WRITE_FAULT;
+    return ERROR_SUCCESS;
+}
+
+// Generates the MSI with the "Directory", "Component", "File", "Property" and "Binary" tables
+static DWORD GenerateMsi(const char * szFileName, const BENCH_SHAPE & Shape)
+{
+    static const GEN_COLUMN DirectoryColumns[] =
+    {
+        {"Directory",        MSI_TYPE_STRING(72) | MSI_COLUMN_KEY},
+        {"Directory_Parent", MSI_TYPE_STRING(72) | MSI_COLUMN_NULLABLE},
+        {"DefaultDir",       MSI_TYPE_STRING(255) | MSI_COLUMN_LOCALIZABLE}
+    };
+    static const GEN_COLUMN ComponentColumns[] =
+    {
+        {"Component",        MSI_TYPE_STRING(72) | MSI_COLUMN_KEY},
+        {"ComponentId",      MSI_TYPE_STRING(38) | MSI_COLUMN_NULLABLE},
+        {"Directory_",       MSI_TYPE_STRING(72)},
+        {"Attributes",       MSI_TYPE_INTEGER(2)},
+        {"Condition",        MSI_TYPE_STRING(255) | MSI_COLUMN_NULLABLE},
+        {"KeyPath",          MSI_TYPE_STRING(72) | MSI_COLUMN_NULLABLE}
+    };
+    static const GEN_COLUMN FileColumns[] =
+    {
+        {"File",             MSI_TYPE_STRING(72) | MSI_COLUMN_KEY},
+        {"Component_",       MSI_TYPE_STRING(72)},
+        {"FileName",         MSI_TYPE_STRING(255) | MSI_COLUMN_LOCALIZABLE},
+        {"FileSize",         MSI_TYPE_INTEGER(4)},
+        {"Version",          MSI_TYPE_STRING(72) | MSI_COLUMN_NULLABLE},
+        {"Language",         MSI_TYPE_STRING(20) | MSI_COLUMN_NULLABLE},
+        {"Attributes",       MSI_TYPE_INTEGER(2) | MSI_COLUMN_NULLABLE},
+        {"Sequence",         MSI_TYPE_INTEGER(4)}
+    };
+    static const GEN_COLUMN PropertyColumns[] =
+    {
+        {"Property",         MSI_TYPE_STRING(72) | MSI_COLUMN_KEY},
+        {"Value",            MSI_TYPE_STRING(0) | MSI_COLUMN_LOCALIZABLE}
+    };
+    static const GEN_COLUMN BinaryColumns[] =
+    {
+        {"Name",             MSI_TYPE_STRING(72) | MSI_COLUMN_KEY},
+        {"Data",             MSI_TYPE_BINARY}
+    };
+    static const GEN_COLUMN TablesColumns[] =
+    {
+        {"Name",             MSI_TYPE_STRING(64) | MSI_COLUMN_KEY}
+    };
+    static const GEN_COLUMN ColumnsColumns[] =
+    {
+        {"Table",            MSI_TYPE_STRING(64) | MSI_COLUMN_KEY},
+        {"Number",           MSI_TYPE_INTEGER(2) | MSI_COLUMN_KEY},
+        {"Name",             MSI_TYPE_STRING(64)},
+        {"Type",             MSI_TYPE_INTEGER(2)}
+    };
+
+    TGenTable Directory("Directory", DirectoryColumns, _countof(DirectoryColumns));
+    TGenTable Component("Component", ComponentColumns, _countof(ComponentColumns));
+    TGenTable File("File", FileColumns, _countof(FileColumns));
+    TGenTable Property("Property", PropertyColumns, _countof(PropertyColumns));
+    TGenTable Binary("Binary", BinaryColumns, _countof(BinaryColumns));
+    TGenTable Tables("_Tables", TablesColumns, _countof(TablesColumns));
+    TGenTable Columns("_Columns", ColumnsColumns, _countof(ColumnsColumns));
+    TGenTable * UserTables[] = {&Directory, &Component, &File, &Property, &Binary};
+    std::vector<GEN_STREAM> Streams;
+    std::vector<DWORD> Versions;
+    std::mt19937 Random(Shape.dwSeed);
+    TGenStringPool StringPool;
+    GEN_STREAM Stream;
+    CFB_NAME strEncoded;
+    DWORD dwComponents = std::max<DWORD>(Shape.dwFileRows / 4, 1);
+    DWORD dwDirectories = std::max<DWORD>(dwComponents / 16, 1);
+    DWORD dwStringRefSize;
+    DWORD dwLanguage;
+    char szValue[64];
+
+    // Directory tree. Each directory is in one of the directories before it
+    {
+        DWORD Row[] = {StringPool.Add("TARGETDIR"), 0, StringPool.Add("SourceDir")};
+        Directory.AddRow(Row);
+    }
+    for(DWORD i = 0; i < dwDirectories; i++)
+    {
+        DWORD dwParent = Directory.Cells[(Random() % Directory.dwRows) * Directory.Columns.size()];
+        std::string strName = RandomName(Random, "Dir", i);
+
+        snprintf(szValue, _countof(szValue), "DIR~%u|", i);
+        DWORD Row[] = {StringPool.Add(strName), StringPool.Add(StringPool.m_Strings[dwParent]), StringPool.Add(szValue + strName)};
+        Directory.AddRow(Row);
+    }
+
+    // Components
+    for(DWORD i = 0; i < dwComponents; i++)
+    {
+        DWORD dwDirectory = Directory.Cells[(1 + Random() % dwDirectories) * Directory.Columns.size()];
+        DWORD Row[] = {StringPool.Add(RandomName(Random, "Comp", i)), StringPool.Add(RandomGuid(Random)), StringPool.Add(StringPool.m_Strings[dwDirectory]), (Random() % 2) ? 0 : 256u, 0, 0};
+        Component.AddRow(Row);
+    }
+
+    // Files with shared versions and languages
+    for(DWORD i = 0; i < 50; i++)
+    {
+        snprintf(szValue, _countof(szValue), "1.0.%u.%u", i, (DWORD)(Random() % 10000));
+        Versions.push_back(StringPool.Add(szValue));
+    }
+    dwLanguage = StringPool.Add("1033");
+    for(DWORD i = 0; i < Shape.dwFileRows; i++)
+    {
+        DWORD dwComponent = (DWORD)(Random() % dwComponents);
+        std::string strKey = RandomName(Random, "fil", i);
+
+        snprintf(szValue, _countof(szValue), "FILE~%u.DLL|", i);
+        DWORD Row[] =
+        {
+            StringPool.Add(strKey),
+            StringPool.Add(StringPool.m_Strings[Component.Cells[dwComponent * Component.Columns.size()]]),
+            StringPool.Add(szValue + strKey + ".dll"),
+            (DWORD)(Random() % 10000000),
+            (Random() % 4) ? StringPool.Add(StringPool.m_Strings[Versions[Random() % Versions.size()]]) : 0,
+            (Random() % 4) ? 0 : StringPool.Add(StringPool.m_Strings[dwLanguage]),
+            (Random() % 2) ? 512u : 16384u,
+            i + 1
+        };
+        File.AddRow(Row);
+    }
+
+    // Properties grow the string pool
+    {
+        DWORD Row[] = {StringPool.Add("ProductName"), StringPool.Add("Synthetic \"benchmark\", product")};
+        Property.AddRow(Row);
+    }
+    for(DWORD i = 0; i < Shape.dwExtraStrings; i++)
+    {
+        std::string strValue = RandomName(Random, "Value ", i);
+
+        snprintf(szValue, _countof(szValue), "PROP%u", i);
+        strValue.append(Random() % 48, 'x');
+        DWORD Row[] = {StringPool.Add(szValue), StringPool.Add(strValue)};
+        Property.AddRow(Row);
+    }
+
+    // Binary rows and their streams
+    for(DWORD i = 0; i < Shape.dwBinaries; i++)
+    {
+        snprintf(szValue, _countof(szValue), "Bin%u.dat", i);
+        DWORD Row[] = {StringPool.Add(szValue), 1};
+        Binary.AddRow(Row);
+
+        MsiEncodeStreamName(AsciiToName(std::string("Binary.") + szValue), false, Stream.strName);
+        Stream.Size = Shape.StreamSize;
+        Stream.Seed = ((ULONGLONG)(Shape.dwSeed) << 32) + i + 1;
+        Streams.push_back(Stream);
+    }
+
+    // Streams that are not referenced from any table
+    for(DWORD i = 0; i < Shape.dwStreams; i++)
+    {
+        snprintf(szValue, _countof(szValue), "Stream%u.bin", i);
+        MsiEncodeStreamName(AsciiToName(szValue), false, Stream.strName);
+        Stream.Size = Shape.StreamSize;
+        Stream.Seed = ((ULONGLONG)(Shape.dwSeed) << 32) + 0x80000000ULL + i + 1;
+        Streams.push_back(Stream);
+    }
+
+    // The catalog
+    for(size_t i = 0; i < _countof(UserTables); i++)
+    {
+        DWORD TableRow[] = {StringPool.Add(UserTables[i]->strName)};
+        Tables.AddRow(TableRow);
+
+        for(size_t j = 0; j < UserTables[i]->Columns.size(); j++)
+        {
+            DWORD ColumnRow[] = {StringPool.Add(UserTables[i]->strName), (DWORD)(j + 1), StringPool.Add(UserTables[i]->Columns[j].szName), UserTables[i]->Columns[j].dwType};
+            Columns.AddRow(ColumnRow);
+        }
+    }
+
+    // Encode all tables. Pools with more than 64K strings need long string refs
+    dwStringRefSize = (Shape.bLongRefs || StringPool.m_Strings.size() > 0xFFFF) ? MSI_STRING_REF_LONG : MSI_STRING_REF_SHORT;
+    Stream.Seed = 0;
+    for(size_t i = 0; i < _countof(UserTables) + 2; i++)
+    {
+        const TGenTable & Table = (i < _countof(UserTables)) ? *UserTables[i] : ((i == _countof(UserTables)) ? Tables : Columns);
+
+        MsiEncodeStreamName(AsciiToName(Table.strName), true, Stream.strName);
+        Stream.Data.clear();
+        EncodeTable(Table, dwStringRefSize, Stream.Data);
+        Stream.Size = Stream.Data.size();
+        Streams.push_back(Stream);
+    }
+
+    // The string pool
+    Streams.resize(Streams.size() + 2);
+    MsiEncodeStreamName(MSI_WSTR("_StringPool"), true, Streams[Streams.size() - 2].strName);
+    MsiEncodeStreamName(MSI_WSTR("_StringData"), true, Streams[Streams.size() - 1].strName);
+    EncodeStringPool(StringPool, dwStringRefSize == MSI_STRING_REF_LONG, Streams[Streams.size() - 2].Data, Streams[Streams.size() - 1].Data);
+    for(size_t i = Streams.size() - 2; i < Streams.size(); i++)
+    {
+        Streams[i].Size = Streams[i].Data.size();
+        Streams[i].Seed = 0;
+    }
+
+    fprintf(stderr, "Generated %u file rows, %u strings, %u streams\n", Shape.dwFileRows, (DWORD)(StringPool.m_Strings.size()), (DWORD)(Streams.size()));
+    return WriteCompoundFile(szFileName, Streams);
+}
+
+//-----------------------------------------------------------------------------
+// Benchmark
+
+static double SecondsSince(const std::chrono::steady_clock::time_point & StartTime)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - StartTime).count();
+}
+
+static ULONGLONG PeakRssKb()
+{
+    struct rusage Usage;
+
+    getrusage(RUSAGE_SELF, &Usage);
+    return (ULONGLONG)(Usage.ru_maxrss);
+}
+
+static DWORD ReadWholeItem(TMsiArchive & Archive, DWORD dwItem, TCabFolderReader * pCabReader, std::vector<BYTE> & Chunk, ULONGLONG & Bytes)
+{
+    MSI_ITEM_CURSOR Cursor;
+    DWORD dwBytesRead = 0;
+    DWORD dwErrCode;
+
+    Cursor.pCabReader = pCabReader;
+    while((dwErrCode = Archive.ReadChunk(dwItem, Cursor, Chunk, &dwBytesRead)) == ERROR_SUCCESS && dwBytesRead != 0)
+        Bytes += dwBytesRead;
+    if(dwErrCode == ERROR_SUCCESS && Cursor.ByteOffset != Archive.ItemSize(dwItem))
+        dwErrCode = ERROR_FILE_CORRUPT;
+    return dwErrCode;
+}
+
+// Like the extraction of msitool: each worker takes whole units, and the items
+// with the same data are read once (they would be written to more files)
+static void BulkWorker(TBulkJob * pJob)
+{
+    TMsiArchive & Archive = *pJob->pArchive;
+    TCabFolderReader CabReader;
+    std::vector<BYTE> Chunk(MSI_ITEM_CHUNK_SIZE);
+    size_t nIndex;
+
+    while((nIndex = pJob->nNextUnit++) < pJob->Units.size())
+    {
+        const std::vector<DWORD> & Unit = pJob->Units[nIndex];
+
+        for(size_t i = 0; i < Unit.size(); i++)
+        {
+            ULONGLONG Bytes = 0;
+
+            if(i == 0 || &Archive.DataItem(Unit[i]) != &Archive.DataItem(Unit[i - 1]))
+            {
+                if(ReadWholeItem(Archive, Unit[i], &CabReader, Chunk, Bytes) != ERROR_SUCCESS)
+                    pJob->dwFailed++;
+            }
+            else
+            {
+                Bytes = Archive.ItemSize(Unit[i]);
+            }
+            pJob->Bytes += Bytes;
+        }
+    }
+}
+
+static void PrintJsonString(const char * szValue)
+{
+    putchar('\"');
+    for(; szValue[0] != 0; szValue++)
+    {
+        if(szValue[0] == '\"' || szValue[0] == '\\')
+            putchar('\\');
+        if((BYTE)(szValue[0]) >= 0x20)
+            putchar(szValue[0]);
+    }
+    putchar('\"');
+}
+
+static void PrintPhase(const char * szName, const BENCH_PHASE & Phase, bool bLast)
+{
+    printf("    \"%s\": {\"seconds\": %.6f, \"items\": %u, \"bytes\": %llu, \"mb_per_s\": %.1f, \"peak_rss_kb\": %llu}%s\n",
+           szName,
+           Phase.Seconds,
+           Phase.dwItems,
+           (unsigned long long)(Phase.Bytes),
+           (Phase.Seconds > 0) ? (Phase.Bytes / 1048576.0 / Phase.Seconds) : 0.0,
+           (unsigned long long)(Phase.PeakRssKb),
+           bLast ? "" : ",");
+}
+
+static int RunBenchmark(const char * szFileName, DWORD dwWorkers, const BENCH_SHAPE * pShape)
+{
+    std::vector<double> FileSeconds;
+    std::vector<BYTE> Chunk(MSI_ITEM_CHUNK_SIZE);
+    std::vector<MSI_CSV_JOB> Jobs;
+    std::vector<std::thread> Threads;
+    std::vector<DWORD> Items;
+    TCsvRenderPool CsvPool;
+    TMsiArchive Archive;
+    BENCH_PHASE Open, List, Size, ExtractFile, ExtractBulk;
+    TBulkJob Job;
+    std::string strPath;
+    DWORD dwFailed = 0;
+    DWORD dwErrCode;
+    FILE * fp;
+    unsigned long long FileSize = 0;
+
+    if((fp = fopen(szFileName, "rb")) != NULL)
+    {
+        fseeko(fp, 0, SEEK_END);
+        FileSize = (unsigned long long)ftello(fp);
+        fclose(fp);
+    }
+
+    // Open: parse the compound file, tables and cabinets, and measure all items
+    auto StartTime = std::chrono::steady_clock::now();
+    if((dwErrCode = Archive.Open(szFileName, dwWorkers)) != ERROR_SUCCESS)
+    {
+        fprintf(stderr, "Failed to open %s (error %u)\n", szFileName, dwErrCode);
+        return 1;
+    }
+    Open.Seconds = SecondsSince(StartTime);
+    Open.dwItems = (DWORD)(Archive.ItemCount());
+    Open.PeakRssKb = PeakRssKb();
+
+    // List: the names as the command line tool prints them
+    StartTime = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < Archive.ItemCount(); i++)
+    {
+        MsiUtf16ToUtf8(Archive.Item(i).Name.c_str(), Archive.Item(i).Name.size(), strPath);
+        List.Bytes += strPath.size() + 1;
+    }
+    List.Seconds = SecondsSince(StartTime);
+    List.dwItems = (DWORD)(Archive.ItemCount());
+    List.PeakRssKb = PeakRssKb();
+
+    // Size: measure the CSV files of all tables again, like the open does
+    StartTime = std::chrono::steady_clock::now();
+    CsvPool.Open(dwWorkers);
+    for(size_t i = 0; i < Archive.TableCount(); i++)
+    {
+        MSI_CSV_JOB SizeJob = {&Archive.Table(i).Data, 0, Archive.Table(i).Data.RowCount(), NULL, 0, 0};
+        Jobs.push_back(SizeJob);
+    }
+    if(Jobs.size() && (dwErrCode = CsvPool.Measure(&Jobs[0], Jobs.size(), Archive.StringPool())) != ERROR_SUCCESS)
+    {
+        fprintf(stderr, "Failed to measure the tables (error %u)\n", dwErrCode);
+        return 1;
+    }
+    for(size_t i = 0; i < Jobs.size(); i++)
+        Size.Bytes += Archive.Table(i).CsvHeader.size() + Jobs[i].cbLength;
+    CsvPool.Stop();
+    Size.Seconds = SecondsSince(StartTime);
+    Size.dwItems = (DWORD)(Jobs.size());
+    Size.PeakRssKb = PeakRssKb();
+
+    // Per-file extraction: one item after another, each timed
+    for(DWORD dwItem = 0; dwItem < Archive.ItemCount(); dwItem++)
+    {
+        StartTime = std::chrono::steady_clock::now();
+        if(ReadWholeItem(Archive, dwItem, NULL, Chunk, ExtractFile.Bytes) != ERROR_SUCCESS)
+            dwFailed++;
+        FileSeconds.push_back(SecondsSince(StartTime));
+        ExtractFile.Seconds += FileSeconds.back();
+    }
+    ExtractFile.dwItems = (DWORD)(Archive.ItemCount());
+    ExtractFile.PeakRssKb = PeakRssKb();
+    std::sort(FileSeconds.begin(), FileSeconds.end());
+
+    // Bulk extraction: all items on all workers
+    for(DWORD dwItem = 0; dwItem < Archive.ItemCount(); dwItem++)
+        Items.push_back(dwItem);
+    Job.pArchive = &Archive;
+    Job.nNextUnit = 0;
+    Job.Bytes = 0;
+    Job.dwFailed = 0;
+    StartTime = std::chrono::steady_clock::now();
+    Archive.GroupItems(Items, Job.Units);
+    for(DWORD i = 0; i < dwWorkers; i++)
+        Threads.push_back(std::thread(BulkWorker, &Job));
+    for(size_t i = 0; i < Threads.size(); i++)
+        Threads[i].join();
+    ExtractBulk.Seconds = SecondsSince(StartTime);
+    ExtractBulk.Bytes = Job.Bytes;
+    ExtractBulk.dwItems = (DWORD)(Archive.ItemCount());
+    ExtractBulk.PeakRssKb = PeakRssKb();
+    dwFailed += Job.dwFailed;
+
+    // Print the results
+    printf("{\n  \"file\": ");
+    PrintJsonString(szFileName);
+    printf(",\n  \"file_size\": %llu,\n  \"workers\": %u,\n  \"items\": %u,\n  \"tables\": %u,\n  \"strings\": %u,\n  \"string_ref_size\": %u,\n  \"failed\": %u,\n",
+           FileSize, dwWorkers, (DWORD)(Archive.ItemCount()), (DWORD)(Archive.TableCount()), Archive.StringPool().Count(), Archive.StringPool().StringRefSize(), dwFailed);
+    if(pShape != NULL)
+    {
+        printf("  \"shape\": {\"file_rows\": %u, \"extra_strings\": %u, \"binaries\": %u, \"streams\": %u, \"stream_size\": %llu, \"long_refs\": %s, \"seed\": %u},\n",
+               pShape->dwFileRows, pShape->dwExtraStrings, pShape->dwBinaries, pShape->dwStreams,
+               (unsigned long long)(pShape->StreamSize), pShape->bLongRefs ? "true" : "false", pShape->dwSeed);
+    }
+    printf("  \"phases\": {\n");
+    PrintPhase("open", Open, false);
+    PrintPhase("list", List, false);
+    PrintPhase("size", Size, false);
+    PrintPhase("extract_file", ExtractFile, false);
+    PrintPhase("extract_bulk", ExtractBulk, true);
+    printf("  },\n  \"extract_file_ms\": {\"median\": %.3f, \"max\": %.3f}\n}\n",
+           FileSeconds.size() ? FileSeconds[FileSeconds.size() / 2] * 1000.0 : 0.0,
+           FileSeconds.size() ? FileSeconds.back() * 1000.0 : 0.0);
+    return (dwFailed != 0) ? 1 : 0;
+}
+
+//-----------------------------------------------------------------------------
+// Main
+
+static void PrintUsage()
+{
+    fprintf(stderr, "Usage: bench_archive [options] [file.msi]\n\n");
+    fprintf(stderr, "Without a file, a synthetic MSI is generated, measured and deleted.\n\n");
+    fprintf(stderr, "  -o <file.msi>  Only generate the MSI and keep it\n");
+    fprintf(stderr, "  -r <rows>      Rows of the File table (default 100000)\n");
+    fprintf(stderr, "  -s <strings>   Extra unique strings in the Property table (default 10000)\n");
+    fprintf(stderr, "  -b <count>     Rows of the Binary table, each with a stream (default 100)\n");
+    fprintf(stderr, "  -n <count>     Streams that are not in any table (default 10)\n");
+    fprintf(stderr, "  -z <size>      Size of each stream, with optional K, M or G suffix (default 64K)\n");
+    fprintf(stderr, "  -l             Long string refs, even for small string pools\n");
+    fprintf(stderr, "  -S <seed>      Seed of the generator (default 1)\n");
+    fprintf(stderr, "  -j <workers>   Number of threads (default: number of cores)\n");
+}
+
+static ULONGLONG ParseSize(const char * szValue)
+{
+    char * szEnd = NULL;
+    ULONGLONG Size = strtoull(szValue, &szEnd, 10);
+
+    switch(szEnd ? szEnd[0] : 0)
+    {
+        case 'k': case 'K': return Size << 10;
+        case 'm': case 'M': return Size << 20;
+        case 'g': case 'G': return Size << 30;
+    }
+    return Size;
+}
+
+int main(int argc, char * argv[])
+{
+    BENCH_SHAPE Shape = {100000, 10000, 100, 10, 0x10000, 1, false};
+    const char * szOutput = NULL;
+    const char * szFileName = NULL;
+    char szTempName[64];
+    DWORD dwWorkers = std::thread::hardware_concurrency();
+    DWORD dwErrCode;
+    int nStatus = 0;
+    pid_t Child;
+
+    // Parse the options
+    for(int i = 1; i < argc; i++)
+    {
+        const char * szArg = argv[i];
+
+        if(szArg[0] == '-' && szArg[1] == 'l' && szArg[2] == 0)
+        {
+            Shape.bLongRefs = true;
+            continue;
+        }
+        if(szArg[0] == '-' && szArg[1] != 0 && szArg[2] == 0 && (i + 1) < argc)
+        {
+            const char * szValue = argv[++i];
+
+            switch(szArg[1])
+            {
+                case 'o': szOutput = szValue; continue;
+                case 'r': Shape.dwFileRows = (DWORD)strtoul(szValue, NULL, 10); continue;
+                case 's': Shape.dwExtraStrings = (DWORD)strtoul(szValue, NULL, 10); continue;
+                case 'b': Shape.dwBinaries = (DWORD)strtoul(szValue, NULL, 10); continue;
+                case 'n': Shape.dwStreams = (DWORD)strtoul(szValue, NULL, 10); continue;
+                case 'z': Shape.StreamSize = ParseSize(szValue); continue;
+                case 'S': Shape.dwSeed = (DWORD)strtoul(szValue, NULL, 10); continue;
+                case 'j': dwWorkers = (DWORD)strtoul(szValue, NULL, 10); continue;
+            }
+        }
+        if(szArg[0] == '-' || szFileName != NULL)
+        {
+            PrintUsage();
+            return 2;
+        }
+        szFileName = szArg;
+    }
+    if(dwWorkers == 0)
+        dwWorkers = 1;
+
+    // Only generate the MSI
+    if(szOutput != NULL)
+    {
+        if((dwErrCode = GenerateMsi(szOutput, Shape)) != ERROR_SUCCESS)
+        {
+            fprintf(stderr, "Failed to generate %s (error %u)\n", szOutput, dwErrCode);
+            return 1;
+        }
+        return 0;
+    }
+
+    // Measure an existing MSI
+    if(szFileName != NULL)
+        return RunBenchmark(szFileName, dwWorkers, NULL);
+
+    // Generate the MSI in a child process, so that its memory does not count to the peak RSS
+    snprintf(szTempName, _countof(szTempName), "/tmp/bench_archive_%u.msi", (DWORD)(getpid()));
+    if((Child = fork()) == 0)
+        _exit((GenerateMsi(szTempName, Shape) == ERROR_SUCCESS) ? 0 : 1);
+    if(Child < 0 || waitpid(Child, &nStatus, 0) != Child || !WIFEXITED(nStatus) || WEXITSTATUS(nStatus) != 0)
+    {
+        fprintf(stderr, "Failed to generate %s\n", szTempName);
+        unlink(szTempName);
+        return 1;
+    }
+
+    nStatus = RunBenchmark(szTempName, dwWorkers, &Shape);
+    unlink(szTempName);
+    return nStatus;
+}
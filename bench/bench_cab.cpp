@@ -0,0 +1,144 @@
+/*****************************************************************************/
+/* bench_cab.cpp                          Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Throughput of the bulk extraction from embedded cabinets by core count    */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 16.10.26  1.00  Lad  Created                                              */
+/*****************************************************************************/
+
+#include "../wcx_msi.h"
+#include <chrono>
+
+//-----------------------------------------------------------------------------
+// Local defines
+
+#define BENCH_CHUNK_SIZE    0x100000            // Size of one read, as used by the extraction
+
+//-----------------------------------------------------------------------------
+// Local functions
+
+// Reads all files of the cabinet in order, the same way as Total Commander
+// extracts them. Returns a checksum of the data, so the runs can be compared.
+static DWORD ExtractAll(TCabinet * pCabinet, DWORD dwWorkers, ULONGLONG & TotalBytes, ULONGLONG & Checksum)
+{
+    std::vector<BYTE> Chunk(BENCH_CHUNK_SIZE);
+    TCabFolderPool Pool;
+    DWORD dwErrCode;
+
+    if((dwErrCode = Pool.Open(pCabinet, dwWorkers)) != ERROR_SUCCESS)
+        return dwErrCode;
+
+    TotalBytes = Checksum = 0;
+    for(size_t i = 0; i < pCabinet->FileCount(); i++)
+    {
+        const CAB_FILE & CabFile = pCabinet->File(i);
+        ULONGLONG ByteOffset = 0;
+
+        Pool.FileStarted();
+        while(ByteOffset < CabFile.FileSize)
+        {
+            DWORD dwBytesRead = (DWORD)(CabFile.FileSize - ByteOffset);
+
+            if(dwBytesRead > BENCH_CHUNK_SIZE)
+                dwBytesRead = BENCH_CHUNK_SIZE;
+            if((dwErrCode = Pool.Read(CabFile.Folder, CabFile.FolderOffset + ByteOffset, &Chunk[0], dwBytesRead, &dwBytesRead)) != ERROR_SUCCESS)
+                return dwErrCode;
+            if(dwBytesRead == 0)
+                return ERROR_HANDLE_EOF;
+
+            for(DWORD j = 0; j < dwBytesRead; j++)
+                Checksum = (Checksum * 31) + Chunk[j];
+            ByteOffset += dwBytesRead;
+        }
+        TotalBytes += ByteOffset;
+    }
+    return ERROR_SUCCESS;
+}
+
+static void BenchCabinet(TCabinet * pCabinet, LPCTSTR szName, DWORD dwMaxWorkers)
+{
+    ULONGLONG RefChecksum = 0;
+
+    printf("%s: %u files, %u folders\n", szName, (DWORD)pCabinet->FileCount(), (DWORD)pCabinet->FolderCount());
+    printf("  workers      MB/s   speedup\n");
+
+    // The first run (one worker) is the synchronous extraction
+    double RefSeconds = 0;
+    for(DWORD dwWorkers = 1; dwWorkers <= dwMaxWorkers && dwWorkers <= CAB_POOL_MAX_WORKERS; dwWorkers *= 2)
+    {
+        ULONGLONG TotalBytes = 0;
+        ULONGLONG Checksum = 0;
+        DWORD dwErrCode;
+
+        auto StartTime = std::chrono::steady_clock::now();
+        dwErrCode = ExtractAll(pCabinet, dwWorkers, TotalBytes, Checksum);
+        double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - StartTime).count();
+
+        if(dwErrCode != ERROR_SUCCESS)
+        {
+            printf("  %7u  error %u\n", dwWorkers, dwErrCode);
+            break;
+        }
+
+        if(dwWorkers == 1)
+        {
+            RefChecksum = Checksum;
+            RefSeconds = Seconds;
+        }
+
+        printf("  %7u  %8.1f  %7.2fx%s\n", dwWorkers,
+                                           (TotalBytes / 1048576.0) / Seconds,
+                                           RefSeconds / Seconds,
+                                           (Checksum != RefChecksum) ? "  DATA MISMATCH" : "");
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Main
+
+int main(int argc, char * argv[])
+{
+    TCompoundFile CompFile;
+    DWORD dwMaxWorkers = std::thread::hardware_concurrency();
+    DWORD dwCabinets = 0;
+    DWORD dwErrCode;
+
+    if(argc != 2 && argc != 3)
+    {
+        printf("Usage: bench_cab <file.msi> [max_workers]\n");
+        return 1;
+    }
+
+    // By default, go up to the number of cores
+    if(argc == 3)
+        dwMaxWorkers = strtoul(argv[2], NULL, 10);
+
+    if((dwErrCode = CompFile.Open(argv[1])) != ERROR_SUCCESS)
+    {
+        printf("Failed to open %s (error %u)\n", argv[1], dwErrCode);
+        return 1;
+    }
+
+    // Benchmark every stream that is a cabinet
+    for(DWORD dwEntry = 0; dwEntry < CompFile.EntryCount(); dwEntry++)
+    {
+        if(CompFile.Entry(dwEntry).Type == CFB_TYPE_STREAM && TCabinet::IsCabinet(&CompFile, dwEntry))
+        {
+            TCabinet Cabinet;
+            char szName[32];
+
+            if(Cabinet.Open(&CompFile, dwEntry) == ERROR_SUCCESS)
+            {
+                snprintf(szName, _countof(szName), "stream #%u", dwEntry);
+                BenchCabinet(&Cabinet, szName, dwMaxWorkers);
+                dwCabinets++;
+            }
+        }
+    }
+
+    if(dwCabinets == 0)
+        printf("No embedded cabinets in %s\n", argv[1]);
+    return 0;
+}
@@ -0,0 +1,240 @@
+/*****************************************************************************/
+/* bench_csv.cpp                          Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Throughput of the conversion of UTF-16 strings to CSV cells               */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 16.10.26  1.00  Lad  Created                                              */
+/*****************************************************************************/
+
+#include "../wcx_msi.h"
+#include <chrono>
+#include <random>
+
+//-----------------------------------------------------------------------------
+// Local defines
+
+#define BENCH_CELL_COUNT    200000              // Number of cells in one data set
+#define BENCH_REPEAT        10                  // Number of passes over one data set
+
+typedef std::vector<CFB_NAME> BENCH_CELLS;
+
+//-----------------------------------------------------------------------------
+// Reference implementation: character by character, one pass for the length
+// and another one for the data (like two calls of WideCharToMultiByte)
+
+static size_t ReferenceEncode(LPBYTE pbBuffer, LPCWSTR szValue, size_t ccValue)
+{
+    LPBYTE pbBufferPtr = pbBuffer;
+
+    for(size_t i = 0; i < ccValue; i++)
+    {
+        DWORD dwChar = szValue[i];
+
+        if(0xD800 <= dwChar && dwChar < 0xDC00 && (i + 1) < ccValue && 0xDC00 <= szValue[i + 1] && szValue[i + 1] < 0xE000)
+            dwChar = 0x10000 + ((dwChar - 0xD800) << 10) + (szValue[++i] - 0xDC00);
+        else if(0xD800 <= dwChar && dwChar < 0xE000)
+            dwChar = 0xFFFD;
+
+        if(dwChar == '\"')
+        {
+            *pbBufferPtr++ = '\"';
+            *pbBufferPtr++ = '\"';
+        }
+        else if(dwChar < 0x80)
+        {
+            *pbBufferPtr++ = (BYTE)(dwChar);
+        }
+        else if(dwChar < 0x800)
+        {
+            *pbBufferPtr++ = (BYTE)(0xC0 | (dwChar >> 6));
+            *pbBufferPtr++ = (BYTE)(0x80 | (dwChar & 0x3F));
+        }
+        else if(dwChar < 0x10000)
+        {
+            *pbBufferPtr++ = (BYTE)(0xE0 | (dwChar >> 12));
+            *pbBufferPtr++ = (BYTE)(0x80 | ((dwChar >> 6) & 0x3F));
+            *pbBufferPtr++ = (BYTE)(0x80 | (dwChar & 0x3F));
+        }
+        else
+        {
+            *pbBufferPtr++ = (BYTE)(0xF0 | (dwChar >> 18));
+            *pbBufferPtr++ = (BYTE)(0x80 | ((dwChar >> 12) & 0x3F));
+            *pbBufferPtr++ = (BYTE)(0x80 | ((dwChar >> 6) & 0x3F));
+            *pbBufferPtr++ = (BYTE)(0x80 | (dwChar & 0x3F));
+        }
+    }
+    return (size_t)(pbBufferPtr - pbBuffer);
+}
+
+static size_t ReferenceLength(LPCWSTR szValue, size_t ccValue)
+{
+    BYTE Buffer[0x1000 * 4];
+    size_t cbLength = 0;
+    size_t ccPiece;
+
+    // Measure the string by pieces, as the two-pass conversion would.
+    // A piece must not end between the two halves of a surrogate pair
+    for(size_t i = 0; i < ccValue; i += ccPiece)
+    {
+        ccPiece = (ccValue - i) < 0x1000 ? (ccValue - i) : 0x1000;
+        if(ccPiece == 0x1000 && (i + ccPiece) < ccValue && 0xD800 <= szValue[i + ccPiece - 1] && szValue[i + ccPiece - 1] < 0xDC00)
+            ccPiece--;
+        cbLength += ReferenceEncode(Buffer, szValue + i, ccPiece);
+    }
+    return cbLength;
+}
+
+//-----------------------------------------------------------------------------
+// Data sets
+
+static void GenerateCells(BENCH_CELLS & Cells, LPCSTR szKind, std::mt19937 & Random)
+{
+    static const WCHAR szIdentChars[] = MSI_WSTR("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789_.");
+    static const WCHAR szTextChars[] = MSI_WSTR("abcdefghijklmnopqrstuvwxyz ,;:-[]()\\0123456789");
+
+    Cells.resize(BENCH_CELL_COUNT);
+    for(size_t i = 0; i < Cells.size(); i++)
+    {
+        CFB_NAME & Cell = Cells[i];
+
+        if(!strcmp(szKind, "identifiers"))
+        {
+            Cell.resize(4 + Random() % 40);
+            for(size_t j = 0; j < Cell.size(); j++)
+                Cell[j] = szIdentChars[Random() % (_countof(szIdentChars) - 1)];
+        }
+        else if(!strcmp(szKind, "ascii-text"))
+        {
+            Cell.resize(20 + Random() % 300);
+            for(size_t j = 0; j < Cell.size(); j++)
+                Cell[j] = szTextChars[Random() % (_countof(szTextChars) - 1)];
+        }
+        else if(!strcmp(szKind, "quoted"))
+        {
+            Cell.resize(20 + Random() % 300);
+            for(size_t j = 0; j < Cell.size(); j++)
+                Cell[j] = (Random() % 40) ? szTextChars[Random() % (_countof(szTextChars) - 1)] : '\"';
+        }
+        else
+        {
+            Cell.resize(20 + Random() % 200);
+            for(size_t j = 0; j < Cell.size(); j++)
+            {
+                switch(Random() % 8)
+                {
+                    case 0:  Cell[j] = (WCHAR)(0xC0 + Random() % 0x40); break;      // Latin-1
+                    case 1:  Cell[j] = (WCHAR)(0x4E00 + Random() % 0x5000); break;  // CJK
+                    case 2:  Cell[j] = (WCHAR)(0xD800 + Random() % 0x800); break;   // Surrogates, mostly unpaired
+                    case 3:  Cell[j] = '\"'; break;
+                    default: Cell[j] = szTextChars[Random() % (_countof(szTextChars) - 1)]; break;
+                }
+            }
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Benchmark
+
+static double BenchEncode(const BENCH_CELLS & Cells, std::vector<BYTE> & Output, bool bReference)
+{
+    auto StartTime = std::chrono::steady_clock::now();
+
+    for(size_t nPass = 0; nPass < BENCH_REPEAT; nPass++)
+    {
+        LPBYTE pbBufferPtr = &Output[0];
+
+        for(size_t i = 0; i < Cells.size(); i++)
+        {
+            const CFB_NAME & Cell = Cells[i];
+
+            if(bReference)
+            {
+                ReferenceLength(Cell.c_str(), Cell.size());
+                pbBufferPtr += ReferenceEncode(pbBufferPtr, Cell.c_str(), Cell.size());
+            }
+            else
+            {
+                pbBufferPtr += MsiCsvCellEncode(pbBufferPtr, Cell.size() * 3, Cell.c_str(), Cell.size());
+            }
+        }
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - StartTime).count();
+}
+
+static bool VerifyCells(const BENCH_CELLS & Cells)
+{
+    std::vector<BYTE> Expected;
+    std::vector<BYTE> Encoded;
+
+    for(size_t i = 0; i < Cells.size(); i++)
+    {
+        const CFB_NAME & Cell = Cells[i];
+        size_t cbExpected;
+        size_t cbEncoded;
+
+        Expected.resize(Cell.size() * 3 + 1);
+        Encoded.resize(Cell.size() * 3 + 1);
+        cbExpected = ReferenceEncode(&Expected[0], Cell.c_str(), Cell.size());
+        cbEncoded = MsiCsvCellEncode(&Encoded[0], Encoded.size(), Cell.c_str(), Cell.size());
+
+        if(MsiCsvCellLength(Cell.c_str(), Cell.size()) != cbExpected || ReferenceLength(Cell.c_str(), Cell.size()) != cbExpected)
+            return false;
+        if(cbEncoded != cbExpected || memcmp(&Expected[0], &Encoded[0], cbExpected))
+            return false;
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Main
+
+int main(int /* argc */, char * /* argv */ [])
+{
+    LPCSTR DataSets[] = {"identifiers", "ascii-text", "quoted", "mixed"};
+    std::mt19937 Random(0x4D5349);
+
+#if defined(__AVX2__)
+    printf("Vector path: AVX2\n");
+#elif defined(__SSE2__)
+    printf("Vector path: SSE2\n");
+#else
+    printf("Vector path: none (scalar)\n");
+#endif
+    printf("  data set      cells/s (M)   MB/s out   reference MB/s   speedup\n");
+
+    for(size_t i = 0; i < _countof(DataSets); i++)
+    {
+        std::vector<BYTE> Output;
+        BENCH_CELLS Cells;
+        size_t cbOutput = 0;
+        size_t ccInput = 0;
+
+        GenerateCells(Cells, DataSets[i], Random);
+        for(size_t j = 0; j < Cells.size(); j++)
+        {
+            cbOutput += MsiCsvCellLength(Cells[j].c_str(), Cells[j].size());
+            ccInput += Cells[j].size();
+        }
+        Output.resize(ccInput * 3);
+
+        if(!VerifyCells(Cells))
+        {
+            printf("  %-12s  DATA MISMATCH\n", DataSets[i]);
+            return 1;
+        }
+
+        double Seconds = BenchEncode(Cells, Output, false);
+        double RefSeconds = BenchEncode(Cells, Output, true);
+        double MegaBytes = (double)(cbOutput) * BENCH_REPEAT / 1048576.0;
+
+        printf("  %-12s  %11.1f  %9.1f  %15.1f  %7.2fx\n", DataSets[i],
+                                                           (Cells.size() * BENCH_REPEAT / Seconds) / 1000000.0,
+                                                           MegaBytes / Seconds,
+                                                           MegaBytes / RefSeconds,
+                                                           RefSeconds / Seconds);
+    }
+    return 0;
+}
@@ -0,0 +1,198 @@
+/*****************************************************************************/
+/* bench_render.cpp                       Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Throughput of the rendering of a big table to CSV by core count           */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 16.10.26  1.00  Lad  Created                                              */
+/*****************************************************************************/
+
+#include "../wcx_msi.h"
+#include <chrono>
+#include <random>
+
+//-----------------------------------------------------------------------------
+// Local defines
+
+#define BENCH_ROW_COUNT     1000000             // Number of rows of the synthetic table
+#define BENCH_REPEAT        5                   // Number of renders per worker count
+
+//-----------------------------------------------------------------------------
+// Synthetic string pool and table. They fill the same arrays
+// as the loaders do when reading them from an MSI file.
+
+struct TBenchStringPool : public TMsiStringPool
+{
+    DWORD AddString(const CFB_NAME & strValue)
+    {
+        MSI_STRING_ENTRY Entry;
+
+        Entry.Offset = (DWORD)(m_Text.size());
+        Entry.Length = (DWORD)(strValue.size());
+        Entry.CsvLength = (DWORD)(MsiCsvCellLength(strValue.c_str(), strValue.size()));
+        Entry.Refs = 1;
+        m_Text.insert(m_Text.end(), strValue.begin(), strValue.end());
+        m_Strings.push_back(Entry);
+        return (DWORD)(m_Strings.size() - 1);
+    }
+
+    void Initialize()
+    {
+        MSI_STRING_ENTRY Entry = {0, 0, 0, 0};
+
+        // String ID 0 is the null string
+        m_Strings.push_back(Entry);
+        m_Text.push_back(0);
+    }
+};
+
+struct TBenchTableData : public TMsiTableData
+{
+    void AddColumn(MSI_CELL_TYPE CellType, DWORD dwWidth)
+    {
+        MSI_COLUMN_LAYOUT Column = {CellType, dwWidth, false};
+
+        m_Layout.push_back(Column);
+    }
+
+    // Same columns as the "File" table
+    void Generate(TBenchStringPool & StringPool, DWORD dwRows, std::mt19937 & Random)
+    {
+        static const WCHAR szNameChars[] = MSI_WSTR("abcdefghijklmnopqrstuvwxyz0123456789_.");
+        std::vector<DWORD> Components;
+        std::vector<DWORD> Versions;
+        CFB_NAME strValue;
+
+        AddColumn(MsiCellString, MSI_STRING_REF_LONG);      // File
+        AddColumn(MsiCellString, MSI_STRING_REF_LONG);      // Component_
+        AddColumn(MsiCellString, MSI_STRING_REF_LONG);      // FileName
+        AddColumn(MsiCellInteger, 4);                       // FileSize
+        AddColumn(MsiCellString, MSI_STRING_REF_LONG);      // Version
+        AddColumn(MsiCellString, MSI_STRING_REF_LONG);      // Language
+        AddColumn(MsiCellInteger, 2);                       // Attributes
+        AddColumn(MsiCellInteger, 4);                       // Sequence
+
+        m_dwRows = dwRows;
+        m_Cells.resize(m_Layout.size() * dwRows);
+
+        // Shared values
+        StringPool.Initialize();
+        for(DWORD i = 0; i < 5000; i++)
+        {
+            strValue = MSI_WSTR("Component_");
+            for(DWORD j = i; j != 0; j /= 10)
+                strValue.append(1, (WCHAR)('0' + (j % 10)));
+            Components.push_back(StringPool.AddString(strValue));
+        }
+        for(DWORD i = 0; i < 50; i++)
+        {
+            strValue = MSI_WSTR("1.0.");
+            strValue.append(1, (WCHAR)('0' + (i / 10)));
+            strValue.append(1, (WCHAR)('0' + (i % 10)));
+            Versions.push_back(StringPool.AddString(strValue));
+        }
+
+        for(DWORD dwRow = 0; dwRow < dwRows; dwRow++)
+        {
+            // Unique file key and long|short file name
+            strValue.resize(8 + Random() % 24);
+            for(size_t j = 0; j < strValue.size(); j++)
+                strValue[j] = szNameChars[Random() % (_countof(szNameChars) - 1)];
+            m_Cells[0 * dwRows + dwRow] = StringPool.AddString(strValue);
+            strValue.insert(0, MSI_WSTR("FILE~1.DLL|"));
+            m_Cells[2 * dwRows + dwRow] = StringPool.AddString(strValue);
+
+            m_Cells[1 * dwRows + dwRow] = Components[Random() % Components.size()];
+            m_Cells[3 * dwRows + dwRow] = Random() % 10000000;
+            m_Cells[4 * dwRows + dwRow] = (Random() % 4) ? Versions[Random() % Versions.size()] : 0;
+            m_Cells[5 * dwRows + dwRow] = (Random() % 4) ? MSI_NULL_INTEGER : 1033;
+            m_Cells[6 * dwRows + dwRow] = (Random() % 2) ? 512 : 16384;
+            m_Cells[7 * dwRows + dwRow] = dwRow + 1;
+        }
+    }
+};
+
+//-----------------------------------------------------------------------------
+// Local functions
+
+static ULONGLONG Checksum(const std::vector<BYTE> & Data, size_t cbData)
+{
+    ULONGLONG Hash = 0xCBF29CE484222325ULL;
+
+    for(size_t i = 0; i < cbData; i++)
+        Hash = (Hash ^ Data[i]) * 0x100000001B3ULL;
+    return Hash;
+}
+
+//-----------------------------------------------------------------------------
+// Main
+
+int main(int argc, char * argv[])
+{
+    TBenchStringPool StringPool;
+    TBenchTableData TableData;
+    std::vector<BYTE> Output;
+    std::mt19937 Random(0x4D5349);
+    ULONGLONG RefChecksum = 0;
+    DWORD dwMaxWorkers = std::thread::hardware_concurrency();
+    double RefSeconds = 0;
+
+    // By default, go up to the number of cores
+    if(argc == 2)
+        dwMaxWorkers = strtoul(argv[1], NULL, 10);
+
+    TableData.Generate(StringPool, BENCH_ROW_COUNT, Random);
+    printf("Table: %u rows, %u columns, %u strings\n", TableData.RowCount(), (DWORD)TableData.ColumnCount(), StringPool.Count());
+    printf("  workers   measure ms   render ms      MB/s   speedup\n");
+
+    // The first run (one worker) is the rendering on the calling thread alone
+    for(DWORD dwWorkers = 1; dwWorkers <= dwMaxWorkers && dwWorkers <= MSI_CSV_MAX_WORKERS; dwWorkers *= 2)
+    {
+        MSI_CSV_JOB Job = {&TableData, 0, TableData.RowCount(), NULL, 0, 0};
+        TCsvRenderPool Pool;
+        double MeasureSeconds = 0;
+        double RenderSeconds = 0;
+        DWORD dwErrCode = ERROR_SUCCESS;
+
+        Pool.Open(dwWorkers);
+        for(DWORD nPass = 0; nPass < BENCH_REPEAT && dwErrCode == ERROR_SUCCESS; nPass++)
+        {
+            auto StartTime = std::chrono::steady_clock::now();
+            Pool.Measure(&Job, 1, StringPool);
+            MeasureSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - StartTime).count();
+
+            // The buffer is allocated outside of the timed part
+            Output.resize((size_t)(Job.cbLength));
+            Job.pbBuffer = &Output[0];
+            Job.cbBuffer = Output.size();
+
+            // Rendering measures the ranges again, to get their offsets
+            StartTime = std::chrono::steady_clock::now();
+            dwErrCode = Pool.Render(&Job, 1, StringPool);
+            RenderSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - StartTime).count();
+        }
+
+        if(dwErrCode != ERROR_SUCCESS)
+        {
+            printf("  %7u  error %u\n", dwWorkers, dwErrCode);
+            return 1;
+        }
+
+        MeasureSeconds /= BENCH_REPEAT;
+        RenderSeconds /= BENCH_REPEAT;
+        if(dwWorkers == 1)
+        {
+            RefChecksum = Checksum(Output, (size_t)(Job.cbLength));
+            RefSeconds = RenderSeconds;
+        }
+
+        printf("  %7u  %11.1f  %10.1f  %8.1f  %7.2fx%s\n", dwWorkers,
+                                                          MeasureSeconds * 1000.0,
+                                                          RenderSeconds * 1000.0,
+                                                          (Job.cbLength / 1048576.0) / RenderSeconds,
+                                                          RefSeconds / RenderSeconds,
+                                                          (Checksum(Output, (size_t)(Job.cbLength)) != RefChecksum) ? "  DATA MISMATCH" : "");
+    }
+    return 0;
+}
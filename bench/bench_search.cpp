@@ -0,0 +1,278 @@
+/*****************************************************************************/
+/* bench_search.cpp                       Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Text search in the string pool against scanning of the tables rendered    */
+/* to CSV                                                                    */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 16.10.26  1.00  Lad  Created                                              */
+/*****************************************************************************/
+
+#include "../wcx_msi.h"
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+//-----------------------------------------------------------------------------
+// Local defines
+
+#define BENCH_COMPONENT_ROWS    200000          // Number of rows of the synthetic "Component" table
+#define BENCH_FILE_ROWS         500000          // Number of rows of the synthetic "File" table
+#define BENCH_REPEAT            5               // Number of searches per pattern and method
+
+//-----------------------------------------------------------------------------
+// Synthetic string pool and tables. They fill the same arrays
+// as the loaders do when reading them from an MSI file.
+
+struct TBenchStringPool : public TMsiStringPool
+{
+    DWORD AddString(const CFB_NAME & strValue)
+    {
+        MSI_STRING_ENTRY Entry;
+
+        Entry.Offset = (DWORD)(m_Text.size());
+        Entry.Length = (DWORD)(strValue.size());
+        Entry.CsvLength = (DWORD)(MsiCsvCellLength(strValue.c_str(), strValue.size()));
+        Entry.Refs = 1;
+        m_Text.insert(m_Text.end(), strValue.begin(), strValue.end());
+        m_Strings.push_back(Entry);
+        return (DWORD)(m_Strings.size() - 1);
+    }
+
+    void Initialize()
+    {
+        MSI_STRING_ENTRY Entry = {0, 0, 0, 0};
+
+        // String ID 0 is the null string
+        m_Strings.push_back(Entry);
+        m_Text.push_back(0);
+    }
+};
+
+struct TBenchTableData : public TMsiTableData
+{
+    void AddColumn(MSI_CELL_TYPE CellType, DWORD dwWidth)
+    {
+        MSI_COLUMN_LAYOUT Column = {CellType, dwWidth, false};
+
+        m_Layout.push_back(Column);
+    }
+
+    void SetRows(DWORD dwRows)
+    {
+        m_dwRows = dwRows;
+        m_Cells.resize(m_Layout.size() * dwRows);
+    }
+
+    void SetCell(size_t nColumn, DWORD dwRow, DWORD dwValue)
+    {
+        m_Cells[nColumn * m_dwRows + dwRow] = dwValue;
+    }
+};
+
+//-----------------------------------------------------------------------------
+// Local functions
+
+static CFB_NAME RandomName(std::mt19937 & Random, const char * szPrefix)
+{
+    static const char szNameChars[] = "abcdefghijklmnopqrstuvwxyz0123456789_";
+    CFB_NAME strValue;
+
+    for(; szPrefix[0] != 0; szPrefix++)
+        strValue.append(1, (WCHAR)(szPrefix[0]));
+    for(size_t nLength = 8 + Random() % 24; nLength > 0; nLength--)
+        strValue.append(1, (WCHAR)(szNameChars[Random() % (_countof(szNameChars) - 1)]));
+    return strValue;
+}
+
+static CFB_NAME RandomGuid(std::mt19937 & Random)
+{
+    static const char szHexChars[] = "0123456789ABCDEF";
+    static const char szTemplate[] = "{xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx}";
+    CFB_NAME strValue;
+
+    for(size_t i = 0; szTemplate[i] != 0; i++)
+        strValue.append(1, (WCHAR)((szTemplate[i] == 'x') ? szHexChars[Random() % 16] : szTemplate[i]));
+    return strValue;
+}
+
+// Same columns as the "Component" and "File" tables
+static void GenerateTables(TBenchStringPool & StringPool, TBenchTableData & Components, TBenchTableData & Files, std::mt19937 & Random)
+{
+    std::vector<DWORD> Directories;
+    std::vector<DWORD> Versions;
+    CFB_NAME strValue;
+    DWORD dwLanguage;
+
+    Components.AddColumn(MsiCellString, MSI_STRING_REF_LONG);   // Component
+    Components.AddColumn(MsiCellString, MSI_STRING_REF_LONG);   // ComponentId
+    Components.AddColumn(MsiCellString, MSI_STRING_REF_LONG);   // Directory_
+    Components.AddColumn(MsiCellInteger, 2);                    // Attributes
+    Components.AddColumn(MsiCellString, MSI_STRING_REF_LONG);   // Condition
+    Components.AddColumn(MsiCellString, MSI_STRING_REF_LONG);   // KeyPath
+    Components.SetRows(BENCH_COMPONENT_ROWS);
+
+    Files.AddColumn(MsiCellString, MSI_STRING_REF_LONG);        // File
+    Files.AddColumn(MsiCellString, MSI_STRING_REF_LONG);        // Component_
+    Files.AddColumn(MsiCellString, MSI_STRING_REF_LONG);        // FileName
+    Files.AddColumn(MsiCellInteger, 4);                         // FileSize
+    Files.AddColumn(MsiCellString, MSI_STRING_REF_LONG);        // Version
+    Files.AddColumn(MsiCellString, MSI_STRING_REF_LONG);        // Language
+    Files.AddColumn(MsiCellInteger, 2);                         // Attributes
+    Files.AddColumn(MsiCellInteger, 4);                         // Sequence
+    Files.SetRows(BENCH_FILE_ROWS);
+
+    // Shared values
+    StringPool.Initialize();
+    for(DWORD i = 0; i < 2000; i++)
+        Directories.push_back(StringPool.AddString(RandomName(Random, "Dir_")));
+    for(DWORD i = 0; i < 50; i++)
+        Versions.push_back(StringPool.AddString(RandomName(Random, "1.0.")));
+    dwLanguage = StringPool.AddString(MSI_WSTR("1033"));
+
+    // Each component has its GUID, some of them have a key file
+    for(DWORD dwRow = 0; dwRow < BENCH_COMPONENT_ROWS; dwRow++)
+    {
+        Components.SetCell(0, dwRow, StringPool.AddString(RandomName(Random, "Comp_")));
+        Components.SetCell(1, dwRow, StringPool.AddString(RandomGuid(Random)));
+        Components.SetCell(2, dwRow, Directories[Random() % Directories.size()]);
+        Components.SetCell(3, dwRow, (Random() % 2) ? 0 : 256);
+        Components.SetCell(4, dwRow, 0);
+    }
+
+    for(DWORD dwRow = 0; dwRow < BENCH_FILE_ROWS; dwRow++)
+    {
+        DWORD dwComponent = Random() % BENCH_COMPONENT_ROWS;
+
+        // Unique file key and long|short file name
+        strValue = RandomName(Random, "fil_");
+        Files.SetCell(0, dwRow, StringPool.AddString(strValue));
+        strValue.insert(0, MSI_WSTR("FILE~1.DLL|"));
+        Files.SetCell(2, dwRow, StringPool.AddString(strValue));
+
+        Files.SetCell(1, dwRow, Components.Cell(0, dwComponent));
+        Files.SetCell(3, dwRow, Random() % 10000000);
+        Files.SetCell(4, dwRow, (Random() % 4) ? Versions[Random() % Versions.size()] : 0);
+        Files.SetCell(5, dwRow, (Random() % 4) ? 0 : dwLanguage);
+        Files.SetCell(6, dwRow, (Random() % 2) ? 512 : 16384);
+        Files.SetCell(7, dwRow, dwRow + 1);
+        Components.SetCell(5, dwComponent, Files.Cell(0, dwRow));
+    }
+}
+
+// The rows that contain the pattern, as (table << 32 | row)
+static void ScanCsv(const std::vector<BYTE> & Csv, size_t nTable, const std::string & strPattern, std::vector<ULONGLONG> & Rows)
+{
+    const BYTE * pbCsv = &Csv[0];
+    const BYTE * pbEnd = pbCsv + Csv.size();
+    const BYTE * pbLine = pbCsv;
+    DWORD dwRow = 0;
+
+    for(const BYTE * pbFound = pbCsv; ; pbFound++)
+    {
+        // Find the next occurrence of the pattern
+        pbFound = std::search(pbFound, pbEnd, strPattern.begin(), strPattern.end());
+        if(pbFound >= pbEnd)
+            break;
+
+        // Count the lines up to it
+        for(const BYTE * pbEol; (pbEol = (const BYTE *)memchr(pbLine, '\n', pbFound - pbLine)) != NULL; dwRow++)
+            pbLine = pbEol + 1;
+        if(Rows.empty() || Rows.back() != (((ULONGLONG)nTable << 32) | dwRow))
+            Rows.push_back(((ULONGLONG)nTable << 32) | dwRow);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Main
+
+int main(int argc, char * argv[])
+{
+    const TMsiTableData * Tables[2];
+    TBenchStringPool StringPool;
+    TBenchTableData Components;
+    TBenchTableData Files;
+    TMsiStringRefs StringRefs;
+    std::vector<BYTE> Csv;
+    std::mt19937 Random(0x4D5349);
+    const char * Patterns[4] = {NULL, "Dir_a", "FILE~1.DLL|fil_zz", "DOES-NOT-EXIST"};
+    char szGuidPart[16];
+
+    // The last pattern can be given on the command line
+    if(argc == 2)
+        Patterns[3] = argv[1];
+
+    GenerateTables(StringPool, Components, Files, Random);
+    Tables[0] = &Components;
+    Tables[1] = &Files;
+    printf("Tables: %u + %u rows, %u strings\n", Components.RowCount(), Files.RowCount(), StringPool.Count());
+
+    // Pick a part of one GUID
+    {
+        size_t ccGuid = 0;
+        LPCWSTR szGuid = StringPool.String(Components.Cell(1, BENCH_COMPONENT_ROWS / 2), ccGuid);
+
+        for(size_t i = 0; i < 9; i++)
+            szGuidPart[i] = (char)(szGuid[10 + i]);
+        szGuidPart[9] = 0;
+        Patterns[0] = szGuidPart;
+    }
+
+    // Build the reverse index once
+    auto StartTime = std::chrono::steady_clock::now();
+    StringRefs.Build(StringPool, Tables, _countof(Tables));
+    double BuildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - StartTime).count();
+    printf("Reverse index: %.1f ms, %.1f MB\n", BuildSeconds * 1000.0, StringRefs.MemorySize() / 1048576.0);
+    printf("  %-20s  %6s  %11s  %11s  %8s\n", "pattern", "rows", "csv scan ms", "pool ms", "speedup");
+
+    for(size_t nPattern = 0; nPattern < _countof(Patterns); nPattern++)
+    {
+        std::string strPattern(Patterns[nPattern]);
+        CFB_NAME strWidePattern(strPattern.begin(), strPattern.end());
+        std::vector<ULONGLONG> CsvRows;
+        std::vector<ULONGLONG> PoolRows;
+        std::vector<MSI_STRING_REF> Hits;
+        double CsvSeconds = 0;
+        double PoolSeconds = 0;
+
+        for(DWORD nPass = 0; nPass < BENCH_REPEAT; nPass++)
+        {
+            // (a) Render every table to CSV and scan the bytes
+            StartTime = std::chrono::steady_clock::now();
+            CsvRows.clear();
+            for(size_t nTable = 0; nTable < _countof(Tables); nTable++)
+            {
+                const TMsiTableData & TableData = *Tables[nTable];
+
+                Csv.resize((size_t)(MsiCsvRowsLength(TableData, StringPool, 0, TableData.RowCount())));
+                MsiCsvRenderRows(&Csv[0], TableData, StringPool, 0, TableData.RowCount());
+                ScanCsv(Csv, nTable, strPattern, CsvRows);
+            }
+            CsvSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - StartTime).count();
+
+            // (b) Search the string pool and map the strings to the rows
+            StartTime = std::chrono::steady_clock::now();
+            PoolRows.clear();
+            StringRefs.Search(StringPool, strWidePattern.c_str(), strWidePattern.size(), 0, Hits);
+            for(size_t i = 0; i < Hits.size(); i++)
+            {
+                ULONGLONG RowKey = ((ULONGLONG)Hits[i].nTable << 32) | Hits[i].dwRow;
+
+                if(PoolRows.empty() || PoolRows.back() != RowKey)
+                    PoolRows.push_back(RowKey);
+            }
+            PoolSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - StartTime).count();
+        }
+
+        CsvSeconds /= BENCH_REPEAT;
+        PoolSeconds /= BENCH_REPEAT;
+        printf("  %-20s  %6u  %11.2f  %11.3f  %7.1fx%s\n", Patterns[nPattern],
+                                                         (DWORD)(PoolRows.size()),
+                                                         CsvSeconds * 1000.0,
+                                                         PoolSeconds * 1000.0,
+                                                         CsvSeconds / PoolSeconds,
+                                                         (CsvRows != PoolRows) ? "  ROW MISMATCH" : "");
+    }
+    return 0;
+}
@@ -0,0 +1,500 @@
+/*****************************************************************************/
+/* test_cab.cpp                           Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Round trip of stored, MSZIP and LZX folders through TCabFolderPool        */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 16.10.26  1.00  Lad  Created                                              */
+/*****************************************************************************/
+
+#include "../wcx_msi.h"
+#include <algorithm>
+
+//-----------------------------------------------------------------------------
+// Local defines
+
+#define TEST_CHUNK_SIZE     5000                // Read size that is not aligned to the data blocks
+#define TEST_SECTOR_SIZE    0x200               // Sector size of the compound file (version 3)
+#define TEST_FAT_ENTRIES    (TEST_SECTOR_SIZE / sizeof(DWORD))
+
+struct CAB_TEST_BLOCK
+{
+    WORD CompressedSize;
+    WORD UncompressedSize;
+};
+
+struct CAB_TEST_FOLDER
+{
+    WORD CompressType;                          // CAB_COMPRESS_XXX, LZX window size in bits 8-12
+    DWORD dwSeed;                               // Seed of the uncompressed data
+    const CAB_TEST_BLOCK * pBlocks;             // Compressed blocks (NULL = stored blocks)
+    size_t nBlocks;
+    const BYTE * pbData;                        // Data of the compressed blocks
+    size_t nFiles;
+    DWORD FileSizes[4];                         // Sizes of the files in the folder
+};
+
+//-----------------------------------------------------------------------------
+// Local variables
+
+// The compressed blocks were made from the output of GenerateData. Each folder
+// has two blocks, so that the second one needs the history of the first one.
+
+// MSZIP blocks, compressed by zlib. Seed 1, 36000 bytes
+static const CAB_TEST_BLOCK MsZipBlocks[] =
+{
+    {425, 32768},
+    {53, 3232},
+};
+
+static const BYTE MsZipData[] =
+{
+    0x43, 0x4B, 0xED, 0xD8, 0x3B, 0x4E, 0x02, 0x51, 0x00, 0x40, 0xD1, 0xDE, 0xC4, 0x3D, 0xB0, 0x04,
+    0xF9, 0xEB, 0x36, 0xD8, 0x01, 0x0A, 0xD1, 0x02, 0xA2, 0x31, 0xEE, 0x3F, 0x26, 0x62, 0xC8, 0x0C,
+    0x88, 0xF5, 0x29, 0x6E, 0xF3, 0x80, 0x37, 0xF3, 0x3E, 0xE1, 0x74, 0x77, 0xB3, 0x7F, 0x79, 0xFF,
+    0xDC, 0x4D, 0x1E, 0xEE, 0xEF, 0x5E, 0xB7, 0xC7, 0xE3, 0xF6, 0xFC, 0xF1, 0xBC, 0xFF, 0xDA, 0x4E,
+    0x76, 0xFB, 0xC3, 0xC5, 0xF8, 0xFB, 0xF4, 0xF4, 0x63, 0x7B, 0xF8, 0x78, 0x3B, 0x4F, 0x0D, 0x16,
+    0x9C, 0xE6, 0x4F, 0xE3, 0x60, 0xFA, 0xF2, 0xEB, 0xF8, 0xC0, 0xD1, 0xCE, 0x37, 0x8F, 0x1C, 0x2E,
+    0xBC, 0x3A, 0xE6, 0xF6, 0x4E, 0xC3, 0x3B, 0xFE, 0x0C, 0xC3, 0xB5, 0x57, 0x17, 0xBD, 0x5E, 0x33,
+    0x9A, 0x19, 0x3E, 0x18, 0xEE, 0xF0, 0xD7, 0x4B, 0xD7, 0x97, 0xFF, 0xFF, 0x8F, 0x1D, 0xBD, 0xBF,
+    0x39, 0xD9, 0x4C, 0xB3, 0x61, 0x6D, 0x66, 0xD9, 0xB0, 0x36, 0xF3, 0x6C, 0x58, 0x9B, 0x45, 0x36,
+    0xAC, 0xCD, 0x32, 0x1B, 0xD6, 0x66, 0x95, 0x0D, 0x6B, 0xB3, 0xCE, 0x86, 0xB5, 0x79, 0xCC, 0x86,
+    0xB5, 0x79, 0xCA, 0x86, 0xB5, 0x99, 0x16, 0x06, 0x60, 0x9C, 0xCA, 0x00, 0x8C, 0x53, 0x1A, 0x80,
+    0x71, 0x6A, 0x03, 0x30, 0x4E, 0x71, 0x00, 0xC6, 0xA9, 0x0E, 0xC0, 0x38, 0xE5, 0x01, 0x18, 0xA7,
+    0x3E, 0x00, 0xE3, 0x14, 0x08, 0x60, 0x9C, 0x0A, 0x81, 0x8B, 0x33, 0xAB, 0x10, 0xC0, 0x38, 0x15,
+    0x02, 0x18, 0xA7, 0x42, 0x00, 0xE3, 0x54, 0x08, 0x60, 0x9C, 0x0A, 0x01, 0x8C, 0x53, 0x21, 0x80,
+    0x71, 0x2A, 0x04, 0x30, 0x4E, 0x85, 0x00, 0xC6, 0xA9, 0x10, 0xC0, 0x38, 0x15, 0x02, 0x17, 0x67,
+    0x5E, 0x21, 0x80, 0x71, 0x2A, 0x04, 0x30, 0x4E, 0x85, 0x00, 0xC6, 0xA9, 0x10, 0xC0, 0x38, 0x15,
+    0x02, 0x18, 0xA7, 0x42, 0x00, 0xE3, 0x54, 0x08, 0x60, 0x9C, 0x0A, 0x01, 0x8C, 0x53, 0x21, 0x80,
+    0x71, 0x2A, 0x04, 0x2E, 0xCE, 0xA2, 0x42, 0x00, 0xE3, 0x54, 0x08, 0x60, 0x9C, 0x0A, 0x01, 0x8C,
+    0x53, 0x21, 0x80, 0x71, 0x2A, 0x04, 0x30, 0x4E, 0x85, 0x00, 0xC6, 0xA9, 0x10, 0xC0, 0x38, 0x15,
+    0x02, 0x18, 0xA7, 0x42, 0x00, 0xE3, 0x54, 0x08, 0x5C, 0x9C, 0x65, 0x85, 0x00, 0xC6, 0xA9, 0x10,
+    0xC0, 0x38, 0x15, 0x02, 0x18, 0xA7, 0x42, 0x00, 0xE3, 0x54, 0x08, 0x60, 0x9C, 0x0A, 0x01, 0x8C,
+    0x53, 0x21, 0x80, 0x71, 0x2A, 0x04, 0x30, 0x4E, 0x85, 0x00, 0xC6, 0xA9, 0x10, 0xB8, 0x38, 0xAB,
+    0x0A, 0x01, 0x8C, 0x53, 0x21, 0x80, 0x71, 0x2A, 0x04, 0x30, 0x4E, 0x85, 0x00, 0xC6, 0xA9, 0x10,
+    0xC0, 0x38, 0x15, 0x02, 0x18, 0xA7, 0x42, 0x00, 0xE3, 0x54, 0x08, 0x60, 0x9C, 0x0A, 0x01, 0x8C,
+    0x53, 0x21, 0x70, 0x71, 0xD6, 0x15, 0x02, 0x18, 0xA7, 0x42, 0x00, 0xE3, 0x54, 0x08, 0x60, 0x9C,
+    0x0A, 0x01, 0x8C, 0x53, 0x21, 0x80, 0x71, 0x2A, 0x04, 0x30, 0x4E, 0x85, 0x00, 0xC6, 0xA9, 0x10,
+    0xC0, 0x38, 0x15, 0x02, 0x18, 0x07, 0x2B, 0x04, 0xDF, 0x43, 0x4B, 0xED, 0xD8, 0x21, 0x01, 0x00,
+    0x00, 0x08, 0xC0, 0xB0, 0x5A, 0xF4, 0x4F, 0x86, 0x25, 0x00, 0xE2, 0x62, 0x19, 0xE6, 0x06, 0xE7,
+    0xE0, 0x8C, 0x21, 0x08, 0xE3, 0x18, 0x82, 0x30, 0x8E, 0x21, 0x08, 0xE3, 0x18, 0x82, 0x30, 0x8E,
+    0x21, 0x08, 0xE3, 0x18, 0x82, 0x30, 0x8E, 0x21, 0x08, 0xE3, 0x3C, 0x0D, 0xC1, 0x02,
+};
+
+// LZX blocks with a 64 KB window, verbatim and aligned. Seed 2, 36000 bytes
+static const CAB_TEST_BLOCK LzxBlocks[] =
+{
+    {1728, 32768},
+    {140, 3232},
+};
+
+static const BYTE LzxData[] =
+{
+    0x04, 0x20, 0x57, 0xE2, 0x6D, 0x55, 0x00, 0x42, 0x00, 0x00, 0x34, 0x02, 0x00, 0x00, 0x33, 0x00,
+    0xD0, 0x4A, 0xE9, 0x25, 0xF4, 0x6D, 0xE2, 0x7C, 0xB9, 0x36, 0x0A, 0x67, 0x82, 0x04, 0xEF, 0x88,
+    0xE8, 0xEF, 0x00, 0xA0, 0x00, 0x00, 0x99, 0x12, 0x2A, 0xB3, 0x20, 0x81, 0x27, 0x26, 0xCD, 0xC4,
+    0xA1, 0x29, 0x89, 0x88, 0x82, 0x19, 0x00, 0x75, 0x3F, 0xC1, 0x66, 0x20, 0x3F, 0x79, 0xEA, 0xD3,
+    0xAC, 0x24, 0x22, 0x91, 0xC8, 0x25, 0xF9, 0x94, 0x54, 0x29, 0xD4, 0xAD, 0x77, 0xEA, 0x80, 0x48,
+    0x00, 0x00, 0x00, 0x00, 0x86, 0x88, 0x06, 0x66, 0xEE, 0x41, 0xB9, 0x27, 0x29, 0x9B, 0x04, 0x75,
+    0xF9, 0x7C, 0xE0, 0xF3, 0xAB, 0x97, 0xB3, 0x5F, 0xF1, 0xDF, 0xE8, 0xED, 0x73, 0xF2, 0x6A, 0xF3,
+    0xF8, 0xEE, 0xB5, 0x7B, 0x7A, 0x74, 0xFC, 0xF5, 0x74, 0xB5, 0xEB, 0x76, 0xFA, 0xEE, 0xDD, 0x9E,
+    0xFD, 0x5D, 0xB9, 0xFA, 0xB6, 0xF9, 0xF0, 0x17, 0xDB, 0x37, 0xFB, 0xBE, 0xFF, 0xF4, 0x3F, 0xF9,
+    0xBF, 0xB1, 0x5D, 0xAB, 0xFB, 0x7D, 0x43, 0x6E, 0x8B, 0x7F, 0x1D, 0xBC, 0x57, 0x9F, 0xA5, 0x00,
+    0xFD, 0xF0, 0xF0, 0x42, 0xE6, 0x3C, 0x34, 0x10, 0x5D, 0x45, 0x8A, 0x37, 0x4C, 0x42, 0xA5, 0xA3,
+    0xFA, 0x03, 0xA7, 0x77, 0xD7, 0xE7, 0x39, 0x78, 0x0D, 0x84, 0x57, 0x11, 0xE2, 0x4D, 0x93, 0x90,
+    0xE9, 0x28, 0xFF, 0x40, 0xEA, 0x19, 0x8E, 0xBF, 0xE0, 0xDD, 0x10, 0xE6, 0x45, 0x34, 0x37, 0x5D,
+    0x42, 0x8A, 0xA3, 0x4C, 0x03, 0xA5, 0xD4, 0xFE, 0xBF, 0xEB, 0xDD, 0x8E, 0xE6, 0xE0, 0x34, 0x10,
+    0x5D, 0x45, 0x8A, 0x37, 0x4C, 0x42, 0xA5, 0xA3, 0xC4, 0x03, 0xB2, 0xD3, 0x3B, 0xFE, 0x83, 0x77,
+    0x40, 0x98, 0x15, 0xD1, 0xDE, 0x74, 0x09, 0x29, 0x8E, 0x32, 0x0E, 0x94, 0x2F, 0x20, 0xFE, 0x96,
+    0x77, 0x3B, 0x98, 0x83, 0xD1, 0x40, 0x74, 0x15, 0x29, 0xDE, 0x32, 0x09, 0x94, 0x8E, 0x2C, 0x0E,
+    0x35, 0xDF, 0x76, 0xFC, 0x07, 0xEF, 0x81, 0x30, 0x2A, 0xA2, 0xBC, 0xE9, 0x12, 0x52, 0x1D, 0x65,
+    0x1C, 0x28, 0xCF, 0x73, 0xFC, 0x3D, 0xEF, 0x76, 0x30, 0x07, 0xA2, 0x81, 0xE9, 0x2A, 0x52, 0xBC,
+    0x65, 0x12, 0x28, 0x1D, 0x8D, 0x1C, 0x8B, 0x1E, 0xED, 0xF8, 0x0E, 0xDE, 0x03, 0x61, 0x55, 0x44,
+    0x78, 0xD3, 0x24, 0xA4, 0x3A, 0xCA, 0x39, 0x50, 0x3D, 0x1A, 0xF1, 0x37, 0xBC, 0xDB, 0xC2, 0x1C,
+    0x88, 0x06, 0xA6, 0xAB, 0x48, 0xF1, 0x94, 0x49, 0xA0, 0x74, 0x34, 0x72, 0xE3, 0x74, 0x1C, 0xC0,
+    0x9C, 0x47, 0x06, 0xC2, 0xAB, 0x88, 0xF1, 0xA6, 0x49, 0x48, 0x74, 0x94, 0x6D, 0xA0, 0x8F, 0x3D,
+    0xC2, 0x00, 0xE6, 0x3C, 0x34, 0x10, 0x5D, 0x45, 0x8A, 0x37, 0x4C, 0x42, 0xA5, 0xA3, 0x71, 0x03,
+    0x3C, 0xE6, 0xE2, 0x03, 0xE6, 0x3C, 0x34, 0x10, 0x5D, 0x45, 0x8A, 0x37, 0x4C, 0x42, 0xA5, 0xA3,
+    0x7B, 0x03, 0xC7, 0x5F, 0x42, 0x80, 0xE6, 0x3C, 0x34, 0x10, 0x5D, 0x45, 0x8A, 0x37, 0x4C, 0x42,
+    0xA5, 0xA3, 0x81, 0x03, 0x3C, 0xAE, 0xF2, 0x03, 0xE6, 0x3C, 0x34, 0x10, 0x5D, 0x45, 0x8A, 0x37,
+    0x4C, 0x42, 0xA5, 0xA3, 0xC0, 0x02, 0x8F, 0x7D, 0xD2, 0x00, 0xE6, 0x3C, 0x34, 0x10, 0x5D, 0x45,
+    0x8A, 0x37, 0x4C, 0x42, 0xA5, 0xA3, 0xCD, 0x02, 0x3C, 0x2E, 0x88, 0x03, 0x98, 0xF3, 0xD1, 0x40,
+    0x74, 0x15, 0x29, 0xDE, 0x32, 0x09, 0x94, 0x8E, 0x67, 0x0B, 0x78, 0xEC, 0x23, 0x05, 0x61, 0xCE,
+    0x44, 0x03, 0xD3, 0x55, 0xA4, 0x78, 0xCA, 0x24, 0x50, 0x3A, 0x36, 0x30, 0xC0, 0x63, 0x47, 0x3C,
+    0xC2, 0x9C, 0x88, 0x06, 0xA6, 0xAB, 0x48, 0xF1, 0x94, 0x49, 0xA0, 0x74, 0x6C, 0x60, 0x80, 0xC7,
+    0x1E, 0xA1, 0x08, 0x73, 0x22, 0x1A, 0x9B, 0xAE, 0x21, 0xC5, 0x51, 0x26, 0x81, 0xD2, 0xD9, 0xC8,
+    0x97, 0xD5, 0xB1, 0x00, 0x73, 0x1E, 0x1A, 0x08, 0xAE, 0x22, 0xC5, 0x9B, 0x26, 0x21, 0xD2, 0x51,
+    0xB4, 0x81, 0x5C, 0xF6, 0x48, 0x02, 0x98, 0xF3, 0xD1, 0x40, 0x74, 0x15, 0x29, 0xDE, 0x32, 0x09,
+    0x94, 0x8E, 0xC7, 0x0D, 0x70, 0x99, 0x88, 0x0B, 0x98, 0xF3, 0xD1, 0x40, 0x74, 0x15, 0x29, 0xDE,
+    0x32, 0x09, 0x94, 0x8E, 0xED, 0x0D, 0x2E, 0x7F, 0xC2, 0x01, 0xE6, 0x3C, 0x34, 0x10, 0x5D, 0x45,
+    0x8A, 0x37, 0x4C, 0x42, 0xA5, 0xA3, 0x81, 0x03, 0x5C, 0xAE, 0xF1, 0x03, 0x73, 0x1E, 0x1A, 0x08,
+    0xAE, 0x22, 0xC5, 0x9B, 0x26, 0x21, 0xD2, 0x51, 0x60, 0x81, 0xCB, 0x3E, 0x61, 0x80, 0x73, 0x1E,
+    0x1A, 0x08, 0xAE, 0x22, 0xC5, 0x9B, 0x26, 0x21, 0xD2, 0x51, 0x66, 0x81, 0x2E, 0x97, 0xFC, 0x01,
+    0x39, 0x8F, 0x0D, 0x84, 0x57, 0x11, 0xE2, 0x4D, 0x93, 0x90, 0xE9, 0x28, 0xB6, 0x40, 0xCB, 0x7E,
+    0x74, 0x80, 0x39, 0x8F, 0x0D, 0x84, 0x57, 0x11, 0xE2, 0x4D, 0x93, 0x90, 0xE9, 0x28, 0xC0, 0x40,
+    0x97, 0xD9, 0xF1, 0x00, 0x73, 0x1E, 0x1A, 0x08, 0xAE, 0x22, 0xC5, 0x9B, 0x26, 0x21, 0xD2, 0x51,
+    0x81, 0x81, 0x2E, 0xB3, 0xA4, 0x01, 0xCC, 0x79, 0x68, 0x20, 0xBA, 0x8A, 0x14, 0x6F, 0x99, 0x84,
+    0x4A, 0x47, 0x23, 0x07, 0x5E, 0x67, 0x04, 0x7C, 0x1E, 0xF9, 0x08, 0x73, 0x22, 0x1A, 0x9B, 0xAE,
+    0x21, 0xC5, 0x51, 0x26, 0x81, 0xD2, 0xF6, 0xB4, 0x04, 0x7C, 0x79, 0xA4, 0x20, 0xCC, 0x8A, 0x68,
+    0x6F, 0xBA, 0x84, 0x14, 0x47, 0x99, 0x06, 0x4A, 0xCC, 0xE3, 0x09, 0xF8, 0xF3, 0x88, 0x40, 0x98,
+    0x15, 0xD1, 0xDE, 0x74, 0x09, 0x29, 0x8E, 0x32, 0x0D, 0x94, 0x7F, 0xED, 0x02, 0x3E, 0x79, 0x24,
+    0x20, 0xCC, 0x8A, 0x68, 0x6F, 0xBA, 0x84, 0x14, 0x47, 0x99, 0x07, 0x4A, 0x5C, 0x03, 0x09, 0xF8,
+    0x79, 0xC4, 0x20, 0xCC, 0x8A, 0x68, 0x6F, 0xBA, 0x84, 0x14, 0x47, 0x99, 0x05, 0x4A, 0xFB, 0x80,
+    0x02, 0x3E, 0x3C, 0xC2, 0x10, 0xE6, 0x45, 0x34, 0x37, 0x5D, 0x42, 0x8A, 0xA3, 0x4C, 0x02, 0xA5,
+    0x2E, 0xCD, 0x05, 0x7C, 0x1E, 0xF1, 0x08, 0x73, 0x22, 0x1A, 0x9B, 0xAE, 0x21, 0xC5, 0x51, 0x26,
+    0x81, 0xD2, 0xFD, 0x6C, 0x01, 0x9F, 0x3C, 0x42, 0x10, 0xE6, 0x45, 0x34, 0x37, 0x5D, 0x42, 0x8A,
+    0xA3, 0x4C, 0x03, 0xA5, 0x66, 0x03, 0x05, 0x7C, 0x1E, 0xF9, 0x08, 0x73, 0x22, 0x1A, 0x9B, 0xAE,
+    0x21, 0xC5, 0x51, 0x26, 0x81, 0xD2, 0xB3, 0x81, 0x02, 0x3E, 0x3C, 0xD2, 0x10, 0xE6, 0x45, 0x34,
+    0x37, 0x5D, 0x42, 0x8A, 0xA3, 0x4C, 0x03, 0xA5, 0xB3, 0x91, 0x4E, 0xB3, 0xBC, 0x01, 0x9C, 0x47,
+    0x06, 0xC2, 0xAB, 0x88, 0xF1, 0xA6, 0x49, 0x48, 0x74, 0x94, 0x6D, 0xA0, 0xA7, 0x3D, 0xC1, 0x00,
+    0x73, 0x1E, 0x1A, 0x08, 0xAE, 0x22, 0xC5, 0x9B, 0x26, 0x21, 0xD2, 0x51, 0xB8, 0x81, 0x4E, 0xF3,
+    0xBE, 0x01, 0x9C, 0x47, 0x06, 0xC2, 0xAB, 0x88, 0xF1, 0xA6, 0x49, 0x48, 0x74, 0x94, 0x6F, 0xA0,
+    0xFA, 0x6B, 0x0D, 0x70, 0xF3, 0x48, 0x40, 0x98, 0x15, 0xD1, 0xDE, 0x74, 0x09, 0x29, 0x8E, 0x32,
+    0x0E, 0x94, 0xBA, 0x06, 0x0D, 0x70, 0xF3, 0x88, 0x40, 0x98, 0x15, 0xD1, 0xDE, 0x74, 0x09, 0x29,
+    0x8E, 0x32, 0x0B, 0x94, 0xF6, 0x01, 0x03, 0x9C, 0x79, 0x24, 0x20, 0xCC, 0x8A, 0x68, 0x6F, 0xBA,
+    0x84, 0x14, 0x47, 0x99, 0x05, 0x4A, 0x5D, 0x9A, 0x06, 0x38, 0x3C, 0xE2, 0x10, 0xE6, 0x45, 0x34,
+    0x37, 0x5D, 0x42, 0x8A, 0xA3, 0x4C, 0x02, 0xA5, 0xFB, 0xD9, 0x01, 0x4E, 0x1E, 0xE1, 0x08, 0x73,
+    0x22, 0x1A, 0x9B, 0xAE, 0x21, 0xC5, 0x51, 0x26, 0x81, 0xD2, 0xB3, 0x81, 0x01, 0x4E, 0x47, 0xFC,
+    0xC1, 0x9C, 0x0B, 0x00, 0x00, 0xB9, 0x00, 0x02, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7F, 0x10,
+    0xDF, 0xE7, 0xD3, 0x7D, 0x00, 0x24, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x0B, 0x22, 0xD5, 0xF7,
+    0xE4, 0xC9, 0x62, 0xF2, 0x62, 0x43, 0x62, 0x62, 0x91, 0x7E, 0x74, 0xAA, 0x30, 0x42, 0x30, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x32, 0x03, 0x62, 0x0A, 0x3B, 0x70, 0xEF, 0xC7, 0xBF, 0xDF, 0x34, 0x44,
+    0xB3, 0x6C, 0x86, 0x2B, 0x94, 0xC2, 0x40, 0x4B, 0x05, 0xD8, 0xB5, 0xF9, 0x03, 0xBE, 0x3D, 0xA2,
+    0x9A, 0xEC, 0x59, 0x36, 0xC3, 0x95, 0x4A, 0x61, 0xA0, 0x25, 0x02, 0x6C, 0xDA, 0xF8, 0x7E, 0xE3,
+    0xE4, 0x07, 0xD9, 0x7B, 0x6C, 0x34, 0x2B, 0xB3, 0xC2, 0x86, 0x4B, 0x94, 0xD8, 0x40, 0xC9, 0x05,
+    0xF8, 0xDD, 0x11, 0x20, 0x64, 0xEF, 0xB2, 0xD1, 0xAE, 0xCC, 0x0A, 0x1B, 0x2D, 0x51, 0x60, 0x03,
+    0x47, 0x17, 0xF0, 0x1B, 0x23, 0x41, 0xC9, 0xDE, 0x65, 0xA3, 0x5C, 0x99, 0x14, 0x36, 0x5A, 0xA2,
+    0xC0, 0x06, 0xDA, 0x2E, 0xF0, 0x7B, 0x23, 0x42, 0xC9, 0xDE, 0x65, 0xA3, 0x5C, 0x99, 0x14, 0x36,
+    0x5A, 0xA2, 0xC0, 0x06, 0x0D, 0x2F, 0xF0, 0xDB, 0x23, 0x43, 0xC9, 0xDE, 0x65, 0xA3, 0x5C, 0x99,
+    0x14, 0x36, 0x5A, 0xA2, 0xC0, 0x06, 0x40, 0x2F, 0xF8, 0x9D, 0x11, 0x22, 0x64, 0xEF, 0xB2, 0xD1,
+    0xAE, 0xCC, 0x0A, 0x1B, 0x2D, 0x51, 0x60, 0x03, 0x00, 0x12, 0xC2, 0x32, 0x56, 0x95, 0x30, 0xD3,
+    0x00, 0x00, 0x33, 0x30, 0x00, 0x00, 0x00, 0x00, 0x7E, 0x10, 0xB7, 0x4B, 0xF7, 0x7D, 0x35, 0xDA,
+    0x00, 0x00, 0x00, 0x00, 0x05, 0x05, 0x31, 0x05, 0xDF, 0x30, 0x2C, 0xDF, 0x1C, 0x1C, 0x15, 0x1C,
+    0x1D, 0x5D, 0x1F, 0x1D, 0x66, 0x05, 0xC7, 0xA7, 0xF4, 0xE1, 0x80, 0x84, 0x00, 0x00, 0x00, 0x00,
+    0x80, 0x00, 0x44, 0x06, 0x19, 0x00, 0x72, 0x01, 0xFB, 0xFD, 0xD6, 0xF7, 0xFB, 0xF5, 0x27, 0x8D,
+    0x08, 0x7A, 0x73, 0xA2, 0x58, 0xD8, 0xC5, 0x71, 0x2F, 0x1C, 0x41, 0xC8, 0x06, 0x4D, 0x0E, 0xD0,
+    0xDD, 0x67, 0x21, 0xE8, 0x9E, 0x13, 0xC3, 0xC2, 0x28, 0x8E, 0x7E, 0xE1, 0x0A, 0x42, 0x36, 0x68,
+    0x74, 0x80, 0xEF, 0x6C, 0x18, 0x41, 0x7B, 0x4E, 0x0E, 0x0B, 0xA3, 0x38, 0xF9, 0x85, 0x29, 0x08,
+    0xDA, 0xA0, 0xD1, 0x01, 0xBD, 0xB3, 0xF0, 0x04, 0xF6, 0x9C, 0x1C, 0x16, 0x47, 0x71, 0xF2, 0x0B,
+    0x53, 0x10, 0xB4, 0x41, 0xF1, 0x03, 0xFD, 0xB3, 0x09, 0xB8, 0x73, 0xA2, 0x58, 0xD8, 0xC5, 0x71,
+    0x2F, 0x1C, 0x41, 0xC8, 0x06, 0x4D, 0x0F, 0xD0, 0x77, 0x47, 0x28, 0x01, 0xF6, 0x9C, 0x1C, 0x16,
+    0x47, 0x71, 0xF2, 0x0B, 0x53, 0x10, 0xB4, 0x41, 0xD9, 0x03, 0x70, 0xFB, 0x84, 0x13, 0xB0, 0xE7,
+    0xE3, 0xB0, 0x38, 0x8A, 0x90, 0x5F, 0x9A, 0x82, 0xA0, 0x0D, 0x1A, 0x1F, 0xE0, 0xFE, 0x84, 0x2B,
+    0xB0, 0xE7, 0xE3, 0xB0, 0x38, 0x8A, 0x90, 0x5F, 0x9A, 0x82, 0xA0, 0x0D, 0x4D, 0x1F, 0x01, 0x77,
+    0x13, 0x5E, 0xC2, 0x9E, 0x8E, 0xC3, 0xE1, 0x28, 0x42, 0x7E, 0x68, 0x0A, 0x80, 0x36, 0x0F, 0x70,
+    0x01, 0xB7, 0x9C, 0x40, 0x16, 0xF6, 0x71, 0x1C, 0x0B, 0x47, 0x10, 0xF2, 0x41, 0x53, 0x03, 0xB4,
+    0x26, 0x8D, 0x2B, 0xE0, 0x73, 0xE2, 0x58, 0xD8, 0xC5, 0x71, 0x2F, 0x1C, 0x41, 0xC8, 0x06, 0x4D,
+    0x0E, 0xD0, 0xDB, 0x67, 0xA8, 0x80, 0x3D, 0x27, 0x87, 0x85, 0x51, 0x1C, 0xFC, 0xC2, 0x14, 0x84,
+    0x6D, 0xD0, 0xE8, 0x00, 0xB8, 0xD9, 0xA2, 0x0A, 0xD8, 0x73, 0x71, 0x58, 0x1C, 0xC5, 0xC8, 0x2F,
+    0x4D, 0x41, 0xD0, 0x06, 0x8D, 0x0E, 0x80, 0x9B, 0x4E, 0xA4, 0x0B, 0x7B, 0x38, 0x0E, 0x85, 0xA3,
+    0x08, 0xF9, 0xA0, 0x29, 0x01, 0xDA, 0xD9, 0xF8, 0xDD, 0xFF, 0xFC, 0x05, 0x7B, 0x4E, 0x0E, 0x0B,
+    0xA3, 0x38, 0xF9, 0x85, 0x29, 0x08, 0xDA, 0xA0, 0xE8, 0x01, 0xE8, 0xEE, 0x09, 0x2E, 0x61, 0xCF,
+    0xC7, 0x61, 0x70, 0x14, 0x21, 0xBF, 0x34, 0x05, 0x40, 0x1B, 0x9F, 0x3D, 0x41, 0xB7, 0x4E, 0x74,
+    0x0B, 0x7B, 0x38, 0x0E, 0x85, 0xA3, 0x08, 0xF9, 0xA0, 0x29, 0x01, 0xDA, 0xAF, 0xF1, 0x82, 0xEE,
+    0x39, 0xD1, 0x2C, 0xEC, 0xE2, 0x38, 0x17, 0x8E, 0x20, 0xE4, 0x83, 0xA6, 0x07, 0x68, 0x5D, 0xD3,
+    0x5E, 0xD0, 0x9E, 0x13, 0xC3, 0xC2, 0x28, 0x8E, 0x7E, 0xE1, 0x0A, 0x42, 0x36, 0x68, 0x70, 0x80,
+    0xB7, 0x0F, 0x9C, 0x41, 0x3D, 0x27, 0x87, 0x85, 0x51, 0x1C, 0xFC, 0xC2, 0x14, 0x84, 0x6D, 0xD0,
+    0xE3, 0x00, 0xBA, 0x49, 0xF0, 0x0C, 0xF6, 0x9C, 0x1C, 0x16, 0x47, 0x71, 0xF2, 0x0B, 0x53, 0x10,
+    0xB4, 0x41, 0x99, 0x03, 0xE8, 0xF6, 0x13, 0x30, 0xC2, 0x9E, 0x8E, 0xC3, 0xE1, 0x28, 0x42, 0x7E,
+    0x68, 0x0A, 0x80, 0x36, 0x6C, 0x74, 0x06, 0xDD, 0x4E, 0x7C, 0x0B, 0x7B, 0x38, 0x0E, 0x85, 0xA3,
+    0x08, 0xF9, 0xA0, 0x29, 0x01, 0xDA, 0xB3, 0xD1, 0x19, 0x74, 0xE7, 0x04, 0xB0, 0xB0, 0x88, 0xE3,
+    0x0B, 0x47, 0x10, 0xF2, 0x41, 0x53, 0x03, 0xB4, 0xB3, 0xF1, 0xCC, 0xFB, 0x7C, 0x03, 0x3D, 0x27,
+    0x87, 0x85, 0x51, 0x1C, 0xFC, 0xC2, 0x14, 0x84, 0x6D, 0xD0, 0xF4, 0x00, 0xCC, 0x77, 0x41, 0x03,
+    0xEC, 0x39, 0x38, 0x2C, 0x8E, 0xE2, 0xE4, 0x17, 0xA6, 0x20, 0x68, 0x83, 0xB3, 0x07, 0x98, 0xF7,
+    0xFC, 0x06, 0x7B, 0x4E, 0x0E, 0x0B, 0xA3, 0x38, 0xF9, 0x85, 0x29, 0x08, 0xDA, 0xA0, 0xF1, 0x01,
+    0xF9, 0xAF, 0x6C, 0x80, 0x9E, 0x13, 0xC3, 0xC2, 0x28, 0x8E, 0x7E, 0xE1, 0x0A, 0x42, 0x36, 0x68,
+    0x7D, 0x80, 0xF3, 0x35, 0xDA, 0x00, 0x3D, 0x27, 0x87, 0x85, 0x51, 0x1C, 0xFC, 0xC2, 0x14, 0x84,
+    0x6D, 0xD0, 0xE0, 0x00, 0x79, 0x1F, 0x6A, 0x80, 0x3D, 0x27, 0x87, 0x85, 0x51, 0x1C, 0xFC, 0xC2,
+    0x14, 0x84, 0x6D, 0xD0, 0xE3, 0x00, 0xE6, 0x49, 0xB8, 0x01, 0x7B, 0x4E, 0x0E, 0x0B, 0xA3, 0x38,
+    0xF9, 0x85, 0x29, 0x08, 0xDA, 0xA0, 0xCC, 0x01, 0xCF, 0xFB, 0xDC, 0x01,
+};
+
+static const CAB_TEST_FOLDER TestFolders[] =
+{
+    {CAB_COMPRESS_NONE,            3, NULL,        0,                    NULL,       3, {7000, 0, 33000}},
+    {CAB_COMPRESS_MSZIP,           1, MsZipBlocks, _countof(MsZipBlocks), MsZipData, 2, {20000, 16000}},
+    {CAB_COMPRESS_LZX | (16 << 8), 2, LzxBlocks,   _countof(LzxBlocks),   LzxData,   3, {1000, 30000, 5000}},
+};
+
+static DWORD dwFailures = 0;
+
+//-----------------------------------------------------------------------------
+// Local functions
+
+static void Check(bool bCondition, const char * szWhat, const char * szDetail)
+{
+    if(!bCondition)
+    {
+        printf("  FAILED: %s (%s)\n", szWhat, szDetail);
+        dwFailures++;
+    }
+}
+
+static void AppendData(std::vector<BYTE> & Buffer, const void * pvData, size_t cbData)
+{
+    Buffer.insert(Buffer.end(), (const BYTE *)(pvData), (const BYTE *)(pvData) + cbData);
+}
+
+// Records with a repeated line of random words. Compressible, but not trivially
+static void GenerateData(std::vector<BYTE> & Data, DWORD dwSeed, size_t cbData)
+{
+    static const char * Words[] = {"alpha ", "beta ", "gamma\r\n", "delta "};
+    std::string strLine;
+    char szRecord[32];
+
+    while(strLine.size() < 400)
+    {
+        dwSeed = dwSeed * 1103515245 + 12345;
+        strLine.append(Words[(dwSeed >> 16) & 3]);
+    }
+
+    Data.clear();
+    for(DWORD dwRecord = 0; Data.size() < cbData; dwRecord++)
+    {
+        snprintf(szRecord, _countof(szRecord), "Record %u\r\n", dwRecord);
+        AppendData(Data, szRecord, strlen(szRecord));
+        AppendData(Data, strLine.c_str(), strLine.size());
+    }
+    Data.resize(cbData);
+}
+
+// Builds the cabinet of the test folders. Also gives the expected data of each file
+static void BuildCabinet(std::vector<BYTE> & Cabinet, std::vector<std::vector<BYTE> > & Files)
+{
+    std::vector<BYTE> FileEntries;
+    std::vector<BYTE> DataBlocks;
+    std::vector<BYTE> Data;
+    CAB_FOLDER_ENTRY FolderEntries[_countof(TestFolders)];
+    CAB_HEADER Header = {0};
+    DWORD dwDataOffset;
+
+    // The data blocks follow the header, the folders and the files
+    for(WORD nFolder = 0; nFolder < _countof(TestFolders); nFolder++)
+    {
+        const CAB_TEST_FOLDER & TestFolder = TestFolders[nFolder];
+        DWORD FolderOffset = 0;
+
+        for(size_t i = 0; i < TestFolder.nFiles; i++)
+            FolderOffset += TestFolder.FileSizes[i];
+        GenerateData(Data, TestFolder.dwSeed, FolderOffset);
+
+        // Each file has a CFFILE entry and its name
+        FolderOffset = 0;
+        for(size_t i = 0; i < TestFolder.nFiles; i++)
+        {
+            CAB_FILE_ENTRY FileEntry = {TestFolder.FileSizes[i], FolderOffset, nFolder, 0x5A21, 0x6000, 0x20};
+            char szFileName[32];
+
+            snprintf(szFileName, _countof(szFileName), "folder%u_file%u.bin", nFolder, (DWORD)(i));
+            AppendData(FileEntries, &FileEntry, sizeof(CAB_FILE_ENTRY));
+            AppendData(FileEntries, szFileName, strlen(szFileName) + 1);
+            Files.push_back(std::vector<BYTE>(Data.begin() + FolderOffset, Data.begin() + FolderOffset + TestFolder.FileSizes[i]));
+            FolderOffset += TestFolder.FileSizes[i];
+        }
+
+        // Stored blocks are made from the data, the compressed ones are taken as they are
+        FolderEntries[nFolder].DataOffset = (DWORD)(DataBlocks.size());
+        FolderEntries[nFolder].CompressType = TestFolder.CompressType;
+        if(TestFolder.pBlocks == NULL)
+        {
+            FolderEntries[nFolder].DataBlocks = 0;
+            for(size_t nOffset = 0; nOffset < Data.size(); nOffset += CAB_FRAME_SIZE)
+            {
+                WORD cbBlock = (WORD)std::min<size_t>(Data.size() - nOffset, CAB_FRAME_SIZE);
+                CAB_DATA_ENTRY DataEntry = {0, cbBlock, cbBlock};
+
+                AppendData(DataBlocks, &DataEntry, sizeof(CAB_DATA_ENTRY));
+                AppendData(DataBlocks, &Data[nOffset], cbBlock);
+                FolderEntries[nFolder].DataBlocks++;
+            }
+        }
+        else
+        {
+            const BYTE * pbBlock = TestFolder.pbData;
+
+            FolderEntries[nFolder].DataBlocks = (WORD)(TestFolder.nBlocks);
+            for(size_t i = 0; i < TestFolder.nBlocks; i++)
+            {
+                CAB_DATA_ENTRY DataEntry = {0, TestFolder.pBlocks[i].CompressedSize, TestFolder.pBlocks[i].UncompressedSize};
+
+                AppendData(DataBlocks, &DataEntry, sizeof(CAB_DATA_ENTRY));
+                AppendData(DataBlocks, pbBlock, DataEntry.CompressedSize);
+                pbBlock += DataEntry.CompressedSize;
+            }
+        }
+    }
+
+    // Now that the sizes are known, fix the offsets
+    dwDataOffset = (DWORD)(sizeof(CAB_HEADER) + sizeof(FolderEntries) + FileEntries.size());
+    for(size_t i = 0; i < _countof(FolderEntries); i++)
+        FolderEntries[i].DataOffset += dwDataOffset;
+
+    Header.Signature = CAB_SIGNATURE;
+    Header.CabinetSize = (DWORD)(dwDataOffset + DataBlocks.size());
+    Header.FilesOffset = (DWORD)(sizeof(CAB_HEADER) + sizeof(FolderEntries));
+    Header.VersionMinor = 3;
+    Header.VersionMajor = 1;
+    Header.Folders = _countof(FolderEntries);
+    Header.Files = (WORD)(Files.size());
+    Header.SetID = 0x1234;
+
+    Cabinet.clear();
+    AppendData(Cabinet, &Header, sizeof(CAB_HEADER));
+    AppendData(Cabinet, FolderEntries, sizeof(FolderEntries));
+    AppendData(Cabinet, &FileEntries[0], FileEntries.size());
+    AppendData(Cabinet, &DataBlocks[0], DataBlocks.size());
+}
+
+// Writes a compound file with one stream. The stream must be at least
+// as big as the mini stream cutoff, so that it is in the regular sectors.
+// Layout: header, the stream, one directory sector, the FAT.
+static bool WriteCompoundFile(const char * szFileName, const std::vector<BYTE> & Stream)
+{
+    static const char szStreamName[] = "Cabinet";
+    std::vector<CFB_DIRENTRY> Directory(TEST_SECTOR_SIZE / sizeof(CFB_DIRENTRY));
+    std::vector<DWORD> Fat;
+    std::vector<BYTE> File;
+    CFB_HEADER Header;
+    DWORD dwStreamSectors = (DWORD)((Stream.size() + TEST_SECTOR_SIZE - 1) / TEST_SECTOR_SIZE);
+    DWORD dwFatSectors = 1;
+    FILE * fp;
+    bool bResult = false;
+
+    // The FAT must cover the stream, the directory and the FAT itself
+    while((dwStreamSectors + 1 + dwFatSectors) > dwFatSectors * TEST_FAT_ENTRIES)
+        dwFatSectors++;
+    for(DWORD i = 0; i < dwStreamSectors; i++)
+        Fat.push_back((i + 1 < dwStreamSectors) ? (i + 1) : CFB_ENDOFCHAIN);
+    Fat.push_back(CFB_ENDOFCHAIN);
+    Fat.insert(Fat.end(), dwFatSectors, CFB_FATSECT);
+    Fat.resize(dwFatSectors * TEST_FAT_ENTRIES, CFB_FREESECT);
+
+    // The root and the stream. The root has no mini stream
+    memset(&Directory[0], 0, Directory.size() * sizeof(CFB_DIRENTRY));
+    for(size_t i = 0; i < Directory.size(); i++)
+        Directory[i].LeftSibling = Directory[i].RightSibling = Directory[i].Child = CFB_NOSTREAM;
+    for(size_t i = 0; i < sizeof("Root Entry"); i++)
+        Directory[0].Name[i] = "Root Entry"[i];
+    Directory[0].NameLength = sizeof("Root Entry") * sizeof(WORD);
+    Directory[0].Type = CFB_TYPE_ROOT;
+    Directory[0].Color = 1;
+    Directory[0].Child = 1;
+    Directory[0].StartSector = CFB_ENDOFCHAIN;
+    for(size_t i = 0; i < sizeof(szStreamName); i++)
+        Directory[1].Name[i] = szStreamName[i];
+    Directory[1].NameLength = sizeof(szStreamName) * sizeof(WORD);
+    Directory[1].Type = CFB_TYPE_STREAM;
+    Directory[1].Color = 1;
+    Directory[1].StartSector = 0;
+    Directory[1].StreamSize = Stream.size();
+
+    memset(&Header, 0, sizeof(CFB_HEADER));
+    Header.Signature = CFB_HEADER_SIGNATURE;
+    Header.MinorVersion = 0x3E;
+    Header.MajorVersion = 3;
+    Header.ByteOrder = CFB_BYTE_ORDER_MARK;
+    Header.SectorShift = 9;
+    Header.MiniSectorShift = 6;
+    Header.FatSectors = dwFatSectors;
+    Header.FirstDirSector = dwStreamSectors;
+    Header.MiniStreamCutoff = 0x1000;
+    Header.FirstMiniFatSector = CFB_ENDOFCHAIN;
+    Header.FirstDifatSector = CFB_ENDOFCHAIN;
+    for(DWORD i = 0; i < CFB_HEADER_DIFAT_COUNT; i++)
+        Header.Difat[i] = (i < dwFatSectors) ? (dwStreamSectors + 1 + i) : CFB_FREESECT;
+
+    // Put the file together, each part padded to whole sectors
+    AppendData(File, &Header, sizeof(CFB_HEADER));
+    File.resize(TEST_SECTOR_SIZE);
+    AppendData(File, &Stream[0], Stream.size());
+    File.resize(TEST_SECTOR_SIZE * (1 + dwStreamSectors));
+    AppendData(File, &Directory[0], Directory.size() * sizeof(CFB_DIRENTRY));
+    AppendData(File, &Fat[0], Fat.size() * sizeof(DWORD));
+
+    if((fp = fopen(szFileName, "wb")) != NULL)
+    {
+        bResult = (fwrite(&File[0], 1, File.size(), fp) == File.size());
+        fclose(fp);
+    }
+    return bResult;
+}
+
+// Reads the files in the given order, the same way as the extraction does
+static void ReadFiles(TCabinet * pCabinet, DWORD dwWorkers, const std::vector<size_t> & Order, const std::vector<std::vector<BYTE> > & Files, const char * szOrderName)
+{
+    std::vector<BYTE> Chunk(TEST_CHUNK_SIZE);
+    TCabFolderPool Pool;
+    char szDetail[64];
+
+    snprintf(szDetail, _countof(szDetail), "%s, %u workers", szOrderName, dwWorkers);
+    Check(Pool.Open(pCabinet, dwWorkers) == ERROR_SUCCESS, "Open", szDetail);
+    for(size_t i = 0; i < Order.size(); i++)
+    {
+        const CAB_FILE & CabFile = pCabinet->File(Order[i]);
+        const std::vector<BYTE> & Expected = Files[Order[i]];
+        ULONGLONG ByteOffset = 0;
+        bool bMatch = (CabFile.FileSize == Expected.size());
+
+        Pool.FileStarted();
+        while(bMatch && ByteOffset < CabFile.FileSize)
+        {
+            DWORD dwBytesRead = (DWORD)std::min<ULONGLONG>(CabFile.FileSize - ByteOffset, TEST_CHUNK_SIZE);
+
+            if(Pool.Read(CabFile.Folder, CabFile.FolderOffset + ByteOffset, &Chunk[0], dwBytesRead, &dwBytesRead) != ERROR_SUCCESS || dwBytesRead == 0)
+                break;
+            bMatch = !memcmp(&Chunk[0], &Expected[(size_t)(ByteOffset)], dwBytesRead);
+            ByteOffset += dwBytesRead;
+        }
+        Check(bMatch && ByteOffset == Expected.size(), CabFile.Name.c_str(), szDetail);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Main
+
+int main(int argc, char * argv[])
+{
+    std::vector<std::vector<BYTE> > Files;
+    std::vector<BYTE> Cabinet;
+    std::vector<size_t> Order;
+    std::string strFileName = std::string(argv[0]) + ".msi";
+    TCompoundFile CompFile;
+    TCabinet Cabinet1;
+
+    // Store the cabinet in a compound file, like it is in an MSI
+    BuildCabinet(Cabinet, Files);
+    if(!WriteCompoundFile(strFileName.c_str(), Cabinet))
+    {
+        printf("Failed to create %s\n", strFileName.c_str());
+        return 1;
+    }
+
+    printf("Cabinet\n");
+    Check(CompFile.Open(strFileName.c_str()) == ERROR_SUCCESS, "TCompoundFile::Open", strFileName.c_str());
+    Check(CompFile.EntryCount() >= 2 && TCabinet::IsCabinet(&CompFile, 1), "TCabinet::IsCabinet", "stream #1");
+    Check(Cabinet1.Open(&CompFile, 1) == ERROR_SUCCESS, "TCabinet::Open", "stream #1");
+    Check(Cabinet1.FolderCount() == _countof(TestFolders) && Cabinet1.FileCount() == Files.size(), "TCabinet::Open", "folders and files");
+
+    if(dwFailures == 0)
+    {
+        // In order, as Total Commander extracts the files
+        for(size_t i = 0; i < Files.size(); i++)
+            Order.push_back(i);
+        printf("Files in order\n");
+        for(DWORD dwWorkers = 1; dwWorkers <= 4; dwWorkers *= 2)
+            ReadFiles(&Cabinet1, dwWorkers, Order, Files, "in order");
+
+        // Backwards, so that every folder is restarted
+        std::reverse(Order.begin(), Order.end());
+        printf("Files in reverse order\n");
+        for(DWORD dwWorkers = 1; dwWorkers <= 4; dwWorkers *= 2)
+            ReadFiles(&Cabinet1, dwWorkers, Order, Files, "reverse order");
+    }
+
+    CompFile.Close();
+    remove(strFileName.c_str());
+
+    printf("test_cab: %s\n", (dwFailures == 0) ? "OK" : "FAILED");
+    return (dwFailures == 0) ? 0 : 1;
+}
@@ -0,0 +1,240 @@
+/*****************************************************************************/
+/* test_cache.cpp                         Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Rejection of damaged listing cache files                                  */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 16.10.26  1.00  Lad  Created                                              */
+/*****************************************************************************/
+
+#include "../wcx_msi.h"
+
+//-----------------------------------------------------------------------------
+// Local defines
+
+#define TEST_FILE_TYPES     6                   // Number of file types known to the plugin
+#define TEST_ENTRY_COUNT    5                   // Number of entries of the compound file
+
+enum CACHE_DAMAGE
+{
+    CacheIntact,
+    CacheShortHeader,
+    CacheSignature,
+    CacheVersion,
+    CacheCharSize,
+    CacheOtherArchive,
+    CacheExtraByte,
+    CacheShortArena,
+    CacheHugeFileCount,
+    CacheIndexNotPowerOfTwo,
+    CacheIndexTooSmall,
+    CacheNameOutsideArena,
+    CacheEmptyName,
+    CacheNameNotTerminated,
+    CacheFoldedNameNotTerminated,
+    CacheRefFileOutside,
+    CacheRefFileChain,
+    CacheFileType,
+    CacheStreamEntry,
+    CacheIndexSlot
+};
+
+struct CACHE_TEST
+{
+    const char * szName;
+    CACHE_DAMAGE Damage;
+    DWORD dwExpected;                           // Expected result of MsiCacheCheckData
+};
+
+// The parts of a cache file, before they are put together
+struct CACHE_TEST_PARTS
+{
+    MSI_CACHE_HEADER Header;
+    std::vector<MSI_FILE_ENTRY> Entries;
+    std::vector<MSI_CACHE_FILE> CacheFiles;
+    std::vector<DWORD> Index;
+    std::vector<TCHAR> Arena;
+};
+
+//-----------------------------------------------------------------------------
+// Local variables
+
+static const CACHE_TEST CacheTests[] =
+{
+    {"intact",                          CacheIntact,                    ERROR_SUCCESS},
+    {"short header",                    CacheShortHeader,               ERROR_FILE_CORRUPT},
+    {"signature",                       CacheSignature,                 ERROR_BAD_FORMAT},
+    {"version",                         CacheVersion,                   ERROR_BAD_FORMAT},
+    {"character size",                  CacheCharSize,                  ERROR_BAD_FORMAT},
+    {"other archive",                   CacheOtherArchive,              ERROR_INVALID_DATA},
+    {"extra byte",                      CacheExtraByte,                 ERROR_FILE_CORRUPT},
+    {"short arena",                     CacheShortArena,                ERROR_FILE_CORRUPT},
+    {"huge file count",                 CacheHugeFileCount,             ERROR_FILE_CORRUPT},
+    {"index not a power of two",        CacheIndexNotPowerOfTwo,        ERROR_FILE_CORRUPT},
+    {"index more than half full",       CacheIndexTooSmall,             ERROR_FILE_CORRUPT},
+    {"name outside the arena",          CacheNameOutsideArena,          ERROR_FILE_CORRUPT},
+    {"empty name",                      CacheEmptyName,                 ERROR_FILE_CORRUPT},
+    {"name not terminated",             CacheNameNotTerminated,         ERROR_FILE_CORRUPT},
+    {"lowercased name not terminated",  CacheFoldedNameNotTerminated,   ERROR_FILE_CORRUPT},
+    {"referenced file outside",         CacheRefFileOutside,            ERROR_FILE_CORRUPT},
+    {"referenced file refers further",  CacheRefFileChain,              ERROR_FILE_CORRUPT},
+    {"unknown file type",               CacheFileType,                  ERROR_FILE_CORRUPT},
+    {"stream entry outside",            CacheStreamEntry,               ERROR_FILE_CORRUPT},
+    {"index slot outside",              CacheIndexSlot,                 ERROR_FILE_CORRUPT},
+};
+
+static DWORD dwFailures = 0;
+
+//-----------------------------------------------------------------------------
+// Local functions
+
+static void Check(bool bCondition, const char * szWhat, const char * szDetail)
+{
+    if(!bCondition)
+    {
+        printf("  FAILED: %s (%s)\n", szWhat, szDetail);
+        dwFailures++;
+    }
+}
+
+static void AppendData(std::vector<BYTE> & Buffer, const void * pvData, size_t cbData)
+{
+    Buffer.insert(Buffer.end(), (const BYTE *)(pvData), (const BYTE *)(pvData) + cbData);
+}
+
+static DWORD AppendName(CACHE_TEST_PARTS & Parts, const char * szName, const char * szFoldedName)
+{
+    DWORD dwOffset = (DWORD)(Parts.Arena.size());
+
+    Parts.Arena.insert(Parts.Arena.end(), szName, szName + strlen(szName) + 1);
+    Parts.Arena.insert(Parts.Arena.end(), szFoldedName, szFoldedName + strlen(szFoldedName) + 1);
+    return dwOffset;
+}
+
+// Two files, the second one shows the data of the first one
+static void MakeCache(CACHE_TEST_PARTS & Parts, const MSI_CACHE_KEY & CacheKey)
+{
+    MSI_FILE_ENTRY Entry = {0};
+    MSI_CACHE_FILE CacheFile = {0};
+
+    Entry.FileSize = 100;
+    Entry.NameOffset = AppendName(Parts, "Table.csv", "table.csv");
+    Entry.NameLength = 9;
+    Entry.RefFile = MSI_NO_FILE;
+    Parts.Entries.push_back(Entry);
+    CacheFile.FileType = 4;
+    CacheFile.dwStreamEntry = 3;
+    Parts.CacheFiles.push_back(CacheFile);
+
+    Entry.NameOffset = AppendName(Parts, "Copy.csv", "copy.csv");
+    Entry.NameLength = 8;
+    Entry.RefFile = 0;
+    Parts.Entries.push_back(Entry);
+    CacheFile.dwStreamEntry = CFB_NOSTREAM;
+    Parts.CacheFiles.push_back(CacheFile);
+
+    Parts.Index.assign(4, MSI_NO_FILE);
+    Parts.Index[1] = 1;
+    Parts.Index[2] = 0;
+
+    memset(&Parts.Header, 0, sizeof(MSI_CACHE_HEADER));
+    Parts.Header.Signature = MSI_CACHE_SIGNATURE;
+    Parts.Header.Version = MSI_CACHE_VERSION;
+    Parts.Header.CharSize = sizeof(TCHAR);
+    Parts.Header.FileCount = (DWORD)(Parts.Entries.size());
+    Parts.Header.CacheKey = CacheKey;
+    Parts.Header.IndexSize = (DWORD)(Parts.Index.size());
+    Parts.Header.ArenaLength = (DWORD)(Parts.Arena.size());
+}
+
+static void DamageCache(CACHE_TEST_PARTS & Parts, CACHE_DAMAGE Damage)
+{
+    switch(Damage)
+    {
+        case CacheSignature:                Parts.Header.Signature++; break;
+        case CacheVersion:                  Parts.Header.Version++; break;
+        case CacheCharSize:                 Parts.Header.CharSize = 4; break;
+        case CacheOtherArchive:             Parts.Header.CacheKey.ArchiveSize++; break;
+        case CacheShortArena:               Parts.Arena.pop_back(); break;
+        case CacheHugeFileCount:            Parts.Header.FileCount = 0x80000000; break;
+        case CacheNameOutsideArena:         Parts.Entries[1].NameOffset = Parts.Header.ArenaLength - 8; break;
+        case CacheEmptyName:                Parts.Entries[0].NameLength = 0; break;
+        case CacheNameNotTerminated:        Parts.Arena[9] = 'x'; break;
+        case CacheFoldedNameNotTerminated:  Parts.Arena[19] = 'x'; break;
+        case CacheRefFileOutside:           Parts.Entries[1].RefFile = 2; break;
+        case CacheRefFileChain:             Parts.Entries[0].RefFile = 1; break;
+        case CacheFileType:                 Parts.CacheFiles[1].FileType = TEST_FILE_TYPES; break;
+        case CacheStreamEntry:              Parts.CacheFiles[0].dwStreamEntry = TEST_ENTRY_COUNT; break;
+        case CacheIndexSlot:                Parts.Index[3] = 2; break;
+
+        case CacheIndexNotPowerOfTwo:
+            Parts.Index.resize(6, MSI_NO_FILE);
+            Parts.Header.IndexSize = (DWORD)(Parts.Index.size());
+            break;
+
+        case CacheIndexTooSmall:
+            Parts.Index.resize(2);
+            Parts.Header.IndexSize = (DWORD)(Parts.Index.size());
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void PutCacheTogether(const CACHE_TEST_PARTS & Parts, CACHE_DAMAGE Damage, std::vector<BYTE> & Cache)
+{
+    Cache.clear();
+    AppendData(Cache, &Parts.Header, sizeof(MSI_CACHE_HEADER));
+    AppendData(Cache, &Parts.Entries[0], Parts.Entries.size() * sizeof(MSI_FILE_ENTRY));
+    AppendData(Cache, &Parts.CacheFiles[0], Parts.CacheFiles.size() * sizeof(MSI_CACHE_FILE));
+    AppendData(Cache, &Parts.Index[0], Parts.Index.size() * sizeof(DWORD));
+    AppendData(Cache, &Parts.Arena[0], Parts.Arena.size() * sizeof(TCHAR));
+
+    if(Damage == CacheShortHeader)
+        Cache.resize(sizeof(MSI_CACHE_HEADER) - 1);
+    if(Damage == CacheExtraByte)
+        Cache.push_back(0);
+}
+
+//-----------------------------------------------------------------------------
+// Main
+
+int main(int argc, char * argv[])
+{
+    MSI_CACHE_KEY CacheKey = {0};
+
+    CacheKey.ArchiveSize = 0x123456;
+    CacheKey.LastWriteTime.dwLowDateTime = 0x89ABCDEF;
+    CacheKey.LastWriteTime.dwHighDateTime = 0x01DC0000;
+    CacheKey.PathHash = 0xCBF29CE484222325ULL;
+    CacheKey.HeaderHash = 0x811C9DC5;
+
+    printf("Listing cache\n");
+    for(size_t i = 0; i < _countof(CacheTests); i++)
+    {
+        const CACHE_TEST & CacheTest = CacheTests[i];
+        MSI_CACHE_ARRAYS Arrays;
+        CACHE_TEST_PARTS Parts;
+        std::vector<BYTE> Cache;
+        DWORD dwErrCode;
+
+        MakeCache(Parts, CacheKey);
+        DamageCache(Parts, CacheTest.Damage);
+        PutCacheTogether(Parts, CacheTest.Damage, Cache);
+
+        dwErrCode = MsiCacheCheckData(&Cache[0], Cache.size(), CacheKey, TEST_FILE_TYPES, TEST_ENTRY_COUNT, Arrays);
+        Check(dwErrCode == CacheTest.dwExpected, "MsiCacheCheckData", CacheTest.szName);
+
+        // The arrays of an intact cache point to the data in the cache
+        if(CacheTest.Damage == CacheIntact && dwErrCode == ERROR_SUCCESS)
+        {
+            Check(Arrays.pEntries[1].RefFile == 0 && Arrays.pCacheFiles[0].dwStreamEntry == 3, "MsiCacheCheckData", "arrays");
+            Check(Arrays.pIndex[2] == 0 && !strcmp(Arrays.pArena + Arrays.pEntries[1].NameOffset, "Copy.csv"), "MsiCacheCheckData", "names");
+        }
+    }
+
+    printf("test_cache: %s\n", (dwFailures == 0) ? "OK" : "FAILED");
+    return (dwFailures == 0) ? 0 : 1;
+}
@@ -0,0 +1,214 @@
+/*****************************************************************************/
+/* test_csv.cpp                           Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Quoting and UTF-8 encoding of the CSV cells, serial and parallel render   */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 16.10.26  1.00  Lad  Created                                              */
+/*****************************************************************************/
+
+#include "../wcx_msi.h"
+
+//-----------------------------------------------------------------------------
+// Local defines
+
+#define TEST_ROW_COUNT      10000               // More than two ranges of the render pool
+
+struct CSV_TEST_CELL
+{
+    const char * szName;
+    WCHAR szValue[64];                          // Zero-terminated UTF-16 value
+    const char * szExpected;                    // Expected UTF-8 content of the cell
+};
+
+//-----------------------------------------------------------------------------
+// Local variables
+
+static const CSV_TEST_CELL TestCells[] =
+{
+    {"empty",               {0},                                            ""},
+    {"plain",               {'a', 'b', 'c', 0},                             "abc"},
+    {"quotes",              {'s', 'a', 'y', ' ', '"', 'h', 'i', '"', 0},    "say \"\"hi\"\""},
+    {"only quote",          {'"', 0},                                       "\"\""},
+    {"comma and eol",       {'a', ',', '\r', '\n', 'b', 0},                 "a,\r\nb"},
+    {"two-byte",            {0x00E9, 't', 0x00E9, 0},                       "\xC3\xA9t\xC3\xA9"},
+    {"three-byte",          {0x20AC, '"', 0},                               "\xE2\x82\xAC\"\""},
+    {"surrogate pair",      {'x', 0xD83D, 0xDE00, 'y', 0},                  "x\xF0\x9F\x98\x80y"},
+    {"high surrogate",      {0xD83D, 'a', 0},                               "\xEF\xBF\xBD" "a"},
+    {"low surrogate",       {'a', 0xDE00, 0},                               "a\xEF\xBF\xBD"},
+    {"trailing high",       {'a', 'b', 0xD800, 0},                          "ab\xEF\xBF\xBD"},
+    {"reversed pair",       {0xDC00, 0xD800, 0},                            "\xEF\xBF\xBD\xEF\xBF\xBD"},
+    {"long ascii run",      {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f',
+                             '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f',
+                             '0', '1', '2', '3', '4', '5', '6', '7', '"', '9', 0x0416, 'b', 0},
+                             "0123456789abcdef0123456789abcdef01234567\"\"9\xD0\x96" "b"},
+};
+
+static DWORD dwFailures = 0;
+
+//-----------------------------------------------------------------------------
+// Synthetic string pool and table, like in bench_render
+
+struct TTestStringPool : public TMsiStringPool
+{
+    TTestStringPool()
+    {
+        MSI_STRING_ENTRY Entry = {0, 0, 0, 0};
+
+        // String ID 0 is the null string
+        m_Strings.push_back(Entry);
+        m_Text.push_back(0);
+    }
+
+    DWORD AddString(LPCWSTR szValue)
+    {
+        MSI_STRING_ENTRY Entry;
+        size_t ccValue = std::char_traits<WCHAR>::length(szValue);
+
+        Entry.Offset = (DWORD)(m_Text.size());
+        Entry.Length = (DWORD)(ccValue);
+        Entry.CsvLength = (DWORD)(MsiCsvCellLength(szValue, ccValue));
+        Entry.Refs = 1;
+        m_Text.insert(m_Text.end(), szValue, szValue + ccValue);
+        m_Strings.push_back(Entry);
+        return (DWORD)(m_Strings.size() - 1);
+    }
+};
+
+struct TTestTableData : public TMsiTableData
+{
+    void AddColumn(MSI_CELL_TYPE CellType, DWORD dwWidth)
+    {
+        MSI_COLUMN_LAYOUT Column = {CellType, dwWidth, false};
+
+        m_Layout.push_back(Column);
+    }
+
+    // A string column with all test cells and two integer columns
+    void Generate(TTestStringPool & StringPool, DWORD dwRows)
+    {
+        std::vector<DWORD> Strings;
+
+        AddColumn(MsiCellString, MSI_STRING_REF_LONG);
+        AddColumn(MsiCellInteger, 2);
+        AddColumn(MsiCellInteger, 4);
+        m_dwRows = dwRows;
+        m_Cells.resize(m_Layout.size() * dwRows);
+
+        for(size_t i = 0; i < _countof(TestCells); i++)
+            Strings.push_back(StringPool.AddString(TestCells[i].szValue));
+
+        for(DWORD dwRow = 0; dwRow < dwRows; dwRow++)
+        {
+            m_Cells[0 * dwRows + dwRow] = (dwRow % 7) ? Strings[dwRow % Strings.size()] : 0;
+            m_Cells[1 * dwRows + dwRow] = (dwRow % 5) ? dwRow % 0x8000 : MSI_NULL_INTEGER;
+            m_Cells[2 * dwRows + dwRow] = (dwRow & 1) ? (DWORD)(-(int)(dwRow)) : dwRow * 1000;
+        }
+    }
+};
+
+//-----------------------------------------------------------------------------
+// Local functions
+
+static void Check(bool bCondition, const char * szWhat, const char * szDetail)
+{
+    if(!bCondition)
+    {
+        printf("  FAILED: %s (%s)\n", szWhat, szDetail);
+        dwFailures++;
+    }
+}
+
+static void TestCellEncoding()
+{
+    BYTE Buffer[0x100];
+
+    printf("Cell encoding\n");
+    for(size_t i = 0; i < _countof(TestCells); i++)
+    {
+        const CSV_TEST_CELL & TestCell = TestCells[i];
+        size_t ccValue = std::char_traits<WCHAR>::length(TestCell.szValue);
+        size_t cbExpected = strlen(TestCell.szExpected);
+        size_t cbWritten;
+
+        Check(MsiCsvCellLength(TestCell.szValue, ccValue) == cbExpected, "MsiCsvCellLength", TestCell.szName);
+        cbWritten = MsiCsvCellEncode(Buffer, sizeof(Buffer), TestCell.szValue, ccValue);
+        Check(cbWritten == cbExpected && !memcmp(Buffer, TestCell.szExpected, cbExpected), "MsiCsvCellEncode", TestCell.szName);
+    }
+}
+
+// A character that does not fit is not written at all
+static void TestShortBuffer()
+{
+    static const WCHAR szValue[] = {'a', 'b', 0xD83D, 0xDE00, 'c', 0};
+    BYTE Buffer[8];
+
+    printf("Short buffer\n");
+    memset(Buffer, 0xCC, sizeof(Buffer));
+    Check(MsiCsvCellEncode(Buffer, 5, szValue, 5) == 2, "MsiCsvCellEncode", "4-byte character at the end");
+    Check(Buffer[2] == 0xCC, "MsiCsvCellEncode", "nothing written after the end");
+    Check(MsiCsvCellEncode(Buffer, 6, szValue, 5) == 6, "MsiCsvCellEncode", "exact fit");
+    Check(MsiCsvCellEncode(Buffer, 1, szValue, 5) == 1, "MsiCsvCellEncode", "ASCII run cut");
+}
+
+// The rows rendered by the pool must be the same like the rows rendered
+// serially, and the first rows must be what a CSV reader expects
+static void TestRenderPool()
+{
+    TTestStringPool StringPool;
+    TTestTableData TableData;
+    std::vector<BYTE> Serial;
+    std::string strFirstRows;
+    ULONGLONG cbSerial;
+
+    printf("Render pool\n");
+    TableData.Generate(StringPool, TEST_ROW_COUNT);
+    cbSerial = MsiCsvRowsLength(TableData, StringPool, 0, TableData.RowCount());
+    Serial.resize((size_t)(cbSerial));
+    Check(MsiCsvRenderRows(&Serial[0], TableData, StringPool, 0, TableData.RowCount()) == &Serial[0] + Serial.size(), "MsiCsvRenderRows", "rendered length");
+    Check(MsiCsvRowLength(TableData, StringPool, 0) + MsiCsvRowLength(TableData, StringPool, 1) == MsiCsvRowsLength(TableData, StringPool, 0, 2), "MsiCsvRowLength", "two rows");
+
+    strFirstRows.assign(Serial.begin(), Serial.begin() + MsiCsvRowsLength(TableData, StringPool, 0, 4));
+    Check(strFirstRows == "\"\",\"(null)\",\"0\"\r\n"
+                          "\"abc\",\"1\",\"-1\"\r\n"
+                          "\"say \"\"hi\"\"\",\"2\",\"2000\"\r\n"
+                          "\"\"\"\",\"3\",\"-3\"\r\n", "MsiCsvRenderRows", "first rows");
+
+    for(DWORD dwWorkers = 1; dwWorkers <= 8; dwWorkers *= 2)
+    {
+        MSI_CSV_JOB Jobs[2] = {{&TableData, 0, TableData.RowCount(), NULL, 0, 0}, {&TableData, 123, 5000, NULL, 0, 0}};
+        std::vector<BYTE> Output[2];
+        TCsvRenderPool Pool;
+        char szDetail[32];
+
+        snprintf(szDetail, _countof(szDetail), "%u workers", dwWorkers);
+        Pool.Open(dwWorkers);
+        Check(Pool.Measure(Jobs, _countof(Jobs), StringPool) == ERROR_SUCCESS, "Measure", szDetail);
+        Check(Jobs[0].cbLength == cbSerial, "Measure", szDetail);
+        Check(Jobs[1].cbLength == MsiCsvRowsLength(TableData, StringPool, 123, 5000), "Measure of a part", szDetail);
+
+        for(size_t i = 0; i < _countof(Jobs); i++)
+        {
+            Output[i].resize((size_t)(Jobs[i].cbLength));
+            Jobs[i].pbBuffer = &Output[i][0];
+            Jobs[i].cbBuffer = Output[i].size();
+        }
+        Check(Pool.Render(Jobs, _countof(Jobs), StringPool) == ERROR_SUCCESS, "Render", szDetail);
+        Check(Output[0] == Serial, "Render", szDetail);
+        Check(!memcmp(&Output[1][0], &Serial[(size_t)(MsiCsvRowsLength(TableData, StringPool, 0, 123))], Output[1].size()), "Render of a part", szDetail);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Main
+
+int main(int argc, char * argv[])
+{
+    TestCellEncoding();
+    TestShortBuffer();
+    TestRenderPool();
+
+    printf("test_csv: %s\n", (dwFailures == 0) ? "OK" : "FAILED");
+    return (dwFailures == 0) ? 0 : 1;
+}
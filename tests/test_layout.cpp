@@ -0,0 +1,217 @@
+/*****************************************************************************/
+/* test_layout.cpp                        Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Paths of the installed layout, with directories listed in any order       */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 16.10.26  1.00  Lad  Created                                              */
+/*****************************************************************************/
+
+#include "../wcx_msi.h"
+#include <algorithm>
+
+//-----------------------------------------------------------------------------
+// Local defines
+
+struct LAYOUT_TEST_DIR
+{
+    const char * szDirectory;
+    const char * szParent;                              // NULL = no parent
+    const char * szDefaultDir;
+};
+
+struct LAYOUT_TEST_FILE
+{
+    const char * szComponent;
+    const char * szDirectory;                           // Directory of the component
+    const char * szFileName;
+    DWORD FileSize;
+    const char * szExpectedPath;
+};
+
+//-----------------------------------------------------------------------------
+// Local variables
+
+// Children are listed before their parents
+static const LAYOUT_TEST_DIR TestDirs[] =
+{
+    {"SubDir",             "INSTALLDIR",  "SUBDIR~1|Sub Dir"},
+    {"SameDir",            "SubDir",      "."},
+    {"INSTALLDIR",         "VendorDir",   "APP|Application:SRC"},
+    {"VendorDir",          "TARGETDIR",   "Vendor"},
+    {"FontsFolder",        "TARGETDIR",   "FONTS"},
+    {"FontsSubDir",        "FontsFolder", "Extra"},
+    {"TARGETDIR",          NULL,          "SourceDir"},
+    {"LoopA",              "LoopB",       "A"},
+    {"LoopB",              "LoopA",       "B"},
+};
+
+static const LAYOUT_TEST_FILE TestFiles[] =
+{
+    {"C_Sub",     "SubDir",      "README~1.TXT|readme.txt", 10,                "Vendor\\Application\\Sub Dir\\readme.txt"},
+    {"C_Same",    "SameDir",     "a.dll",                   MSI_NULL_INTEGER,  "Vendor\\Application\\Sub Dir\\a.dll"},
+    {"C_App",     "INSTALLDIR",  "app.exe",                 100,               "Vendor\\Application\\app.exe"},
+    {"C_Fonts",   "FontsSubDir", "f.ttf",                   1,                 "FontsFolder\\Extra\\f.ttf"},
+    {"C_Root",    "TARGETDIR",   "root.ini",                2,                 "root.ini"},
+    {"C_Missing", "NoSuchDir",   "orphan.txt",              3,                 "orphan.txt"},
+};
+
+static DWORD dwFailures = 0;
+
+//-----------------------------------------------------------------------------
+// Synthetic string pool and tables, like in bench_render
+
+struct TTestStringPool : public TMsiStringPool
+{
+    TTestStringPool()
+    {
+        MSI_STRING_ENTRY Entry = {0, 0, 0, 0};
+
+        // String ID 0 is the null string
+        m_Strings.push_back(Entry);
+        m_Text.push_back(0);
+    }
+
+    DWORD AddString(const char * szValue)
+    {
+        MSI_STRING_ENTRY Entry;
+        CFB_NAME strValue;
+
+        if(szValue == NULL)
+            return 0;
+
+        // Reuse the existing strings, like the string pool of an MSI file does
+        strValue.assign(szValue, szValue + strlen(szValue));
+        for(DWORD i = 1; i < m_Strings.size(); i++)
+        {
+            if(m_Strings[i].Length == strValue.size() && !memcmp(&m_Text[m_Strings[i].Offset], strValue.c_str(), strValue.size() * sizeof(WCHAR)))
+                return i;
+        }
+
+        Entry.Offset = (DWORD)(m_Text.size());
+        Entry.Length = (DWORD)(strValue.size());
+        Entry.CsvLength = (DWORD)(MsiCsvCellLength(strValue.c_str(), strValue.size()));
+        Entry.Refs = 1;
+        m_Text.insert(m_Text.end(), strValue.begin(), strValue.end());
+        m_Strings.push_back(Entry);
+        return (DWORD)(m_Strings.size() - 1);
+    }
+};
+
+struct TTestTableData : public TMsiTableData
+{
+    void AddColumn(MSI_CELL_TYPE CellType, DWORD dwWidth)
+    {
+        MSI_COLUMN_LAYOUT Column = {CellType, dwWidth, false};
+
+        m_Layout.push_back(Column);
+    }
+
+    void SetRows(DWORD dwRows)
+    {
+        m_dwRows = dwRows;
+        m_Cells.resize(m_Layout.size() * dwRows);
+    }
+
+    void SetCell(size_t nColumn, DWORD dwRow, DWORD dwValue)
+    {
+        m_Cells[nColumn * m_dwRows + dwRow] = dwValue;
+    }
+};
+
+//-----------------------------------------------------------------------------
+// Local functions
+
+static void Check(bool bCondition, const char * szWhat, const char * szDetail)
+{
+    if(!bCondition)
+    {
+        printf("  FAILED: %s (%s)\n", szWhat, szDetail);
+        dwFailures++;
+    }
+}
+
+static std::string PathToString(const CFB_NAME & strPath)
+{
+    return std::string(strPath.begin(), strPath.end());
+}
+
+// Builds the tables with the directories in the given order and checks the paths
+static void TestLayout(const std::vector<size_t> & DirOrder, const char * szOrderName)
+{
+    MSI_LAYOUT_COLUMNS Columns = {0, 1, 2, 0, 1, 0, 1, 2, 3};
+    TTestStringPool StringPool;
+    TTestTableData Directory;
+    TTestTableData Component;
+    TTestTableData File;
+    TMsiLayout Layout;
+
+    Directory.AddColumn(MsiCellString, MSI_STRING_REF_LONG);    // Directory
+    Directory.AddColumn(MsiCellString, MSI_STRING_REF_LONG);    // Directory_Parent
+    Directory.AddColumn(MsiCellString, MSI_STRING_REF_LONG);    // DefaultDir
+    Directory.SetRows((DWORD)(DirOrder.size()));
+    for(DWORD dwRow = 0; dwRow < DirOrder.size(); dwRow++)
+    {
+        const LAYOUT_TEST_DIR & TestDir = TestDirs[DirOrder[dwRow]];
+
+        Directory.SetCell(0, dwRow, StringPool.AddString(TestDir.szDirectory));
+        Directory.SetCell(1, dwRow, StringPool.AddString(TestDir.szParent));
+        Directory.SetCell(2, dwRow, StringPool.AddString(TestDir.szDefaultDir));
+    }
+
+    Component.AddColumn(MsiCellString, MSI_STRING_REF_LONG);    // Component
+    Component.AddColumn(MsiCellString, MSI_STRING_REF_LONG);    // Directory_
+    Component.SetRows(_countof(TestFiles));
+    File.AddColumn(MsiCellString, MSI_STRING_REF_LONG);         // File
+    File.AddColumn(MsiCellString, MSI_STRING_REF_LONG);         // Component_
+    File.AddColumn(MsiCellString, MSI_STRING_REF_LONG);         // FileName
+    File.AddColumn(MsiCellInteger, 4);                          // FileSize
+    File.SetRows(_countof(TestFiles));
+    for(DWORD dwRow = 0; dwRow < _countof(TestFiles); dwRow++)
+    {
+        const LAYOUT_TEST_FILE & TestFile = TestFiles[dwRow];
+
+        Component.SetCell(0, dwRow, StringPool.AddString(TestFile.szComponent));
+        Component.SetCell(1, dwRow, StringPool.AddString(TestFile.szDirectory));
+        File.SetCell(0, dwRow, StringPool.AddString(TestFile.szFileName));
+        File.SetCell(1, dwRow, StringPool.AddString(TestFile.szComponent));
+        File.SetCell(2, dwRow, StringPool.AddString(TestFile.szFileName));
+        File.SetCell(3, dwRow, TestFile.FileSize);
+    }
+
+    printf("Directories %s\n", szOrderName);
+    Check(Layout.Build(StringPool, Directory, Component, File, Columns) == ERROR_SUCCESS, "Build", szOrderName);
+    Check(Layout.FileCount() == _countof(TestFiles), "FileCount", szOrderName);
+    for(DWORD i = 0; i < Layout.FileCount() && i < _countof(TestFiles); i++)
+    {
+        std::string strPath = PathToString(Layout.File(i).Path);
+
+        Check(strPath == TestFiles[i].szExpectedPath, TestFiles[i].szExpectedPath, strPath.c_str());
+        Check(Layout.File(i).FileSize == ((TestFiles[i].FileSize != MSI_NULL_INTEGER) ? TestFiles[i].FileSize : 0), "FileSize", TestFiles[i].szFileName);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Main
+
+int main(int argc, char * argv[])
+{
+    std::vector<size_t> DirOrder;
+
+    // Children before parents, as listed
+    for(size_t i = 0; i < _countof(TestDirs); i++)
+        DirOrder.push_back(i);
+    TestLayout(DirOrder, "children first");
+
+    // Parents before children
+    std::reverse(DirOrder.begin(), DirOrder.end());
+    TestLayout(DirOrder, "parents first");
+
+    // Parent in the middle of the chain
+    std::rotate(DirOrder.begin(), DirOrder.begin() + 4, DirOrder.end());
+    TestLayout(DirOrder, "rotated");
+
+    printf("test_layout: %s\n", (dwFailures == 0) ? "OK" : "FAILED");
+    return (dwFailures == 0) ? 0 : 1;
+}
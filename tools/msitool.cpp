@@ -0,0 +1,469 @@
+/*****************************************************************************/
+/* msitool.cpp                            Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Command line lister and extractor of MSI files. The files are named       */
+/* the same way like in the plugin                                           */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 16.10.26  1.00  Lad  Created                                              */
+/*****************************************************************************/
+
+#include "../wcx_msi.h"
+#include <atomic>
+#include <errno.h>
+#include <sys/stat.h>
+
+//-----------------------------------------------------------------------------
+// Local structures
+
+struct TExtractJob
+{
+    TMsiArchive * pArchive;                             // The open archive
+    const std::vector<std::vector<DWORD> > * pUnits;    // Items to extract, grouped by TMsiArchive::GroupItems
+    std::string strTargetDir;                           // Where to extract them
+    std::atomic<size_t> nNextUnit;                      // The next unit to be taken by a worker
+    std::atomic<DWORD> dwFailed;                        // Number of items that failed
+};
+
+//-----------------------------------------------------------------------------
+// Local functions
+
+static void PrintUsage()
+{
+    fprintf(stderr, "Usage: msitool [-j threads] <command> <file.msi> [arguments]\n\n");
+    fprintf(stderr, "  list    <file.msi>                      List all files with their sizes\n");
+    fprintf(stderr, "  extract <file.msi> <dir> [pattern ...]  Extract all files or the files matching the patterns\n");
+    fprintf(stderr, "  cat     <file.msi> <name>               Write one file to the standard output\n");
+    fprintf(stderr, "  find    <file.msi> <text> [-i]          Find the table rows that contain the text\n\n");
+    fprintf(stderr, "Names use '/' as separator. Patterns may contain '*' and '?'\n");
+    fprintf(stderr, "and they are compared case-insensitively.\n");
+}
+
+static void Utf8ToName(const char * szString, CFB_NAME & strName)
+{
+    std::vector<WCHAR> Buffer(strlen(szString) + 1);
+    size_t ccName;
+
+    ccName = MsiCodePageToUtf16(CP_UTF8, (const BYTE *)(szString), strlen(szString), &Buffer[0]);
+    strName.assign(&Buffer[0], ccName);
+}
+
+// Converts the name from the command line to the name of an item, with backslashes
+static void ArgumentToName(const char * szArgument, CFB_NAME & strName)
+{
+    Utf8ToName(szArgument, strName);
+    for(size_t i = 0; i < strName.size(); i++)
+    {
+        if(strName[i] == '/')
+            strName[i] = '\\';
+    }
+}
+
+// Converts the name of the item to UTF-8 path with slashes
+static void NameToPath(const CFB_NAME & strName, std::string & strPath)
+{
+    MsiUtf16ToUtf8(strName.c_str(), strName.size(), strPath);
+    for(size_t i = 0; i < strPath.size(); i++)
+    {
+        if(strPath[i] == '\\')
+            strPath[i] = '/';
+    }
+}
+
+// Wildcard match. The '*' matches any number of characters, including backslashes.
+// The case is ignored the same way as in the names of the items
+static bool MatchPattern(LPCWSTR szString, LPCWSTR szPattern)
+{
+    LPCWSTR szStarPattern = NULL;
+    LPCWSTR szStarString = NULL;
+
+    while(szString[0] != 0)
+    {
+        if(szPattern[0] == '*')
+        {
+            szStarPattern = ++szPattern;
+            szStarString = szString;
+        }
+        else if(szPattern[0] == '?' || (szPattern[0] != 0 && MsiLowerChar(szPattern[0]) == MsiLowerChar(szString[0])))
+        {
+            szPattern++;
+            szString++;
+        }
+        else if(szStarPattern != NULL)
+        {
+            szPattern = szStarPattern;
+            szString = ++szStarString;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    // Only asterisks may remain in the pattern
+    while(szPattern[0] == '*')
+        szPattern++;
+    return (szPattern[0] == 0);
+}
+
+// Names come from the MSI, so they must not escape the target directory
+static bool IsSafePath(const std::string & strPath)
+{
+    size_t nStart = 0;
+
+    while(nStart <= strPath.size())
+    {
+        size_t nEnd = strPath.find('/', nStart);
+        std::string strPart;
+
+        if(nEnd == std::string::npos)
+            nEnd = strPath.size();
+        strPart.assign(strPath, nStart, nEnd - nStart);
+        if(strPart.size() == 0 || strPart == "." || strPart == "..")
+            return false;
+        nStart = nEnd + 1;
+    }
+    return true;
+}
+
+static DWORD CreateParentDirs(const std::string & strFileName)
+{
+    for(size_t i = 1; i < strFileName.size(); i++)
+    {
+        if(strFileName[i] == '/')
+        {
+            std::string strDirectory(strFileName, 0, i);
+
+            if(mkdir(strDirectory.c_str(), 0755) != 0 && errno != EEXIST)
+                return (DWORD)(errno);
+        }
+    }
+    return ERROR_SUCCESS;
+}
+
+// Reads the whole item and gives it to the files. Cabinet files are read
+// with the caller's folder reader, if there is one
+// Streams are written directly from the compound file, without reading them to the chunk
+static DWORD WriteStreamItem(TMsiArchive & Archive, DWORD dwItem, FILE ** pFiles, size_t nFiles)
+{
+    ULONGLONG BytesWritten = 0;
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    for(size_t i = 0; i < nFiles && dwErrCode == ERROR_SUCCESS; i++)
+    {
+        if(fflush(pFiles[i]) != 0)
+            return ERROR_WRITE_FAULT;
+        if((dwErrCode = Archive.WriteItem(dwItem, fileno(pFiles[i]), &BytesWritten)) == ERROR_SUCCESS)
+        {
+            if(BytesWritten != Archive.ItemSize(dwItem))
+                dwErrCode = ERROR_FILE_CORRUPT;
+        }
+    }
+    return dwErrCode;
+}
+
+static DWORD CopyItem(TMsiArchive & Archive, DWORD dwItem, FILE ** pFiles, size_t nFiles, TCabFolderReader * pCabReader, std::vector<BYTE> & Chunk)
+{
+    MSI_ITEM_CURSOR Cursor;
+    DWORD dwBytesRead = 0;
+    DWORD dwErrCode;
+
+    // Streams don't need the chunk
+    if((dwErrCode = WriteStreamItem(Archive, dwItem, pFiles, nFiles)) != ERROR_NOT_SUPPORTED)
+        return dwErrCode;
+
+    Cursor.pCabReader = pCabReader;
+    while((dwErrCode = Archive.ReadChunk(dwItem, Cursor, Chunk, &dwBytesRead)) == ERROR_SUCCESS && dwBytesRead != 0)
+    {
+        for(size_t i = 0; i < nFiles; i++)
+        {
+            if(fwrite(&Chunk[0], 1, dwBytesRead, pFiles[i]) != dwBytesRead)
+                return ERROR_WRITE_FAULT;
+        }
+    }
+
+    // The item must have exactly the listed size
+    if(dwErrCode == ERROR_SUCCESS && Cursor.ByteOffset != Archive.ItemSize(dwItem))
+        dwErrCode = ERROR_FILE_CORRUPT;
+    return dwErrCode;
+}
+
+static DWORD CreateTargetFile(TMsiArchive & Archive, DWORD dwItem, const std::string & strTargetDir, FILE ** PtrFile)
+{
+    std::string strFileName;
+    std::string strPath;
+    DWORD dwErrCode;
+
+    // Construct the name of the target file
+    NameToPath(Archive.Item(dwItem).Name, strPath);
+    if(!IsSafePath(strPath))
+        return ERROR_INVALID_PARAMETER;
+    strFileName = strTargetDir + "/" + strPath;
+
+    // Create the file
+    if((dwErrCode = CreateParentDirs(strFileName)) != ERROR_SUCCESS)
+        return dwErrCode;
+    if((PtrFile[0] = fopen(strFileName.c_str(), "wb")) == NULL)
+        return (DWORD)(errno);
+    return ERROR_SUCCESS;
+}
+
+static void ReportFailure(TExtractJob * pJob, DWORD dwItem, DWORD dwErrCode)
+{
+    std::string strPath;
+
+    NameToPath(pJob->pArchive->Item(dwItem).Name, strPath);
+    fprintf(stderr, "Failed to extract %s (error %u)\n", strPath.c_str(), dwErrCode);
+    pJob->dwFailed++;
+}
+
+// Workers take whole units. The files of one cabinet folder are read in the order
+// of their data with the reader of the worker, so each folder is decompressed once.
+// Items with the same data (like "_Installed" and "_Cabinets") are read only once.
+static void ExtractWorker(TExtractJob * pJob)
+{
+    TMsiArchive & Archive = *pJob->pArchive;
+    TCabFolderReader CabReader;
+    std::vector<BYTE> Chunk(MSI_ITEM_CHUNK_SIZE);
+    std::vector<DWORD> FileItems;
+    std::vector<FILE *> Files;
+    size_t nIndex;
+
+    while((nIndex = pJob->nNextUnit++) < pJob->pUnits->size())
+    {
+        const std::vector<DWORD> & Unit = pJob->pUnits->at(nIndex);
+        size_t nNext;
+
+        for(size_t i = 0; i < Unit.size(); i = nNext)
+        {
+            const MSI_LISTING_ITEM & DataItem = Archive.DataItem(Unit[i]);
+            DWORD dwErrCode = ERROR_SUCCESS;
+
+            // Create the files of all items with the same data
+            FileItems.clear();
+            Files.clear();
+            for(nNext = i; nNext < Unit.size() && &Archive.DataItem(Unit[nNext]) == &DataItem; nNext++)
+            {
+                FILE * fp = NULL;
+
+                if((dwErrCode = CreateTargetFile(Archive, Unit[nNext], pJob->strTargetDir, &fp)) == ERROR_SUCCESS)
+                {
+                    FileItems.push_back(Unit[nNext]);
+                    Files.push_back(fp);
+                }
+                else
+                {
+                    ReportFailure(pJob, Unit[nNext], dwErrCode);
+                }
+            }
+
+            // Copy the data to all of them
+            if(Files.size() != 0)
+            {
+                dwErrCode = CopyItem(Archive, FileItems[0], &Files[0], Files.size(), &CabReader, Chunk);
+                for(size_t j = 0; j < Files.size(); j++)
+                {
+                    DWORD dwFileError = dwErrCode;
+
+                    if(fclose(Files[j]) != 0 && dwFileError == ERROR_SUCCESS)
+                        dwFileError = ERROR_WRITE_FAULT;
+                    if(dwFileError != ERROR_SUCCESS)
+                        ReportFailure(pJob, FileItems[j], dwFileError);
+                }
+            }
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Commands
+
+static int ListItems(TMsiArchive & Archive)
+{
+    std::string strPath;
+
+    for(size_t i = 0; i < Archive.ItemCount(); i++)
+    {
+        NameToPath(Archive.Item(i).Name, strPath);
+        printf("%12llu  %s\n", (unsigned long long)(Archive.ItemSize(i)), strPath.c_str());
+    }
+    return 0;
+}
+
+static int ExtractItems(TMsiArchive & Archive, DWORD dwThreads, int argc, char * argv[])
+{
+    std::vector<std::thread> Threads;
+    std::vector<std::vector<DWORD> > Units;
+    std::vector<CFB_NAME> Patterns;
+    std::vector<DWORD> Items;
+    TExtractJob Job;
+
+    // The first argument is the target directory, the rest are patterns
+    if(argc < 1)
+    {
+        PrintUsage();
+        return 2;
+    }
+
+    // Names in the archive have backslashes
+    Patterns.resize(argc - 1);
+    for(int i = 1; i < argc; i++)
+        ArgumentToName(argv[i], Patterns[i - 1]);
+
+    // Select the items to extract
+    for(DWORD dwItem = 0; dwItem < Archive.ItemCount(); dwItem++)
+    {
+        bool bSelected = (Patterns.size() == 0);
+
+        for(size_t i = 0; i < Patterns.size() && bSelected == false; i++)
+            bSelected = MatchPattern(Archive.Item(dwItem).Name.c_str(), Patterns[i].c_str());
+        if(bSelected)
+            Items.push_back(dwItem);
+    }
+
+    // Create the target directory
+    if(mkdir(argv[0], 0755) != 0 && errno != EEXIST)
+    {
+        fprintf(stderr, "Failed to create %s (error %u)\n", argv[0], (DWORD)(errno));
+        return 1;
+    }
+
+    // Extract the items on multiple threads
+    Archive.GroupItems(Items, Units);
+    Job.pArchive = &Archive;
+    Job.pUnits = &Units;
+    Job.strTargetDir = argv[0];
+    Job.nNextUnit = 0;
+    Job.dwFailed = 0;
+    for(DWORD i = 0; i < dwThreads; i++)
+        Threads.push_back(std::thread(ExtractWorker, &Job));
+    for(size_t i = 0; i < Threads.size(); i++)
+        Threads[i].join();
+
+    fprintf(stderr, "Extracted %u of %u files\n", (DWORD)(Items.size()) - Job.dwFailed, (DWORD)(Items.size()));
+    return (Job.dwFailed != 0) ? 1 : 0;
+}
+
+static int CatItem(TMsiArchive & Archive, const char * szItemName)
+{
+    std::vector<BYTE> Chunk(MSI_ITEM_CHUNK_SIZE);
+    CFB_NAME strName;
+    FILE * fp = stdout;
+    DWORD dwErrCode;
+    DWORD dwItem;
+
+    ArgumentToName(szItemName, strName);
+    if((dwItem = Archive.FindItem(strName)) == MSI_NO_ITEM)
+    {
+        fprintf(stderr, "File not found: %s\n", szItemName);
+        return 1;
+    }
+
+    if((dwErrCode = CopyItem(Archive, dwItem, &fp, 1, NULL, Chunk)) != ERROR_SUCCESS)
+    {
+        fprintf(stderr, "Failed to read %s (error %u)\n", szItemName, dwErrCode);
+        return 1;
+    }
+    return 0;
+}
+
+static int FindText(TMsiArchive & Archive, const char * szText, DWORD dwFlags)
+{
+    const TMsiStringPool & StringPool = Archive.StringPool();
+    std::vector<const TMsiTableData *> Tables;
+    std::vector<MSI_STRING_REF> Hits;
+    TMsiStringRefs StringRefs;
+    std::string strTableName;
+    std::string strColumnName;
+    std::string strValue;
+    CFB_NAME strText;
+    DWORD dwErrCode;
+
+    // Index the string cells of all tables
+    for(size_t i = 0; i < Archive.TableCount(); i++)
+        Tables.push_back(&Archive.Table(i).Data);
+    if(Tables.size() != 0)
+        StringRefs.Build(StringPool, &Tables[0], Tables.size());
+
+    // Search the string pool and map the strings to the cells
+    Utf8ToName(szText, strText);
+    if((dwErrCode = StringRefs.Search(StringPool, strText.c_str(), strText.size(), dwFlags, Hits)) != ERROR_SUCCESS)
+    {
+        fprintf(stderr, "Failed to search for %s (error %u)\n", szText, dwErrCode);
+        return 1;
+    }
+
+    // Rows are numbered from 1, like the lines of the CSV files without the header
+    for(size_t i = 0; i < Hits.size(); i++)
+    {
+        const MSI_ARCHIVE_TABLE & Table = Archive.Table(Hits[i].nTable);
+        const MSI_CATALOG_COLUMN & Column = Table.pCatalogTable->Columns[Hits[i].nColumn];
+        LPCWSTR szValue;
+        size_t ccValue = 0;
+
+        szValue = StringPool.String(Table.Data.Cell(Hits[i].nColumn, Hits[i].dwRow), ccValue);
+        MsiUtf16ToUtf8(Table.pCatalogTable->Name.c_str(), Table.pCatalogTable->Name.size(), strTableName);
+        MsiUtf16ToUtf8(Column.Name.c_str(), Column.Name.size(), strColumnName);
+        MsiUtf16ToUtf8(szValue, ccValue, strValue);
+        printf("%s\t%u\t%s\t%s\n", strTableName.c_str(), Hits[i].dwRow + 1, strColumnName.c_str(), strValue.c_str());
+    }
+    return (Hits.size() != 0) ? 0 : 1;
+}
+
+//-----------------------------------------------------------------------------
+// Main
+
+int main(int argc, char * argv[])
+{
+    TMsiArchive Archive;
+    const char * szCommand;
+    DWORD dwThreads = std::thread::hardware_concurrency();
+    DWORD dwErrCode;
+    int nArg = 1;
+
+    // Parse the options
+    if(nArg + 1 < argc && strcmp(argv[nArg], "-j") == 0)
+    {
+        dwThreads = (DWORD)(strtoul(argv[nArg + 1], NULL, 10));
+        nArg += 2;
+    }
+    if(dwThreads == 0)
+        dwThreads = 1;
+
+    // We need the command and the MSI file
+    if((argc - nArg) < 2)
+    {
+        PrintUsage();
+        return 2;
+    }
+    szCommand = argv[nArg];
+
+    // Check the command before the file is loaded
+    if(strcmp(szCommand, "list") && strcmp(szCommand, "extract") && strcmp(szCommand, "cat") && strcmp(szCommand, "find"))
+    {
+        PrintUsage();
+        return 2;
+    }
+    if((!strcmp(szCommand, "cat") || !strcmp(szCommand, "find")) && (argc - nArg) < 3)
+    {
+        PrintUsage();
+        return 2;
+    }
+
+    // Open the MSI file
+    if((dwErrCode = Archive.Open(argv[nArg + 1], dwThreads)) != ERROR_SUCCESS)
+    {
+        fprintf(stderr, "Failed to open %s (error %u)\n", argv[nArg + 1], dwErrCode);
+        return 1;
+    }
+
+    // Perform the command
+    if(!strcmp(szCommand, "list"))
+        return ListItems(Archive);
+    if(!strcmp(szCommand, "extract"))
+        return ExtractItems(Archive, dwThreads, argc - nArg - 2, argv + nArg + 2);
+    if(!strcmp(szCommand, "cat"))
+        return CatItem(Archive, argv[nArg + 2]);
+    return FindText(Archive, argv[nArg + 2], (argc - nArg > 3 && !strcmp(argv[nArg + 3], "-i")) ? MSI_SEARCH_IGNORE_CASE : 0);
+}
@@ -13,6 +13,11 @@
 
 #pragma comment(lib, "Msi.lib")
 
+//-----------------------------------------------------------------------------
+// Local defines
+
+#define PROGRESS_INTERVAL   100         // Min. interval between two calls of the progress callback (ms)
+
 //-----------------------------------------------------------------------------
 // Local variables
 
@@ -21,6 +26,11 @@ PFN_PROCESS_DATAW PfnProcessDataW;      // Process data procedure (UNICODE)
 PFN_CHANGE_VOLUMEA PfnChangeVolA;       // Change volume procedure (ANSI)
 PFN_CHANGE_VOLUMEW PfnChangeVolW;       // Change volume procedure (UNICODE)
 TCHAR g_szIniFile[MAX_PATH];
+TCHAR g_szCacheDir[MAX_PATH];           // Directory of the listing cache
+DWORD g_bListingCache;                  // TRUE if the listing cache is enabled
+size_t g_cbSharedCache;                 // Memory budget of the shared data of the opened archives
+DWORD g_dwPrefetchFiles;                // Number of files whose streams are loaded ahead during extraction
+size_t g_cbPrefetchMemory;              // Memory budget of the streams loaded ahead
 
 //-----------------------------------------------------------------------------
 // CanYouHandleThisFile(W) allows the plugin to handle files with different
@@ -31,6 +41,20 @@ BOOL WINAPI CanYouHandleThisFileW(LPCWSTR szFileName)
 {
     MSIHANDLE hMsiDb = NULL;
 
+    // Total Commander calls this for any file, so first have a look
+    // at the header. Only if it is not conclusive, ask msi.dll
+    switch(MsiSniffStorage(szFileName))
+    {
+        case MsiStorageDatabase:
+            return TRUE;
+
+        case MsiStorageUnknown:
+            break;
+
+        default:
+            return FALSE;
+    }
+
     // Just try to open the database. If it succeeds,
     // then we can handle this file
     if(MsiOpenDatabase(szFileName, MSIDBOPEN_READONLY, &hMsiDb) == ERROR_SUCCESS)
@@ -73,6 +97,7 @@ static void FileTimeToDosFTime(DOS_FTIME & DosTime, const FILETIME & ft)
 static HANDLE OpenArchiveAW(TOpenArchiveData * pArchiveData, LPCWSTR szArchiveName)
 {
     WIN32_FIND_DATA wf;
+    TCompoundFile * pCompFile;
     TMsiDatabase * pMsiDB = NULL;
     MSIHANDLE hMsiDb = NULL;
     HANDLE hFind;
@@ -95,9 +120,35 @@ static HANDLE OpenArchiveAW(TOpenArchiveData * pArchiveData, LPCWSTR szArchiveNa
                     // Log the handle for diagnostics
                     MSI_LOG_OPEN_HANDLE(hMsiDb);
 
+                    // Also open the compound file directly. If that fails,
+                    // we still can do everything through msi.dll
+                    if((pCompFile = new TCompoundFile()) != NULL)
+                    {
+                        if(pCompFile->Open(szArchiveName) != ERROR_SUCCESS)
+                        {
+                            delete pCompFile;
+                            pCompFile = NULL;
+                        }
+                    }
+
                     // Create the TMsiDatabase object
-                    if((pMsiDB = new TMsiDatabase(hMsiDb, wf.ftLastWriteTime)) != NULL)
+                    if((pMsiDB = new TMsiDatabase(hMsiDb, pCompFile, wf.ftLastWriteTime)) != NULL)
                     {
+                        // Let the database use the shared data and the listing cache
+                        if((g_cbSharedCache || g_bListingCache) && pCompFile != NULL)
+                        {
+                            std::tstring strCacheFile;
+                            MSI_CACHE_KEY CacheKey;
+
+                            if(MsiCacheMakeKey(szArchiveName, wf, pCompFile, CacheKey) == ERROR_SUCCESS)
+                            {
+                                if(g_cbSharedCache != 0)
+                                    pMsiDB->SetSharedData(MsiSharedCacheAcquire(CacheKey));
+                                if(g_bListingCache && MsiCacheFileName(g_szCacheDir, CacheKey, strCacheFile) == ERROR_SUCCESS)
+                                    pMsiDB->SetListingCache(strCacheFile.c_str(), CacheKey);
+                            }
+                        }
+
                         pArchiveData->OpenResult = 0;
                         return (HANDLE)(pMsiDB);
                     }
@@ -105,6 +156,7 @@ static HANDLE OpenArchiveAW(TOpenArchiveData * pArchiveData, LPCWSTR szArchiveNa
                     {
                         pArchiveData->OpenResult = E_NO_MEMORY;
                         MSI_CLOSE_HANDLE(hMsiDb);
+                        delete pCompFile;
                     }
                 }
                 FindClose(hFind);
@@ -137,7 +189,7 @@ int WINAPI CloseArchive(HANDLE hArchive)
     {
         // Force-close all loaded files
         pMsiDb->CloseAllFiles();
-        pMsiDb->UnlockAndRelease();
+        pMsiDb->Release();
 
         // Finally release the database
         pMsiDb->Release();
@@ -201,13 +253,83 @@ static int CallProcessDataProc(LPCWSTR szFullPath, int nSize)
     return TRUE;
 }
 
+static int WriteTargetFile(TFileWriter & Writer, TMsiFile * pMsiFile, LPCWSTR szFullPath)
+{
+    MSI_READ_CURSOR Cursor;
+    const BYTE * pbData = NULL;
+    DWORD dwLastProgress = GetTickCount();
+    DWORD dwUnreported = 0;
+    DWORD dwBytesRead = 0;
+    DWORD dwErrCode;
+    int nResult = 0;
+
+    // Tell Total Commader what we are doing
+    if(!CallProcessDataProc(szFullPath, 0))
+        return E_EABORTED;
+
+    // Read the next chunk while the previous one is being written
+    for(;;)
+    {
+        pbData = NULL;
+
+        // Data that are already in memory (mapped streams) are written
+        // directly from there. The rest is read to the writer's buffer
+        if((dwErrCode = pMsiFile->MapChunk(Cursor, Writer.WriteSize(), &pbData, &dwBytesRead)) == ERROR_NOT_SUPPORTED)
+            dwErrCode = pMsiFile->ReadChunk(Cursor, Writer.Buffer(), &dwBytesRead);
+        if(dwErrCode != ERROR_SUCCESS)
+        {
+            nResult = E_EREAD;
+            break;
+        }
+
+        // Are we done?
+        if(dwBytesRead == 0)
+            break;
+
+        // Start writing the chunk
+        if(pbData != NULL)
+            dwErrCode = Writer.WriteData(pbData, dwBytesRead);
+        else
+            dwErrCode = Writer.Write(dwBytesRead);
+        if(dwErrCode != ERROR_SUCCESS)
+        {
+            nResult = E_EWRITE;
+            break;
+        }
+        dwUnreported += dwBytesRead;
+
+        // Don't call the progress callback more often than needed.
+        // If the user cancels the operation, stop in the middle of the file.
+        if((GetTickCount() - dwLastProgress) >= PROGRESS_INTERVAL)
+        {
+            if(!CallProcessDataProc(szFullPath, dwUnreported))
+            {
+                nResult = E_EABORTED;
+                break;
+            }
+            dwLastProgress = GetTickCount();
+            dwUnreported = 0;
+        }
+    }
+
+    // The pending writes may use the data of the cursor,
+    // so they must be finished or cancelled before it is freed
+    if(nResult != 0)
+    {
+        Writer.Abort();
+        return nResult;
+    }
+
+    // Wait for all writes to finish
+    if(Writer.Close() != ERROR_SUCCESS)
+        return E_EWRITE;
+    return CallProcessDataProc(szFullPath, dwUnreported) ? 0 : E_EABORTED;
+}
+
 int WINAPI ProcessFileW(HANDLE hArchive, PROCESS_FILE_OPERATION nOperation, LPCWSTR szDestPath, LPCWSTR szDestName)
 {
     TMsiDatabase * pMsiDb;
     TMsiFile * pMsiFile;
-    HANDLE hLocFile = INVALID_HANDLE_VALUE;
-    DWORD dwBytesWritten;
-    DWORD dwFileOffset = 0;
     WCHAR szFullPath[MAX_PATH];
     int nResult = E_NOT_SUPPORTED;              // Result reported to Total Commander
 
@@ -217,58 +339,32 @@ int WINAPI ProcessFileW(HANDLE hArchive, PROCESS_FILE_OPERATION nOperation, LPCW
         // If verify or skip the file, do nothing
         if(nOperation == PK_TEST || nOperation == PK_SKIP)
         {
-            pMsiDb->UnlockAndRelease();
+            pMsiDb->FileSkipped();
+            pMsiDb->Release();
             return 0;
         }
 
         // Do we have to extract the file? If yes, the file must be saved in TMsiDatabase
         if(nOperation == PK_EXTRACT)
         {
+            // Files from the listing cache may need the real file list
+            if(pMsiDb->ReloadCachedFiles() != ERROR_SUCCESS)
+            {
+                pMsiDb->Release();
+                return E_BAD_ARCHIVE;
+            }
+
             if((pMsiFile = pMsiDb->LastFile()) != NULL)
             {
                 // Construct the full path name
                 MergePath(szFullPath, _countof(szFullPath), szDestPath, szDestName);
 
-                // Create the local file
-                hLocFile = CreateFile(szFullPath, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, 0, NULL);
-                if(hLocFile != INVALID_HANDLE_VALUE)
+                // Create the local file, preallocated to its final size if possible.
+                // If anything fails, the writer cancels the pending writes.
+                TFileWriter Writer;
+                if(Writer.Create(szFullPath, pMsiFile->FileSize()) == ERROR_SUCCESS)
                 {
-                    // Populate the cach with complete file data
-                    if(pMsiFile->LoadFileData() == ERROR_SUCCESS)
-                    {
-                        const MSI_BLOB & FileData = pMsiFile->FileData();
-
-                        // Tell Total Commader what we are doing
-                        while(CallProcessDataProc(szFullPath, dwFileOffset))
-                        {
-                            DWORD dwBytesToWrite = 0x1000;
-
-                            // Get the size of remaining data
-                            if((dwFileOffset + dwBytesToWrite) > FileData.cbData)
-                                dwBytesToWrite = FileData.cbData - dwFileOffset;
-
-                            // Are we done?
-                            if(dwBytesToWrite == 0)
-                            {
-                                nResult = 0;
-                                break;
-                            }
-
-                            // Write the target file
-                            if(!WriteFile(hLocFile, FileData.pbData + dwFileOffset, dwBytesToWrite, &dwBytesWritten, NULL))
-                            {
-                                nResult = E_EWRITE;
-                                break;
-                            }
-
-                            // Increment the total bytes
-                            dwFileOffset += dwBytesWritten;
-                        }
-                    }
-
-                    // Close the local file
-                    SetEndOfFile(hLocFile);
-                    CloseHandle(hLocFile);
+                    nResult = WriteTargetFile(Writer, pMsiFile, szFullPath);
                 }
                 else
                 {
@@ -280,8 +376,8 @@ int WINAPI ProcessFileW(HANDLE hArchive, PROCESS_FILE_OPERATION nOperation, LPCW
             }
         }
 
-        // Unlock and release the archive
-        pMsiDb->UnlockAndRelease();
+        // Release the archive
+        pMsiDb->Release();
     }
     return nResult;
 }
@@ -295,6 +391,16 @@ int WINAPI ProcessFile(HANDLE hArchive, PROCESS_FILE_OPERATION nOperation, LPCST
 // Totalcmd calls ReadHeader to find out what files are in the archive.
 // https://www.ghisler.ch/wiki/index.php?title=ReadHeader
 
+static void StoreFileSize(DWORD & dwTarget, ULONGLONG FileSize)
+{
+    dwTarget = (FileSize > 0xFFFFFFFF) ? 0xFFFFFFFF : (DWORD)(FileSize);
+}
+
+static void StoreFileSize(ULONGLONG & Target, ULONGLONG FileSize)
+{
+    Target = FileSize;
+}
+
 template <typename HDR>
 static void StoreFoundFile(TMsiFile * pMsiFile, HDR * pHeaderData, DOS_FTIME & fileTime)
 {
@@ -305,8 +411,8 @@ static void StoreFoundFile(TMsiFile * pMsiFile, HDR * pHeaderData, DOS_FTIME & f
     pHeaderData->FileTime = fileTime;
 
     // Store the file sizes
-    pHeaderData->PackSize = pMsiFile->FileSize();
-    pHeaderData->UnpSize = pMsiFile->FileSize();
+    StoreFileSize(pHeaderData->PackSize, pMsiFile->FileSize());
+    StoreFileSize(pHeaderData->UnpSize, pMsiFile->FileSize());
 
     // Store file attributes
     pHeaderData->FileAttr = FILE_ATTRIBUTE_ARCHIVE;
@@ -333,7 +439,7 @@ int ReadHeaderTemplate(HANDLE hArchive, HDR * pHeaderData)
             pMsiFile->Release();
             dwErrCode = 0;
         }
-        pMsiDb->UnlockAndRelease();
+        pMsiDb->Release();
     }
     return dwErrCode;
 }
@@ -447,16 +553,51 @@ void WINAPI ConfigurePacker(HWND hParent, HINSTANCE hDllInstance)
 // Commander >=5.51, but is ignored by older versions.
 // https://www.ghisler.ch/wiki/index.php?title=PackSetDefaultParams
 
+static void SetDefaultConfiguration()
+{
+    g_szCacheDir[0] = 0;
+    g_bListingCache = FALSE;
+    g_cbSharedCache = 64 * 1024 * 1024;
+    g_dwPrefetchFiles = 8;
+    g_cbPrefetchMemory = 32 * 1024 * 1024;
+}
+
+static void LoadConfiguration()
+{
+    LPTSTR szFileName;
+
+    // [wcx_msi]
+    // ListingCache=1           ; Remember the listings of the opened archives
+    // CacheDirectory=<path>    ; Where to store them. Default is "wcx_msi.cache" next to the INI file
+    // SharedCacheSize=64       ; Memory for the parsed data of the recently opened archives, in MB
+    // PrefetchFiles=8          ; Number of files loaded ahead during extraction. 0 disables it
+    // PrefetchMemory=32        ; Memory for the files loaded ahead, in MB
+    g_cbSharedCache = (size_t)(GetPrivateProfileInt(_T("wcx_msi"), _T("SharedCacheSize"), 64, g_szIniFile)) * 1024 * 1024;
+    g_dwPrefetchFiles = GetPrivateProfileInt(_T("wcx_msi"), _T("PrefetchFiles"), 8, g_szIniFile);
+    g_cbPrefetchMemory = (size_t)(GetPrivateProfileInt(_T("wcx_msi"), _T("PrefetchMemory"), 32, g_szIniFile)) * 1024 * 1024;
+    g_bListingCache = GetPrivateProfileInt(_T("wcx_msi"), _T("ListingCache"), 0, g_szIniFile) ? TRUE : FALSE;
+    GetPrivateProfileString(_T("wcx_msi"), _T("CacheDirectory"), _T(""), g_szCacheDir, _countof(g_szCacheDir), g_szIniFile);
+
+    // Default cache directory
+    if(g_szCacheDir[0] == 0)
+    {
+        StringCchCopy(g_szCacheDir, _countof(g_szCacheDir), g_szIniFile);
+        if((szFileName = _tcsrchr(g_szCacheDir, _T('\\'))) != NULL)
+            szFileName[0] = 0;
+        StringCchCat(g_szCacheDir, _countof(g_szCacheDir), _T("\\wcx_msi.cache"));
+    }
+}
+
 void WINAPI PackSetDefaultParams(TPackDefaultParamStruct * dps)
 {
     // Set default configuration.
-    //SetDefaultConfiguration();
+    SetDefaultConfiguration();
     g_szIniFile[0] = 0;
 
     // If INI file, load it from it too.
     if(dps != NULL && dps->DefaultIniName[0])
     {
         StringCchCopyX(g_szIniFile, _countof(g_szIniFile), dps->DefaultIniName);
-        //LoadConfiguration();
+        LoadConfiguration();
     }
 }
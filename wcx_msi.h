@@ -11,6 +11,7 @@
 #ifndef __WCX_MSI_H__
 #define __WCX_MSI_H__
 
+#ifdef _WIN32
 #pragma warning (disable: 4091)                 // 4091: 'typedef ': ignored on left of 'tagDTI_ADTIWUI' when no variable is declared
 #include <tchar.h>
 #include <stdio.h>
@@ -22,10 +23,21 @@
 
 #include <string>
 #include <vector>
+#include <list>
 
 #include "Utils.h"                              // Utility functions
 #include "TStringConvert.h"                     // String convertion functions
+#else
+#include "wcx_port.h"                           // Portability layer
+#endif
+
+#include "TMsiNative.h"                         // Native MSI storage classes
+#include "TCabinet.h"                           // Embedded cabinets
+
+#ifdef _WIN32
 #include "TMsi.h"                               // MSI classes
+#include "TFileWriter.h"                        // Writer of the extracted files
+#endif
 
 //-----------------------------------------------------------------------------
 // Defines
@@ -205,5 +217,10 @@ typedef struct
 extern HINSTANCE g_hInst;                   // Our DLL instance
 extern HANDLE g_hHeap;                      // Process heap
 extern TCHAR g_szIniFile[MAX_PATH];         // Packer INI file
+extern TCHAR g_szCacheDir[MAX_PATH];        // Directory of the listing cache
+extern DWORD g_bListingCache;               // TRUE if the listing cache is enabled
+extern size_t g_cbSharedCache;              // Memory budget of the shared data of the opened archives
+extern DWORD g_dwPrefetchFiles;             // Number of files whose streams are loaded ahead during extraction
+extern size_t g_cbPrefetchMemory;           // Memory budget of the streams loaded ahead
 
 #endif // __WCX_MSI_H__
@@ -0,0 +1,98 @@
+/*****************************************************************************/
+/* wcx_port.h                             Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Portability layer for building the native MSI core outside of Windows     */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 16.10.26  1.00  Lad  Created                                              */
+/*****************************************************************************/
+
+#ifndef __WCX_PORT_H__
+#define __WCX_PORT_H__
+
+#ifndef _WIN32
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+
+#include <string>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Windows data types used by the native MSI code
+
+typedef uint8_t             BYTE, *LPBYTE;
+typedef uint16_t            WORD, *LPWORD;
+typedef uint32_t            DWORD, *LPDWORD;
+typedef int32_t             LONG;
+typedef int                 INT;
+typedef unsigned int        UINT;
+typedef int                 BOOL;
+typedef uint64_t            ULONGLONG, *PULONGLONG;
+typedef int64_t             LONGLONG;
+typedef uintptr_t           DWORD_PTR;
+typedef void              * LPVOID;
+typedef const void        * LPCVOID;
+typedef void              * HANDLE;
+typedef void              * HINSTANCE;
+
+typedef char                CHAR;
+typedef char              * LPSTR;
+typedef const char        * LPCSTR;
+typedef char16_t            WCHAR;                  // MSI strings are always UTF-16
+typedef WCHAR             * LPWSTR;
+typedef const WCHAR       * LPCWSTR;
+typedef char                TCHAR;                  // File names are UTF-8
+typedef TCHAR             * LPTSTR;
+typedef const TCHAR       * LPCTSTR;
+
+struct FILETIME
+{
+    DWORD dwLowDateTime;
+    DWORD dwHighDateTime;
+};
+
+namespace std
+{
+    typedef string tstring;
+}
+
+//-----------------------------------------------------------------------------
+// Windows macros used by the native MSI code
+
+#define TRUE                1
+#define FALSE               0
+#define WINAPI
+#define MAX_PATH            260
+#define _T(x)               x
+#define _countof(x)         (sizeof(x) / sizeof(x[0]))
+#define CP_ACP              0
+#define CP_UTF8             65001
+
+//-----------------------------------------------------------------------------
+// Error codes. Values are the same like in <winerror.h>
+
+#define ERROR_SUCCESS               0
+#define ERROR_FILE_NOT_FOUND        2
+#define ERROR_ACCESS_DENIED         5
+#define ERROR_NOT_ENOUGH_MEMORY     8
+#define ERROR_BAD_FORMAT            11
+#define ERROR_INVALID_DATA          13
+#define ERROR_WRITE_FAULT           29
+#define ERROR_HANDLE_EOF            38
+#define ERROR_NOT_SUPPORTED         50
+#define ERROR_INVALID_PARAMETER     87
+#define ERROR_INSUFFICIENT_BUFFER   122
+#define ERROR_NO_MORE_ITEMS         259
+#define ERROR_CAN_NOT_COMPLETE      1003
+#define ERROR_CANCELLED             1223
+#define ERROR_FILE_CORRUPT          1392
+
+#endif // _WIN32
+#endif // __WCX_PORT_H__